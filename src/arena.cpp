@@ -0,0 +1,202 @@
+//------------------------------------------------------------------------------
+/// @brief SnuPL per-module memory arena
+/// @author Bernhard Egger <bernhard@csap.snu.ac.kr>
+/// @section changelog Change Log
+/// 2026/10/16 created: bump allocation of AST nodes, symbols, and TAC
+///
+///
+/// @section license_section License
+/// Copyright (c) 2012-2016, Bernhard Egger
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms,  with or without modifi-
+/// cation, are permitted provided that the following conditions are met:
+///
+/// - Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+/// - Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,  BUT NOT LIMITED TO,  THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY  AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER  OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT,  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSE-
+/// QUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF  SUBSTITUTE
+/// GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+/// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN  CONTRACT, STRICT
+/// LIABILITY, OR TORT  (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY
+/// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+/// DAMAGE.
+//------------------------------------------------------------------------------
+
+#include <cassert>
+#include <new>
+
+#include "arena.h"
+using namespace std;
+
+
+/// @brief round up to the arena's alignment
+static inline size_t Align(size_t size)
+{
+  return (size + 15) & ~(size_t)15;
+}
+
+
+//------------------------------------------------------------------------------
+// CArena
+//
+static thread_local CArena *_current = NULL;
+
+CArena::CHeader* const CArena::HeapObject = (CArena::CHeader*)1;
+
+CArena::CArena(size_t block_size)
+  : _cur(NULL), _end(NULL), _block_size(Align(block_size)), _first(NULL),
+    _last(NULL), _size(0), _objects(0), _reserved(0)
+{
+  assert(sizeof(CHeader) == Align(sizeof(CHeader)));
+}
+
+CArena::~CArena(void)
+{
+  Release();
+
+  for (size_t i=0; i<_block.size(); i++) delete [] _block[i];
+  if (_current == this) _current = NULL;
+}
+
+CArena* CArena::GetCurrent(void)
+{
+  return _current;
+}
+
+CArena* CArena::SetCurrent(CArena *arena)
+{
+  CArena *prev = _current;
+  _current = arena;
+  return prev;
+}
+
+void* CArena::Allocate(size_t size)
+{
+  size = Align(size > 0 ? size : 1);
+
+  if (size > _block_size / 4) {
+    _large.push_back(new char[size]);
+    _size += size;
+    return _large.back();
+  }
+
+  if ((size_t)(_end - _cur) < size) {
+    _block.push_back(new char[_block_size]);
+    _reserved += _block_size;
+    _cur = _block.back();
+    _end = _cur + _block_size;
+  }
+
+  void *p = _cur;
+  _cur += size;
+  _size += size;
+  return p;
+}
+
+void CArena::Release(void)
+{
+  // destroy the live objects in reverse order of allocation; objects may
+  // refer to objects allocated before them
+  while (_last != NULL) {
+    CHeader *h = _last;
+    _last = h->prev;
+    if (h->destroy != NULL) {
+      TDestructor destroy = h->destroy;
+      h->destroy = NULL;
+      destroy(h + 1);
+    }
+  }
+  _first = NULL;
+
+  // keep the first block for the next compilation
+  for (size_t i=1; i<_block.size(); i++) delete [] _block[i];
+  if (_block.size() > 1) _block.resize(1);
+  for (size_t i=0; i<_large.size(); i++) delete [] _large[i];
+  _large.clear();
+
+  _cur = _block.empty() ? NULL : _block[0];
+  _end = _block.empty() ? NULL : _block[0] + _block_size;
+  _reserved = _block.size() * _block_size;
+  _size = _objects = 0;
+}
+
+void CArena::Adopt(CArena *arena)
+{
+  assert((arena != NULL) && (arena != this) &&
+         (arena->_block_size == _block_size));
+
+  // the current block stays last so that allocation continues in it
+  if (_block.empty()) {
+    _block.swap(arena->_block);
+  } else {
+    _block.insert(_block.end()-1, arena->_block.begin(), arena->_block.end());
+    arena->_block.clear();
+  }
+  _large.insert(_large.end(), arena->_large.begin(), arena->_large.end());
+  arena->_large.clear();
+
+  if (arena->_first != NULL) {
+    arena->_first->prev = _last;
+    if (_first == NULL) _first = arena->_first;
+    _last = arena->_last;
+  }
+
+  _size += arena->_size;
+  _objects += arena->_objects;
+  _reserved += arena->_reserved;
+
+  arena->_cur = arena->_end = NULL;
+  arena->_first = arena->_last = NULL;
+  arena->_size = arena->_objects = arena->_reserved = 0;
+}
+
+void* CArena::New(size_t size, TDestructor destroy)
+{
+  CArena *arena = _current;
+  CHeader *h;
+
+  if (arena != NULL) {
+    h = (CHeader*)arena->Allocate(sizeof(CHeader) + size);
+    h->prev = arena->_last;
+    if (arena->_last == NULL) arena->_first = h;
+    arena->_last = h;
+    arena->_objects++;
+  } else {
+    h = (CHeader*)::operator new(sizeof(CHeader) + size);
+    h->prev = HeapObject;
+  }
+
+  h->destroy = destroy;
+
+  return h + 1;
+}
+
+void CArena::Delete(void *object)
+{
+  if (object == NULL) return;
+
+  CHeader *h = GetHeader(object);
+  if (h->prev == HeapObject) ::operator delete(h);
+  else h->destroy = NULL;
+}
+
+bool CArena::Owns(const void *object)
+{
+  assert(object != NULL);
+
+  return GetHeader(object)->prev != HeapObject;
+}
+
+CArena::CHeader* CArena::GetHeader(const void *object)
+{
+  return (CHeader*)object - 1;
+}
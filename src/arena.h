@@ -0,0 +1,225 @@
+//------------------------------------------------------------------------------
+/// @brief SnuPL per-module memory arena
+/// @author Bernhard Egger <bernhard@csap.snu.ac.kr>
+/// @section changelog Change Log
+/// 2026/10/16 created: bump allocation of AST nodes, symbols, and TAC
+///
+///
+/// @section license_section License
+/// Copyright (c) 2012-2016, Bernhard Egger
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms,  with or without modifi-
+/// cation, are permitted provided that the following conditions are met:
+///
+/// - Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+/// - Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,  BUT NOT LIMITED TO,  THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY  AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER  OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT,  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSE-
+/// QUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF  SUBSTITUTE
+/// GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+/// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN  CONTRACT, STRICT
+/// LIABILITY, OR TORT  (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY
+/// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+/// DAMAGE.
+//------------------------------------------------------------------------------
+
+#ifndef __SnuPL_ARENA_H__
+#define __SnuPL_ARENA_H__
+
+#include <cstddef>
+#include <vector>
+using namespace std;
+
+
+//------------------------------------------------------------------------------
+/// @brief memory arena
+///
+/// a bump allocator for the objects of one compilation (AST nodes, symbols,
+/// and three-address code). The classes of these objects overload operator
+/// new to allocate from the arena of the current thread if there is one and
+/// from the heap otherwise. Releasing the arena runs the destructors of its
+/// objects that are still alive and frees their memory in one step.
+///
+/// Arena objects are owned by the arena. Destructors must not delete arena
+/// objects they refer to; CArena::Dispose() deletes an object only if it
+/// has been allocated from the heap. Deleting an arena object explicitly
+/// runs its destructor, the memory is reclaimed when the arena is released.
+///
+class CArena {
+  public:
+    /// @brief destructor of an arena object
+    typedef void (*TDestructor)(void *object);
+
+    /// @name construction/destruction
+    /// @{
+
+    /// @brief constructor
+    ///
+    /// @param block_size size of the memory blocks
+    CArena(size_t block_size = 1 << 16);
+
+    /// @brief destructor (releases the arena)
+    ~CArena(void);
+
+    /// @}
+
+    /// @name current arena
+    /// @{
+
+    /// @brief return the arena of the calling thread (or NULL)
+    static CArena* GetCurrent(void);
+
+    /// @brief set the arena of the calling thread
+    ///
+    /// @param arena arena (NULL to allocate from the heap)
+    /// @retval previous arena of the calling thread
+    static CArena* SetCurrent(CArena *arena);
+
+    /// @}
+
+    /// @name allocation
+    /// @{
+
+    /// @brief allocate raw memory
+    ///
+    /// @param size number of bytes
+    /// @retval memory aligned to 16 bytes
+    void* Allocate(size_t size);
+
+    /// @brief run the destructors of all live objects and free the memory
+    void Release(void);
+
+    /// @brief take over the memory and the objects of another arena
+    ///
+    /// collects the objects that worker threads have allocated from their
+    /// own arenas into the arena of the compilation. The adopted objects
+    /// count as allocated after the objects of this arena. @a arena is left
+    /// empty.
+    ///
+    /// @param arena arena with the same block size
+    void Adopt(CArena *arena);
+
+    /// @brief return the size of the memory blocks
+    size_t GetBlockSize(void) const { return _block_size; };
+
+    /// @brief allocate an object from the current arena or the heap
+    ///
+    /// used by the class-specific operator new of arena objects.
+    ///
+    /// @param size size of the object
+    /// @param destroy function that runs the object's destructor (NULL:
+    ///        none, e.g., for raw memory)
+    /// @retval memory for the object
+    static void* New(size_t size, TDestructor destroy);
+
+    /// @brief free an object allocated by New()
+    ///
+    /// used by the class-specific operator delete of arena objects. The
+    /// memory of arena objects is reclaimed when the arena is released.
+    ///
+    /// @param object object (after its destructor has run)
+    static void Delete(void *object);
+
+    /// @brief check whether an object has been allocated from an arena
+    ///
+    /// @param object object allocated by New()
+    static bool Owns(const void *object);
+
+    /// @brief delete an object unless it is owned by an arena
+    ///
+    /// @param object object allocated by New() (or NULL)
+    template<class T>
+    static void Dispose(T *object)
+    {
+      if ((object != NULL) && !Owns(object)) delete object;
+    };
+
+    /// @}
+
+    /// @name statistics
+    /// @{
+
+    /// @brief return the number of bytes allocated since the last release
+    size_t GetSize(void) const { return _size; };
+
+    /// @brief return the number of objects allocated since the last release
+    size_t GetObjects(void) const { return _objects; };
+
+    /// @brief return the number of bytes reserved for blocks
+    size_t GetReserved(void) const { return _reserved; };
+
+    /// @}
+
+  private:
+    /// @brief header preceding every object allocated by New()
+    struct CHeader {
+      CHeader *prev;                ///< previously allocated arena object
+                                    ///< (HeapObject: allocated from the heap)
+      TDestructor destroy;          ///< destructor (NULL: destroyed)
+    };
+
+    /// @brief CHeader::prev of objects allocated from the heap
+    static CHeader* const HeapObject;
+
+    /// @brief return the header of an object
+    static CHeader* GetHeader(const void *object);
+
+    vector<char*> _block;           ///< memory blocks (last: current)
+    vector<char*> _large;           ///< allocations larger than a block
+    char   *_cur;                   ///< next free byte in the current block
+    char   *_end;                   ///< end of the current block
+    size_t  _block_size;            ///< size of the memory blocks
+    CHeader *_first;                ///< first allocated object
+    CHeader *_last;                 ///< most recently allocated object
+    size_t  _size;                  ///< number of bytes allocated
+    size_t  _objects;               ///< number of objects allocated
+    size_t  _reserved;              ///< number of bytes reserved for blocks
+};
+
+
+//------------------------------------------------------------------------------
+/// @brief arena allocator
+///
+/// STL allocator for the containers of arena objects (e.g., the arguments of
+/// a call node). The elements are allocated with CArena::New() from the
+/// current arena, i.e., next to the object owning the container, or from the
+/// heap if there is no current arena.
+///
+template<class T>
+class CArenaAllocator {
+  public:
+    typedef T value_type;
+
+    CArenaAllocator(void) {};
+
+    template<class U>
+    CArenaAllocator(const CArenaAllocator<U> &) {};
+
+    /// @brief allocate memory for @a n elements
+    T* allocate(size_t n) { return (T*)CArena::New(n*sizeof(T), NULL); };
+
+    /// @brief free memory allocated by allocate()
+    void deallocate(T *p, size_t) { CArena::Delete(p); };
+};
+
+template<class T, class U>
+bool operator==(const CArenaAllocator<T>&, const CArenaAllocator<U>&)
+{
+  return true;
+}
+
+template<class T, class U>
+bool operator!=(const CArenaAllocator<T>&, const CArenaAllocator<U>&)
+{
+  return false;
+}
+
+#endif // __SnuPL_ARENA_H__
@@ -39,25 +39,132 @@
 #include <cstring>
 
 #include <typeinfo>
+#include <algorithm>
 
 #include "ast.h"
+#include "compilation.h"
 using namespace std;
 
 
 //------------------------------------------------------------------------------
-// CAstNode
+// expression walks
+//
+// the passes over expressions use explicit stacks instead of recursion; the
+// parser accepts expressions of any width and depth, and so must the passes
+// that follow it.
 //
-int CAstNode::_global_id = 0;
 
-CAstNode::CAstNode(CToken token)
-  : _token(token), _addr(NULL)
+/// @brief check whether a node is an expression
+static bool IsExpression(const CAstNode *n)
+{
+  return n->GetKind() >= akBinaryOp;
+}
+
+/// @brief return the number of operands of an expression
+static size_t NumOperands(const CAstExpression *e)
+{
+  switch (e->GetKind()) {
+    case akBinaryOp:
+      return 2;
+    case akUnaryOp:
+    case akSpecialOp:
+      return 1;
+    case akFunctionCall:
+      return static_cast<const CAstFunctionCall*>(e)->GetNArgs();
+    case akArrayDesignator:
+      return static_cast<const CAstArrayDesignator*>(e)->GetNIndices();
+    default:
+      return 0;
+  }
+}
+
+/// @brief return the @a i-th operand of an expression
+static CAstExpression* GetOperand(const CAstExpression *e, size_t i)
+{
+  switch (e->GetKind()) {
+    case akBinaryOp: {
+      const CAstBinaryOp *b = static_cast<const CAstBinaryOp*>(e);
+      return i == 0 ? b->GetLeft() : b->GetRight();
+    }
+    case akUnaryOp:
+      return static_cast<const CAstUnaryOp*>(e)->GetOperand();
+    case akSpecialOp:
+      return static_cast<const CAstSpecialOp*>(e)->GetOperand();
+    case akFunctionCall:
+      return static_cast<const CAstFunctionCall*>(e)->GetArg((int)i);
+    case akArrayDesignator:
+      return static_cast<const CAstArrayDesignator*>(e)->GetIndex((int)i);
+    default:
+      assert(false);
+      return NULL;
+  }
+}
+
+/// @brief position of a walk in an expression
+struct CExprVisit {
+  CExprVisit(const CAstExpression *x, int i=0)
+    : e(x), indent(i), next(0), failed(false) {};
+
+  const CAstExpression *e;          ///< expression
+  int        indent;                ///< indentation (output)
+  size_t     next;                  ///< next operand to visit
+  bool       failed;                ///< an operand has a type error
+};
+
+/// @brief delete an AST node unless it is owned by an arena
+///
+/// the destructors of the nodes delete their children with DisposeNode().
+/// While a node is deleted, the children are queued and deleted one after
+/// the other instead of recursively.
+static void DisposeNode(CAstNode *n)
+{
+  static thread_local vector<CAstNode*> *pending = NULL;
+
+  if ((n == NULL) || CArena::Owns(n)) return;
+
+  if (pending != NULL) {
+    pending->push_back(n);
+    return;
+  }
+
+  vector<CAstNode*> queue(1, n);
+  pending = &queue;
+  while (!queue.empty()) {
+    n = queue.back();
+    queue.pop_back();
+    delete n;
+  }
+  pending = NULL;
+}
+
+
+//------------------------------------------------------------------------------
+// CAstNode
+//
+CAstNode::CAstNode(CToken token, EAstKind kind)
+  : _pos(token.GetPosition()), _kind(kind)
 {
-  _id = _global_id++;
+  _id = CCompilation::GetCurrent()->NextNodeID();
 }
 
 CAstNode::~CAstNode(void)
 {
-  if (_addr != NULL) delete _addr;
+}
+
+/// @brief run the destructor of an arena-allocated node
+static void DestroyNode(void *p)
+{
+  static_cast<CAstNode*>(p)->~CAstNode();
+}
+
+void* CAstNode::operator new(size_t size)
+{
+  return CArena::New(size, DestroyNode);
+}
+
+void CAstNode::operator delete(void *p)
+{
+  CArena::Delete(p);
 }
 
 int CAstNode::GetID(void) const
@@ -67,7 +174,7 @@ int CAstNode::GetID(void) const
 
 CToken CAstNode::GetToken(void) const
 {
-  return _token;
+  return CToken(_pos, tUndefined);
 }
 
 const CType* CAstNode::GetType(void) const
@@ -94,9 +201,70 @@ void CAstNode::toDot(ostream &out, int indent) const
   out << ind << dotID() << dotAttr() << ";" << endl;
 }
 
-CTacAddr* CAstNode::GetTacAddr(void) const
+/// @brief print a node (without the operands of an expression)
+static ostream& PrintNode(const CAstNode *n, ostream &out, int indent)
+{
+  switch (n->GetKind()) {
+    case akModule:
+    case akProcedure:
+      return static_cast<const CAstScope*>(n)->printNode(out, indent);
+    case akType:
+      return static_cast<const CAstType*>(n)->printNode(out, indent);
+    case akStatAssign:
+      return static_cast<const CAstStatAssign*>(n)->printNode(out, indent);
+    case akStatCall:
+      return static_cast<const CAstStatCall*>(n)->printNode(out, indent);
+    case akStatReturn:
+      return static_cast<const CAstStatReturn*>(n)->printNode(out, indent);
+    case akStatIf:
+      return static_cast<const CAstStatIf*>(n)->printNode(out, indent);
+    case akStatBreak:
+      return static_cast<const CAstStatBreak*>(n)->printNode(out, indent);
+    case akStatWhile:
+      return static_cast<const CAstStatWhile*>(n)->printNode(out, indent);
+    case akBinaryOp:
+      return static_cast<const CAstBinaryOp*>(n)->printNode(out, indent);
+    case akUnaryOp:
+      return static_cast<const CAstUnaryOp*>(n)->printNode(out, indent);
+    case akSpecialOp:
+      return static_cast<const CAstSpecialOp*>(n)->printNode(out, indent);
+    case akFunctionCall:
+      return static_cast<const CAstFunctionCall*>(n)->printNode(out, indent);
+    case akDesignator:
+      return static_cast<const CAstDesignator*>(n)->printNode(out, indent);
+    case akArrayDesignator:
+      return static_cast<const CAstArrayDesignator*>(n)->printNode(out,
+                                                                    indent);
+    case akConstant:
+      return static_cast<const CAstConstant*>(n)->printNode(out, indent);
+    case akStringConstant:
+      return static_cast<const CAstStringConstant*>(n)->printNode(out,
+                                                                   indent);
+  }
+
+  assert(false);
+  return out;
+}
+
+ostream& CAstNode::print(ostream &out, int indent) const
 {
-  return _addr;
+  if (!IsExpression(this)) return PrintNode(this, out, indent);
+
+  // pre-order: a node, then its operands indented below it
+  vector<CExprVisit> stack(1, CExprVisit(static_cast<const CAstExpression*>
+                                           (this), indent));
+
+  while (!stack.empty()) {
+    CExprVisit v = stack.back();
+    stack.pop_back();
+
+    PrintNode(v.e, out, v.indent);
+    for (size_t i=NumOperands(v.e); i>0; i--) {
+      stack.push_back(CExprVisit(GetOperand(v.e, i-1), v.indent+2));
+    }
+  }
+
+  return out;
 }
 
 ostream& operator<<(ostream &out, const CAstNode &t)
@@ -109,11 +277,455 @@ ostream& operator<<(ostream &out, const CAstNode *t)
   return t->print(out);
 }
 
+//------------------------------------------------------------------------------
+// statement walks
+//
+// if and while statements nest statement sequences to any depth. Like the
+// expression walks, the passes over statements keep the open sequences on an
+// explicit stack; the work of a pass is done in the hooks of a CStatWalk.
+//
+
+/// @brief delete the statements of a statement sequence
+static void DisposeStatements(const CAstStatSeq &statseq)
+{
+  for (size_t i=0; i<statseq.size(); i++) DisposeNode(statseq[i]);
+}
+
+/// @brief return the number of bodies (statement sequences) of a statement
+static int NumBodies(const CAstStatement *s)
+{
+  switch (s->GetKind()) {
+    case akStatIf:    return 2;
+    case akStatWhile: return 1;
+    default:          return 0;
+  }
+}
+
+/// @brief return the @a i-th body of an if or while statement
+static const CAstStatSeq& GetBody(const CAstStatement *s, int i)
+{
+  if (s->GetKind() == akStatWhile) {
+    return static_cast<const CAstStatWhile*>(s)->GetBody();
+  }
+
+  const CAstStatIf *is = static_cast<const CAstStatIf*>(s);
+  return i == 0 ? is->GetIfBody() : is->GetElseBody();
+}
+
+/// @brief return the condition of an if or while statement
+static CAstExpression* GetCondition(const CAstStatement *s)
+{
+  if (s->GetKind() == akStatWhile) {
+    return static_cast<const CAstStatWhile*>(s)->GetCondition();
+  }
+  return static_cast<const CAstStatIf*>(s)->GetCondition();
+}
+
+/// @brief check that the condition of an if or while statement is boolean
+static bool CheckCondition(const CAstStatement *s, CToken *t, string *msg)
+{
+  CAstExpression *cond = GetCondition(s);
+
+  if (!cond->GetType()->Match(CTypeManager::Get()->GetBool())) {
+    if (t != NULL) *t = cond->GetToken();
+    if (msg != NULL) *msg = "expected boolean type condition";
+    return false;
+  }
+  return true;
+}
+
+/// @brief check the expressions of a simple statement and collect all their
+///        type errors (see CAstExpression::TypeCheckAll())
+static bool TypeCheckAllExpressions(const CAstStatement *s,
+                                    vector<CSourceError> *errors)
+{
+  CAstExpression *e[2] = { NULL, NULL };
+
+  switch (s->GetKind()) {
+    case akStatAssign:
+      e[0] = static_cast<const CAstStatAssign*>(s)->GetLHS();
+      e[1] = static_cast<const CAstStatAssign*>(s)->GetRHS();
+      break;
+    case akStatCall:
+      e[0] = static_cast<const CAstStatCall*>(s)->GetCall();
+      break;
+    case akStatReturn:
+      e[0] = static_cast<const CAstStatReturn*>(s)->GetExpression();
+      break;
+    default:
+      break;
+  }
+
+  bool chk = true;
+  for (int i=0; i<2; i++) {
+    if ((e[i] != NULL) && !e[i]->TypeCheckAll(errors)) chk = false;
+  }
+  return chk;
+}
+
+/// @brief hooks of a statement walk (see WalkStatements())
+class CStatWalk {
+  public:
+    virtual ~CStatWalk(void) {};
+
+    /// @brief visit a statement before its bodies
+    /// @retval true to continue the walk, false to stop it
+    virtual bool Enter(CAstStatement *s) = 0;
+
+    /// @brief visit the @a i-th body of @a s before its statements
+    virtual void Body(CAstStatement *s, int i) {};
+
+    /// @brief visit a statement after its bodies
+    /// @retval true to continue the walk, false to stop it
+    virtual bool Leave(CAstStatement *s) { return true; };
+};
+
+/// @brief position of a walk in a statement sequence
+struct CStatVisit {
+  CStatVisit(CAstStatement *o, CAstStatement *const *s, size_t n)
+    : owner(o), body(-1), stats(s), nstats(n), next(0) {};
+
+  CAstStatement *owner;             ///< statement owning the sequence
+  int        body;                  ///< body of owner
+  CAstStatement *const *stats;      ///< statements
+  size_t     nstats;                ///< number of statements
+  size_t     next;                  ///< next statement to visit
+};
+
+/// @brief walk the statements @a stats[0..n) and their bodies in source order
+/// @retval true if the walk has completed
+/// @retval false if a hook has stopped it
+static bool WalkStatements(CAstStatement *const *stats, size_t n,
+                           CStatWalk *w)
+{
+  vector<CStatVisit> stack(1, CStatVisit(NULL, stats, n));
+
+  while (!stack.empty()) {
+    CStatVisit &v = stack.back();
+
+    if (v.next < v.nstats) {
+      CAstStatement *s = v.stats[v.next++];
+      if (!w->Enter(s)) return false;
+      stack.push_back(CStatVisit(s, NULL, 0));
+      continue;
+    }
+
+    CAstStatement *s = v.owner;
+    if ((s != NULL) && (v.body+1 < NumBodies(s))) {
+      const CAstStatSeq &body = GetBody(s, ++v.body);
+      v.stats = body.data();
+      v.nstats = body.size();
+      v.next = 0;
+      w->Body(s, v.body);
+      continue;
+    }
+
+    stack.pop_back();
+    if ((s != NULL) && !w->Leave(s)) return false;
+  }
+
+  return true;
+}
+
+/// @brief walk a statement sequence (see WalkStatements())
+static bool WalkStatements(const CAstStatSeq &statseq, CStatWalk *w)
+{
+  return WalkStatements(statseq.data(), statseq.size(), w);
+}
+
+/// @brief walk a single statement (see WalkStatements())
+static bool WalkStatement(const CAstStatement *s, CStatWalk *w)
+{
+  CAstStatement *stat = const_cast<CAstStatement*>(s);
+  return WalkStatements(&stat, 1, w);
+}
+
+/// @brief statement walk: print
+class CPrintWalk : public CStatWalk {
+  public:
+    CPrintWalk(ostream &out, int indent) : _out(out), _indent(1, indent) {};
+
+    virtual bool Enter(CAstStatement *s)
+    {
+      int indent = _indent.back();
+
+      if (NumBodies(s) == 0) {
+        PrintNode(s, _out, indent);
+        return true;
+      }
+
+      _out << string(indent, ' ')
+           << (s->GetKind() == akStatIf ? "if" : "while") << " cond" << endl;
+      GetCondition(s)->print(_out, indent+2);
+      _indent.push_back(indent+2);
+      return true;
+    }
+
+    virtual void Body(CAstStatement *s, int i)
+    {
+      string ind(_indent.back()-2, ' ');
+
+      if (s->GetKind() == akStatWhile) _out << ind << "while-body" << endl;
+      else _out << ind << (i == 0 ? "if-body" : "else-body") << endl;
+      if (GetBody(s, i).empty()) _out << ind << "  empty." << endl;
+    }
+
+    virtual bool Leave(CAstStatement *s)
+    {
+      if (NumBodies(s) > 0) _indent.pop_back();
+      return true;
+    }
+
+  private:
+    ostream &_out;                  ///< output stream
+    vector<int> _indent;            ///< indentation of the open sequences
+};
+
+/// @brief statement walk: dot format
+///
+/// each statement of a sequence is linked to its predecessor, the first one
+/// to the owner of the sequence
+class CDotWalk : public CStatWalk {
+  public:
+    CDotWalk(ostream &out, int indent, string from)
+      : _out(out), _ind(indent, ' '), _from(1, from) {};
+
+    virtual bool Enter(CAstStatement *s)
+    {
+      int indent = (int)_ind.size();
+
+      if (NumBodies(s) == 0) {
+        s->toDot(_out, indent);
+        return true;
+      }
+
+      CAstExpression *cond = GetCondition(s);
+      s->CAstNode::toDot(_out, indent);
+      cond->toDot(_out, indent);
+      _out << _ind << s->dotID() << "->" << cond->dotID() << ";" << endl;
+      return true;
+    }
+
+    virtual void Body(CAstStatement *s, int i)
+    {
+      if (i > 0) _from.pop_back();
+      _from.push_back(s->dotID());
+    }
+
+    virtual bool Leave(CAstStatement *s)
+    {
+      if (NumBodies(s) > 0) _from.pop_back();
+      if (!_from.back().empty()) {
+        _out << _ind << _from.back() << " -> " << s->dotID()
+             << " [style=dotted];" << endl;
+      }
+      _from.back() = s->dotID();
+      return true;
+    }
+
+  private:
+    ostream &_out;                  ///< output stream
+    string  _ind;                   ///< indentation
+    vector<string> _from;           ///< predecessors in the open sequences
+};
+
+/// @brief statement walk: type checking, stops at the first error
+class CTypeCheckWalk : public CStatWalk {
+  public:
+    CTypeCheckWalk(CToken *t, string *msg) : _t(t), _msg(msg) {};
+
+    virtual bool Enter(CAstStatement *s)
+    {
+      if (NumBodies(s) == 0) return s->TypeCheck(_t, _msg);
+      return GetCondition(s)->TypeCheck(_t, _msg);
+    }
+
+    virtual bool Leave(CAstStatement *s)
+    {
+      return (NumBodies(s) == 0) || CheckCondition(s, _t, _msg);
+    }
+
+  private:
+    CToken *_t;                     ///< type error at token
+    string *_msg;                   ///< type error message
+};
+
+/// @brief statement walk: type checking, collects all errors
+///
+/// all operands of the expressions are checked, and the bodies of a compound
+/// statement are checked even if its condition is erroneous. A statement
+/// with an erroneous expression is not checked itself.
+class CTypeCheckAllWalk : public CStatWalk {
+  public:
+    CTypeCheckAllWalk(vector<CSourceError> *errors) : _errors(errors) {};
+
+    virtual bool Enter(CAstStatement *s)
+    {
+      CToken t;
+      string msg;
+
+      if (NumBodies(s) == 0) {
+        if (TypeCheckAllExpressions(s, _errors) && !s->TypeCheck(&t, &msg)) {
+          _errors->push_back(CSourceError(t, msg));
+        }
+        return true;
+      }
+
+      _cond.push_back(GetCondition(s)->TypeCheckAll(_errors));
+      return true;
+    }
+
+    virtual bool Leave(CAstStatement *s)
+    {
+      CToken t;
+      string msg;
+
+      if (NumBodies(s) == 0) return true;
+
+      bool chk = _cond.back();
+      _cond.pop_back();
+      if (chk && !CheckCondition(s, &t, &msg)) {
+        _errors->push_back(CSourceError(t, msg));
+      }
+      return true;
+    }
+
+  private:
+    vector<CSourceError> *_errors;  ///< type errors
+    vector<bool> _cond;             ///< conditions of the open statements
+};
+
+/// @brief statement walk: conversion into TAC
+///
+/// every statement of a sequence is followed by its own 'next' label; a
+/// single statement can be given its 'next' label by the caller.
+class CTacWalk : public CStatWalk {
+  public:
+    CTacWalk(CCodeBlock *cb, CTacLabel *end, CTacLabel *next=NULL)
+      : _cb(cb), _end(end), _next(next) {};
+
+    virtual bool Enter(CAstStatement *s)
+    {
+      CLabels l;
+      l.end = _labels.empty() ? _end : _labels.back().inner;
+      l.own = (_next == NULL) || !_labels.empty();
+      l.next = l.own ? _cb->CreateLabel() : _next;
+      l.inner = l.end;
+
+      switch (s->GetKind()) {
+        case akStatIf:
+          // if, else, end
+          for (int i=0; i<3; i++) l.l[i] = _cb->CreateLabel();
+          GetCondition(s)->ToTac(_cb, l.l[0], l.l[1]);
+          _cb->AddInstr(l.l[0]);
+          break;
+
+        case akStatWhile:
+          // condition, body, loop end
+          for (int i=0; i<3; i++) l.l[i] = _cb->CreateLabel();
+          _cb->AddInstr(l.l[0]);
+          GetCondition(s)->ToTac(_cb, l.l[1], l.l[2]);
+          _cb->AddInstr(l.l[1]);
+          l.inner = l.l[2];
+          break;
+
+        default:
+          s->ToTac(_cb, l.next, l.end);
+          break;
+      }
+
+      _labels.push_back(l);
+      return true;
+    }
+
+    virtual void Body(CAstStatement *s, int i)
+    {
+      // skip the else-body after the if-body
+      if (i == 1) {
+        CLabels &l = _labels.back();
+        _cb->AddInstr(new CTacInstr(opGoto, l.l[2]));
+        _cb->AddInstr(l.l[1]);
+      }
+    }
+
+    virtual bool Leave(CAstStatement *s)
+    {
+      CLabels l = _labels.back();
+      _labels.pop_back();
+
+      switch (s->GetKind()) {
+        case akStatIf:
+          _cb->AddInstr(l.l[2]);
+          _cb->AddInstr(new CTacInstr(opGoto, l.next));
+          break;
+
+        case akStatWhile:
+          _cb->AddInstr(new CTacInstr(opGoto, l.l[0]));
+          _cb->AddInstr(l.l[2]);
+          _cb->AddInstr(new CTacInstr(opGoto, l.next));
+          break;
+
+        default:
+          break;
+      }
+
+      if (l.own) _cb->AddInstr(l.next);
+      return true;
+    }
+
+  private:
+    /// @brief labels of an open statement
+    struct CLabels {
+      CTacLabel *next;              ///< next statement
+      CTacLabel *end;               ///< end of the enclosing loop
+      CTacLabel *inner;             ///< end of the loop around the bodies
+      CTacLabel *l[3];              ///< labels of an if or while statement
+      bool own;                     ///< 'next' is added by the walk
+    };
+
+    CCodeBlock *_cb;                ///< code block
+    CTacLabel *_end;                ///< end of the enclosing loop (or NULL)
+    CTacLabel *_next;               ///< next label of a single statement
+    vector<CLabels> _labels;        ///< labels of the open statements
+};
+
+/// @brief print the statements of a statement sequence ("empty." if none)
+static void PrintStatements(ostream &out, int indent,
+                            const CAstStatSeq &statseq)
+{
+  CPrintWalk w(out, indent);
+
+  if (statseq.empty()) out << string(indent, ' ') << "empty." << endl;
+  WalkStatements(statseq, &w);
+}
+
+/// @brief print the statements of a statement sequence in dot format, linked
+///        to the node with ID @a from
+static void StatementsToDot(ostream &out, int indent, string from,
+                            const CAstStatSeq &statseq)
+{
+  CDotWalk w(out, indent, from);
+  WalkStatements(statseq, &w);
+}
+
+/// @brief convert the statements of a statement sequence into TAC
+/// @param cb code block
+/// @param statseq statements
+/// @param end label of the end of the enclosing loop (or NULL)
+static void StatementsToTac(CCodeBlock *cb, const CAstStatSeq &statseq,
+                            CTacLabel *end)
+{
+  CTacWalk w(cb, end);
+  WalkStatements(statseq, &w);
+}
+
+
 //------------------------------------------------------------------------------
 // CAstScope
 //
-CAstScope::CAstScope(CToken t, const string name, CAstScope *parent)
-  : CAstNode(t), _name(name), _symtab(NULL), _parent(parent), _statseq(NULL),
+CAstScope::CAstScope(CToken t, const string name, CAstScope *parent,
+                     EAstKind kind)
+  : CAstNode(t, kind), _name(name), _symtab(NULL), _parent(parent),
     _cb(NULL)
 {
   if (_parent != NULL) _parent->AddChild(this);
@@ -122,7 +734,7 @@ CAstScope::CAstScope(CToken t, const string name, CAstScope *parent)
 CAstScope::~CAstScope(void)
 {
   delete _symtab;
-  delete _statseq;
+  DisposeStatements(_statseq);
   delete _cb;
 }
 
@@ -147,32 +759,44 @@ CAstScope* CAstScope::GetChild(size_t i) const
   return _children[i];
 }
 
+void CAstScope::InsertChild(CAstScope *child, size_t i)
+{
+  assert(child != NULL);
+
+  RemoveChild(child);
+
+  assert(i <= _children.size());
+  _children.insert(_children.begin() + i, child);
+}
+
+void CAstScope::RemoveChild(CAstScope *child)
+{
+  vector<CAstScope*>::iterator it = find(_children.begin(), _children.end(),
+                                         child);
+  if (it != _children.end()) _children.erase(it);
+}
+
 CSymtab* CAstScope::GetSymbolTable(void) const
 {
   assert(_symtab != NULL);
   return _symtab;
 }
 
-void CAstScope::SetStatementSequence(CAstStatement *statseq)
+void CAstScope::SetStatementSequence(const vector<CAstStatement*> &statseq)
 {
-  _statseq = statseq;
+  DisposeStatements(_statseq);
+  _statseq.assign(statseq.begin(), statseq.end());
 }
 
-CAstStatement* CAstScope::GetStatementSequence(void) const
+const CAstStatSeq& CAstScope::GetStatementSequence(void) const
 {
   return _statseq;
 }
 
 bool CAstScope::TypeCheck(CToken *t, string *msg) const
 {
-  bool result = true;
+  bool result = TypeCheckStatements(t, msg);
   try {
-    CAstStatement *s = _statseq;
-    // check for all statements in the statement sequence
-    while (result && (s != NULL)) {
-      result = s->TypeCheck(t, msg);
-      s = s->GetNext();
-    }
     // check for all scopes in the children
     vector<CAstScope*>::const_iterator it = _children.begin();
     while (result && (it != _children.end())) {
@@ -185,7 +809,41 @@ bool CAstScope::TypeCheck(CToken *t, string *msg) const
   return result;
 }
 
-ostream& CAstScope::print(ostream &out, int indent) const
+bool CAstScope::TypeCheckStatements(CToken *t, string *msg) const
+{
+  bool result = true;
+  try {
+    // check for all statements in the statement sequence
+    CTypeCheckWalk w(t, msg);
+    result = WalkStatements(_statseq, &w);
+  } catch (...) {
+    result = false;
+  }
+  return result;
+}
+
+bool CAstScope::TypeCheckAll(vector<CSourceError> *errors) const
+{
+  bool result = TypeCheckStatementsAll(errors);
+
+  // check for all scopes in the children
+  for (size_t i=0; i<_children.size(); i++) {
+    if (!_children[i]->TypeCheckAll(errors)) result = false;
+  }
+
+  return result;
+}
+
+bool CAstScope::TypeCheckStatementsAll(vector<CSourceError> *errors) const
+{
+  size_t nerrors = errors->size();
+  CTypeCheckAllWalk w(errors);
+
+  WalkStatements(_statseq, &w);
+  return errors->size() == nerrors;
+}
+
+ostream& CAstScope::printNode(ostream &out, int indent) const
 {
   string ind(indent, ' ');
 
@@ -193,15 +851,7 @@ ostream& CAstScope::print(ostream &out, int indent) const
   out << ind << "  symbol table:" << endl;
   _symtab->print(out, indent+4);
   out << ind << "  statement list:" << endl;
-  CAstStatement *s = GetStatementSequence();
-  if (s != NULL) {
-    do {
-      s->print(out, indent+4);
-      s = s->GetNext();
-    } while (s != NULL);
-  } else {
-    out << ind << "    empty." << endl;
-  }
+  PrintStatements(out, indent+4, _statseq);
 
   out << ind << "  nested scopes:" << endl;
   if (_children.size() > 0) {
@@ -221,17 +871,7 @@ void CAstScope::toDot(ostream &out, int indent) const
   string ind(indent, ' ');
 
   CAstNode::toDot(out, indent);
-
-  CAstStatement *s = GetStatementSequence();
-  if (s != NULL) {
-    string prev = dotID();
-    do {
-      s->toDot(out, indent);
-      out << ind << prev << " -> " << s->dotID() << " [style=dotted];" << endl;
-      prev = s->dotID();
-      s = s->GetNext();
-    } while (s != NULL);
-  }
+  StatementsToDot(out, indent, dotID(), _statseq);
 
   vector<CAstScope*>::const_iterator it = _children.begin();
   while (it != _children.end()) {
@@ -245,17 +885,12 @@ void CAstScope::toDot(ostream &out, int indent) const
 CTacAddr* CAstScope::ToTac(CCodeBlock *cb)
 {
   assert(cb != NULL);
-  // add statement three address code until there is no statement
-  CAstStatement *s = GetStatementSequence();
-  while (s != NULL) {
-    CTacLabel *next = cb->CreateLabel();
-    s->ToTac(cb, next, NULL);
-    cb->AddInstr(next);
-    s = s->GetNext();
-  }
+  // add the three address code of the statements
+  StatementsToTac(cb, _statseq, NULL);
 
-  // clean up control flow
+  // clean up control flow and build the control flow graph
   cb->CleanupControlFlow();
+  cb->BuildCFG();
   return NULL;
 }
 
@@ -280,7 +915,7 @@ void CAstScope::AddChild(CAstScope *child)
 // CAstModule
 //
 CAstModule::CAstModule(CToken t, const string name)
-  : CAstScope(t, name, NULL)
+  : CAstScope(t, name, NULL, akModule)
 {
   SetSymbolTable(new CSymtab());
 }
@@ -302,7 +937,7 @@ string CAstModule::dotAttr(void) const
 //
 CAstProcedure::CAstProcedure(CToken t, const string name,
                              CAstScope *parent, CSymProc *symbol)
-  : CAstScope(t, name, parent), _symbol(symbol)
+  : CAstScope(t, name, parent, akProcedure), _symbol(symbol)
 {
   assert(GetParent() != NULL);
   SetSymbolTable(new CSymtab(GetParent()->GetSymbolTable()));
@@ -334,7 +969,7 @@ string CAstProcedure::dotAttr(void) const
 // CAstType
 //
 CAstType::CAstType(CToken t, const CType *type)
-  : CAstNode(t), _type(type)
+  : CAstNode(t, akType), _type(type)
 {
   assert(type != NULL);
 }
@@ -344,7 +979,7 @@ const CType* CAstType::GetType(void) const
   return _type;
 }
 
-ostream& CAstType::print(ostream &out, int indent) const
+ostream& CAstType::printNode(ostream &out, int indent) const
 {
   string ind(indent, ' ');
 
@@ -356,31 +991,61 @@ ostream& CAstType::print(ostream &out, int indent) const
 //------------------------------------------------------------------------------
 // CAstStatement
 //
-CAstStatement::CAstStatement(CToken token)
-  : CAstNode(token), _next(NULL)
-{
-}
-
-CAstStatement::~CAstStatement(void)
-{
-  delete _next;
+CAstStatement::CAstStatement(CToken token, EAstKind kind)
+  : CAstNode(token, kind)
+{
+}
+
+bool CAstStatement::TypeCheck(CToken *t, string *msg) const
+{
+  switch (GetKind()) {
+    case akStatAssign:
+      return static_cast<const CAstStatAssign*>(this)->TypeCheckNode(t, msg);
+    case akStatCall:
+      return static_cast<const CAstStatCall*>(this)->TypeCheckNode(t, msg);
+    case akStatReturn:
+      return static_cast<const CAstStatReturn*>(this)->TypeCheckNode(t, msg);
+    case akStatIf:
+      return static_cast<const CAstStatIf*>(this)->TypeCheckNode(t, msg);
+    case akStatBreak:
+      return static_cast<const CAstStatBreak*>(this)->TypeCheckNode(t, msg);
+    case akStatWhile:
+      return static_cast<const CAstStatWhile*>(this)->TypeCheckNode(t, msg);
+    default:
+      assert(false);
+      return false;
+  }
 }
 
-void CAstStatement::SetNext(CAstStatement *next)
+bool CAstStatement::TypeCheckAll(vector<CSourceError> *errors) const
 {
-  _next = next;
-}
+  size_t nerrors = errors->size();
+  CTypeCheckAllWalk w(errors);
 
-CAstStatement* CAstStatement::GetNext(void) const
-{
-  return _next;
+  WalkStatement(this, &w);
+  return errors->size() == nerrors;
 }
 
 CTacAddr* CAstStatement::ToTac(CCodeBlock *cb, CTacLabel *next, CTacLabel* end)
 {
-  // nothing done
-  cb->AddInstr(new CTacInstr(opGoto, next));
-  return NULL;
+  switch (GetKind()) {
+    case akStatAssign:
+      return static_cast<CAstStatAssign*>(this)->ToTacNode(cb, next, end);
+    case akStatCall:
+      return static_cast<CAstStatCall*>(this)->ToTacNode(cb, next, end);
+    case akStatReturn:
+      return static_cast<CAstStatReturn*>(this)->ToTacNode(cb, next, end);
+    case akStatIf:
+      return static_cast<CAstStatIf*>(this)->ToTacNode(cb, next, end);
+    case akStatBreak:
+      return static_cast<CAstStatBreak*>(this)->ToTacNode(cb, next, end);
+    case akStatWhile:
+      return static_cast<CAstStatWhile*>(this)->ToTacNode(cb, next, end);
+    default:
+      // nothing done
+      cb->AddInstr(new CTacInstr(opGoto, next));
+      return NULL;
+  }
 }
 
 
@@ -389,12 +1054,18 @@ CTacAddr* CAstStatement::ToTac(CCodeBlock *cb, CTacLabel *next, CTacLabel* end)
 //
 CAstStatAssign::CAstStatAssign(CToken t,
                                CAstDesignator *lhs, CAstExpression *rhs)
-  : CAstStatement(t), _lhs(lhs), _rhs(rhs)
+  : CAstStatement(t, akStatAssign), _lhs(lhs), _rhs(rhs)
 {
   assert(lhs != NULL);
   assert(rhs != NULL);
 }
 
+CAstStatAssign::~CAstStatAssign(void)
+{
+  DisposeNode(_lhs);
+  DisposeNode(_rhs);
+}
+
 CAstDesignator* CAstStatAssign::GetLHS(void) const
 {
   return _lhs;
@@ -405,7 +1076,7 @@ CAstExpression* CAstStatAssign::GetRHS(void) const
   return _rhs;
 }
 
-bool CAstStatAssign::TypeCheck(CToken *t, string *msg) const
+bool CAstStatAssign::TypeCheckNode(CToken *t, string *msg) const
 {
   bool chk = _lhs->TypeCheck(t, msg) && _rhs->TypeCheck(t, msg);
   if (!chk) return false;
@@ -433,7 +1104,7 @@ const CType* CAstStatAssign::GetType(void) const
   return _lhs->GetType();
 }
 
-ostream& CAstStatAssign::print(ostream &out, int indent) const
+ostream& CAstStatAssign::printNode(ostream &out, int indent) const
 {
   string ind(indent, ' ');
 
@@ -467,7 +1138,8 @@ void CAstStatAssign::toDot(ostream &out, int indent) const
   out << ind << dotID() << "->" << _rhs->dotID() << ";" << endl;
 }
 
-CTacAddr* CAstStatAssign::ToTac(CCodeBlock *cb, CTacLabel *next, CTacLabel* end)
+CTacAddr* CAstStatAssign::ToTacNode(CCodeBlock *cb, CTacLabel *next,
+                                    CTacLabel* end)
 {
   // add three address code of left hand side, right hand side
   //     assignment instruction
@@ -483,22 +1155,27 @@ CTacAddr* CAstStatAssign::ToTac(CCodeBlock *cb, CTacLabel *next, CTacLabel* end)
 // CAstStatCall
 //
 CAstStatCall::CAstStatCall(CToken t, CAstFunctionCall *call)
-  : CAstStatement(t), _call(call)
+  : CAstStatement(t, akStatCall), _call(call)
 {
   assert(call != NULL);
 }
 
+CAstStatCall::~CAstStatCall(void)
+{
+  DisposeNode(_call);
+}
+
 CAstFunctionCall* CAstStatCall::GetCall(void) const
 {
   return _call;
 }
 
-bool CAstStatCall::TypeCheck(CToken *t, string *msg) const
+bool CAstStatCall::TypeCheckNode(CToken *t, string *msg) const
 {
   return GetCall()->TypeCheck(t, msg);
 }
 
-ostream& CAstStatCall::print(ostream &out, int indent) const
+ostream& CAstStatCall::printNode(ostream &out, int indent) const
 {
   _call->print(out, indent);
 
@@ -520,7 +1197,8 @@ void CAstStatCall::toDot(ostream &out, int indent) const
   _call->toDot(out, indent);
 }
 
-CTacAddr* CAstStatCall::ToTac(CCodeBlock *cb, CTacLabel *next, CTacLabel* end)
+CTacAddr* CAstStatCall::ToTacNode(CCodeBlock *cb, CTacLabel *next,
+                                  CTacLabel* end)
 {
   // add three address code of call
   GetCall()->ToTac(cb);
@@ -533,11 +1211,16 @@ CTacAddr* CAstStatCall::ToTac(CCodeBlock *cb, CTacLabel *next, CTacLabel* end)
 // CAstStatReturn
 //
 CAstStatReturn::CAstStatReturn(CToken t, CAstScope *scope, CAstExpression *expr)
-  : CAstStatement(t), _scope(scope), _expr(expr)
+  : CAstStatement(t, akStatReturn), _scope(scope), _expr(expr)
 {
   assert(scope != NULL);
 }
 
+CAstStatReturn::~CAstStatReturn(void)
+{
+  DisposeNode(_expr);
+}
+
 CAstScope* CAstStatReturn::GetScope(void) const
 {
   return _scope;
@@ -548,7 +1231,7 @@ CAstExpression* CAstStatReturn::GetExpression(void) const
   return _expr;
 }
 
-bool CAstStatReturn::TypeCheck(CToken *t, string *msg) const
+bool CAstStatReturn::TypeCheckNode(CToken *t, string *msg) const
 {
   const CType *st = GetScope()->GetType();
   CAstExpression *e = GetExpression();
@@ -587,7 +1270,7 @@ const CType* CAstStatReturn::GetType(void) const
   return t;
 }
 
-ostream& CAstStatReturn::print(ostream &out, int indent) const
+ostream& CAstStatReturn::printNode(ostream &out, int indent) const
 {
   string ind(indent, ' ');
 
@@ -620,7 +1303,8 @@ void CAstStatReturn::toDot(ostream &out, int indent) const
   }
 }
 
-CTacAddr* CAstStatReturn::ToTac(CCodeBlock *cb, CTacLabel *next, CTacLabel* end)
+CTacAddr* CAstStatReturn::ToTacNode(CCodeBlock *cb, CTacLabel *next,
+                                    CTacLabel* end)
 {
   // check if expression exists
   // add retrun instruction
@@ -639,74 +1323,47 @@ CTacAddr* CAstStatReturn::ToTac(CCodeBlock *cb, CTacLabel *next, CTacLabel* end)
 // CAstStatIf
 //
 CAstStatIf::CAstStatIf(CToken t, CAstExpression *cond,
-                       CAstStatement *ifBody, CAstStatement *elseBody)
-  : CAstStatement(t), _cond(cond), _ifBody(ifBody), _elseBody(elseBody)
+                       const vector<CAstStatement*> &ifBody,
+                       const vector<CAstStatement*> &elseBody)
+  : CAstStatement(t, akStatIf), _cond(cond),
+    _ifBody(ifBody.begin(), ifBody.end()),
+    _elseBody(elseBody.begin(), elseBody.end())
 {
   assert(cond != NULL);
 }
 
+CAstStatIf::~CAstStatIf(void)
+{
+  DisposeNode(_cond);
+  DisposeStatements(_ifBody);
+  DisposeStatements(_elseBody);
+}
+
 CAstExpression* CAstStatIf::GetCondition(void) const
 {
   return _cond;
 }
 
-CAstStatement* CAstStatIf::GetIfBody(void) const
+const CAstStatSeq& CAstStatIf::GetIfBody(void) const
 {
   return _ifBody;
 }
 
-CAstStatement* CAstStatIf::GetElseBody(void) const
+const CAstStatSeq& CAstStatIf::GetElseBody(void) const
 {
   return _elseBody;
 }
 
-bool CAstStatIf::TypeCheck(CToken *t, string *msg) const
+bool CAstStatIf::TypeCheckNode(CToken *t, string *msg) const
 {
-  // check recursively
-  bool chk = _cond->TypeCheck(t, msg);
-  CAstStatement *n = _ifBody;
-  while (chk && n != NULL){
-    chk = n->TypeCheck(t, msg);
-    n = n->GetNext();
-  }
-  n = _elseBody;
-  if (chk && n != NULL){
-    chk = n->TypeCheck(t, msg);
-    n = n->GetNext();
-  }
-  if (!chk) return false;
-  CTypeManager *tm = CTypeManager::Get();
-  if (!_cond->GetType()->Match(tm->GetBool())) { // condition must be boolean
-    if (t != NULL) *t = _cond->GetToken();
-    if (msg != NULL) *msg = "expected boolean type condition";
-    return false;
-  }
-  return true;
+  CTypeCheckWalk w(t, msg);
+  return WalkStatement(this, &w);
 }
 
-ostream& CAstStatIf::print(ostream &out, int indent) const
+ostream& CAstStatIf::printNode(ostream &out, int indent) const
 {
-  string ind(indent, ' ');
-
-  out << ind << "if cond" << endl;
-  _cond->print(out, indent+2);
-  out << ind << "if-body" << endl;
-  if (_ifBody != NULL) {
-    CAstStatement *s = _ifBody;
-    do {
-      s->print(out, indent+2);
-      s = s->GetNext();
-    } while (s != NULL);
-  } else out << ind << "  empty." << endl;
-  out << ind << "else-body" << endl;
-  if (_elseBody != NULL) {
-    CAstStatement *s = _elseBody;
-    do {
-      s->print(out, indent+2);
-      s = s->GetNext();
-    } while (s != NULL);
-  } else out << ind << "  empty." << endl;
-
+  CPrintWalk w(out, indent);
+  WalkStatement(this, &w);
   return out;
 }
 
@@ -716,256 +1373,516 @@ string CAstStatIf::dotAttr(void) const
 }
 
 void CAstStatIf::toDot(ostream &out, int indent) const
+{
+  CDotWalk w(out, indent, "");
+  WalkStatement(this, &w);
+}
+
+CTacAddr* CAstStatIf::ToTacNode(CCodeBlock *cb, CTacLabel *next,
+                                CTacLabel* end)
+{
+  CTacWalk w(cb, end, next);
+  WalkStatement(this, &w);
+  return NULL;
+}
+
+//------------------------------------------------------------------------------
+// CAstStatBreak
+//
+CAstStatBreak::CAstStatBreak(CToken t)
+  : CAstStatement(t, akStatBreak)
+{
+}
+
+bool CAstStatBreak::TypeCheckNode(CToken *t, string *msg) const
+{
+  return true; // doesn't need any type check
+}
+
+
+ostream& CAstStatBreak::printNode(ostream &out, int indent) const
 {
   string ind(indent, ' ');
 
-  CAstNode::toDot(out, indent);
+  out << ind << "break" << endl;
 
-  _cond->toDot(out, indent);
-  out << ind << dotID() << "->" << _cond->dotID() << ";" << endl;
-
-  if (_ifBody != NULL) {
-    CAstStatement *s = _ifBody;
-    if (s != NULL) {
-      string prev = dotID();
-      do {
-        s->toDot(out, indent);
-        out << ind << prev << " -> " << s->dotID() << " [style=dotted];"
-            << endl;
-        prev = s->dotID();
-        s = s->GetNext();
-      } while (s != NULL);
-    }
-  }
+  return out;
+}
 
-  if (_elseBody != NULL) {
-    CAstStatement *s = _elseBody;
-    if (s != NULL) {
-      string prev = dotID();
-      do {
-        s->toDot(out, indent);
-        out << ind << prev << " -> " << s->dotID() << " [style=dotted];"
-            << endl;
-        prev = s->dotID();
-        s = s->GetNext();
-      } while (s != NULL);
-    }
-  }
+string CAstStatBreak::dotAttr(void) const
+{
+  ostringstream out;
+  out << " [label=\"" << "break" << "\",shape=ellipse]";
+  return out.str();
 }
 
-CTacAddr* CAstStatIf::ToTac(CCodeBlock *cb, CTacLabel *next, CTacLabel* end)
-{
-  // prepare labels
-  CTacLabel* ifLabel = cb->CreateLabel();
-  CTacLabel* elseLabel = cb->CreateLabel();
-  CTacLabel* endLabel = cb->CreateLabel();
-  CAstStatement *ifStats = GetIfBody();
-  CAstStatement *elseStats = GetElseBody();
-
-  // add three address code of condition with true, false labels
-  _cond->ToTac(cb, ifLabel, elseLabel);
-  cb->AddInstr(ifLabel);
-  // add three address code of statements until
-  while (ifStats != NULL) {
-    CTacLabel *next = cb->CreateLabel();
-    ifStats->ToTac(cb, next, end);
-    cb->AddInstr(next);
-    ifStats = ifStats->GetNext();
-  }
-  // skip else label after adding if statements, jump to end label
-  cb->AddInstr(new CTacInstr(opGoto, endLabel));
-  cb->AddInstr(elseLabel);
-  // add three address code of statements until
-  while (elseStats != NULL) {
-    CTacLabel *next = cb->CreateLabel();
-    elseStats->ToTac(cb, next, end);
-    cb->AddInstr(next);
-    elseStats = elseStats->GetNext();
-  }
-  cb->AddInstr(endLabel);
-  cb->AddInstr(new CTacInstr(opGoto, next));
+CTacAddr* CAstStatBreak::ToTacNode(CCodeBlock *cb, CTacLabel *next,
+                                   CTacLabel* end)
+{
+  assert(end != NULL);
+  // go to the end of the loop
+  cb->AddInstr(new CTacInstr(opGoto, end));
   return NULL;
 }
 
+
 //------------------------------------------------------------------------------
-// CAstStatBreak
+// CAstStatWhile
+//
+CAstStatWhile::CAstStatWhile(CToken t, CAstExpression *cond,
+                             const vector<CAstStatement*> &body)
+  : CAstStatement(t, akStatWhile), _cond(cond), _body(body.begin(), body.end())
+{
+  assert(cond != NULL);
+}
+
+CAstStatWhile::~CAstStatWhile(void)
+{
+  DisposeNode(_cond);
+  DisposeStatements(_body);
+}
+
+CAstExpression* CAstStatWhile::GetCondition(void) const
+{
+  return _cond;
+}
+
+const CAstStatSeq& CAstStatWhile::GetBody(void) const
+{
+  return _body;
+}
+
+bool CAstStatWhile::TypeCheckNode(CToken *t, string *msg) const
+{
+  CTypeCheckWalk w(t, msg);
+  return WalkStatement(this, &w);
+}
+
+ostream& CAstStatWhile::printNode(ostream &out, int indent) const
+{
+  CPrintWalk w(out, indent);
+  WalkStatement(this, &w);
+  return out;
+}
+
+string CAstStatWhile::dotAttr(void) const
+{
+  return " [label=\"while\",shape=box]";
+}
+
+void CAstStatWhile::toDot(ostream &out, int indent) const
+{
+  CDotWalk w(out, indent, "");
+  WalkStatement(this, &w);
+}
+
+CTacAddr* CAstStatWhile::ToTacNode(CCodeBlock *cb, CTacLabel *next,
+                                   CTacLabel* end)
+{
+  CTacWalk w(cb, end, next);
+  WalkStatement(this, &w);
+  return NULL;
+}
+
+
+//------------------------------------------------------------------------------
+// CAstExpression
 //
-CAstStatBreak::CAstStatBreak(CToken t)
-  : CAstStatement(t)
+CAstExpression::CAstExpression(CToken t, EAstKind kind)
+  : CAstNode(t, kind), _typed(false), _type(NULL)
 {
 }
 
-bool CAstStatBreak::TypeCheck(CToken *t, string *msg) const
+const CType* CAstExpression::GetType(void) const
 {
-  return true; // doesn't need any type check
-}
+  if (_typed) return _type;
 
+  // post-order over the untyped nodes
+  vector<CExprVisit> stack(1, CExprVisit(this));
 
-ostream& CAstStatBreak::print(ostream &out, int indent) const
-{
-  string ind(indent, ' ');
+  while (!stack.empty()) {
+    const CAstExpression *e = stack.back().e;
+    size_t i = stack.back().next++;
 
-  out << ind << "break" << endl;
+    if (i < NumOperands(e)) {
+      const CAstExpression *o = GetOperand(e, i);
+      if (!o->_typed) stack.push_back(CExprVisit(o));
+      continue;
+    }
 
-  return out;
-}
+    e->_type = e->ComputeType();
+    e->_typed = true;
+    stack.pop_back();
+  }
 
-string CAstStatBreak::dotAttr(void) const
-{
-  ostringstream out;
-  out << " [label=\"" << "break" << "\",shape=ellipse]";
-  return out.str();
+  return _type;
 }
 
-CTacAddr* CAstStatBreak::ToTac(CCodeBlock *cb, CTacLabel *next, CTacLabel* end)
+const CType* CAstExpression::ComputeType(void) const
 {
-  assert(end != NULL);
-  // go to the end of the loop
-  cb->AddInstr(new CTacInstr(opGoto, end));
   return NULL;
 }
 
-
-//------------------------------------------------------------------------------
-// CAstStatWhile
-//
-CAstStatWhile::CAstStatWhile(CToken t,
-                             CAstExpression *cond, CAstStatement *body)
-  : CAstStatement(t), _cond(cond), _body(body)
+void CAstExpression::SetType(const CType *type)
 {
-  assert(cond != NULL);
+  _type = type;
+  _typed = true;
 }
 
-CAstExpression* CAstStatWhile::GetCondition(void) const
+void CAstExpression::ResetType(void)
 {
-  return _cond;
+  _type = NULL;
+  _typed = false;
 }
 
-CAstStatement* CAstStatWhile::GetBody(void) const
+/// @brief type check an expression node (its operands have been checked)
+static bool TypeCheckNode(const CAstExpression *e, CToken *t, string *msg)
 {
-  return _body;
+  switch (e->GetKind()) {
+    case akBinaryOp:
+      return static_cast<const CAstBinaryOp*>(e)->TypeCheckNode(t, msg);
+    case akUnaryOp:
+      return static_cast<const CAstUnaryOp*>(e)->TypeCheckNode(t, msg);
+    case akSpecialOp:
+      return static_cast<const CAstSpecialOp*>(e)->TypeCheckNode(t, msg);
+    case akFunctionCall:
+      return static_cast<const CAstFunctionCall*>(e)->TypeCheckNode(t, msg);
+    case akDesignator:
+      return static_cast<const CAstDesignator*>(e)->TypeCheckNode(t, msg);
+    case akArrayDesignator:
+      return static_cast<const CAstArrayDesignator*>(e)->TypeCheckNode(t, msg);
+    case akConstant:
+      return static_cast<const CAstConstant*>(e)->TypeCheckNode(t, msg);
+    case akStringConstant:
+      return static_cast<const CAstStringConstant*>(e)->TypeCheckNode(t, msg);
+    default:
+      assert(false);
+      return false;
+  }
 }
 
-bool CAstStatWhile::TypeCheck(CToken *t, string *msg) const
+bool CAstExpression::TypeCheck(CToken *t, string *msg) const
 {
-  // check recursively
-  bool chk = _cond->TypeCheck(t, msg);
-  CAstStatement *n = _body;
-  while (chk && n != NULL){
-    chk = n->TypeCheck(t, msg);
-    n = n->GetNext();
-  }
-  if (!chk) return false;
+  // post-order: the operands are checked (and typed) before their operation
+  vector<CExprVisit> stack(1, CExprVisit(this));
 
-  CTypeManager *tm = CTypeManager::Get();
-  if (!_cond->GetType()->Match(tm->GetBool())) { // condition must be boolean
-    if (t != NULL) *t = _cond->GetToken();
-    if (msg != NULL) *msg = "expected boolean type condition";
-    return false;
+  while (!stack.empty()) {
+    const CAstExpression *e = stack.back().e;
+    size_t i = stack.back().next++;
+
+    if (i < NumOperands(e)) {
+      stack.push_back(CExprVisit(GetOperand(e, i)));
+      continue;
+    }
+
+    if (!TypeCheckNode(e, t, msg)) return false;
+    stack.pop_back();
   }
+
   return true;
 }
 
-ostream& CAstStatWhile::print(ostream &out, int indent) const
+bool CAstExpression::TypeCheckAll(vector<CSourceError> *errors) const
 {
-  string ind(indent, ' ');
+  vector<CExprVisit> stack(1, CExprVisit(this));
 
-  out << ind << "while cond" << endl;
-  _cond->print(out, indent+2);
-  out << ind << "while-body" << endl;
-  if (_body != NULL) {
-    CAstStatement *s = _body;
-    do {
-      s->print(out, indent+2);
-      s = s->GetNext();
-    } while (s != NULL);
-  }
-  else out << ind << "  empty." << endl;
+  while (!stack.empty()) {
+    const CAstExpression *e = stack.back().e;
+    size_t i = stack.back().next++;
 
-  return out;
-}
+    if (i < NumOperands(e)) {
+      stack.push_back(CExprVisit(GetOperand(e, i)));
+      continue;
+    }
 
-string CAstStatWhile::dotAttr(void) const
-{
-  return " [label=\"while\",shape=box]";
+    // an operation with an erroneous operand would only repeat the error
+    bool failed = stack.back().failed;
+    if (!failed) {
+      CToken t;
+      string msg;
+
+      failed = !TypeCheckNode(e, &t, &msg);
+      if (failed) errors->push_back(CSourceError(t, msg));
+    }
+
+    stack.pop_back();
+    if (failed) {
+      if (stack.empty()) return false;
+      stack.back().failed = true;
+    }
+  }
+
+  return true;
 }
 
-void CAstStatWhile::toDot(ostream &out, int indent) const
+void CAstExpression::toDot(ostream &out, int indent) const
 {
   string ind(indent, ' ');
 
-  CAstNode::toDot(out, indent);
+  // a node, then each operand followed by the edge to it
+  vector<CExprVisit> stack(1, CExprVisit(this));
 
-  _cond->toDot(out, indent);
-  out << ind << dotID() << "->" << _cond->dotID() << ";" << endl;
-
-  if (_body != NULL) {
-    CAstStatement *s = _body;
-    if (s != NULL) {
-      string prev = dotID();
-      do {
-        s->toDot(out, indent);
-        out << ind << prev << " -> " << s->dotID() << " [style=dotted];"
-            << endl;
-        prev = s->dotID();
-        s = s->GetNext();
-      } while (s != NULL);
+  while (!stack.empty()) {
+    const CAstExpression *e = stack.back().e;
+    size_t i = stack.back().next++;
+
+    if (i == 0) e->CAstNode::toDot(out, indent);
+
+    if (i < NumOperands(e)) {
+      stack.push_back(CExprVisit(GetOperand(e, i)));
+      continue;
+    }
+
+    stack.pop_back();
+    if (!stack.empty()) {
+      const CAstExpression *p = stack.back().e;
+      out << ind << p->dotID()
+          << (p->GetKind() == akArrayDesignator ? "-> " : "->")
+          << e->dotID() << ";" << endl;
     }
   }
 }
 
-CTacAddr* CAstStatWhile::ToTac(CCodeBlock *cb, CTacLabel *next, CTacLabel* end)
-{
-  // prepare labels
-  CTacLabel* re = cb->CreateLabel();
-  CTacLabel* body = cb->CreateLabel();
-  CAstStatement *s = GetBody();
-  CTacLabel* loopEnd = cb->CreateLabel();
-
-  // mark return label
-  cb->AddInstr(re);
-  // add three address code of condtion with true, false label
-  _cond->ToTac(cb, body, loopEnd);
-  cb->AddInstr(body);
-  while (s != NULL) {
-    CTacLabel *next = cb->CreateLabel();
-    s->ToTac(cb, next, loopEnd);
-    cb->AddInstr(next);
-    s = s->GetNext();
+/// @brief step of the conversion of an expression into TAC
+///
+/// converts expression e into a value (ltrue == NULL) or into jumps to
+/// ltrue and lfalse. A step that needs the code of an operand pushes a step
+/// for the operand and continues in its next phase once the operand's
+/// step is done; the values of the operands are passed on a value stack.
+///
+struct CTacStep {
+  CTacStep(CAstExpression *x, CTacLabel *lt, CTacLabel *lf)
+    : e(x), ltrue(lt), lfalse(lf), phase(0), ret(NULL) {};
+
+  CAstExpression *e;                ///< expression
+  CTacLabel  *ltrue;                ///< jump target if true (NULL: value)
+  CTacLabel  *lfalse;               ///< jump target if false
+  int        phase;                 ///< number of completed phases
+  CTacAddr   *ret;                  ///< result of a boolean value or a call
+  CTacLabel  *label[3];             ///< labels of a boolean value or && / ||
+  CArrayAddress addr;               ///< address of an array element
+};
+
+/// @brief convert an expression into TAC
+///
+/// the temporaries, labels, and instructions are created in the order of
+/// a recursive descent.
+///
+/// @param cb code block
+/// @param e expression
+/// @param ltrue jump target if true (NULL: convert into a value)
+/// @param lfalse jump target if false
+/// @retval CTacAddr* value of the expression (NULL if converted into jumps)
+static CTacAddr* ExpressionToTac(CCodeBlock *cb, CAstExpression *e,
+                                 CTacLabel *ltrue, CTacLabel *lfalse)
+{
+  CTypeManager *tm = CTypeManager::Get();
+  vector<CTacStep> steps(1, CTacStep(e, ltrue, lfalse));
+  vector<CTacAddr*> vals;
+
+  while (!steps.empty()) {
+    CTacStep *s = &steps.back();
+    int phase = s->phase++;
+    bool value = s->ltrue == NULL;
+
+    // the operand to convert next (or NULL if the step is done), and the
+    // value of the step
+    CAstExpression *next = NULL;
+    CTacLabel *nt = NULL, *nf = NULL;
+    CTacAddr *res = NULL;
+
+    EAstKind kind = s->e->GetKind();
+    EOperation oper = opNop;
+    if ((kind == akBinaryOp) || (kind == akUnaryOp) || (kind == akSpecialOp)) {
+      oper = static_cast<CAstOperation*>(s->e)->GetOperation();
+    }
+
+    if (value && (((kind == akBinaryOp) &&
+                   tm->GetBool()->Match(s->e->GetType())) ||
+                  ((kind == akUnaryOp) && (oper == opNot)))) {
+      // boolean operations are converted into jumps that assign the value
+      if (phase == 0) {
+        s->ret = cb->CreateTemp(tm->GetBool());
+        for (int l=0; l<3; l++) s->label[l] = cb->CreateLabel();
+        next = s->e; nt = s->label[0]; nf = s->label[1];
+      } else {
+        cb->AddInstr(s->label[0]);
+        cb->AddInstr(new CTacInstr(opAssign, s->ret, new CTacConst(1)));
+        cb->AddInstr(new CTacInstr(opGoto, s->label[2]));
+        cb->AddInstr(s->label[1]);
+        cb->AddInstr(new CTacInstr(opAssign, s->ret, new CTacConst(0)));
+        cb->AddInstr(s->label[2]);
+        res = s->ret;
+      }
+    } else switch (kind) {
+      case akBinaryOp: {
+        CAstBinaryOp *b = static_cast<CAstBinaryOp*>(s->e);
+        if (!value && ((oper == opAnd) || (oper == opOr))) {
+          // the right operand is evaluated only if the left one does not
+          // decide the result
+          if (phase == 0) {
+            s->label[0] = cb->CreateLabel();
+            next = b->GetLeft();
+            nt = oper == opAnd ? s->label[0] : s->ltrue;
+            nf = oper == opAnd ? s->lfalse : s->label[0];
+          } else if (phase == 1) {
+            cb->AddInstr(s->label[0]);
+            next = b->GetRight(); nt = s->ltrue; nf = s->lfalse;
+          }
+        } else if (phase < 2) {
+          next = phase == 0 ? b->GetLeft() : b->GetRight();
+        } else {
+          CTacAddr *rhs = vals.back(); vals.pop_back();
+          CTacAddr *lhs = vals.back(); vals.pop_back();
+          if (value) {
+            CTacTemp *ret = cb->CreateTemp(b->GetType());
+            cb->AddInstr(new CTacInstr(oper, ret, lhs, rhs));
+            res = ret;
+          } else {
+            // relational operation
+            assert(tm->GetBool()->Match(b->GetType()));
+            cb->AddInstr(new CTacInstr(oper, s->ltrue, lhs, rhs));
+            cb->AddInstr(new CTacInstr(opGoto, s->lfalse));
+          }
+        }
+        break;
+      }
+
+      case akUnaryOp: {
+        CAstUnaryOp *u = static_cast<CAstUnaryOp*>(s->e);
+        if (!value) {
+          // opNot: swap the targets
+          assert(tm->GetBool()->Match(u->GetType()));
+          if (phase == 0) {
+            next = u->GetOperand(); nt = s->lfalse; nf = s->ltrue;
+          }
+        } else if (phase == 0) {
+          next = u->GetOperand();
+        } else {
+          res = vals.back(); vals.pop_back();
+          if (oper == opNeg) {
+            CTacTemp *ret = cb->CreateTemp(u->GetType());
+            cb->AddInstr(new CTacInstr(oper, ret, res));
+            res = ret;
+          }
+        }
+        break;
+      }
+
+      case akSpecialOp:
+        // special operations are not used as conditions
+        if (!value) break;
+        if (phase == 0) {
+          next = static_cast<CAstSpecialOp*>(s->e)->GetOperand();
+        } else {
+          CTacAddr *operand = vals.back(); vals.pop_back();
+          CTacTemp *ret = cb->CreateTemp(s->e->GetType());
+          cb->AddInstr(new CTacInstr(oper, ret, operand));
+          res = ret;
+        }
+        break;
+
+      case akFunctionCall:
+      case akArrayDesignator:
+        if (!value) {
+          // compare the value with true
+          assert(tm->GetBool()->Match(s->e->GetType()));
+          if (phase == 0) {
+            next = s->e;
+          } else {
+            CTacAddr *v = vals.back(); vals.pop_back();
+            cb->AddInstr(new CTacInstr(opEqual, s->ltrue, v, new CTacConst(1)));
+            cb->AddInstr(new CTacInstr(opGoto, s->lfalse));
+          }
+        } else if (kind == akFunctionCall) {
+          // the arguments are passed from the last to the first
+          CAstFunctionCall *f = static_cast<CAstFunctionCall*>(s->e);
+          int n = f->GetNArgs();
+          if (phase == 0) {
+            if (!tm->GetNull()->Match(f->GetType())) {
+              s->ret = cb->CreateTemp(f->GetType());
+            }
+          } else {
+            CTacAddr *arg = vals.back(); vals.pop_back();
+            cb->AddInstr(new CTacInstr(opParam, new CTacConst(n - phase),
+                                       arg));
+          }
+          if (phase < n) {
+            next = f->GetArg(n - phase - 1);
+          } else {
+            cb->AddInstr(new CTacInstr(opCall, s->ret,
+                                       new CTacName(f->GetSymbol())));
+            res = s->ret;
+          }
+        } else {
+          // the index of each dimension is converted in between
+          CAstArrayDesignator *a = static_cast<CAstArrayDesignator*>(s->e);
+          if (phase == 0) {
+            a->ToTacBegin(cb, &s->addr);
+          } else {
+            a->ToTacIndex(cb, &s->addr, vals.back());
+            vals.pop_back();
+          }
+          while ((next == NULL) && (s->addr.dim < s->addr.ndim)) {
+            a->ToTacDim(cb, &s->addr);
+            if (s->addr.dim < a->GetNIndices()) next = a->GetIndex(s->addr.dim);
+            else a->ToTacIndex(cb, &s->addr, NULL);
+          }
+          if (next == NULL) res = a->ToTacEnd(cb, &s->addr);
+        }
+        break;
+
+      case akDesignator:
+        if (value) res = static_cast<CAstDesignator*>(s->e)->ToTacNode(cb);
+        else static_cast<CAstDesignator*>(s->e)->ToTacNode(cb, s->ltrue,
+                                                           s->lfalse);
+        break;
+
+      case akConstant:
+        if (value) res = static_cast<CAstConstant*>(s->e)->ToTacNode(cb);
+        else static_cast<CAstConstant*>(s->e)->ToTacNode(cb, s->ltrue,
+                                                         s->lfalse);
+        break;
+
+      case akStringConstant:
+        if (value) res = static_cast<CAstStringConstant*>(s->e)->ToTacNode(cb);
+        break;
+
+      default:
+        break;
+    }
+
+    if (next != NULL) {
+      steps.push_back(CTacStep(next, nt, nf));
+    } else {
+      steps.pop_back();
+      if (value) vals.push_back(res);
+    }
   }
-  // return to up after adding while statements
-  cb->AddInstr(new CTacInstr(opGoto, re));
-  cb->AddInstr(loopEnd);
-  cb->AddInstr(new CTacInstr(opGoto, next));
-  return NULL;
-}
 
+  if (ltrue != NULL) return NULL;
 
-//------------------------------------------------------------------------------
-// CAstExpression
-//
-CAstExpression::CAstExpression(CToken t)
-  : CAstNode(t)
-{
+  assert(vals.size() == 1);
+  return vals.back();
 }
 
 CTacAddr* CAstExpression::ToTac(CCodeBlock *cb)
 {
-  return NULL;
+  return ExpressionToTac(cb, this, NULL, NULL);
 }
 
 CTacAddr* CAstExpression::ToTac(CCodeBlock *cb,
                                 CTacLabel *ltrue, CTacLabel *lfalse)
 {
-  return NULL;
+  return ExpressionToTac(cb, this, ltrue, lfalse);
 }
 
 
 //------------------------------------------------------------------------------
 // CAstOperation
 //
-CAstOperation::CAstOperation(CToken t, EOperation oper)
-  : CAstExpression(t), _oper(oper)
+CAstOperation::CAstOperation(CToken t, EOperation oper, EAstKind kind)
+  : CAstExpression(t, kind), _oper(oper)
 {
 }
 
@@ -980,7 +1897,7 @@ EOperation CAstOperation::GetOperation(void) const
 //
 CAstBinaryOp::CAstBinaryOp(CToken t, EOperation oper,
                            CAstExpression *l,CAstExpression *r)
-  : CAstOperation(t, oper), _left(l), _right(r)
+  : CAstOperation(t, oper, akBinaryOp), _left(l), _right(r)
 {
   // these are the only binary operation we support for now
   assert((oper == opAdd)        || (oper == opSub)         ||
@@ -994,6 +1911,12 @@ CAstBinaryOp::CAstBinaryOp(CToken t, EOperation oper,
   assert(r != NULL);
 }
 
+CAstBinaryOp::~CAstBinaryOp(void)
+{
+  DisposeNode(_left);
+  DisposeNode(_right);
+}
+
 CAstExpression* CAstBinaryOp::GetLeft(void) const
 {
   return _left;
@@ -1004,12 +1927,9 @@ CAstExpression* CAstBinaryOp::GetRight(void) const
   return _right;
 }
 
-bool CAstBinaryOp::TypeCheck(CToken *t, string *msg) const
+bool CAstBinaryOp::TypeCheckNode(CToken *t, string *msg) const
 {
-  // check recursively
-  bool ret = _left->TypeCheck(t,msg) && _right->TypeCheck(t,msg);
   CTypeManager* tm = CTypeManager::Get();
-  if (!ret) return false;
 
   const CType* leftType = _left->GetType(), *rightType = _right->GetType();
   switch (GetOperation()) {
@@ -1076,7 +1996,7 @@ bool CAstBinaryOp::TypeCheck(CToken *t, string *msg) const
   }
 }
 
-const CType* CAstBinaryOp::GetType(void) const
+const CType* CAstBinaryOp::ComputeType(void) const
 {
   switch (GetOperation()) {
   case opAdd:
@@ -1098,7 +2018,7 @@ const CType* CAstBinaryOp::GetType(void) const
   }
 }
 
-ostream& CAstBinaryOp::print(ostream &out, int indent) const
+ostream& CAstBinaryOp::printNode(ostream &out, int indent) const
 {
   string ind(indent, ' ');
 
@@ -1109,9 +2029,6 @@ ostream& CAstBinaryOp::print(ostream &out, int indent) const
 
   out << endl;
 
-  _left->print(out, indent+2);
-  _right->print(out, indent+2);
-
   return out;
 }
 
@@ -1122,100 +2039,28 @@ string CAstBinaryOp::dotAttr(void) const
   return out.str();
 }
 
-void CAstBinaryOp::toDot(ostream &out, int indent) const
-{
-  string ind(indent, ' ');
-
-  CAstNode::toDot(out, indent);
-
-  _left->toDot(out, indent);
-  out << ind << dotID() << "->" << _left->dotID() << ";" << endl;
-  _right->toDot(out, indent);
-  out << ind << dotID() << "->" << _right->dotID() << ";" << endl;
-}
-
-CTacAddr* CAstBinaryOp::ToTac(CCodeBlock *cb)
-{
-  // check if a type is boolean type
-  //     to use three address code with true, false label
-  CTypeManager* tm = CTypeManager::Get();
-  if (tm->GetBool()->Match(GetType())) {
-    CTacAddr* ret = cb->CreateTemp(tm->GetBool());
-    CTacLabel* trueLabel = cb->CreateLabel();
-    CTacLabel* falseLabel = cb->CreateLabel();
-    CTacLabel* nextLabel = cb->CreateLabel();
-    ToTac(cb, trueLabel, falseLabel);
-    cb->AddInstr(trueLabel);
-    cb->AddInstr(new CTacInstr(opAssign, ret, new CTacConst(1)));
-    cb->AddInstr(new CTacInstr(opGoto, nextLabel));
-    cb->AddInstr(falseLabel);
-    cb->AddInstr(new CTacInstr(opAssign, ret, new CTacConst(0)));
-    cb->AddInstr(nextLabel);
-    return ret;
-  } else {
-    CTacAddr* lhs = _left->ToTac(cb);
-    CTacAddr* rhs = _right->ToTac(cb);
-    CTacTemp* ret = cb->CreateTemp(GetType());
-    cb->AddInstr(new CTacInstr(GetOperation(), ret, lhs, rhs));
-    return ret;
-  }
-}
-
-CTacAddr* CAstBinaryOp::ToTac(CCodeBlock *cb,
-                              CTacLabel *ltrue, CTacLabel *lfalse)
-{
-  // this is the case of opAnd, opOr, opEqual, opNotEqual,
-  // opLessThan, opLessEqual, opBiggerThan, opBiggerEqual
-  // _right must have same type as _left
-  CTypeManager* tm = CTypeManager::Get();
-  EOperation oper = GetOperation();
-  assert(tm->GetBool()->Match(GetType()));
-  switch (oper) {
-    case opAnd:
-    case opOr:
-    {
-      CTacLabel* midLabel = cb->CreateLabel();
-      if (oper == opAnd)
-        _left->ToTac(cb, midLabel, lfalse);
-      else // oper == opOr
-        _left->ToTac(cb, ltrue, midLabel);
-      cb->AddInstr(midLabel);
-      _right->ToTac(cb, ltrue, lfalse);
-      return NULL;
-    }
-    default: //relational operations
-    {
-      CTacAddr* lhs = _left->ToTac(cb);
-      CTacAddr* rhs = _right->ToTac(cb);
-      cb->AddInstr(new CTacInstr(oper, ltrue, lhs, rhs));
-      cb->AddInstr(new CTacInstr(opGoto, lfalse));
-      return NULL;
-    }
-  }
-}
-
-
 //------------------------------------------------------------------------------
 // CAstUnaryOp
 //
 CAstUnaryOp::CAstUnaryOp(CToken t, EOperation oper, CAstExpression *e)
-  : CAstOperation(t, oper), _operand(e)
+  : CAstOperation(t, oper, akUnaryOp), _operand(e)
 {
   assert((oper == opNeg) || (oper == opPos) || (oper == opNot));
   assert(e != NULL);
 }
 
+CAstUnaryOp::~CAstUnaryOp(void)
+{
+  DisposeNode(_operand);
+}
+
 CAstExpression* CAstUnaryOp::GetOperand(void) const
 {
   return _operand;
 }
 
-bool CAstUnaryOp::TypeCheck(CToken *t, string *msg) const
+bool CAstUnaryOp::TypeCheckNode(CToken *t, string *msg) const
 {
-  // check recursively
-  bool ret = _operand->TypeCheck(t, msg);
-  if (!ret) return false;
-
   const CType *eType = _operand->GetType();
   CTypeManager* tm = CTypeManager::Get();
   switch (GetOperation()) {
@@ -1241,7 +2086,7 @@ bool CAstUnaryOp::TypeCheck(CToken *t, string *msg) const
   }
 }
 
-const CType* CAstUnaryOp::GetType(void) const
+const CType* CAstUnaryOp::ComputeType(void) const
 {
   switch (GetOperation()) {
     case opNeg:
@@ -1254,7 +2099,7 @@ const CType* CAstUnaryOp::GetType(void) const
   }
 }
 
-ostream& CAstUnaryOp::print(ostream &out, int indent) const
+ostream& CAstUnaryOp::printNode(ostream &out, int indent) const
 {
   string ind(indent, ' ');
 
@@ -1264,8 +2109,6 @@ ostream& CAstUnaryOp::print(ostream &out, int indent) const
   if (t != NULL) out << t; else out << "<INVALID>";
   out << endl;
 
-  _operand->print(out, indent+2);
-
   return out;
 }
 
@@ -1276,73 +2119,25 @@ string CAstUnaryOp::dotAttr(void) const
   return out.str();
 }
 
-void CAstUnaryOp::toDot(ostream &out, int indent) const
-{
-  string ind(indent, ' ');
-
-  CAstNode::toDot(out, indent);
-
-  _operand->toDot(out, indent);
-  out << ind << dotID() << "->" << _operand->dotID() << ";" << endl;
-}
-
-CTacAddr* CAstUnaryOp::ToTac(CCodeBlock *cb)
-{
-  CTypeManager* tm = CTypeManager::Get();
-  EOperation oper = GetOperation();
-  switch (oper) {
-    case opNeg:
-    {
-      CTacAddr* operand = _operand->ToTac(cb);
-      CTacTemp* ret = cb->CreateTemp(GetType());
-      cb->AddInstr(new CTacInstr(GetOperation(), ret, operand));
-      return ret;
-    }
-    case opPos:
-    {
-      CTacAddr* operand = _operand->ToTac(cb);
-      return operand;
-    }
-    default: // opNot
-    // if an operator is opNot, add three address code with true, false label
-    {
-      CTacAddr* ret = cb->CreateTemp(tm->GetBool());
-      CTacLabel* trueLabel = cb->CreateLabel();
-      CTacLabel* falseLabel = cb->CreateLabel();
-      CTacLabel* nextLabel = cb->CreateLabel();
-      ToTac(cb, trueLabel, falseLabel);
-      cb->AddInstr(trueLabel);
-      cb->AddInstr(new CTacInstr(opAssign, ret, new CTacConst(1)));
-      cb->AddInstr(new CTacInstr(opGoto, nextLabel));
-      cb->AddInstr(falseLabel);
-      cb->AddInstr(new CTacInstr(opAssign, ret, new CTacConst(0)));
-      cb->AddInstr(nextLabel);
-      return ret;
-    }
-  }
-}
-
-CTacAddr* CAstUnaryOp::ToTac(CCodeBlock *cb,
-                             CTacLabel *ltrue, CTacLabel *lfalse)
-{
-  //opNot
-  assert(CTypeManager::Get()->GetBool()->Match(GetType()));
-  _operand->ToTac(cb, lfalse, ltrue); // change the order of label for not operation
-  return NULL;
-}
-
-
 //------------------------------------------------------------------------------
 // CAstSpecialOp
 //
 CAstSpecialOp::CAstSpecialOp(CToken t, EOperation oper, CAstExpression *e,
                              const CType *type)
-  : CAstOperation(t, oper), _operand(e), _type(type)
+  : CAstOperation(t, oper, akSpecialOp), _operand(e)
 {
   assert((oper == opAddress) || (oper == opDeref) || (oper = opCast));
   assert(e != NULL);
   assert(((oper != opCast) && (type == NULL)) ||
          ((oper == opCast) && (type != NULL)));
+
+  // the type of a cast is forced
+  if (oper == opCast) SetType(type);
+}
+
+CAstSpecialOp::~CAstSpecialOp(void)
+{
+  DisposeNode(_operand);
 }
 
 CAstExpression* CAstSpecialOp::GetOperand(void) const
@@ -1350,9 +2145,8 @@ CAstExpression* CAstSpecialOp::GetOperand(void) const
   return _operand;
 }
 
-bool CAstSpecialOp::TypeCheck(CToken *t, string *msg) const
+bool CAstSpecialOp::TypeCheckNode(CToken *t, string *msg) const
 {
-  if(!_operand->TypeCheck(t, msg)) return false;
   switch (GetOperation()) {
   case opAddress:
     // check if the type is array
@@ -1382,7 +2176,7 @@ bool CAstSpecialOp::TypeCheck(CToken *t, string *msg) const
   }
 }
 
-const CType* CAstSpecialOp::GetType(void) const
+const CType* CAstSpecialOp::ComputeType(void) const
 {
   CTypeManager* tm = CTypeManager::Get();
   switch (GetOperation()) {
@@ -1394,13 +2188,13 @@ const CType* CAstSpecialOp::GetType(void) const
     if (pt == NULL) return NULL;
     return pt->GetBaseType(); // dereferencing makes type to the basetype
   case opCast:
-    return _type; // change the type to specific type
+    return NULL; // the forced type is set by the constructor
   default:
     return NULL;
   }
 }
 
-ostream& CAstSpecialOp::print(ostream &out, int indent) const
+ostream& CAstSpecialOp::printNode(ostream &out, int indent) const
 {
   string ind(indent, ' ');
 
@@ -1410,8 +2204,6 @@ ostream& CAstSpecialOp::print(ostream &out, int indent) const
   if (t != NULL) out << t; else out << "<INVALID>";
   out << endl;
 
-  _operand->print(out, indent+2);
-
   return out;
 }
 
@@ -1422,35 +2214,20 @@ string CAstSpecialOp::dotAttr(void) const
   return out.str();
 }
 
-void CAstSpecialOp::toDot(ostream &out, int indent) const
-{
-  string ind(indent, ' ');
-
-  CAstNode::toDot(out, indent);
-
-  _operand->toDot(out, indent);
-  out << ind << dotID() << "->" << _operand->dotID() << ";" << endl;
-}
-
-CTacAddr* CAstSpecialOp::ToTac(CCodeBlock *cb)
-{
-  // make an operation instruction and return temp value
-  CTacAddr* operand = _operand->ToTac(cb);
-  CTacTemp* temp = cb->CreateTemp(GetType());
-  cb->AddInstr(new CTacInstr(GetOperation(), temp, operand));
-  return temp;
-}
-
-
 //------------------------------------------------------------------------------
 // CAstFunctionCall
 //
 CAstFunctionCall::CAstFunctionCall(CToken t, const CSymProc *symbol)
-  : CAstExpression(t), _symbol(symbol)
+  : CAstExpression(t, akFunctionCall), _symbol(symbol)
 {
   assert(symbol != NULL);
 }
 
+CAstFunctionCall::~CAstFunctionCall(void)
+{
+  for (size_t i=0; i<_arg.size(); i++) DisposeNode(_arg[i]);
+}
+
 const CSymProc* CAstFunctionCall::GetSymbol(void) const
 {
   return _symbol;
@@ -1472,7 +2249,7 @@ CAstExpression* CAstFunctionCall::GetArg(int index) const
   return _arg[index];
 }
 
-bool CAstFunctionCall::TypeCheck(CToken *t, string *msg) const
+bool CAstFunctionCall::TypeCheckNode(CToken *t, string *msg) const
 {
   const CSymProc* symProc = GetSymbol();
   // check the number of arguments
@@ -1481,12 +2258,6 @@ bool CAstFunctionCall::TypeCheck(CToken *t, string *msg) const
     if (msg != NULL) *msg = "number of arguments does not match the number of parameters";
     return false;
   }
-  // check recursively
-  for (CAstExpression* it : _arg) {
-    if (!it->TypeCheck(t, msg)) {
-      return false;
-    }
-  }
   // check whether arguments' type matches parameters' type
   int n = symProc->GetNParams();
   for (int i = 0; i < n; i++) {
@@ -1506,12 +2277,12 @@ bool CAstFunctionCall::TypeCheck(CToken *t, string *msg) const
   return true;
 }
 
-const CType* CAstFunctionCall::GetType(void) const
+const CType* CAstFunctionCall::ComputeType(void) const
 {
   return GetSymbol()->GetDataType();
 }
 
-ostream& CAstFunctionCall::print(ostream &out, int indent) const
+ostream& CAstFunctionCall::printNode(ostream &out, int indent) const
 {
   string ind(indent, ' ');
 
@@ -1520,10 +2291,6 @@ ostream& CAstFunctionCall::print(ostream &out, int indent) const
   if (t != NULL) out << t; else out << "<INVALID>";
   out << endl;
 
-  for (size_t i=0; i<_arg.size(); i++) {
-    _arg[i]->print(out, indent+2);
-  }
-
   return out;
 }
 
@@ -1534,56 +2301,11 @@ string CAstFunctionCall::dotAttr(void) const
   return out.str();
 }
 
-void CAstFunctionCall::toDot(ostream &out, int indent) const
-{
-  string ind(indent, ' ');
-
-  CAstNode::toDot(out, indent);
-
-  for (size_t i=0; i<_arg.size(); i++) {
-    _arg[i]->toDot(out, indent);
-    out << ind << dotID() << "->" << _arg[i]->dotID() << ";" << endl;
-  }
-}
-
-CTacAddr* CAstFunctionCall::ToTac(CCodeBlock *cb)
-{
-  // make return type temp variable if the return type is not null
-  CTacAddr* dst;
-  CTypeManager* tm = CTypeManager::Get();
-  if (tm->GetNull()->Match(GetType())){
-    dst = NULL;
-  } else {
-    dst = cb->CreateTemp(GetType());
-  }
-
-  // add params
-  for (int i = GetNArgs() - 1; i >= 0; i--)
-    cb->AddInstr(new CTacInstr(opParam, new CTacConst(i), GetArg(i)->ToTac(cb)));
-
-  // add an call instruction
-  cb->AddInstr(new CTacInstr(opCall, dst, new CTacName(GetSymbol())));
-  return dst;
-}
-
-CTacAddr* CAstFunctionCall::ToTac(CCodeBlock *cb,
-                                  CTacLabel *ltrue, CTacLabel *lfalse)
-{
-  // the return type should be the Boolean type
-  assert(CTypeManager::Get()->GetBool()->Match(GetType()));
-  CTacAddr* dst = ToTac(cb);
-  cb->AddInstr(new CTacInstr(opEqual, ltrue, dst, new CTacConst(1)));
-  cb->AddInstr(new CTacInstr(opGoto, lfalse));
-  return NULL;
-}
-
-
-
 //------------------------------------------------------------------------------
 // CAstOperand
 //
-CAstOperand::CAstOperand(CToken t)
-  : CAstExpression(t)
+CAstOperand::CAstOperand(CToken t, EAstKind kind)
+  : CAstExpression(t, kind)
 {
 }
 
@@ -1592,7 +2314,14 @@ CAstOperand::CAstOperand(CToken t)
 // CAstDesignator
 //
 CAstDesignator::CAstDesignator(CToken t, const CSymbol *symbol)
-  : CAstOperand(t), _symbol(symbol)
+  : CAstOperand(t, akDesignator), _symbol(symbol)
+{
+  assert(symbol != NULL);
+}
+
+CAstDesignator::CAstDesignator(CToken t, const CSymbol *symbol,
+                               EAstKind kind)
+  : CAstOperand(t, kind), _symbol(symbol)
 {
   assert(symbol != NULL);
 }
@@ -1602,7 +2331,7 @@ const CSymbol* CAstDesignator::GetSymbol(void) const
   return _symbol;
 }
 
-bool CAstDesignator::TypeCheck(CToken *t, string *msg) const
+bool CAstDesignator::TypeCheckNode(CToken *t, string *msg) const
 {
   if (GetType() == NULL) {
     if (t != NULL) *t = GetToken();
@@ -1612,12 +2341,12 @@ bool CAstDesignator::TypeCheck(CToken *t, string *msg) const
   return true;
 }
 
-const CType* CAstDesignator::GetType(void) const
+const CType* CAstDesignator::ComputeType(void) const
 {
   return GetSymbol()->GetDataType();
 }
 
-ostream& CAstDesignator::print(ostream &out, int indent) const
+ostream& CAstDesignator::printNode(ostream &out, int indent) const
 {
   string ind(indent, ' ');
 
@@ -1639,20 +2368,13 @@ string CAstDesignator::dotAttr(void) const
   return out.str();
 }
 
-void CAstDesignator::toDot(ostream &out, int indent) const
-{
-  string ind(indent, ' ');
-
-  CAstNode::toDot(out, indent);
-}
-
-CTacAddr* CAstDesignator::ToTac(CCodeBlock *cb)
+CTacAddr* CAstDesignator::ToTacNode(CCodeBlock *cb)
 {
   // make symbol name
   return new CTacName(GetSymbol());
 }
 
-CTacAddr* CAstDesignator::ToTac(CCodeBlock *cb,
+CTacAddr* CAstDesignator::ToTacNode(CCodeBlock *cb,
                                 CTacLabel *ltrue, CTacLabel *lfalse)
 {
   assert(CTypeManager::Get()->GetBool()->Match(GetType()));
@@ -1666,20 +2388,27 @@ CTacAddr* CAstDesignator::ToTac(CCodeBlock *cb,
 // CAstArrayDesignator
 //
 CAstArrayDesignator::CAstArrayDesignator(CToken t, const CSymbol *symbol)
-  : CAstDesignator(t, symbol), _done(false), _offset(NULL)
+  : CAstDesignator(t, symbol, akArrayDesignator), _done(false)
+{
+}
+
+CAstArrayDesignator::~CAstArrayDesignator(void)
 {
+  for (size_t i=0; i<_idx.size(); i++) DisposeNode(_idx[i]);
 }
 
 void CAstArrayDesignator::AddIndex(CAstExpression *idx)
 {
   assert(!_done);
   _idx.push_back(idx);
+  ResetType();
 }
 
 void CAstArrayDesignator::IndicesComplete(void)
 {
   assert(!_done);
   _done = true;
+  ResetType();
 }
 
 int CAstArrayDesignator::GetNIndices(void) const
@@ -1693,10 +2422,8 @@ CAstExpression* CAstArrayDesignator::GetIndex(int index) const
   return _idx[index];
 }
 
-bool CAstArrayDesignator::TypeCheck(CToken *t, string *msg) const
+bool CAstArrayDesignator::TypeCheckNode(CToken *t, string *msg) const
 {
-  bool result = true;
-
   assert(_done);
   // check if the symbol is array or pointer of array
   const CType* ret = _symbol->GetDataType();
@@ -1711,8 +2438,6 @@ bool CAstArrayDesignator::TypeCheck(CToken *t, string *msg) const
   for (int i = 0; i < _idx.size(); i++) {
     CAstExpression* it = _idx[i];
     assert(it != NULL);
-    result = it->TypeCheck(t, msg);
-    if (!result) return false;
     if (!it->GetType()->Match(CTypeManager::Get()->GetInt())) {
       if (t != NULL) *t = it->GetToken();
       if (msg != NULL) *msg = "index in array designator must be integer type";
@@ -1733,10 +2458,10 @@ bool CAstArrayDesignator::TypeCheck(CToken *t, string *msg) const
     return false;
   }
 
-  return result;
+  return true;
 }
 
-const CType* CAstArrayDesignator::GetType(void) const
+const CType* CAstArrayDesignator::ComputeType(void) const
 {
   const CType* ret = _symbol->GetDataType();
   try {
@@ -1753,7 +2478,7 @@ const CType* CAstArrayDesignator::GetType(void) const
   }
 }
 
-ostream& CAstArrayDesignator::print(ostream &out, int indent) const
+ostream& CAstArrayDesignator::printNode(ostream &out, int indent) const
 {
   string ind(indent, ' ');
 
@@ -1764,10 +2489,6 @@ ostream& CAstArrayDesignator::print(ostream &out, int indent) const
 
   out << endl;
 
-  for (size_t i=0; i<_idx.size(); i++) {
-    _idx[i]->print(out, indent+2);
-  }
-
   return out;
 }
 
@@ -1778,103 +2499,142 @@ string CAstArrayDesignator::dotAttr(void) const
   return out.str();
 }
 
-void CAstArrayDesignator::toDot(ostream &out, int indent) const
-{
-  string ind(indent, ' ');
-
-  CAstNode::toDot(out, indent);
+/// @brief emit dst = lhs op rhs for address arithmetic
+///
+/// folds constant operands and the neutral elements of opAdd and opMul so
+/// that the addressing of statically sized arrays reduces to constants.
+///
+/// @param cb code block
+/// @param op operation (opAdd or opMul)
+/// @param lhs left operand
+/// @param rhs right operand
+/// @retval the result (a constant, one of the operands, or a new temporary)
+static CTacAddr* AddressOp(CCodeBlock *cb, EOperation op,
+                           CTacAddr *lhs, CTacAddr *rhs)
+{
+  assert((op == opAdd) || (op == opMul));
+
+  const CTacConst *cl = dynamic_cast<const CTacConst*>(lhs);
+  const CTacConst *cr = dynamic_cast<const CTacConst*>(rhs);
+
+  // wrap around like the 32-bit arithmetic of the target
+  if ((cl != NULL) && (cr != NULL)) {
+    unsigned int l = cl->GetValue(), r = cr->GetValue();
+    return new CTacConst((int)(op == opAdd ? l + r : l * r));
+  }
 
-  for (size_t i=0; i<_idx.size(); i++) {
-    _idx[i]->toDot(out, indent);
-    out << ind << dotID() << "-> " << _idx[i]->dotID() << ";" << endl;
+  int neutral = op == opAdd ? 0 : 1;
+  if ((cl != NULL) && (cl->GetValue() == neutral)) return rhs;
+  if ((cr != NULL) && (cr->GetValue() == neutral)) return lhs;
+  if (op == opMul) {
+    if ((cl != NULL) && (cl->GetValue() == 0)) return lhs;
+    if ((cr != NULL) && (cr->GetValue() == 0)) return rhs;
   }
+
+  CTacTemp *res = cb->CreateTemp(CTypeManager::Get()->GetInt());
+  cb->AddInstr(new CTacInstr(op, res, lhs, rhs));
+  return res;
 }
 
-CTacAddr* CAstArrayDesignator::ToTac(CCodeBlock *cb)
+void CAstArrayDesignator::ToTacBegin(CCodeBlock *cb, CArrayAddress *a)
 {
-  //dereference if the symbol is pointer type
-  const CArrayType* arrayType;
-  CAstExpression* arrayPointer;
-  CToken emptyToken = new CToken();
+  // an array is stored as [ndim][dim1]...[dimN][data]. The element offset
+  // ((i1*dim2 + i2)*dim3 + ...)*size + 4 + 4*ndim is computed at compile
+  // time as far as the type allows; only the dimensions of open arrays
+  // (passed as pointers) are loaded from the dope vector at runtime.
+  CTypeManager* tm = CTypeManager::Get();
 
   if (_symbol->GetDataType()->IsPointer()) {
     const CPointerType* pointerType = dynamic_cast<const CPointerType*>(_symbol->GetDataType());
-    arrayType = dynamic_cast<const CArrayType*>(pointerType->GetBaseType());
-    arrayPointer = new CAstDesignator(emptyToken, _symbol);
+    a->type = dynamic_cast<const CArrayType*>(pointerType->GetBaseType());
+    a->array = new CTacName(_symbol);
   } else {
-    arrayType = dynamic_cast<const CArrayType*>(_symbol->GetDataType());
-    arrayPointer = new CAstSpecialOp(emptyToken, opAddress, new CAstDesignator(emptyToken, _symbol));
+    a->type = dynamic_cast<const CArrayType*>(_symbol->GetDataType());
+    CTacTemp* address = cb->CreateTemp(tm->GetPointer(a->type));
+    cb->AddInstr(new CTacInstr(opAddress, address, new CTacName(_symbol)));
+    a->array = address;
   }
-  assert(arrayType != NULL);
-
-  //fill the empty indices
-  CTypeManager* tm = CTypeManager::Get();
-  const CType* t = arrayType;
-  int cnt = 0;
-  while(t->IsArray()) {
-    if (cnt >= _idx.size()) {
-      _idx.push_back(new CAstConstant(emptyToken, tm->GetInt(), 0));
+  assert(a->type != NULL);
+
+  // missing indices are treated as 0
+  a->var = NULL;
+  a->cofs = new CTacConst(0);
+  a->elem = a->type;
+  a->dim = 0;
+  a->ndim = a->type->GetNDim();
+}
+
+void CAstArrayDesignator::ToTacDim(CCodeBlock *cb, CArrayAddress *a)
+{
+  const CArrayType* at = dynamic_cast<const CArrayType*>(a->elem);
+  assert(at != NULL);
+
+  if (a->dim > 0) {
+    CTacAddr* dim;
+    if (at->GetNElem() == CArrayType::OPEN) {
+      // dim = *(array + 4*(i+1))
+      CTacAddr* da = AddressOp(cb, opAdd, a->array,
+                               new CTacConst(4*(a->dim+1)));
+      CTacTemp* d = cb->CreateTemp(CTypeManager::Get()->GetInt());
+      cb->AddInstr(new CTacInstr(opDeref, d, da));
+      a->var = AddressOp(cb, opAdd,
+                         a->var != NULL ? a->var : new CTacConst(0), a->cofs);
+      a->cofs = new CTacConst(0);
+      dim = d;
+    } else {
+      dim = new CTacConst(at->GetNElem());
+      a->cofs = dynamic_cast<CTacConst*>(AddressOp(cb, opMul, a->cofs, dim));
     }
-    cnt++;
-    t = dynamic_cast<const CArrayType*>(t)->GetInnerType();
+    if (a->var != NULL) a->var = AddressOp(cb, opMul, a->var, dim);
   }
+}
 
-  //get size from type, t is already unwrapped
-  int size = t->GetSize();
-
-  //use function to find out the offset
-  CAstExpression* offset;
-  const CSymProc* dimSym = dynamic_cast<const CSymProc*>(cb->GetOwner()->GetSymbolTable()->FindSymbol("DIM"));
-  const CSymProc* dofsSym = dynamic_cast<const CSymProc*>(cb->GetOwner()->GetSymbolTable()->FindSymbol("DOFS"));
-  for (int i = 0; i < _idx.size(); i++) {
-    if (i == 0) {
-      offset = _idx[i];
-    } else {
-      offset = new CAstBinaryOp(emptyToken, opAdd, offset, _idx[i]);
-    }
-    if (i == _idx.size() - 1) {
-      offset = new CAstBinaryOp(emptyToken, opMul, offset, new CAstConstant(emptyToken, tm->GetInt(), size));
+void CAstArrayDesignator::ToTacIndex(CCodeBlock *cb, CArrayAddress *a,
+                                     CTacAddr *idx)
+{
+  if (idx != NULL) {
+    if (dynamic_cast<CTacConst*>(idx) != NULL) {
+      a->cofs = dynamic_cast<CTacConst*>(AddressOp(cb, opAdd, a->cofs, idx));
     } else {
-      CAstFunctionCall* dimCall = new CAstFunctionCall(emptyToken, dimSym);
-      dimCall->AddArg(arrayPointer);
-      dimCall->AddArg(new CAstConstant(emptyToken, tm->GetInt(), i+2));
-      offset = new CAstBinaryOp(emptyToken, opMul, offset, dimCall);
+      a->var = a->var != NULL ? AddressOp(cb, opAdd, a->var, idx) : idx;
     }
   }
 
-  //add the offset to the symbol's address
-  CAstFunctionCall* dofsCall = new CAstFunctionCall(emptyToken, dofsSym);
-  dofsCall->AddArg(arrayPointer);
-  CAstExpression* address = new CAstBinaryOp(emptyToken, opAdd, offset, dofsCall);
-  address = new CAstBinaryOp(emptyToken, opAdd, arrayPointer, address);
-
-  //return the referencing variable
-  CTacAddr* result = dynamic_cast<CTacAddr*>(address->ToTac(cb));
-  CTacName* resultName = dynamic_cast<CTacName*>(result);
-  if (resultName == NULL) {
-    CTacTemp* temp = cb->CreateTemp(tm->GetInt());
-    cb->AddInstr(new CTacInstr(opAssign, temp, result));
-    resultName = temp;
-  }
-  return new CTacReference(resultName->GetSymbol(), _symbol);
+  a->elem = dynamic_cast<const CArrayType*>(a->elem)->GetInnerType();
+  a->dim++;
 }
 
-CTacAddr* CAstArrayDesignator::ToTac(CCodeBlock *cb,
-                                     CTacLabel *ltrue, CTacLabel *lfalse)
+CTacAddr* CAstArrayDesignator::ToTacEnd(CCodeBlock *cb, CArrayAddress *a)
 {
-  CTacAddr* ret = ToTac(cb);
-  cb->AddInstr(new CTacInstr(opEqual, ltrue, ret, new CTacConst(1)));
-  cb->AddInstr(new CTacInstr(opGoto, lfalse));
-  return ret;
-}
+  // scale by the element size and skip the dope vector
+  CTacConst* size = new CTacConst(a->elem->GetSize());
+  CTacConst* cofs;
+  cofs = dynamic_cast<CTacConst*>(AddressOp(cb, opMul, a->cofs, size));
+  cofs = dynamic_cast<CTacConst*>(AddressOp(cb, opAdd, cofs,
+                                            new CTacConst(4 + 4*a->ndim)));
+  assert(cofs != NULL);
+
+  CTacAddr* result = a->array;
+  if (a->var != NULL) result = AddressOp(cb, opAdd, result,
+                                         AddressOp(cb, opMul, a->var, size));
+  result = AddressOp(cb, opAdd, result, cofs);
 
+  //return the referencing variable
+  CTacTemp* base = dynamic_cast<CTacTemp*>(result);
+  if (base == NULL) {
+    base = cb->CreateTemp(CTypeManager::Get()->GetInt());
+    cb->AddInstr(new CTacInstr(opAssign, base, result));
+  }
+  return new CTacReference(base, _symbol);
+}
 
 //------------------------------------------------------------------------------
 // CAstConstant
 //
 CAstConstant::CAstConstant(CToken t, const CType *type, long long value)
-  : CAstOperand(t), _type(type), _value(value)
+  : CAstOperand(t, akConstant), _value(value)
 {
+  SetType(type);
 }
 
 void CAstConstant::SetValue(long long value)
@@ -1900,22 +2660,23 @@ string CAstConstant::GetValueStr(void) const
   return out.str();
 }
 
-bool CAstConstant::TypeCheck(CToken *t, string *msg) const
+bool CAstConstant::TypeCheckNode(CToken *t, string *msg) const
 {
   CTypeManager* tm = CTypeManager::Get();
-  if (_type->Match(tm->GetInt())) {
+  const CType *type = GetType();
+  if (type->Match(tm->GetInt())) {
     if (_value < -2147483648 || _value > 2147483647) {
       if (t != NULL) *t = GetToken();
       if (msg != NULL) *msg = "invalid value for integer type constant";
       return false;
     }
-  } else if (_type->Match(tm->GetChar())) {
+  } else if (type->Match(tm->GetChar())) {
     if (_value < 0 || _value > 255) {
       if (t != NULL) *t = GetToken();
       if (msg != NULL) *msg = "invalid value for character type constant";
       return false;
     }
-  } else if (_type->Match(tm->GetBool())) {
+  } else if (type->Match(tm->GetBool())) {
     if (_value != 0 && _value != 1) {
       if (t != NULL) *t = GetToken();
       if (msg != NULL) *msg = "invalid value for boolean type constant";
@@ -1929,12 +2690,7 @@ bool CAstConstant::TypeCheck(CToken *t, string *msg) const
   return true;
 }
 
-const CType* CAstConstant::GetType(void) const
-{
-  return _type;
-}
-
-ostream& CAstConstant::print(ostream &out, int indent) const
+ostream& CAstConstant::printNode(ostream &out, int indent) const
 {
   string ind(indent, ' ');
 
@@ -1955,13 +2711,13 @@ string CAstConstant::dotAttr(void) const
   return out.str();
 }
 
-CTacAddr* CAstConstant::ToTac(CCodeBlock *cb)
+CTacAddr* CAstConstant::ToTacNode(CCodeBlock *cb)
 {
   // return constant instance with value
   return new CTacConst((int)GetValue());
 }
 
-CTacAddr* CAstConstant::ToTac(CCodeBlock *cb,
+CTacAddr* CAstConstant::ToTacNode(CCodeBlock *cb,
                                 CTacLabel *ltrue, CTacLabel *lfalse)
 {
   assert(CTypeManager::Get()->GetBool()->Match(GetType()));
@@ -1974,26 +2730,42 @@ CTacAddr* CAstConstant::ToTac(CCodeBlock *cb,
 //------------------------------------------------------------------------------
 // CAstStringConstant
 //
-int CAstStringConstant::_idx = 0;
-
 CAstStringConstant::CAstStringConstant(CToken t, const string value,
                                        CAstScope *s)
-  : CAstOperand(t)
+  : CAstOperand(t, akStringConstant)
 {
   CTypeManager *tm = CTypeManager::Get();
 
-  _type = tm->GetArray(strlen(CToken::unescape(value).c_str())+1,
-                       tm->GetChar());
-  _value = new CDataInitString(value);
+  SetType(tm->GetArray(strlen(value.c_str())+1, tm->GetChar()));
+  _value = new CDataInitString(CToken::escape(value));
+  _sym = NULL;
+
+  if (s != NULL) Register(s);
+}
+
+CAstStringConstant::~CAstStringConstant(void)
+{
+  // once registered, the data initializer is owned by the symbol
+  if (_sym == NULL) delete _value;
+}
+
+void CAstStringConstant::Register(CAstScope *s)
+{
+  assert(_sym == NULL);
 
   ostringstream o;
-  o << "_str_" << ++_idx;
+  o << "_str_" << CCompilation::GetCurrent()->NextStringID();
 
-  _sym = new CSymGlobal(o.str(), _type);
+  _sym = new CSymGlobal(o.str(), GetType());
   _sym->SetData(_value);
   s->GetSymbolTable()->AddSymbol(_sym);
 }
 
+const CSymGlobal* CAstStringConstant::GetSymbol(void) const
+{
+  return _sym;
+}
+
 const string CAstStringConstant::GetValue(void) const
 {
   return _value->GetData();
@@ -2004,17 +2776,12 @@ const string CAstStringConstant::GetValueStr(void) const
   return GetValue();
 }
 
-bool CAstStringConstant::TypeCheck(CToken *t, string *msg) const
+bool CAstStringConstant::TypeCheckNode(CToken *t, string *msg) const
 {
   return true;
 }
 
-const CType* CAstStringConstant::GetType(void) const
-{
-  return _type;
-}
-
-ostream& CAstStringConstant::print(ostream &out, int indent) const
+ostream& CAstStringConstant::printNode(ostream &out, int indent) const
 {
   string ind(indent, ' ');
 
@@ -2037,13 +2804,13 @@ string CAstStringConstant::dotAttr(void) const
   return out.str();
 }
 
-CTacAddr* CAstStringConstant::ToTac(CCodeBlock *cb)
+CTacAddr* CAstStringConstant::ToTacNode(CCodeBlock *cb)
 {
   // return name of string
   return new CTacName(_sym);
 }
 
-CTacAddr* CAstStringConstant::ToTac(CCodeBlock *cb,
+CTacAddr* CAstStringConstant::ToTacNode(CCodeBlock *cb,
                                 CTacLabel *ltrue, CTacLabel *lfalse)
 {
   // never reached code
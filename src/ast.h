@@ -43,6 +43,7 @@
 #include <map>
 #include <vector>
 
+#include "arena.h"
 #include "scanner.h"
 #include "type.h"
 #include "symtab.h"
@@ -55,11 +56,69 @@ class CAstFunctionCall;
 class CAstConstant;
 class CAstDesignator;
 
+/// @brief statement sequence
+///
+/// the statements of a scope or of an if or while body are kept in a
+/// contiguous array that is allocated next to the node owning it (see
+/// CArenaAllocator).
+///
+typedef vector<CAstStatement*, CArenaAllocator<CAstStatement*> > CAstStatSeq;
+
+//------------------------------------------------------------------------------
+/// @brief error in the source code (syntax or type error)
+///
+struct CSourceError {
+  CSourceError(const CToken &t, const string &m) : token(t), message(m) {};
+
+  CToken     token;                 ///< token causing the error
+  string     message;               ///< error message
+};
+
+//------------------------------------------------------------------------------
+/// @brief AST node kinds
+///
+/// the kind of a node identifies its (concrete) class. Passes that treat
+/// the node classes differently switch on the kind instead of probing the
+/// node with dynamic_cast. The expression kinds come last, starting with
+/// akBinaryOp.
+///
+enum EAstKind {
+  akModule,                         ///< CAstModule
+  akProcedure,                      ///< CAstProcedure
+  akType,                           ///< CAstType
+  akStatAssign,                     ///< CAstStatAssign
+  akStatCall,                       ///< CAstStatCall
+  akStatReturn,                     ///< CAstStatReturn
+  akStatIf,                         ///< CAstStatIf
+  akStatBreak,                      ///< CAstStatBreak
+  akStatWhile,                      ///< CAstStatWhile
+  akBinaryOp,                       ///< CAstBinaryOp
+  akUnaryOp,                        ///< CAstUnaryOp
+  akSpecialOp,                      ///< CAstSpecialOp
+  akFunctionCall,                   ///< CAstFunctionCall
+  akDesignator,                     ///< CAstDesignator
+  akArrayDesignator,                ///< CAstArrayDesignator
+  akConstant,                       ///< CAstConstant
+  akStringConstant,                 ///< CAstStringConstant
+};
+
 //------------------------------------------------------------------------------
 /// @brief AST base node
 ///
 /// base node class for all node types in the AST
 ///
+/// nodes are kept small: instead of the token that triggered its creation,
+/// a node stores the token's 32-bit source offset, and the node kind is
+/// stored in the padding following the header.
+///
+/// the walks that visit every node (type checking, the conversion into TAC
+/// and printing) are not dispatched through the vtable: TypeCheck(), ToTac()
+/// and print() of the base classes switch on the node kind and call the
+/// TypeCheckNode(), ToTacNode() or printNode() method of the node's class.
+/// Within an expression and within the nested bodies of if and while
+/// statements, these walks use explicit stacks instead of recursion, so the
+/// width and the depth of the tree are not limited by the native stack.
+///
 
 class CAstNode {
   public:
@@ -67,18 +126,39 @@ class CAstNode {
     /// @{
 
     /// @param token token in input stream (used for error reporting purposes)
-    CAstNode(CToken token);
+    /// @param kind node kind
+    CAstNode(CToken token, EAstKind kind);
     virtual ~CAstNode(void);
 
     /// @}
 
+    /// @name arena allocation
+    /// @{
+
+    /// @brief allocate a node from the current arena (or the heap)
+    static void* operator new(size_t size);
+
+    /// @brief free a node allocated by operator new
+    static void operator delete(void *p);
+
+    /// @}
+
     /// @name properties
     /// @{
 
     /// @brief return the ID of this node
     int GetID(void) const;
 
+    /// @brief return the kind of this node
+    EAstKind GetKind(void) const { return (EAstKind)_kind; };
+
+    /// @brief return the source offset of the token associated with this node
+    unsigned int GetPosition(void) const { return _pos; };
+
     /// @brief return the token associated with this node
+    ///
+    /// the token only holds the source position (used for error reporting);
+    /// its type and value are not kept in the node.
     CToken GetToken(void) const;
 
     /// @}
@@ -96,9 +176,12 @@ class CAstNode {
     /// @{
 
     /// @brief print the node to an output stream
+    ///
+    /// calls printNode() of the node's class
+    ///
     /// @param out output stream
     /// @param indent indentation
-    virtual ostream&  print(ostream &out, int indent=0) const = 0;
+    ostream&  print(ostream &out, int indent=0) const;
 
     /// @brief return the node ID in (dot) string format
     /// @retval string node ID as a string
@@ -115,23 +198,13 @@ class CAstNode {
 
     /// @}
 
-    /// @name transformation into TAC
-    /// @{
-
-    virtual CTacAddr* GetTacAddr(void) const;
-
-    /// @}
-
   private:
-    CToken     _token;              ///< token in input stream that triggered
-                                    ///< the creation of the node. Used for
-                                    ///< error reporting purposes)
-    int        _id;                 ///< id of the node
-    static int _global_id;          ///< holds the (global) next id
-
-  protected:
-    CTacAddr   *_addr;              ///< result of this node in three-address
-                                    ///< code (only set after calling ToTac())
+    unsigned int _pos;              ///< source offset of the token that
+                                    ///< triggered the creation of the node
+                                    ///< (used for error reporting purposes)
+    int        _id;                 ///< id of the node (numbered per
+                                    ///< compilation)
+    unsigned char _kind;            ///< node kind (EAstKind)
 };
 
 /// @name CAstNode output operators
@@ -168,7 +241,8 @@ class CAstScope : public CAstNode {
     /// @param t token in input stream (used for error reporting purposes)
     /// @param name scope name
     /// @param parent superordinate scope, or NULL if none
-    CAstScope(CToken t, const string name, CAstScope *parent=NULL);
+    /// @param kind node kind
+    CAstScope(CToken t, const string name, CAstScope *parent, EAstKind kind);
 
     /// @brief destructor
     virtual ~CAstScope(void);
@@ -190,6 +264,15 @@ class CAstScope : public CAstNode {
     /// @brief return the @a i-th subordinate scope
     CAstScope* GetChild(size_t i) const;
 
+    /// @brief register @a child as the @a i-th subordinate scope
+    ///
+    /// scopes register with their parent when they are constructed; if
+    /// @a child is already registered, it is moved to position @a i.
+    void InsertChild(CAstScope *child, size_t i);
+
+    /// @brief unregister the subordinate scope @a child (without deleting it)
+    void RemoveChild(CAstScope *child);
+
     /// @brief get the symbol table for this scope
     CSymtab* GetSymbolTable(void) const;
 
@@ -197,10 +280,14 @@ class CAstScope : public CAstNode {
     virtual CSymbol* CreateVar(const string ident, const CType *type) = 0;
 
     /// @brief set the statement sequence
-    void SetStatementSequence(CAstStatement *statement);
+    ///
+    /// the statements of the previous sequence are deleted
+    ///
+    /// @param statseq statements
+    void SetStatementSequence(const vector<CAstStatement*> &statseq);
 
     /// @brief get the statement sequence
-    CAstStatement* GetStatementSequence(void) const;
+    const CAstStatSeq& GetStatementSequence(void) const;
 
     /// @}
 
@@ -214,6 +301,32 @@ class CAstScope : public CAstNode {
     /// @retval false otherwise
     virtual bool TypeCheck(CToken *t, string *msg) const;
 
+    /// @brief perform type checking of the statement sequence only (i.e.,
+    ///        without the subordinate scopes)
+    /// @param t (out, optional) type error at token t
+    /// @param msg (out, optional) type error message
+    /// @retval true if no type error has been found
+    /// @retval false otherwise
+    bool TypeCheckStatements(CToken *t, string *msg) const;
+
+    /// @brief perform type checking and collect all type errors
+    ///
+    /// checks every statement of this and the subordinate scopes, also
+    /// after an error. A statement reports its first error only; the
+    /// errors are appended in the order TypeCheck() would find them.
+    ///
+    /// @param errors (out) type errors
+    /// @retval true if no type error has been found
+    /// @retval false otherwise
+    bool TypeCheckAll(vector<CSourceError> *errors) const;
+
+    /// @brief perform type checking of the statement sequence only and
+    ///        collect all type errors
+    /// @param errors (out) type errors
+    /// @retval true if no type error has been found
+    /// @retval false otherwise
+    bool TypeCheckStatementsAll(vector<CSourceError> *errors) const;
+
     /// @}
 
     /// @name output
@@ -222,7 +335,7 @@ class CAstScope : public CAstNode {
     /// @brief print the node to an output stream
     /// @param out output stream
     /// @param indent indentation
-    virtual ostream&  print(ostream &out, int indent=0) const;
+    ostream&  printNode(ostream &out, int indent=0) const;
 
     /// @brief print the node in dot format to an output stream
     /// @param out output stream
@@ -254,7 +367,7 @@ class CAstScope : public CAstNode {
     string    _name;                ///< name
     CSymtab   *_symtab;             ///< symbol table
     CAstScope *_parent;             ///< superordinate scope
-    CAstStatement* _statseq;        ///< statement sequence
+    CAstStatSeq _statseq;           ///< statement sequence
     vector<CAstScope*> _children;   ///< subordinate scopes
     CCodeBlock *_cb;                ///< (entry) code block for this scope
 };
@@ -378,7 +491,7 @@ class CAstType : public CAstNode {
     /// @brief print the node to an output stream
     /// @param out output stream
     /// @param indent indentation
-    virtual ostream&  print(ostream &out, int indent=0) const;
+    ostream&  printNode(ostream &out, int indent=0) const;
 
     /// @}
 
@@ -399,19 +512,8 @@ class CAstStatement : public CAstNode {
     /// @{
 
     /// @param token token in input stream (used for error reporting purposes)
-    CAstStatement(CToken token);
-    virtual ~CAstStatement(void);
-
-    /// @}
-
-    /// @name statement list management
-    /// @{
-
-    /// @brief set the next @a statement
-    void SetNext(CAstStatement *next);
-
-    /// @brief get the next @a statement
-    CAstStatement* GetNext(void) const;
+    /// @param kind node kind
+    CAstStatement(CToken token, EAstKind kind);
 
     /// @}
 
@@ -420,11 +522,24 @@ class CAstStatement : public CAstNode {
     /// @{
 
     /// @brief perform type checking
+    ///
+    /// calls TypeCheckNode() of the statement's class
+    ///
     /// @param t (out, optional) type error at token t
     /// @param msg (out, optional) type error message
     /// @retval true if no type error has been found
     /// @retval false otherwise
-    virtual bool TypeCheck(CToken *t, string *msg) const = 0;
+    bool TypeCheck(CToken *t, string *msg) const;
+
+    /// @brief perform type checking and collect all type errors
+    ///
+    /// compound statements also check their nested statements after an
+    /// error
+    ///
+    /// @param errors (out) type errors
+    /// @retval true if no type error has been found
+    /// @retval false otherwise
+    bool TypeCheckAll(vector<CSourceError> *errors) const;
 
     /// @}
 
@@ -432,13 +547,11 @@ class CAstStatement : public CAstNode {
     /// @name transformation into TAC
     /// @{
 
-    virtual CTacAddr* ToTac(CCodeBlock *cb, CTacLabel *next, CTacLabel* end);
+    /// @brief convert the statement into TAC (calls ToTacNode() of the
+    ///        statement's class)
+    CTacAddr* ToTac(CCodeBlock *cb, CTacLabel *next, CTacLabel* end);
 
     /// @}
-
-
-  private:
-    CAstStatement* _next;           ///< next statement
 };
 
 
@@ -458,6 +571,9 @@ class CAstStatAssign : public CAstStatement {
     /// @param rhs right-hand side of assignment (expression)
     CAstStatAssign(CToken t, CAstDesignator *lhs, CAstExpression *rhs);
 
+    /// @brief destructor
+    virtual ~CAstStatAssign(void);
+
     /// @}
 
     /// @name property manipulation
@@ -482,7 +598,7 @@ class CAstStatAssign : public CAstStatement {
     /// @param msg (out, optional) type error message
     /// @retval true if no type error has been found
     /// @retval false otherwise
-    virtual bool TypeCheck(CToken *t, string *msg) const;
+    bool TypeCheckNode(CToken *t, string *msg) const;
 
     /// @brief return (compute) the type of the expression.
     virtual const CType* GetType(void) const;
@@ -495,7 +611,7 @@ class CAstStatAssign : public CAstStatement {
     /// @brief print the node to an output stream
     /// @param out output stream
     /// @param indent indentation
-    virtual ostream&  print(ostream &out, int indent=0) const;
+    ostream&  printNode(ostream &out, int indent=0) const;
 
     /// @brief return the node's attributes in (dot) string format
     /// @retval string node attributes as a string
@@ -512,7 +628,7 @@ class CAstStatAssign : public CAstStatement {
     /// @name transformation into TAC
     /// @{
 
-    virtual CTacAddr* ToTac(CCodeBlock *cb, CTacLabel *next, CTacLabel* end);
+    CTacAddr* ToTacNode(CCodeBlock *cb, CTacLabel *next, CTacLabel* end);
 
     /// @}
 
@@ -538,6 +654,9 @@ class CAstStatCall : public CAstStatement {
     /// @param call function call node
     CAstStatCall(CToken t, CAstFunctionCall *call);
 
+    /// @brief destructor
+    virtual ~CAstStatCall(void);
+
     /// @}
 
     /// @name property manipulation
@@ -558,7 +677,7 @@ class CAstStatCall : public CAstStatement {
     /// @param msg (out, optional) type error message
     /// @retval true if no type error has been found
     /// @retval false otherwise
-    virtual bool TypeCheck(CToken *t, string *msg) const;
+    bool TypeCheckNode(CToken *t, string *msg) const;
 
     /// @}
 
@@ -568,7 +687,7 @@ class CAstStatCall : public CAstStatement {
     /// @brief print the node to an output stream
     /// @param out output stream
     /// @param indent indentation
-    virtual ostream&  print(ostream &out, int indent=0) const;
+    ostream&  printNode(ostream &out, int indent=0) const;
 
     /// @brief return the node ID in (dot) string format
     /// @retval string node ID as a string
@@ -589,7 +708,7 @@ class CAstStatCall : public CAstStatement {
     /// @name transformation into TAC
     /// @{
 
-    virtual CTacAddr* ToTac(CCodeBlock *cb, CTacLabel *next, CTacLabel* end);
+    CTacAddr* ToTacNode(CCodeBlock *cb, CTacLabel *next, CTacLabel* end);
 
     /// @}
 
@@ -614,6 +733,9 @@ class CAstStatReturn : public CAstStatement {
     /// @param expr returned expression (or NULL)
     CAstStatReturn(CToken t, CAstScope *scope, CAstExpression *expr);
 
+    /// @brief destructor
+    virtual ~CAstStatReturn(void);
+
     /// @}
 
     /// @name property manipulation
@@ -638,7 +760,7 @@ class CAstStatReturn : public CAstStatement {
     /// @param msg (out, optional) type error message
     /// @retval true if no type error has been found
     /// @retval false otherwise
-    virtual bool TypeCheck(CToken *t, string *msg) const;
+    bool TypeCheckNode(CToken *t, string *msg) const;
 
     /// @brief return (compute) the type of the expression.
     virtual const CType* GetType(void) const;
@@ -651,7 +773,7 @@ class CAstStatReturn : public CAstStatement {
     /// @brief print the node to an output stream
     /// @param out output stream
     /// @param indent indentation
-    virtual ostream&  print(ostream &out, int indent=0) const;
+    ostream&  printNode(ostream &out, int indent=0) const;
 
     /// @brief return the node's attributes in (dot) string format
     /// @retval string node attributes as a string
@@ -668,7 +790,7 @@ class CAstStatReturn : public CAstStatement {
     /// @name transformation into TAC
     /// @{
 
-    virtual CTacAddr* ToTac(CCodeBlock *cb, CTacLabel *next, CTacLabel* end);
+    CTacAddr* ToTacNode(CCodeBlock *cb, CTacLabel *next, CTacLabel* end);
 
     /// @}
 
@@ -683,6 +805,9 @@ class CAstStatReturn : public CAstStatement {
 ///
 /// node representing a if-else statement
 ///
+/// the node and its nested statements are visited by a walk with an explicit
+/// stack of the open statement sequences (see ast.cpp).
+///
 
 class CAstStatIf : public CAstStatement {
   public:
@@ -691,10 +816,14 @@ class CAstStatIf : public CAstStatement {
 
     /// @param t token in input stream (used for error reporting purposes)
     /// @param cond if-else condition (expression)
-    /// @param ifBody statement list of if-body
-    /// @param elseBody statement list of else-body
+    /// @param ifBody statements of the if-body
+    /// @param elseBody statements of the else-body
     CAstStatIf(CToken t, CAstExpression *cond,
-               CAstStatement *ifBody, CAstStatement *elseBody);
+               const vector<CAstStatement*> &ifBody,
+               const vector<CAstStatement*> &elseBody);
+
+    /// @brief destructor
+    virtual ~CAstStatIf(void);
 
     /// @}
 
@@ -706,12 +835,12 @@ class CAstStatIf : public CAstStatement {
     CAstExpression* GetCondition(void) const;
 
     /// @brief return the if-body
-    /// @retval CAstStatement* if-body statement sequence
-    CAstStatement* GetIfBody(void) const;
+    /// @retval CAstStatSeq if-body statement sequence
+    const CAstStatSeq& GetIfBody(void) const;
 
     /// @brief return the else-body
-    /// @retval CAstStatement* else-body statement sequence
-    CAstStatement* GetElseBody(void) const;
+    /// @retval CAstStatSeq else-body statement sequence
+    const CAstStatSeq& GetElseBody(void) const;
 
     /// @}
 
@@ -723,7 +852,7 @@ class CAstStatIf : public CAstStatement {
     /// @param msg (out, optional) type error message
     /// @retval true if no type error has been found
     /// @retval false otherwise
-    virtual bool TypeCheck(CToken *t, string *msg) const;
+    bool TypeCheckNode(CToken *t, string *msg) const;
 
     /// @}
 
@@ -733,7 +862,7 @@ class CAstStatIf : public CAstStatement {
     /// @brief print the node to an output stream
     /// @param out output stream
     /// @param indent indentation
-    virtual ostream&  print(ostream &out, int indent=0) const;
+    ostream&  printNode(ostream &out, int indent=0) const;
 
     /// @brief return the node's attributes in (dot) string format
     /// @retval string node attributes as a string
@@ -750,14 +879,14 @@ class CAstStatIf : public CAstStatement {
     /// @name transformation into TAC
     /// @{
 
-    virtual CTacAddr* ToTac(CCodeBlock *cb, CTacLabel *next, CTacLabel* end);
+    CTacAddr* ToTacNode(CCodeBlock *cb, CTacLabel *next, CTacLabel* end);
 
     /// @}
 
   private:
     CAstExpression *_cond;          ///< condition
-    CAstStatement *_ifBody;         ///< if body
-    CAstStatement *_elseBody;       ///< else body
+    CAstStatSeq    _ifBody;         ///< if body
+    CAstStatSeq    _elseBody;       ///< else body
 };
 
 //------------------------------------------------------------------------------
@@ -784,7 +913,7 @@ class CAstStatBreak : public CAstStatement {
     /// @param msg (out, optional) type error message
     /// @retval true if no type error has been found
     /// @retval false otherwise
-    virtual bool TypeCheck(CToken *t, string *msg) const;
+    bool TypeCheckNode(CToken *t, string *msg) const;
 
     /// @}
 
@@ -794,7 +923,7 @@ class CAstStatBreak : public CAstStatement {
     /// @brief print the node to an output stream
     /// @param out output stream
     /// @param indent indentation
-    virtual ostream&  print(ostream &out, int indent=0) const;
+    ostream&  printNode(ostream &out, int indent=0) const;
 
     /// @brief return the node's attributes in (dot) string format
     /// @retval string node attributes as a string
@@ -806,7 +935,7 @@ class CAstStatBreak : public CAstStatement {
     /// @name transformation into TAC
     /// @{
 
-    virtual CTacAddr* ToTac(CCodeBlock *cb, CTacLabel *next, CTacLabel* end);
+    CTacAddr* ToTacNode(CCodeBlock *cb, CTacLabel *next, CTacLabel* end);
 
     /// @}
 
@@ -817,6 +946,9 @@ class CAstStatBreak : public CAstStatement {
 ///
 /// node representing a while statement
 ///
+/// the node and its nested statements are visited by a walk with an explicit
+/// stack of the open statement sequences (see ast.cpp).
+///
 
 class CAstStatWhile : public CAstStatement {
   public:
@@ -825,8 +957,12 @@ class CAstStatWhile : public CAstStatement {
 
     /// @param t token in input stream (used for error reporting purposes)
     /// @param cond while condition (expression)
-    /// @param body statement list of body
-    CAstStatWhile(CToken t, CAstExpression *cond, CAstStatement *body);
+    /// @param body statements of the body
+    CAstStatWhile(CToken t, CAstExpression *cond,
+                  const vector<CAstStatement*> &body);
+
+    /// @brief destructor
+    virtual ~CAstStatWhile(void);
 
     /// @}
 
@@ -838,8 +974,8 @@ class CAstStatWhile : public CAstStatement {
     CAstExpression* GetCondition(void) const;
 
     /// @brief return the body
-    /// @retval CAstStatement* body statement sequence
-    CAstStatement* GetBody(void) const;
+    /// @retval CAstStatSeq body statement sequence
+    const CAstStatSeq& GetBody(void) const;
 
     /// @}
 
@@ -851,7 +987,7 @@ class CAstStatWhile : public CAstStatement {
     /// @param msg (out, optional) type error message
     /// @retval true if no type error has been found
     /// @retval false otherwise
-    virtual bool TypeCheck(CToken *t, string *msg) const;
+    bool TypeCheckNode(CToken *t, string *msg) const;
 
     /// @}
 
@@ -861,7 +997,7 @@ class CAstStatWhile : public CAstStatement {
     /// @brief print the node to an output stream
     /// @param out output stream
     /// @param indent indentation
-    virtual ostream&  print(ostream &out, int indent=0) const;
+    ostream&  printNode(ostream &out, int indent=0) const;
 
     /// @brief return the node's attributes in (dot) string format
     /// @retval string node attributes as a string
@@ -878,13 +1014,13 @@ class CAstStatWhile : public CAstStatement {
     /// @name transformation into TAC
     /// @{
 
-    virtual CTacAddr* ToTac(CCodeBlock *cb, CTacLabel *next, CTacLabel* end);
+    CTacAddr* ToTacNode(CCodeBlock *cb, CTacLabel *next, CTacLabel* end);
 
     /// @}
 
   private:
     CAstExpression *_cond;          ///< condition
-    CAstStatement *_body;           ///< body
+    CAstStatSeq    _body;           ///< body
 };
 
 
@@ -900,7 +1036,8 @@ class CAstExpression : public CAstNode {
     /// @{
 
     /// @param token token in input stream (used for error reporting purposes)
-    CAstExpression(CToken t);
+    /// @param kind node kind
+    CAstExpression(CToken t, EAstKind kind);
 
     /// @}
 
@@ -909,14 +1046,48 @@ class CAstExpression : public CAstNode {
     /// @{
 
     /// @brief perform type checking
+    ///
+    /// visits the operands before their operation (post-order) and calls
+    /// TypeCheckNode() of each node's class; TypeCheckNode() does not check
+    /// the operands.
+    ///
     /// @param t (out, optional) type error at token t
     /// @param msg (out, optional) type error message
     /// @retval true if no type error has been found
     /// @retval false otherwise
-    virtual bool TypeCheck(CToken *t, string *msg) const = 0;
+    bool TypeCheck(CToken *t, string *msg) const;
 
-    /// @brief return (compute) the type of the expression.
-    virtual const CType* GetType(void) const = 0;
+    /// @brief perform type checking and collect all type errors
+    ///
+    /// like TypeCheck(), but an error does not end the walk: the remaining
+    /// operands are still checked. An operation with an erroneous operand
+    /// is not checked itself.
+    ///
+    /// @param errors (out) type errors
+    /// @retval true if no type error has been found
+    /// @retval false otherwise
+    bool TypeCheckAll(vector<CSourceError> *errors) const;
+
+    /// @brief return the type of the expression
+    ///
+    /// the type is attributed once, i.e., computed by ComputeType() when it
+    /// is first requested and stored in the node. The untyped operands are
+    /// attributed first, in post-order, so ComputeType() finds their types
+    /// stored.
+    ///
+    /// @retval CType* type of the expression (NULL if invalid)
+    virtual const CType* GetType(void) const;
+
+    /// @}
+
+
+    /// @name output
+    /// @{
+
+    /// @brief print the expression in dot format to an output stream
+    /// @param out output stream
+    /// @param indent indentation
+    virtual void toDot(ostream &out, int indent=0) const;
 
     /// @}
 
@@ -924,10 +1095,31 @@ class CAstExpression : public CAstNode {
     /// @name transformation into TAC
     /// @{
 
-    virtual CTacAddr* ToTac(CCodeBlock *cb);
-    virtual CTacAddr* ToTac(CCodeBlock *cb, CTacLabel *ltrue,CTacLabel *lfalse);
+    /// @brief convert the expression into TAC
+    ///
+    /// converts the operations with an explicit stack of steps (see
+    /// ast.cpp); operands call ToTacNode() of their class.
+    CTacAddr* ToTac(CCodeBlock *cb);
+    CTacAddr* ToTac(CCodeBlock *cb, CTacLabel *ltrue,CTacLabel *lfalse);
 
     /// @}
+
+  protected:
+    /// @brief compute the type of the expression from its operands
+    ///
+    /// the default implementation returns NULL; expressions whose type is
+    /// known when they are created set it with SetType() instead.
+    virtual const CType* ComputeType(void) const;
+
+    /// @brief set the type of the expression
+    void SetType(const CType *type);
+
+    /// @brief discard the attributed type (after the operands changed)
+    void ResetType(void);
+
+  private:
+    mutable bool _typed;            ///< true if _type has been attributed
+    mutable const CType *_type;     ///< attributed type
 };
 
 
@@ -944,7 +1136,8 @@ class CAstOperation : public CAstExpression {
 
     /// @param t token in input stream (used for error reporting purposes)
     /// @param o operation
-    CAstOperation(CToken t, EOperation o);
+    /// @param kind node kind
+    CAstOperation(CToken t, EOperation o, EAstKind kind);
 
     /// @}
 
@@ -974,6 +1167,9 @@ class CAstBinaryOp : public CAstOperation {
     /// @param r right operand
     CAstBinaryOp(CToken t, EOperation o, CAstExpression *l, CAstExpression *r);
 
+    /// @brief destructor
+    virtual ~CAstBinaryOp(void);
+
     /// @}
 
     /// @name property manipulation
@@ -998,10 +1194,7 @@ class CAstBinaryOp : public CAstOperation {
     /// @param msg (out, optional) type error message
     /// @retval true if no type error has been found
     /// @retval false otherwise
-    virtual bool TypeCheck(CToken *t, string *msg) const;
-
-    /// @brief return (compute) the type of the expression.
-    virtual const CType* GetType(void) const;
+    bool TypeCheckNode(CToken *t, string *msg) const;
 
     /// @}
 
@@ -1011,27 +1204,17 @@ class CAstBinaryOp : public CAstOperation {
     /// @brief print the node to an output stream
     /// @param out output stream
     /// @param indent indentation
-    virtual ostream&  print(ostream &out, int indent=0) const;
+    ostream&  printNode(ostream &out, int indent=0) const;
 
     /// @brief return the node's attributes in (dot) string format
     /// @retval string node attributes as a string
     virtual string dotAttr(void) const;
 
-    /// @brief print the node in dot format to an output stream
-    /// @param out output stream
-    /// @param indent indentation
-    virtual void toDot(ostream &out, int indent=0) const;
-
     /// @}
 
-
-    /// @name transformation into TAC
-    /// @{
-
-    virtual CTacAddr* ToTac(CCodeBlock *cb);
-    virtual CTacAddr* ToTac(CCodeBlock *cb, CTacLabel *ltrue,CTacLabel *lfalse);
-
-    /// @}
+  protected:
+    /// @brief compute the type of the operation
+    virtual const CType* ComputeType(void) const;
 
   private:
     CAstExpression *_left;          ///< left operand
@@ -1055,6 +1238,9 @@ class CAstUnaryOp : public CAstOperation {
     /// @param e operand
     CAstUnaryOp(CToken t, EOperation o, CAstExpression *e);
 
+    /// @brief destructor
+    virtual ~CAstUnaryOp(void);
+
     /// @}
 
     /// @name property manipulation
@@ -1075,10 +1261,7 @@ class CAstUnaryOp : public CAstOperation {
     /// @param msg (out, optional) type error message
     /// @retval true if no type error has been found
     /// @retval false otherwise
-    virtual bool TypeCheck(CToken *t, string *msg) const;
-
-    /// @brief return (compute) the type of the expression.
-    virtual const CType* GetType(void) const;
+    bool TypeCheckNode(CToken *t, string *msg) const;
 
     /// @}
 
@@ -1088,28 +1271,18 @@ class CAstUnaryOp : public CAstOperation {
     /// @brief print the node to an output stream
     /// @param out output stream
     /// @param indent indentation
-    virtual ostream&  print(ostream &out, int indent=0) const;
+    ostream&  printNode(ostream &out, int indent=0) const;
 
     /// @brief return the node's attributes in (dot) string format
     /// @retval string node attributes as a string
     virtual string dotAttr(void) const;
 
-    /// @brief print the node in dot format to an output stream
-    /// @param out output stream
-    /// @param indent indentation
-    virtual void toDot(ostream &out, int indent=0) const;
-
     /// @}
 
 
-    /// @name transformation into TAC
-    /// @{
-
-    virtual CTacAddr* ToTac(CCodeBlock *cb);
-    virtual CTacAddr* ToTac(CCodeBlock *cb, CTacLabel *ltrue,CTacLabel *lfalse);
-
-    /// @}
-
+  protected:
+    /// @brief compute the type of the operation
+    virtual const CType* ComputeType(void) const;
 
   private:
     CAstExpression *_operand;       ///< operand
@@ -1134,6 +1307,9 @@ class CAstSpecialOp : public CAstOperation {
     CAstSpecialOp(CToken t, EOperation o, CAstExpression *e,
                   const CType *type=NULL);
 
+    /// @brief destructor
+    virtual ~CAstSpecialOp(void);
+
     /// @}
 
 
@@ -1155,10 +1331,7 @@ class CAstSpecialOp : public CAstOperation {
     /// @param msg (out, optional) type error message
     /// @retval true if no type error has been found
     /// @retval false otherwise
-    virtual bool TypeCheck(CToken *t, string *msg) const;
-
-    /// @brief return (compute) the type of the expression.
-    virtual const CType* GetType(void) const;
+    bool TypeCheckNode(CToken *t, string *msg) const;
 
     /// @}
 
@@ -1169,31 +1342,20 @@ class CAstSpecialOp : public CAstOperation {
     /// @brief print the node to an output stream
     /// @param out output stream
     /// @param indent indentation
-    virtual ostream&  print(ostream &out, int indent=0) const;
+    ostream&  printNode(ostream &out, int indent=0) const;
 
     /// @brief return the node's attributes in (dot) string format
     /// @retval string node attributes as a string
     virtual string dotAttr(void) const;
 
-    /// @brief print the node in dot format to an output stream
-    /// @param out output stream
-    /// @param indent indentation
-    virtual void toDot(ostream &out, int indent=0) const;
-
-    /// @}
-
-
-    /// @name transformation into TAC
-    /// @{
-
-    virtual CTacAddr* ToTac(CCodeBlock *cb);
-
     /// @}
 
 
   protected:
+    /// @brief compute the type of the operation
+    virtual const CType* ComputeType(void) const;
+
     CAstExpression *_operand;       ///< operand
-    const CType *_type;             ///< forced type of this op
 };
 
 //------------------------------------------------------------------------------
@@ -1211,6 +1373,9 @@ class CAstFunctionCall : public CAstExpression {
     /// @param symbol symbol of function to call
     CAstFunctionCall(CToken t, const CSymProc *symbol);
 
+    /// @brief destructor
+    virtual ~CAstFunctionCall(void);
+
     /// @}
 
     /// @name property manipulation
@@ -1239,10 +1404,7 @@ class CAstFunctionCall : public CAstExpression {
     /// @param msg (out, optional) type error message
     /// @retval true if no type error has been found
     /// @retval false otherwise
-    virtual bool TypeCheck(CToken *t, string *msg) const;
-
-    /// @brief return the return type of the call
-    virtual const CType* GetType(void) const;
+    bool TypeCheckNode(CToken *t, string *msg) const;
 
     /// @}
 
@@ -1253,32 +1415,23 @@ class CAstFunctionCall : public CAstExpression {
     /// @brief print the node to an output stream
     /// @param out output stream
     /// @param indent indentation
-    virtual ostream&  print(ostream &out, int indent=0) const;
+    ostream&  printNode(ostream &out, int indent=0) const;
 
     /// @brief return the node's attributes in (dot) string format
     /// @retval string node attributes as a string
     virtual string dotAttr(void) const;
 
-    /// @brief print the node in dot format to an output stream
-    /// @param out output stream
-    /// @param indent indentation
-    virtual void toDot(ostream &out, int indent=0) const;
-
     /// @}
 
 
-    /// @name transformation into TAC
-    /// @{
-
-    virtual CTacAddr* ToTac(CCodeBlock *cb);
-    virtual CTacAddr* ToTac(CCodeBlock *cb, CTacLabel *ltrue,CTacLabel *lfalse);
-
-    /// @}
-
+  protected:
+    /// @brief compute the return type of the call
+    virtual const CType* ComputeType(void) const;
 
   private:
     const CSymProc *_symbol;        ///< symbol
-    vector<CAstExpression*> _arg;   ///< parameter list
+    vector<CAstExpression*, CArenaAllocator<CAstExpression*> >
+                   _arg;            ///< parameter list
 };
 
 
@@ -1294,7 +1447,8 @@ class CAstOperand : public CAstExpression {
     /// @{
 
     /// @param token token in input stream (used for error reporting purposes)
-    CAstOperand(CToken token);
+    /// @param kind node kind
+    CAstOperand(CToken token, EAstKind kind);
 
     /// @}
 };
@@ -1333,10 +1487,7 @@ class CAstDesignator : public CAstOperand {
     /// @param msg (out, optional) type error message
     /// @retval true if no type error has been found
     /// @retval false otherwise
-    virtual bool TypeCheck(CToken *t, string *msg) const;
-
-    /// @brief return (compute) the type of the designator.
-    virtual const CType* GetType(void) const;
+    bool TypeCheckNode(CToken *t, string *msg) const;
 
     /// @}
 
@@ -1347,34 +1498,55 @@ class CAstDesignator : public CAstOperand {
     /// @brief print the node to an output stream
     /// @param out output stream
     /// @param indent indentation
-    virtual ostream&  print(ostream &out, int indent=0) const;
+    ostream&  printNode(ostream &out, int indent=0) const;
 
     /// @brief return the node's attributes in (dot) string format
     /// @retval string node attributes as a string
     virtual string dotAttr(void) const;
 
-    /// @brief print the node in dot format to an output stream
-    /// @param out output stream
-    /// @param indent indentation
-    virtual void toDot(ostream &out, int indent=0) const;
-
     /// @}
 
 
     /// @name transformation into TAC
     /// @{
 
-    virtual CTacAddr* ToTac(CCodeBlock *cb);
-    virtual CTacAddr* ToTac(CCodeBlock *cb, CTacLabel *ltrue,CTacLabel *lfalse);
+    CTacAddr* ToTacNode(CCodeBlock *cb);
+    CTacAddr* ToTacNode(CCodeBlock *cb, CTacLabel *ltrue,CTacLabel *lfalse);
 
     /// @}
 
 
   protected:
+    /// @brief compute the type of the designator
+    virtual const CType* ComputeType(void) const;
+
+    /// @brief constructor for subclasses
+    /// @param t token in input stream (used for error reporting purposes)
+    /// @param symbol variable symbol
+    /// @param kind node kind
+    CAstDesignator(CToken t, const CSymbol *symbol, EAstKind kind);
+
     const CSymbol *_symbol;         ///< symbol
 };
 
 
+//------------------------------------------------------------------------------
+/// @brief address computation of an array designator
+///
+/// the element offset is kept as var + cofs so that constant indices and
+/// static dimensions fold into cofs.
+///
+struct CArrayAddress {
+  const CArrayType *type;           ///< array type
+  CTacAddr   *array;                ///< address of the array
+  CTacAddr   *var;                  ///< variable part of the offset (or NULL)
+  CTacConst  *cofs;                 ///< constant part of the offset
+  const CType *elem;                ///< type of dimension dim
+  int        dim;                   ///< current dimension
+  int        ndim;                  ///< number of dimensions
+};
+
+
 //------------------------------------------------------------------------------
 /// @brief AST array designator
 ///
@@ -1390,6 +1562,9 @@ class CAstArrayDesignator : public CAstDesignator {
     /// @param symbol variable symbol
     CAstArrayDesignator(CToken t, const CSymbol *symbol);
 
+    /// @brief destructor
+    virtual ~CAstArrayDesignator(void);
+
     /// @}
 
     /// @name property manipulation
@@ -1425,10 +1600,7 @@ class CAstArrayDesignator : public CAstDesignator {
     /// @param msg (out, optional) type error message
     /// @retval true if no type error has been found
     /// @retval false otherwise
-    virtual bool TypeCheck(CToken *t, string *msg) const;
-
-    /// @brief return (compute) the type of the designator.
-    virtual const CType* GetType(void) const;
+    bool TypeCheckNode(CToken *t, string *msg) const;
 
     /// @}
 
@@ -1439,34 +1611,49 @@ class CAstArrayDesignator : public CAstDesignator {
     /// @brief print the node to an output stream
     /// @param out output stream
     /// @param indent indentation
-    virtual ostream&  print(ostream &out, int indent=0) const;
+    ostream&  printNode(ostream &out, int indent=0) const;
 
     /// @brief return the node's attributes in (dot) string format
     /// @retval string node attributes as a string
     virtual string dotAttr(void) const;
 
-    /// @brief print the node in dot format to an output stream
-    /// @param out output stream
-    /// @param indent indentation
-    virtual void toDot(ostream &out, int indent=0) const;
-
     /// @}
 
 
     /// @name transformation into TAC
     /// @{
 
-    virtual CTacAddr* ToTac(CCodeBlock *cb);
-    virtual CTacAddr* ToTac(CCodeBlock *cb, CTacLabel *ltrue,CTacLabel *lfalse);
+    /// the address of the element is computed dimension by dimension; the
+    /// caller converts the index of each dimension in between (see
+    /// CAstExpression::ToTac()).
+
+    /// @brief start the address computation (the address of the array)
+    void ToTacBegin(CCodeBlock *cb, CArrayAddress *a);
+
+    /// @brief emit the stride of dimension a->dim
+    void ToTacDim(CCodeBlock *cb, CArrayAddress *a);
+
+    /// @brief add the index of dimension a->dim and move to the next one
+    /// @param idx value of the index (NULL: no index, i.e., 0)
+    void ToTacIndex(CCodeBlock *cb, CArrayAddress *a, CTacAddr *idx);
+
+    /// @brief finish the address computation
+    /// @retval CTacAddr* reference to the element
+    CTacAddr* ToTacEnd(CCodeBlock *cb, CArrayAddress *a);
 
     /// @}
 
 
+  protected:
+    /// @brief compute the type of the designator (the element type
+    ///        after applying all indices)
+    virtual const CType* ComputeType(void) const;
+
   private:
     bool _done;                     ///< flag indicating all index expressions
                                     ///< have been added
-    vector<CAstExpression*> _idx;   ///< index expressions
-    CAstExpression *_offset;        ///< address computation expression
+    vector<CAstExpression*, CArenaAllocator<CAstExpression*> >
+                   _idx;            ///< index expressions
 };
 
 
@@ -1511,10 +1698,7 @@ class CAstConstant : public CAstOperand {
     /// @param msg (out, optional) type error message
     /// @retval true if no type error has been found
     /// @retval false otherwise
-    virtual bool TypeCheck(CToken *t, string *msg) const;
-
-    /// @brief return (compute) the type of the constant
-    virtual const CType* GetType(void) const;
+    bool TypeCheckNode(CToken *t, string *msg) const;
 
     /// @}
 
@@ -1525,7 +1709,7 @@ class CAstConstant : public CAstOperand {
     /// @brief print the node to an output stream
     /// @param out output stream
     /// @param indent indentation
-    virtual ostream&  print(ostream &out, int indent=0) const;
+    ostream&  printNode(ostream &out, int indent=0) const;
 
     /// @brief return the node's attributes in (dot) string format
     /// @retval string node attributes as a string
@@ -1537,14 +1721,13 @@ class CAstConstant : public CAstOperand {
     /// @name transformation into TAC
     /// @{
 
-    virtual CTacAddr* ToTac(CCodeBlock *cb);
-    virtual CTacAddr* ToTac(CCodeBlock *cb, CTacLabel *ltrue,CTacLabel *lfalse);
+    CTacAddr* ToTacNode(CCodeBlock *cb);
+    CTacAddr* ToTacNode(CCodeBlock *cb, CTacLabel *ltrue,CTacLabel *lfalse);
 
     /// @}
 
 
   private:
-    const CType *_type;             ///< constant type
     long long _value;               ///< constant value
 };
 
@@ -1561,10 +1744,32 @@ class CAstStringConstant : public CAstOperand {
     /// @{
 
     /// @param t token in input stream (used for error reporting purposes)
-    /// @param value constant value
-    /// @param s enclosing scope
+    /// @param value (unescaped) constant value
+    /// @param s enclosing scope (NULL: register the constant later)
     CAstStringConstant(CToken t, const string value, CAstScope *s);
 
+    /// @brief destructor
+    virtual ~CAstStringConstant(void);
+
+    /// @}
+
+    /// @name symbol management
+    /// @{
+
+    /// @brief create the global symbol holding the string
+    ///
+    /// the symbols are named in the order the constants of a compilation
+    /// are registered (see CCompilation).
+    /// Constants parsed concurrently are created without a scope and
+    /// registered later in source order (see CParser::Parse()).
+    ///
+    /// @param s enclosing scope
+    void Register(CAstScope *s);
+
+    /// @brief return the global symbol holding the string (NULL if the
+    ///        constant has not been registered)
+    const CSymGlobal* GetSymbol(void) const;
+
     /// @}
 
     /// @name property manipulation
@@ -1590,10 +1795,7 @@ class CAstStringConstant : public CAstOperand {
     /// @param msg (out, optional) type error message
     /// @retval true if no type error has been found
     /// @retval false otherwise
-    virtual bool TypeCheck(CToken *t, string *msg) const;
-
-    /// @brief return (compute) the type of the constant
-    virtual const CType* GetType(void) const;
+    bool TypeCheckNode(CToken *t, string *msg) const;
 
     /// @}
 
@@ -1604,7 +1806,7 @@ class CAstStringConstant : public CAstOperand {
     /// @brief print the node to an output stream
     /// @param out output stream
     /// @param indent indentation
-    virtual ostream&  print(ostream &out, int indent=0) const;
+    ostream&  printNode(ostream &out, int indent=0) const;
 
     /// @brief return the node's attributes in (dot) string format
     /// @retval string node attributes as a string
@@ -1616,15 +1818,13 @@ class CAstStringConstant : public CAstOperand {
     /// @name transformation into TAC
     /// @{
 
-    virtual CTacAddr* ToTac(CCodeBlock *cb);
-    virtual CTacAddr* ToTac(CCodeBlock *cb, CTacLabel *ltrue,CTacLabel *lfalse);
+    CTacAddr* ToTacNode(CCodeBlock *cb);
+    CTacAddr* ToTacNode(CCodeBlock *cb, CTacLabel *ltrue,CTacLabel *lfalse);
 
     /// @}
 
 
   private:
-    static int       _idx;          ///< static counter
-    const CType     *_type;         ///< constant type
     CDataInitString *_value;        ///< data initializer (holds string data)
     CSymGlobal      *_sym;          ///< symbol holding the string
 };
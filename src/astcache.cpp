@@ -0,0 +1,929 @@
+//------------------------------------------------------------------------------
+/// @brief SnuPL AST cache
+/// @author Bernhard Egger <bernhard@csap.snu.ac.kr>
+/// @section changelog Change Log
+/// 2026/10/16 created: on-disk cache of type checked module ASTs
+///
+///
+/// @section license_section License
+/// Copyright (c) 2012-2016, Bernhard Egger
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms,  with or without modifi-
+/// cation, are permitted provided that the following conditions are met:
+///
+/// - Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+/// - Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,  BUT NOT LIMITED TO,  THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY  AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER  OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT,  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSE-
+/// QUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF  SUBSTITUTE
+/// GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+/// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN  CONTRACT, STRICT
+/// LIABILITY, OR TORT  (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY
+/// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+/// DAMAGE.
+//------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "arena.h"
+#include "astcache.h"
+using namespace std;
+
+
+/// @brief version of the binary form. Change it whenever the binary form
+///        changes.
+static const unsigned int AstCacheFormat = 3;
+
+/// @brief version of the front end. The Makefile defines SNUPLC_FRONTEND as
+///        a checksum of the scanner, parser and type checker sources, so that
+///        entries written by a different front end are never reused, while
+///        identical builds share their entries. Builds without the Makefile
+///        must change AstCacheFormat whenever the front end changes.
+#ifdef SNUPLC_FRONTEND
+static const char FrontEndVersion[] = SNUPLC_FRONTEND;
+#else
+static const char FrontEndVersion[] = "unversioned";
+#endif
+
+/// @brief magic number of a cache entry
+static const char AstCacheMagic[8] = { 'S', 'n', 'u', 'P', 'L', 'a', 's', 1 };
+
+/// @brief node tags of the binary form (0: no node)
+enum ENodeTag {
+  nNone = 0,
+  nAssign, nCall, nReturn, nIf, nBreak, nWhile,
+  nBinaryOp, nUnaryOp, nSpecialOp, nFunctionCall,
+  nDesignator, nArrayDesignator, nConstant, nStringConstant,
+};
+
+/// @brief type references of the binary form; composite types are
+///        referenced by tNComposite + their index in the type table
+enum ETypeRef {
+  tNone = 0, tNullType, tIntType, tCharType, tBoolType, tVoidPtrType,
+  tNComposite,
+};
+
+
+//------------------------------------------------------------------------------
+/// @brief AST writer
+///
+/// appends the binary form of a module to a string
+///
+class CAstWriter {
+  public:
+    CAstWriter(string *s) : _s(s), _ok(true), _pos(0) {};
+
+    /// @brief write the type table and the module
+    /// @retval true on success
+    bool Module(const CAstModule *m);
+
+  private:
+    void Varint(unsigned long long v);
+    void Signed(long long v)
+    {
+      Varint(((unsigned long long)v << 1) ^ (unsigned long long)(v >> 63));
+    };
+    void String(const string &v);
+    void Atom(const string &v);
+    void Token(const CToken &t);
+    void Type(const CType *t);
+    void Symbol(const CSymbol *s);
+    void Symbols(const CAstScope *s);
+    void Statements(const CAstStatSeq &statseq);
+    void Expression(const CAstExpression *e);
+
+    string *_s;                     ///< output
+    bool    _ok;                    ///< false if the module cannot be written
+    unsigned int _pos;              ///< source offset of the previous token
+    unordered_map<string, unsigned long long> _atom; ///< atom indices
+    map<const CType*, unsigned long long> _type;     ///< type indices
+    map<const CSymbol*, unsigned long long> _symbol; ///< symbol indices
+    map<const CSymbol*, unsigned long long> _string; ///< string constant
+                                    ///< indices in the order of registration
+};
+
+void CAstWriter::Varint(unsigned long long v)
+{
+  while (v >= 0x80) {
+    *_s += (char)(v | 0x80);
+    v >>= 7;
+  }
+  *_s += (char)v;
+}
+
+void CAstWriter::String(const string &v)
+{
+  Varint(v.size());
+  _s->append(v);
+}
+
+void CAstWriter::Atom(const string &v)
+{
+  // an atom is written in full when it occurs for the first time and by its
+  // index afterwards
+  unordered_map<string, unsigned long long>::const_iterator it = _atom.find(v);
+  if (it != _atom.end()) {
+    Varint(it->second);
+  } else {
+    size_t index = _atom.size();
+    Varint(index);
+    String(v);
+    _atom[v] = index;
+  }
+}
+
+void CAstWriter::Token(const CToken &t)
+{
+  Signed((long long)t.GetPosition() - _pos);
+  _pos = t.GetPosition();
+}
+
+void CAstWriter::Type(const CType *t)
+{
+  CTypeManager *tm = CTypeManager::Get();
+
+  if (t == NULL) Varint(tNone);
+  else if (t == tm->GetNull()) Varint(tNullType);
+  else if (t == tm->GetInt()) Varint(tIntType);
+  else if (t == tm->GetChar()) Varint(tCharType);
+  else if (t == tm->GetBool()) Varint(tBoolType);
+  else if (t == tm->GetVoidPtr()) Varint(tVoidPtrType);
+  else {
+    map<const CType*, unsigned long long>::const_iterator it = _type.find(t);
+    if (it == _type.end()) _ok = false;
+    else Varint(tNComposite + it->second);
+  }
+}
+
+void CAstWriter::Symbol(const CSymbol *s)
+{
+  map<const CSymbol*, unsigned long long>::const_iterator it = _symbol.find(s);
+  if (it == _symbol.end()) {
+    _ok = false;
+    Varint(0);
+  } else {
+    Varint(it->second);
+  }
+}
+
+void CAstWriter::Symbols(const CAstScope *s)
+{
+  const vector<CSymbol*> &all = s->GetSymbolTable()->GetSymbols();
+  vector<CSymbol*> symbols;
+
+  // the symbols of string constants are recreated with their constants
+  for (size_t i=0; i<all.size(); i++) {
+    if (all[i]->GetData() == NULL) symbols.push_back(all[i]);
+  }
+
+  Varint(symbols.size());
+  for (size_t i=0; i<symbols.size(); i++) {
+    const CSymbol *sym = symbols[i];
+
+    *_s += (char)sym->GetSymbolType();
+    Atom(sym->GetName());
+    Type(sym->GetDataType());
+
+    if (sym->GetSymbolType() == stParam) {
+      Varint(dynamic_cast<const CSymParam*>(sym)->GetIndex());
+    } else if (sym->GetSymbolType() == stProcedure) {
+      const CSymProc *proc = dynamic_cast<const CSymProc*>(sym);
+      Varint(proc->GetNParams());
+      for (int p=0; p<proc->GetNParams(); p++) {
+        const CSymParam *param = proc->GetParam(p);
+        Varint(param->GetIndex());
+        Atom(param->GetName());
+        Type(param->GetDataType());
+      }
+    }
+
+    size_t index = _symbol.size();
+    _symbol[sym] = index;
+  }
+}
+
+void CAstWriter::Statements(const CAstStatSeq &statseq)
+{
+  Varint(statseq.size());
+
+  for (size_t k=0; k<statseq.size(); k++) {
+    const CAstStatement *s = statseq[k];
+    switch (s->GetKind()) {
+      case akStatAssign: {
+        const CAstStatAssign *a = static_cast<const CAstStatAssign*>(s);
+        Varint(nAssign);
+        Token(a->GetToken());
+        Expression(a->GetLHS());
+        Expression(a->GetRHS());
+        break;
+      }
+      case akStatCall: {
+        const CAstStatCall *c = static_cast<const CAstStatCall*>(s);
+        Varint(nCall);
+        Token(c->GetToken());
+        Expression(c->GetCall());
+        break;
+      }
+      case akStatReturn: {
+        const CAstStatReturn *r = static_cast<const CAstStatReturn*>(s);
+        Varint(nReturn);
+        Token(r->GetToken());
+        Expression(r->GetExpression());
+        break;
+      }
+      case akStatIf: {
+        const CAstStatIf *i = static_cast<const CAstStatIf*>(s);
+        Varint(nIf);
+        Token(i->GetToken());
+        Expression(i->GetCondition());
+        Statements(i->GetIfBody());
+        Statements(i->GetElseBody());
+        break;
+      }
+      case akStatBreak:
+        Varint(nBreak);
+        Token(s->GetToken());
+        break;
+      case akStatWhile: {
+        const CAstStatWhile *w = static_cast<const CAstStatWhile*>(s);
+        Varint(nWhile);
+        Token(w->GetToken());
+        Expression(w->GetCondition());
+        Statements(w->GetBody());
+        break;
+      }
+      default:
+        _ok = false;
+    }
+  }
+}
+
+void CAstWriter::Expression(const CAstExpression *e)
+{
+  if (e == NULL) {
+    Varint(nNone);
+    return;
+  }
+
+  switch (e->GetKind()) {
+    case akBinaryOp: {
+      const CAstBinaryOp *b = static_cast<const CAstBinaryOp*>(e);
+      Varint(nBinaryOp);
+      Token(b->GetToken());
+      Varint(b->GetOperation());
+      Expression(b->GetLeft());
+      Expression(b->GetRight());
+      break;
+    }
+    case akUnaryOp: {
+      const CAstUnaryOp *u = static_cast<const CAstUnaryOp*>(e);
+      Varint(nUnaryOp);
+      Token(u->GetToken());
+      Varint(u->GetOperation());
+      Expression(u->GetOperand());
+      break;
+    }
+    case akSpecialOp: {
+      const CAstSpecialOp *o = static_cast<const CAstSpecialOp*>(e);
+      Varint(nSpecialOp);
+      Token(o->GetToken());
+      Varint(o->GetOperation());
+      Expression(o->GetOperand());
+      Type(o->GetOperation() == opCast ? o->GetType() : NULL);
+      break;
+    }
+    case akFunctionCall: {
+      const CAstFunctionCall *f = static_cast<const CAstFunctionCall*>(e);
+      Varint(nFunctionCall);
+      Token(f->GetToken());
+      Symbol(f->GetSymbol());
+      Varint(f->GetNArgs());
+      for (int i=0; i<f->GetNArgs(); i++) Expression(f->GetArg(i));
+      break;
+    }
+    case akArrayDesignator: {
+      const CAstArrayDesignator *a =
+        static_cast<const CAstArrayDesignator*>(e);
+      Varint(nArrayDesignator);
+      Token(a->GetToken());
+      Symbol(a->GetSymbol());
+      Varint(a->GetNIndices());
+      for (int i=0; i<a->GetNIndices(); i++) Expression(a->GetIndex(i));
+      break;
+    }
+    case akDesignator: {
+      const CAstDesignator *d = static_cast<const CAstDesignator*>(e);
+      Varint(nDesignator);
+      Token(d->GetToken());
+      Symbol(d->GetSymbol());
+      break;
+    }
+    case akConstant: {
+      const CAstConstant *c = static_cast<const CAstConstant*>(e);
+      Varint(nConstant);
+      Token(c->GetToken());
+      Type(c->GetType());
+      Signed(c->GetValue());
+      break;
+    }
+    case akStringConstant: {
+      // the (escaped) value followed by the registration rank
+      const CAstStringConstant *s = static_cast<const CAstStringConstant*>(e);
+      Varint(nStringConstant);
+      Token(s->GetToken());
+      Atom(s->GetValue());
+      map<const CSymbol*, unsigned long long>::const_iterator it =
+        _string.find(s->GetSymbol());
+      if (it == _string.end()) _ok = false;
+      else Varint(it->second);
+      break;
+    }
+    default:
+      _ok = false;
+  }
+}
+
+bool CAstWriter::Module(const CAstModule *m)
+{
+  // type table: the composite types of the type manager in order
+  vector<const CType*> types;
+  CTypeManager::Get()->GetTypes(&types);
+
+  Varint(types.size());
+  for (size_t i=0; i<types.size(); i++) {
+    if (const CArrayType *a = dynamic_cast<const CArrayType*>(types[i])) {
+      *_s += (char)0;
+      Signed(a->GetNElem());
+      Type(a->GetInnerType());
+    } else {
+      *_s += (char)1;
+      Type(dynamic_cast<const CPointerType*>(types[i])->GetBaseType());
+    }
+    _type[types[i]] = i;
+  }
+
+  // string constants: the symbols are numbered in the order of
+  // registration; a loaded module registers its constants in the same order
+  vector<pair<long long, const CSymbol*> > strings;
+  for (size_t i=0; i<=m->GetNumChildren(); i++) {
+    const CAstScope *s = i == 0 ? m : m->GetChild(i-1);
+    const vector<CSymbol*> &symbols = s->GetSymbolTable()->GetSymbols();
+    for (size_t j=0; j<symbols.size(); j++) {
+      if (symbols[j]->GetData() == NULL) continue;
+      string name = symbols[j]->GetName();
+      long long n = atoll(name.c_str() + name.find_last_of('_') + 1);
+      strings.push_back(make_pair(n, symbols[j]));
+    }
+  }
+  sort(strings.begin(), strings.end());
+  Varint(strings.size());
+  for (size_t i=0; i<strings.size(); i++) _string[strings[i].second] = i;
+
+  // module scope
+  Token(m->GetToken());
+  Atom(m->GetName());
+  Symbols(m);
+
+  Varint(m->GetNumChildren());
+  for (size_t i=0; i<m->GetNumChildren(); i++) {
+    const CAstProcedure *p = dynamic_cast<CAstProcedure*>(m->GetChild(i));
+    if (p == NULL) return false;
+
+    Token(p->GetToken());
+    Atom(p->GetName());
+    Symbol(p->GetSymbol());
+    Symbols(p);
+    Statements(p->GetStatementSequence());
+  }
+
+  Statements(m->GetStatementSequence());
+
+  return _ok;
+}
+
+
+//------------------------------------------------------------------------------
+/// @brief AST reader
+///
+/// reconstructs a module from its binary form. The types are requested
+/// from the type manager, the nodes and symbols are allocated from the
+/// current arena.
+///
+class CAstReader {
+  public:
+    CAstReader(const char *p, const char *end)
+      : _p(p), _end(end), _ok(true), _pos(0) {};
+
+    /// @brief read the type table and the module
+    /// @retval CAstModule* module or NULL if the input is invalid
+    CAstModule* Module(void);
+
+  private:
+    unsigned long long Varint(void);
+    long long Signed(void)
+    {
+      unsigned long long v = Varint();
+      return (long long)(v >> 1) ^ -(long long)(v & 1);
+    };
+    unsigned char Byte(void);
+    string String(void);
+    string Atom(void);
+    CToken Token(void);
+    const CType* Type(void);
+    CSymbol* Symbol(void);
+    void Symbols(CAstScope *s);
+    vector<CAstStatement*> Statements(CAstScope *s);
+    CAstExpression* Expression(CAstScope *s);
+
+    const char *_p;                 ///< read position
+    const char *_end;               ///< end of the input
+    bool        _ok;                ///< false once the input is invalid
+    unsigned int _pos;              ///< source offset of the previous token
+    vector<string> _atom;           ///< atoms
+    vector<const CType*> _type;     ///< type table
+    vector<CSymbol*> _symbol;       ///< symbols
+    vector<pair<CAstStringConstant*, CAstScope*> > _string; ///< string
+                                    ///< constants in the order of registration
+};
+
+unsigned long long CAstReader::Varint(void)
+{
+  unsigned long long v = 0;
+  for (int shift=0; (_p < _end) && (shift < 64); shift += 7) {
+    unsigned char b = *_p++;
+    v |= (unsigned long long)(b & 0x7f) << shift;
+    if (b < 0x80) return v;
+  }
+  _ok = false;
+  return 0;
+}
+
+unsigned char CAstReader::Byte(void)
+{
+  if (_p < _end) return *_p++;
+  _ok = false;
+  return 0;
+}
+
+string CAstReader::String(void)
+{
+  unsigned long long len = Varint();
+  if (len > (unsigned long long)(_end - _p)) {
+    _ok = false;
+    return "";
+  }
+  string v(_p, len);
+  _p += len;
+  return v;
+}
+
+string CAstReader::Atom(void)
+{
+  unsigned long long i = Varint();
+
+  if (i < _atom.size()) return _atom[i];
+  if (i == _atom.size()) _atom.push_back(String());
+  else _ok = false;
+  return _ok ? _atom.back() : "";
+}
+
+CToken CAstReader::Token(void)
+{
+  long long pos = (long long)_pos + Signed();
+
+  if ((pos < 0) || (pos > CToken::NOPOS)) {
+    _ok = false;
+    pos = 0;
+  }
+  _pos = (unsigned int)pos;
+  return CToken(_pos, tUndefined);
+}
+
+const CType* CAstReader::Type(void)
+{
+  CTypeManager *tm = CTypeManager::Get();
+  unsigned long long r = Varint();
+
+  switch (r) {
+    case tNone:        return NULL;
+    case tNullType:    return tm->GetNull();
+    case tIntType:     return tm->GetInt();
+    case tCharType:    return tm->GetChar();
+    case tBoolType:    return tm->GetBool();
+    case tVoidPtrType: return tm->GetVoidPtr();
+    default:
+      if (r - tNComposite < _type.size()) return _type[r - tNComposite];
+      _ok = false;
+      return NULL;
+  }
+}
+
+CSymbol* CAstReader::Symbol(void)
+{
+  unsigned long long i = Varint();
+  if (i < _symbol.size()) return _symbol[i];
+  _ok = false;
+  return NULL;
+}
+
+void CAstReader::Symbols(CAstScope *s)
+{
+  CSymtab *st = s->GetSymbolTable();
+  unsigned long long n = Varint();
+
+  for (unsigned long long i=0; _ok && (i<n); i++) {
+    unsigned char stype = Byte();
+    string name = Atom();
+    const CType *type = Type();
+    CSymbol *sym = NULL;
+
+    if (!_ok || name.empty() || (type == NULL)) {
+      _ok = false;
+      return;
+    }
+
+    switch (stype) {
+      case stGlobal: sym = new CSymGlobal(name, type); break;
+      case stLocal:  sym = new CSymLocal(name, type); break;
+      case stParam:  sym = new CSymParam((int)Varint(), name, type); break;
+      case stProcedure: {
+        CSymProc *proc = new CSymProc(name, type);
+        unsigned long long nparam = Varint();
+        for (unsigned long long p=0; _ok && (p<nparam); p++) {
+          int index = (int)Varint();
+          string pname = Atom();
+          const CType *ptype = Type();
+          if (!_ok || pname.empty() || (ptype == NULL)) _ok = false;
+          else proc->AddParam(new CSymParam(index, pname, ptype));
+        }
+        sym = proc;
+        break;
+      }
+      default: _ok = false; return;
+    }
+
+    if (!st->AddSymbol(sym)) {
+      delete sym;
+      _ok = false;
+      return;
+    }
+    _symbol.push_back(sym);
+  }
+}
+
+vector<CAstStatement*> CAstReader::Statements(CAstScope *s)
+{
+  vector<CAstStatement*> statseq;
+  unsigned long long n = Varint();
+
+  for (unsigned long long i=0; _ok && (i<n); i++) {
+    unsigned long long tag = Varint();
+    CToken t = Token();
+    CAstStatement *st = NULL;
+
+    switch (tag) {
+      case nAssign: {
+        CAstDesignator *lhs = dynamic_cast<CAstDesignator*>(Expression(s));
+        CAstExpression *rhs = Expression(s);
+        if ((lhs == NULL) || (rhs == NULL)) _ok = false;
+        else st = new CAstStatAssign(t, lhs, rhs);
+        break;
+      }
+      case nCall: {
+        CAstFunctionCall *call = dynamic_cast<CAstFunctionCall*>(Expression(s));
+        if (call == NULL) _ok = false;
+        else st = new CAstStatCall(t, call);
+        break;
+      }
+      case nReturn:
+        st = new CAstStatReturn(t, s, Expression(s));
+        break;
+      case nIf: {
+        CAstExpression *cond = Expression(s);
+        vector<CAstStatement*> ifBody = Statements(s);
+        vector<CAstStatement*> elseBody = Statements(s);
+        if (cond == NULL) _ok = false;
+        else st = new CAstStatIf(t, cond, ifBody, elseBody);
+        break;
+      }
+      case nBreak:
+        st = new CAstStatBreak(t);
+        break;
+      case nWhile: {
+        CAstExpression *cond = Expression(s);
+        vector<CAstStatement*> body = Statements(s);
+        if (cond == NULL) _ok = false;
+        else st = new CAstStatWhile(t, cond, body);
+        break;
+      }
+      default:
+        _ok = false;
+    }
+
+    if (st == NULL) break;
+    statseq.push_back(st);
+  }
+
+  return statseq;
+}
+
+CAstExpression* CAstReader::Expression(CAstScope *s)
+{
+  unsigned long long tag = Varint();
+  if (tag == nNone) return NULL;
+
+  CToken t = Token();
+
+  switch (tag) {
+    case nBinaryOp: {
+      EOperation op = (EOperation)Varint();
+      CAstExpression *l = Expression(s);
+      CAstExpression *r = Expression(s);
+      if ((op > opOr) && ((op < opEqual) || (op > opBiggerEqual))) _ok = false;
+      if (!_ok || (l == NULL) || (r == NULL)) break;
+      return new CAstBinaryOp(t, op, l, r);
+    }
+    case nUnaryOp: {
+      EOperation op = (EOperation)Varint();
+      CAstExpression *e = Expression(s);
+      if ((op < opNeg) || (op > opNot)) _ok = false;
+      if (!_ok || (e == NULL)) break;
+      return new CAstUnaryOp(t, op, e);
+    }
+    case nSpecialOp: {
+      EOperation op = (EOperation)Varint();
+      CAstExpression *e = Expression(s);
+      const CType *type = Type();
+      if ((op < opAddress) || (op > opCast)) _ok = false;
+      if (!_ok || (e == NULL)) break;
+      return new CAstSpecialOp(t, op, e, type);
+    }
+    case nFunctionCall: {
+      CSymProc *proc = dynamic_cast<CSymProc*>(Symbol());
+      if (proc == NULL) break;
+      CAstFunctionCall *f = new CAstFunctionCall(t, proc);
+      unsigned long long n = Varint();
+      for (unsigned long long i=0; _ok && (i<n); i++) {
+        CAstExpression *arg = Expression(s);
+        if (arg == NULL) _ok = false; else f->AddArg(arg);
+      }
+      return f;
+    }
+    case nArrayDesignator: {
+      CSymbol *sym = Symbol();
+      if (sym == NULL) break;
+      CAstArrayDesignator *a = new CAstArrayDesignator(t, sym);
+      unsigned long long n = Varint();
+      for (unsigned long long i=0; _ok && (i<n); i++) {
+        CAstExpression *idx = Expression(s);
+        if (idx == NULL) _ok = false; else a->AddIndex(idx);
+      }
+      a->IndicesComplete();
+      return a;
+    }
+    case nDesignator: {
+      CSymbol *sym = Symbol();
+      if (sym == NULL) break;
+      return new CAstDesignator(t, sym);
+    }
+    case nConstant: {
+      const CType *type = Type();
+      long long v = Signed();
+      if (!_ok || (type == NULL)) break;
+      return new CAstConstant(t, type, v);
+    }
+    case nStringConstant: {
+      string value = CToken::unescape(Atom());
+      unsigned long long i = Varint();
+      if (!_ok || (i >= _string.size()) || (_string[i].first != NULL)) break;
+      CAstStringConstant *c = new CAstStringConstant(t, value, NULL);
+      _string[i] = make_pair(c, s);
+      return c;
+    }
+  }
+
+  _ok = false;
+  return NULL;
+}
+
+CAstModule* CAstReader::Module(void)
+{
+  CTypeManager *tm = CTypeManager::Get();
+
+  // type table
+  unsigned long long ntypes = Varint();
+  for (unsigned long long i=0; _ok && (i<ntypes); i++) {
+    unsigned char kind = Byte();
+    if (kind == 0) {
+      long long nelem = Signed();
+      const CType *inner = Type();
+      if ((inner == NULL) || (nelem == 0) || (nelem < CArrayType::OPEN) ||
+          (nelem > INT_MAX)) {
+        _ok = false;
+      } else {
+        _type.push_back(tm->GetArray((int)nelem, inner));
+      }
+    } else if (kind == 1) {
+      const CType *base = Type();
+      if (base == NULL) _ok = false;
+      else _type.push_back(tm->GetPointer(base));
+    } else {
+      _ok = false;
+    }
+  }
+  unsigned long long nstrings = Varint();
+  if (nstrings > (unsigned long long)(_end - _p)) _ok = false;
+  else _string.resize(nstrings);
+
+  if (!_ok) return NULL;
+
+  // module scope
+  CToken t = Token();
+  string name = Atom();
+  CAstModule *m = new CAstModule(t, name);
+  Symbols(m);
+
+  unsigned long long nproc = Varint();
+  for (unsigned long long i=0; _ok && (i<nproc); i++) {
+    CToken pt = Token();
+    string pname = Atom();
+    CSymProc *symbol = dynamic_cast<CSymProc*>(Symbol());
+    if (!_ok || (symbol == NULL)) {
+      _ok = false;
+      break;
+    }
+
+    CAstProcedure *p = new CAstProcedure(pt, pname, m, symbol);
+    Symbols(p);
+    p->SetStatementSequence(Statements(p));
+  }
+
+  if (_ok) m->SetStatementSequence(Statements(m));
+
+  for (size_t i=0; _ok && (i<_string.size()); i++) {
+    if (_string[i].first == NULL) _ok = false;
+    else _string[i].first->Register(_string[i].second);
+  }
+
+  if (!_ok || (_p != _end)) {
+    for (size_t i=0; i<m->GetNumChildren(); i++) {
+      CArena::Dispose(m->GetChild(i));
+    }
+    CArena::Dispose(m);
+    return NULL;
+  }
+
+  return m;
+}
+
+
+//------------------------------------------------------------------------------
+// CAstCache
+//
+CAstCache::CAstCache(const string &dir)
+  : _dir(dir)
+{
+  mkdir(_dir.c_str(), 0777);
+}
+
+/// @brief continue a 64-bit FNV-1a hash
+/// @param h hash of the preceding data
+/// @param data data
+/// @param size size of the data
+/// @retval hash
+static unsigned long long Hash(unsigned long long h, const char *data,
+                               size_t size)
+{
+  for (size_t i=0; i<size; i++) {
+    h = (h ^ (unsigned char)data[i]) * 1099511628211ULL;
+  }
+  return h;
+}
+
+/// @brief FNV-1a offset basis
+static const unsigned long long HashBasis = 14695981039346656037ULL;
+
+/// @brief append a 64-bit value in little-endian byte order to a string
+static void PutWord(string *s, unsigned long long v)
+{
+  for (int i=0; i<8; i++) *s += (char)(v >> (8*i));
+}
+
+/// @brief read a 64-bit value in little-endian byte order
+static unsigned long long GetWord(const char *p)
+{
+  unsigned long long v = 0;
+  for (int i=0; i<8; i++) v |= (unsigned long long)(unsigned char)p[i] << (8*i);
+  return v;
+}
+
+unsigned long long CAstCache::Key(const char *data, size_t size)
+{
+  static const string version =
+    "snuplc ast-" + to_string(AstCacheFormat) + " " + FrontEndVersion;
+
+  // the version includes its terminating NUL
+  unsigned long long h = Hash(HashBasis, version.c_str(), version.size() + 1);
+  return Hash(h, data, size);
+}
+
+string CAstCache::GetPath(unsigned long long key) const
+{
+  ostringstream o;
+  o << _dir << "/" << hex << setw(16) << setfill('0') << key << ".ast";
+  return o.str();
+}
+
+CAstModule* CAstCache::Load(const char *data, size_t size) const
+{
+  unsigned long long key = Key(data, size);
+  ifstream in(GetPath(key), ios::binary);
+
+  if (!in.good()) return NULL;
+  return Read(in, key);
+}
+
+bool CAstCache::Save(const char *data, size_t size, const CAstModule *m) const
+{
+  unsigned long long key = Key(data, size);
+  string path = GetPath(key);
+
+  // write to a temporary file and rename it, so that concurrent compilations
+  // never read a partially written entry
+  ostringstream tmp;
+  tmp << path << "." << getpid() << "." << this_thread::get_id();
+
+  ofstream out(tmp.str(), ios::binary);
+  bool good = Write(out, key, m);
+  out.close();
+
+  if (!good || out.fail() || (rename(tmp.str().c_str(), path.c_str()) != 0)) {
+    remove(tmp.str().c_str());
+    return false;
+  }
+
+  return true;
+}
+
+bool CAstCache::Write(ostream &out, unsigned long long key,
+                      const CAstModule *m)
+{
+  assert(m != NULL);
+
+  string s(AstCacheMagic, sizeof(AstCacheMagic));
+  PutWord(&s, key);
+
+  CAstWriter w(&s);
+  if (!w.Module(m)) return false;
+
+  // a checksum rejects damaged entries
+  PutWord(&s, Hash(HashBasis, s.data(), s.size()));
+
+  out.write(s.data(), s.size());
+  return out.good();
+}
+
+CAstModule* CAstCache::Read(istream &in, unsigned long long key)
+{
+  string s;
+  char block[1 << 16];
+  while (in.read(block, sizeof(block)) || (in.gcount() > 0)) {
+    s.append(block, in.gcount());
+  }
+
+  if ((s.size() < sizeof(AstCacheMagic) + 16) ||
+      (memcmp(s.data(), AstCacheMagic, sizeof(AstCacheMagic)) != 0)) {
+    return NULL;
+  }
+
+  const char *p = s.data() + sizeof(AstCacheMagic);
+  const char *end = s.data() + s.size() - 8;
+
+  if ((GetWord(p) != key) ||
+      (GetWord(end) != Hash(HashBasis, s.data(), s.size() - 8))) return NULL;
+
+  CAstReader r(p + 8, end);
+  return r.Module();
+}
@@ -0,0 +1,135 @@
+//------------------------------------------------------------------------------
+/// @brief SnuPL AST cache
+/// @author Bernhard Egger <bernhard@csap.snu.ac.kr>
+/// @section changelog Change Log
+/// 2026/10/16 created: on-disk cache of type checked module ASTs
+///
+///
+/// @section license_section License
+/// Copyright (c) 2012-2016, Bernhard Egger
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms,  with or without modifi-
+/// cation, are permitted provided that the following conditions are met:
+///
+/// - Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+/// - Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,  BUT NOT LIMITED TO,  THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY  AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER  OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT,  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSE-
+/// QUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF  SUBSTITUTE
+/// GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+/// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN  CONTRACT, STRICT
+/// LIABILITY, OR TORT  (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY
+/// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+/// DAMAGE.
+//------------------------------------------------------------------------------
+
+#ifndef __SnuPL_ASTCACHE_H__
+#define __SnuPL_ASTCACHE_H__
+
+#include <iostream>
+#include <string>
+using namespace std;
+
+#include "ast.h"
+
+
+//------------------------------------------------------------------------------
+/// @brief AST cache
+///
+/// stores the type checked AST of a module together with its symbol tables
+/// and the types they reference in a compact binary form. Parsing and type
+/// checking are deterministic, i.e., a module whose source and compiler are
+/// unchanged can be loaded from the cache instead of being scanned, parsed,
+/// and type checked again.
+///
+/// The entries are files in the cache directory named after their key, a
+/// 64-bit FNV-1a hash of the version of the binary form, the build
+/// identifier of the compiler, and the source text. An
+/// entry consists of a magic number, the key, the composite types of the
+/// type manager, the number of string constants, the module in preorder
+/// (the token, name, and symbols of each scope followed by its subroutines
+/// and statements), and a checksum. Types and symbols are referenced by
+/// their index, names and string values are written once and referenced by
+/// their index afterwards. AST nodes only record the source position of
+/// their token; positions are stored as deltas.
+/// Integers are stored as LEB128 varints.
+///
+class CAstCache {
+  public:
+    /// @name construction/destruction
+    /// @{
+
+    /// @brief constructor
+    ///
+    /// @param dir cache directory (created if it does not exist)
+    CAstCache(const string &dir);
+
+    /// @}
+
+    /// @name cache entries
+    /// @{
+
+    /// @brief return the key of a source text
+    ///
+    /// @param data source text
+    /// @param size size of the source text
+    /// @retval key
+    static unsigned long long Key(const char *data, size_t size);
+
+    /// @brief load the module of a source text from the cache
+    ///
+    /// the AST and the symbols are allocated from the current arena (if any)
+    ///
+    /// @param data source text
+    /// @param size size of the source text
+    /// @retval CAstModule* module or NULL if the cache has no valid entry
+    CAstModule* Load(const char *data, size_t size) const;
+
+    /// @brief store the module of a source text in the cache
+    ///
+    /// @param data source text
+    /// @param size size of the source text
+    /// @param m type checked module
+    /// @retval true on success
+    bool Save(const char *data, size_t size, const CAstModule *m) const;
+
+    /// @}
+
+    /// @name binary form
+    /// @{
+
+    /// @brief write a type checked module
+    ///
+    /// @param out output stream
+    /// @param key key of the entry
+    /// @param m module
+    /// @retval true on success
+    static bool Write(ostream &out, unsigned long long key,
+                      const CAstModule *m);
+
+    /// @brief read a module written by Write()
+    ///
+    /// @param in input stream
+    /// @param key expected key
+    /// @retval CAstModule* module or NULL if the input is not a valid entry
+    ///         with key @a key
+    static CAstModule* Read(istream &in, unsigned long long key);
+
+    /// @}
+
+  private:
+    /// @brief return the file name of an entry
+    string GetPath(unsigned long long key) const;
+
+    string  _dir;                   ///< cache directory
+};
+
+#endif // __SnuPL_ASTCACHE_H__
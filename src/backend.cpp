@@ -36,6 +36,9 @@
 #include <sstream>
 #include <iomanip>
 #include <cassert>
+#include <algorithm>
+#include <map>
+#include <queue>
 
 #include "backend.h"
 using namespace std;
@@ -96,9 +99,10 @@ void CBackend::EmitFooter(void)
 //------------------------------------------------------------------------------
 // CBackendx86
 //
-CBackendx86::CBackendx86(ostream &out)
-  : CBackend(out), _curr_scope(NULL)
+CBackendx86::CBackendx86(ostream &out, CCompilation *compilation)
+  : CBackend(out), _compilation(compilation), _curr_scope(NULL)
 {
+  assert(_compilation != NULL);
   _ind = string(4, ' ');
 }
 
@@ -193,7 +197,7 @@ void CBackendx86::EmitScope(CScope *scope)
   _out << _ind << "# scope " << scope->GetName() << endl
        << label << ":" << endl;
 
-  size_t local_size = ComputeStackOffsets(scope->GetSymbolTable(), 8, -12);
+  size_t local_size = ComputeFrameSize(scope);
 
   //Prologue Instructions
   // In prologue, the programs save callee registers and initialize local variables
@@ -250,7 +254,7 @@ void CBackendx86::EmitGlobalData(CScope *scope)
 
   bool header = false;
 
-  vector<CSymbol*> slist = st->GetSymbols();
+  const vector<CSymbol*> &slist = st->GetSymbols();
 
   _out << dec;
 
@@ -322,7 +326,7 @@ void CBackendx86::EmitLocalData(CScope *scope)
   // EmitLocalData emits code for local variables' meta data
 
   assert(scope != NULL);
-  vector<CSymbol*> slist = scope->GetSymbolTable()->GetSymbols();
+  const vector<CSymbol*> &slist = scope->GetSymbolTable()->GetSymbols();
 
   // for all local variable which is array type, insert meta data
   for (CSymbol* s : slist) {
@@ -435,10 +439,16 @@ void CBackendx86::EmitInstruction(CTacInstr *i)
       Store(i->GetDest(), 'a');
       break;
     // dst = *src1
-    case opDeref:
-      // opDeref not generated for now
-      EmitInstruction("# opDeref", "not implemented", cmt.str());
-      break;
+    case opDeref: {
+      string mod = "l";
+      switch (OperandSize(i->GetDest())) {
+        case 1: mod = "zbl"; break;
+        case 2: mod = "zwl"; break;
+      }
+      Load(i->GetSrc(1), "%edi", cmt.str());
+      EmitInstruction("mov" + mod, "(%edi), %eax");
+      Store(i->GetDest(), 'a');
+    } break;
 
     // unconditional branching
     // goto dst
@@ -488,6 +498,11 @@ void CBackendx86::EmitInstruction(CTacInstr *i)
       EmitInstruction("pushl", "%eax");
       break;
 
+    // SSA form
+    case opPhi:
+      // never reached (the code is converted out of SSA form before)
+      break;
+
     // special
     case opLabel:
       _out << Label(dynamic_cast<CTacLabel*>(i)) << ":" << endl;
@@ -560,11 +575,17 @@ string CBackendx86::Operand(const CTac *op)
     return Imm(constant->GetValue());
   }
 
+  const CTacTemp *temp = dynamic_cast<const CTacTemp*>(op);
+  // temporaries live in the stack slots assigned by ComputeTempOffsets
+  if (temp != NULL){
+    assert(temp->GetId() < _temp_ofs.size());
+    return to_string(_temp_ofs[temp->GetId()]) + "(%ebp)";
+  }
+
   const CTacReference *reference = dynamic_cast<const CTacReference*>(op);
   // if it is reference type, move the value to %edi and return (%edi)
   if (reference != NULL){
-    const CSymbol *symbol = reference->GetSymbol();
-    EmitInstruction("movl", to_string(symbol->GetOffset()) + "(" + symbol->GetBaseRegister() + "), %edi");
+    EmitInstruction("movl", Operand(reference->GetBase()) + ", %edi");
     return "(%edi)";
   }
 
@@ -630,29 +651,31 @@ int CBackendx86::OperandSize(CTac *t) const
 {
   // OperandSize returns the expected bytes that CTac t occupies
   const CType *type = NULL;
-  if (dynamic_cast<CTacName*>(t) != NULL){
-    if (dynamic_cast<CTacReference*>(t) != NULL){
-      // if it is CTacReference, unwrap the pointer in case the type is pointer
-      const CSymbol *deref_symbol = dynamic_cast<CTacReference*>(t)->GetDerefSymbol();
-      if (deref_symbol->GetDataType()->IsPointer()) {
-        const CPointerType* pointer_type = dynamic_cast<const CPointerType*>(deref_symbol->GetDataType());
-        type = dynamic_cast<const CArrayType*>(pointer_type->GetBaseType());
-      } else {
-        type = dynamic_cast<const CArrayType*>(deref_symbol->GetDataType());
-      }
-      assert(type != NULL);
-      // also if it is array, get the inner type until it is not array
-      while(type->IsArray()) {
-        type = dynamic_cast<const CArrayType*>(type)->GetInnerType();
-      }
+  if (dynamic_cast<CTacTemp*>(t) != NULL){
+    // temporaries have the type of the value they hold
+    type = dynamic_cast<CTacTemp*>(t)->GetType();
+  }
+  else if (dynamic_cast<CTacReference*>(t) != NULL){
+    // if it is CTacReference, unwrap the pointer in case the type is pointer
+    const CSymbol *deref_symbol = dynamic_cast<CTacReference*>(t)->GetDerefSymbol();
+    if (deref_symbol->GetDataType()->IsPointer()) {
+      const CPointerType* pointer_type = dynamic_cast<const CPointerType*>(deref_symbol->GetDataType());
+      type = dynamic_cast<const CArrayType*>(pointer_type->GetBaseType());
+    } else {
+      type = dynamic_cast<const CArrayType*>(deref_symbol->GetDataType());
     }
-    else {
-      // if is is CTacName but not reference, get the symbol's data type
-      const CSymbol *symbol = dynamic_cast<CTacName*>(t)->GetSymbol();
-      type = symbol->GetDataType();
+    assert(type != NULL);
+    // also if it is array, get the inner type until it is not array
+    while(type->IsArray()) {
+      type = dynamic_cast<const CArrayType*>(type)->GetInnerType();
     }
   }
-  CTypeManager* tm = CTypeManager::Get();
+  else if (dynamic_cast<CTacName*>(t) != NULL){
+    // if is is CTacName, get the symbol's data type
+    const CSymbol *symbol = dynamic_cast<CTacName*>(t)->GetSymbol();
+    type = symbol->GetDataType();
+  }
+  CTypeManager* tm = _compilation->GetTypeManager();
   // if it is boolean or character, return 1
   // else, return 4
   if (type != NULL && (type->Match(tm->GetBool()) || type->Match(tm->GetChar()))){
@@ -669,7 +692,7 @@ size_t CBackendx86::ComputeStackOffsets(CSymtab *symtab,
   // ComputeStackOffsets returns the size of local variables
   // and sets base register and offset of local variables and parameters
   assert(symtab != NULL);
-  vector<CSymbol*> slist = symtab->GetSymbols();
+  const vector<CSymbol*> &slist = symtab->GetSymbols();
   int l_size = 0;
 
   _out << _ind << "# stack offsets:" << endl;
@@ -702,3 +725,181 @@ size_t CBackendx86::ComputeStackOffsets(CSymtab *symtab,
   }
   return l_size;
 }
+
+size_t CBackendx86::ComputeFrameSize(CScope *scope)
+{
+  // the locals start below the saved callee registers, the temporaries
+  // below the (aligned) locals
+  size_t local_size = ComputeStackOffsets(scope->GetSymbolTable(), 8, -12);
+  local_size = (local_size + 3) / 4 * 4;
+  return local_size + ComputeTempOffsets(scope, -12 - (int)local_size);
+}
+
+/// @brief live range of a temporary (see CBackendx86::ComputeTempOffsets)
+struct CLiveRange {
+  int  first;                       ///< first live position (-1: none)
+  int  last;                        ///< last live position
+};
+
+/// @brief extend a live range to include @a pos
+static void Extend(CLiveRange &lr, int pos)
+{
+  if ((lr.first < 0) || (pos < lr.first)) lr.first = pos;
+  if (pos > lr.last) lr.last = pos;
+}
+
+/// @brief return the temporary read or written by an operand, or NULL
+/// @param op operand (may be NULL)
+/// @param def set to false if @a op is a reference (which reads the
+///        temporary holding the address)
+static const CTacTemp* Temporary(const CTac *op, bool &def)
+{
+  const CTacReference *r = dynamic_cast<const CTacReference*>(op);
+  if (r != NULL) { def = false; return r->GetBase(); }
+  return dynamic_cast<const CTacTemp*>(op);
+}
+
+size_t CBackendx86::ComputeTempOffsets(CScope *scope, int temp_ofs)
+{
+  // ComputeTempOffsets assigns a stack slot to each temporary. Liveness is
+  // computed on the control flow graph: a temporary read before it is
+  // defined in a block is live on entry to the block and on exit from its
+  // predecessors, back to the blocks defining it. The live range is the
+  // interval from the first to the last position in the instruction list at
+  // which the temporary is live. Temporaries with disjoint intervals share a
+  // slot (linear scan).
+  assert(scope != NULL);
+  CCodeBlock *cb = scope->GetCodeBlock();
+  assert(!cb->IsSSA());
+  if (!cb->HasCFG()) cb->BuildCFG();
+
+  const vector<CBasicBlock*> &blocks = cb->GetBlocks();
+  size_t ntemps = scope->GetNumTemps(), nblocks = blocks.size();
+  CLiveRange none = { -1, -1 };
+  vector<CLiveRange> range(ntemps, none);
+  vector<int> head(nblocks), tail(nblocks);
+  vector<pair<unsigned int, unsigned int> > exposed, defs;
+  vector<size_t> defined(ntemps, 0), used(ntemps, 0);
+  int pos = 0;
+
+  // 1. occurrences of the temporaries, upward exposed uses, and the blocks
+  //    defining each temporary
+  for (size_t b=0; b<nblocks; b++) {
+    const list<CTacInstr*> &instr = blocks[b]->GetInstr();
+    head[b] = pos;
+
+    for (list<CTacInstr*>::const_iterator it = instr.begin();
+         it != instr.end(); it++, pos++) {
+      const CTacInstr *i = *it;
+      const CTac *dst = (i->IsBranch() || (i->GetOperation() == opLabel)) ?
+                        NULL : i->GetDest();
+
+      // sources are read before the destination is written
+      const CTac *op[3] = { i->GetSrc(1), i->GetSrc(2), dst };
+      for (int o=0; o<3; o++) {
+        bool def = o == 2;
+        const CTacTemp *t = Temporary(op[o], def);
+        if (t == NULL) continue;
+
+        unsigned int id = t->GetId();
+        Extend(range[id], pos);
+
+        if (def) {
+          if (defined[id] != b+1) defs.push_back(make_pair(id, b));
+          defined[id] = b+1;
+        } else if ((defined[id] != b+1) && (used[id] != b+1)) {
+          used[id] = b+1;
+          exposed.push_back(make_pair(id, b));
+        }
+      }
+    }
+    tail[b] = pos > head[b] ? pos - 1 : head[b];
+  }
+
+  // 2. propagate the upward exposed uses backwards to the definitions
+  sort(exposed.begin(), exposed.end());
+  sort(defs.begin(), defs.end());
+
+  vector<size_t> defmark(nblocks, 0), livemark(nblocks, 0);
+  vector<unsigned int> work;
+  size_t d = 0;
+
+  for (size_t e=0; e<exposed.size(); ) {
+    unsigned int id = exposed[e].first;
+    size_t stamp = id + 1;
+
+    while ((d < defs.size()) && (defs[d].first < id)) d++;
+    while ((d < defs.size()) && (defs[d].first == id)) {
+      defmark[defs[d++].second] = stamp;
+    }
+
+    for (; (e < exposed.size()) && (exposed[e].first == id); e++) {
+      livemark[exposed[e].second] = stamp;
+      work.push_back(exposed[e].second);
+    }
+
+    while (!work.empty()) {
+      unsigned int b = work.back();
+      work.pop_back();
+      Extend(range[id], head[b]);
+
+      const vector<CBasicBlock*> &pred = blocks[b]->GetPred();
+      for (size_t p=0; p<pred.size(); p++) {
+        unsigned int pb = pred[p]->GetId();
+        Extend(range[id], tail[pb]);
+        if ((defmark[pb] != stamp) && (livemark[pb] != stamp)) {
+          livemark[pb] = stamp;
+          work.push_back(pb);
+        }
+      }
+    }
+  }
+
+  vector<int> order;
+  for (size_t t=0; t<ntemps; t++) {
+    if (range[t].first >= 0) order.push_back((int)t);
+  }
+
+  // linear scan: assign the slots in the order of the live range starts and
+  // release a slot after the last occurrence of its temporary
+  struct CStart {
+    const vector<CLiveRange> &range;
+    bool operator()(int a, int b) const {
+      return (range[a].first < range[b].first) ||
+             ((range[a].first == range[b].first) && (a < b));
+    }
+  } start = { range };
+  sort(order.begin(), order.end(), start);
+
+  priority_queue<pair<int, int>, vector<pair<int, int> >,
+                 greater<pair<int, int> > > active;
+  vector<int> free;
+  int nslots = 0;
+
+  _temp_ofs.assign(ntemps, 0);
+  for (size_t o=0; o<order.size(); o++) {
+    int t = order[o];
+
+    while (!active.empty() && (active.top().first < range[t].first)) {
+      free.push_back(active.top().second);
+      active.pop();
+    }
+
+    int slot;
+    if (free.empty()) slot = nslots++;
+    else { slot = free.back(); free.pop_back(); }
+
+    active.push(make_pair(range[t].last, slot));
+    _temp_ofs[t] = temp_ofs - 4 * (slot + 1);
+  }
+
+  if (nslots > 0) {
+    _out << _ind << "#" << " "
+         << right << setw(6) << temp_ofs - 4 * nslots << "(%ebp)" << " "
+         << setw(3) << 4 * nslots << "  "
+         << "[ " << order.size() << " temporaries in " << nslots
+         << " slots ]" << endl;
+  }
+
+  return 4 * nslots;
+}
@@ -38,6 +38,7 @@
 #include <iostream>
 #include <vector>
 
+#include "compilation.h"
 #include "symtab.h"
 #include "ir.h"
 
@@ -93,7 +94,11 @@ class CBackendx86 : public CBackend {
     /// @name constructors/destructors
     /// @{
 
-    CBackendx86(ostream &out);
+    /// @brief constructor
+    ///
+    /// @param out output stream
+    /// @param compilation compilation context of the modules to emit
+    CBackendx86(ostream &out, CCompilation *compilation);
     virtual ~CBackendx86(void);
 
     /// @}
@@ -174,10 +179,27 @@ class CBackendx86 : public CBackend {
     /// @param local_ofs offset to local vars from base pointer after epilogue
     size_t ComputeStackOffsets(CSymtab *symtab, int param_ofs, int local_ofs);
 
+    /// @brief compute the location of the temporaries of a scope on the
+    ///        stack. Temporaries whose live ranges do not overlap share a
+    ///        slot. Returns the total size of the slots
+    /// @param scope scope
+    /// @param temp_ofs offset to the temporaries from base pointer after
+    ///        epilogue
+    size_t ComputeTempOffsets(CScope *scope, int temp_ofs);
+
+    /// @brief compute the stack offsets of the parameters, local variables
+    ///        and temporaries of a scope. Returns the size of the locals and
+    ///        temporaries below the saved callee registers
+    /// @param scope scope
+    size_t ComputeFrameSize(CScope *scope);
+
     /// @}
 
     string _ind;                    ///< indentation
+    CCompilation *_compilation;     ///< compilation context
     CScope *_curr_scope;            ///< current scope
+    vector<int> _temp_ofs;          ///< stack offsets of the temporaries of
+                                    ///< the current scope
 };
 
 
@@ -0,0 +1,78 @@
+//------------------------------------------------------------------------------
+/// @brief SnuPL compilation context
+/// @author Bernhard Egger <bernhard@csap.snu.ac.kr>
+/// @section changelog Change Log
+/// 2026/10/16 created: per-compilation types, line table, and ids
+///
+///
+/// @section license_section License
+/// Copyright (c) 2012-2016, Bernhard Egger
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms,  with or without modifi-
+/// cation, are permitted provided that the following conditions are met:
+///
+/// - Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+/// - Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,  BUT NOT LIMITED TO,  THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY  AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER  OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT,  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSE-
+/// QUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF  SUBSTITUTE
+/// GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+/// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN  CONTRACT, STRICT
+/// LIABILITY, OR TORT  (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY
+/// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+/// DAMAGE.
+//------------------------------------------------------------------------------
+
+#include "compilation.h"
+using namespace std;
+
+
+//------------------------------------------------------------------------------
+// CCompilation
+//
+static thread_local CCompilation *_current = NULL;
+
+CCompilation::CCompilation(void)
+  : _types(new CTypeManager()), _lines(new CLineTable()),
+    _pool(new CStringPool()), _node_id(0), _string_id(0)
+{
+}
+
+CCompilation::CCompilation(bool dflt)
+  : _types(new CTypeManager()), _lines(NULL), _pool(NULL), _node_id(0),
+    _string_id(0)
+{
+}
+
+CCompilation::~CCompilation(void)
+{
+  delete _types;
+  delete _lines;
+  delete _pool;
+}
+
+CCompilation* CCompilation::GetCurrent(void)
+{
+  static CCompilation _default(true);
+
+  return _current != NULL ? _current : &_default;
+}
+
+CCompilation* CCompilation::SetCurrent(CCompilation *compilation)
+{
+  CCompilation *prev = _current;
+
+  _current = compilation;
+  CLineTable::SetCurrent(compilation != NULL ? compilation->_lines : NULL);
+  CStringPool::SetCurrent(compilation != NULL ? compilation->_pool : NULL);
+
+  return prev;
+}
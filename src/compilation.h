@@ -0,0 +1,121 @@
+//------------------------------------------------------------------------------
+/// @brief SnuPL compilation context
+/// @author Bernhard Egger <bernhard@csap.snu.ac.kr>
+/// @section changelog Change Log
+/// 2026/10/16 created: per-compilation types, line table, and ids
+///
+///
+/// @section license_section License
+/// Copyright (c) 2012-2016, Bernhard Egger
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms,  with or without modifi-
+/// cation, are permitted provided that the following conditions are met:
+///
+/// - Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+/// - Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,  BUT NOT LIMITED TO,  THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY  AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER  OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT,  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSE-
+/// QUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF  SUBSTITUTE
+/// GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+/// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN  CONTRACT, STRICT
+/// LIABILITY, OR TORT  (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY
+/// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+/// DAMAGE.
+//------------------------------------------------------------------------------
+
+#ifndef __SnuPL_COMPILATION_H__
+#define __SnuPL_COMPILATION_H__
+
+#include <atomic>
+using namespace std;
+
+#include "scanner.h"
+#include "type.h"
+
+
+//------------------------------------------------------------------------------
+/// @brief compilation context
+///
+/// holds the mutable state of the compilation of one module: its composite
+/// types, the line table of its source, and the counters that number its
+/// AST nodes and string constants. Modules compiled in different contexts
+/// do not share any mutable state and can be compiled concurrently. The base
+/// types are immutable and shared by all contexts. Each context interns the
+/// token values and names of its module in a string pool of its own, which
+/// is freed with the context.
+///
+/// Like the arena (see CArena), each thread works on a current context.
+/// CTypeManager::Get(), CLineTable::Get(), and CStringPool::Get() return the
+/// type manager, line table, and string pool of the current context. A
+/// thread that has not set a context uses the default context; the parser
+/// sets the context of its worker threads. The parser and the backend take
+/// their context explicitly, and each document of the language server (see
+/// CDocument) is checked in a context of its own.
+///
+class CCompilation {
+  public:
+    /// @name construction/destruction
+    /// @{
+
+    /// @brief constructor
+    CCompilation(void);
+
+    /// @brief destructor
+    ~CCompilation(void);
+
+    /// @}
+
+    /// @name current context
+    /// @{
+
+    /// @brief return the context of the calling thread
+    static CCompilation* GetCurrent(void);
+
+    /// @brief set the context of the calling thread
+    ///
+    /// @param compilation context (NULL for the default context)
+    /// @retval previous context of the calling thread (NULL: default)
+    static CCompilation* SetCurrent(CCompilation *compilation);
+
+    /// @}
+
+    /// @name state
+    /// @{
+
+    /// @brief return the type manager
+    CTypeManager* GetTypeManager(void) const { return _types; };
+
+    /// @brief return the line table (NULL: the default line table)
+    CLineTable* GetLineTable(void) const { return _lines; };
+
+    /// @brief return the string pool (NULL: the default string pool)
+    CStringPool* GetStringPool(void) const { return _pool; };
+
+    /// @brief return the next AST node id
+    int NextNodeID(void) { return _node_id++; };
+
+    /// @brief return the next string constant number (starting at 1)
+    int NextStringID(void) { return ++_string_id; };
+
+    /// @}
+
+  private:
+    /// @brief constructor of the default context
+    CCompilation(bool dflt);
+
+    CTypeManager  *_types;          ///< composite types
+    CLineTable    *_lines;          ///< line table (NULL: default)
+    CStringPool   *_pool;           ///< string pool (NULL: default)
+    atomic<int>   _node_id;         ///< next AST node id
+    atomic<int>   _string_id;       ///< last string constant number
+};
+
+#endif // __SnuPL_COMPILATION_H__
@@ -0,0 +1,463 @@
+//------------------------------------------------------------------------------
+/// @brief SnuPL incrementally checked source document
+/// @author Bernhard Egger <bernhard@csap.snu.ac.kr>
+/// @section changelog Change Log
+/// 2026/10/16 created: incremental re-lexing/re-parsing for the server mode
+///
+///
+/// @section license_section License
+/// Copyright (c) 2012-2016, Bernhard Egger
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms,  with or without modifi-
+/// cation, are permitted provided that the following conditions are met:
+///
+/// - Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+/// - Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,  BUT NOT LIMITED TO,  THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY  AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER  OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT,  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSE-
+/// QUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF  SUBSTITUTE
+/// GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+/// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN  CONTRACT, STRICT
+/// LIABILITY, OR TORT  (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY
+/// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+/// DAMAGE.
+//------------------------------------------------------------------------------
+
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+#include <map>
+
+#include "document.h"
+using namespace std;
+
+
+/// @brief compare the signatures of two subroutine symbols (either may be NULL)
+static bool SameSignature(const CSymProc *a, const CSymProc *b)
+{
+  if ((a == NULL) || (b == NULL)) return a == b;
+
+  if ((a->GetName() != b->GetName()) ||
+      !a->GetDataType()->Compare(b->GetDataType()) ||
+      (a->GetNParams() != b->GetNParams())) return false;
+
+  for (int i=0; i<a->GetNParams(); i++) {
+    if (!a->GetParam(i)->GetDataType()->Compare(b->GetParam(i)->GetDataType()))
+      return false;
+  }
+
+  return true;
+}
+
+/// @brief tokens that determine how a module is split into parts
+static bool IsStructural(EToken type)
+{
+  return (type == tModule) || (type == tProcedure) || (type == tFunction);
+}
+
+
+//------------------------------------------------------------------------------
+// CDocument
+//
+CDocument::CDocument(void)
+  : _module(NULL), _compilation(NULL)
+{
+  SetText("");
+}
+
+CDocument::~CDocument(void)
+{
+  Release();
+  delete _compilation;
+}
+
+void CDocument::SetText(const string &text)
+{
+  _text = text;
+  BuildLines();
+  Check();
+}
+
+bool CDocument::Edit(int line0, int char0, int line1, int char1,
+                     const string &text)
+{
+  CCompilation *prev = CCompilation::SetCurrent(_compilation);
+  bool incremental = Update(line0, char0, line1, char1, text);
+  CCompilation::SetCurrent(prev);
+
+  if (!incremental) Check();
+  return incremental;
+}
+
+bool CDocument::Update(int line0, int char0, int line1, int char1,
+                       const string &text)
+{
+  size_t s = GetOffset(line0, char0), e = GetOffset(line1, char1);
+  if (e < s) swap(s, e);
+
+  // the edit damages the lines [ls, le) of the old text
+  size_t size = _text.size();
+  size_t ln = FindLine(s);
+  size_t ls = _lines[ln];
+  const char *nl = (const char*)memchr(_text.data() + e, '\n', size - e);
+  size_t le = nl != NULL ? nl - _text.data() + 1 : size;
+  long delta = (long)text.size() - (long)(e - s);
+
+  // old tokens on the damaged lines (tokens never span lines)
+  size_t a = FindToken(ls);
+  size_t b = le < size ? FindToken(le) : _tokens.GetSize();
+  bool structural = (_module == NULL);
+  for (size_t i=a; i<b; i++) structural |= IsStructural(_tokens.GetType(i));
+
+  _text.replace(s, e - s, text);
+
+  // update the line starts
+  size_t l0 = ln + 1;
+  size_t l1 = upper_bound(_lines.begin(), _lines.end(), le) - _lines.begin();
+  for (size_t i=l1; i<_lines.size(); i++) _lines[i] += delta;
+  vector<unsigned int> start;
+  for (size_t i=ls; i<le + delta; i++) {
+    if (_text[i] == '\n') start.push_back(i + 1);
+  }
+  _lines.erase(_lines.begin() + l0, _lines.begin() + l1);
+  _lines.insert(_lines.begin() + l0, start.begin(), start.end());
+
+  // re-scan the damaged lines and splice in the new tokens
+  CTokenBuffer tokens;
+  CScanner::TokenizeLines(_text.data() + ls, le + delta - ls, &tokens);
+  for (size_t i=0; i<tokens.GetSize(); i++) {
+    structural |= IsStructural(tokens.GetType(i));
+  }
+
+  size_t ntokens = _tokens.GetSize();
+  _tokens.Replace(a, b, tokens, ls, delta, b == ntokens);
+  long d = (long)_tokens.GetSize() - (long)ntokens;
+
+  if (structural) return false;
+
+  // find the part containing the edit
+  size_t p = _part.size();
+  while ((p > 0) && (_part[p-1].first >= a)) p--;
+  if ((p == 0) && (a == b) && (d == 0)) return true; // before the header
+  if (p == 0) return false;
+  p--;
+  if (b > _part[p].end) return false;
+
+  if ((a == b) && (d == 0)) {
+    // no tokens were touched; only the error offsets of the part may move
+    CPart &part = _part[p];
+    unsigned int base = _tokens.GetPosition(part.first);
+    for (size_t i=0; i<part.errors.size(); i++) {
+      if (base + part.errors[i].rel >= le) part.errors[i].rel += delta;
+    }
+    return true;
+  }
+
+  if (p == 0) return false;
+
+  _part[p].end += d;
+  for (size_t q=p+1; q<_part.size(); q++) {
+    _part[q].first += d;
+    _part[q].end += d;
+  }
+
+  // edits of the last subroutine or the body must not move the body
+  size_t body = _part.size() - 1;
+  if (p + 2 >= _part.size()) {
+    size_t from = _part.size() > 2 ? _part[body-1].first : 0;
+    if (FindBody(from) != _part[body].first) return false;
+  }
+
+  return CheckPart(p);
+}
+
+vector<CDiagnostic> CDocument::GetDiagnostics(void) const
+{
+  vector<CDiagnostic> res;
+
+  for (size_t p=0; p<_part.size(); p++) {
+    const CPart &part = _part[p];
+
+    for (size_t i=0; i<part.errors.size(); i++) {
+      const CPartError &e = part.errors[i];
+      size_t pos = min((size_t)_tokens.GetPosition(part.first) + e.rel,
+                       _text.size());
+      size_t line = FindLine(pos);
+
+      CDiagnostic d;
+      d.line = (int)line;
+      d.charpos = (int)(pos - _lines[line]);
+      d.length = e.length;
+      d.message = e.message;
+      res.push_back(d);
+    }
+  }
+
+  return res;
+}
+
+void CDocument::Check(void)
+{
+  Release();
+  _part.clear();
+
+  // start over in a new context so that the types and strings of earlier
+  // checks are freed
+  _tokens.Clear();
+  delete _compilation;
+  _compilation = new CCompilation();
+  CCompilation *prev = CCompilation::SetCurrent(_compilation);
+
+  CScanner::TokenizeLines(_text.data(), _text.size(), &_tokens);
+
+  // subroutines start with 'procedure' or 'function'; the keywords cannot
+  // occur anywhere else
+  vector<size_t> start;
+  for (size_t i=0; i<_tokens.GetSize(); i++) {
+    if ((_tokens.GetType(i) == tProcedure) ||
+        (_tokens.GetType(i) == tFunction)) start.push_back(i);
+  }
+  size_t body = FindBody(start.empty() ? 0 : start.back());
+
+  CPart part = { 0, npos, NULL, NULL, vector<CPartError>() };
+
+  // header
+  CParser parser(&_tokens, _compilation);
+  size_t end;
+  _module = parser.ParseModuleHeader(0, &end);
+  if (!start.empty()) part.end = start[0];
+  else if (body != npos) part.end = body;
+  else part.end = end;
+
+  if (_module == NULL) part.end = _tokens.GetSize();
+  SetErrors(&part, parser, end);
+  _part.push_back(part);
+
+  if (_module != NULL) {
+    // subroutines and body
+    for (size_t i=0; i<start.size(); i++) {
+      part.first = start[i];
+      part.end = i+1 < start.size() ? start[i+1] : body;
+      _part.push_back(part);
+    }
+    part.first = body;
+    part.end = _tokens.GetSize();
+    _part.push_back(part);
+
+    for (size_t p=1; p<_part.size(); p++) {
+      if (_part[p].first == npos) _part[p].first = _part[p-1].end;
+      ParsePart(p);
+    }
+  }
+
+  CCompilation::SetCurrent(prev);
+}
+
+void CDocument::ParsePart(size_t p)
+{
+  CPart &part = _part[p];
+  CParser parser(&_tokens, _compilation);
+
+  // like a full parse, hide the subroutines declared after the part
+  map<const CSymbol*, size_t> order;
+  for (size_t q=1; q+1<_part.size(); q++) {
+    if ((q != p) && (_part[q].symbol != NULL)) order[_part[q].symbol] = q;
+  }
+  parser.SetOrder(&order, p);
+
+  part.proc = NULL;
+  part.symbol = NULL;
+
+  if (p == _part.size()-1) {
+    parser.ParseModuleBody(_module, part.first);
+    SetErrors(&part, parser, part.end);
+    return;
+  }
+
+  size_t end;
+  CAstProcedure *proc = parser.ParseSubroutine(_module, part.first, &end);
+  if (part.end == npos) part.end = end;
+
+  if (proc != NULL) {
+    // keep the symbol of a broken subroutine so that calls still resolve
+    CSymProc *symbol = proc->GetSymbol();
+    if (_module->GetSymbolTable()->FindSymbol(symbol->GetName(), sLocal) ==
+        symbol) part.symbol = symbol;
+
+    if (parser.HasError()) {
+      _module->RemoveChild(proc);
+      delete proc;
+    } else {
+      part.proc = proc;
+    }
+  }
+
+  SetErrors(&part, parser, end);
+}
+
+bool CDocument::CheckPart(size_t p)
+{
+  CPart &part = _part[p];
+
+  if (p == _part.size()-1) {
+    _module->SetStatementSequence(vector<CAstStatement*>());
+    ParsePart(p);
+    return true;
+  }
+
+  // the calls in other parts still refer to the old symbol; its memory is
+  // reclaimed by the next full check
+  CSymProc *symbol = part.symbol;
+  if ((symbol != NULL) && (_retired.size() >= max_retired)) return false;
+
+  // delete the old subroutine and retire its symbol
+  CSymtab *symtab = _module->GetSymbolTable();
+  int id = -1;
+  if (part.proc != NULL) {
+    _module->RemoveChild(part.proc);
+    delete part.proc;
+    part.proc = NULL;
+  }
+  if (symbol != NULL) {
+    id = symbol->GetID();
+    symtab->RemoveSymbol(symbol);
+    _retired.push_back(symbol);
+  }
+
+  ParsePart(p);
+
+  // keep the new symbol in the declaration slot of the old one
+  if ((id >= 0) && (part.symbol != NULL)) symtab->MoveSymbol(part.symbol, id);
+
+  // keep the subroutines in source order
+  if (part.proc != NULL) {
+    size_t i = 0;
+    for (size_t q=1; q<p; q++) if (_part[q].proc != NULL) i++;
+    _module->InsertChild(part.proc, i);
+  }
+
+  return SameSignature(symbol, part.symbol);
+}
+
+size_t CDocument::FindBody(size_t from) const
+{
+  // the body is the last 'begin' ... 'end' block; every 'end' closes a
+  // 'begin', 'if', or 'while'
+  int depth = 0;
+
+  for (size_t i=_tokens.GetSize(); i-- > from; ) {
+    switch (_tokens.GetType(i)) {
+      case tEnd:
+        depth++;
+        break;
+      case tIf:
+      case tWhile:
+        if (--depth < 0) return npos;
+        break;
+      case tBegin:
+        if (--depth == 0) return i;
+        if (depth < 0) return npos;
+        break;
+      default:
+        break;
+    }
+  }
+
+  return npos;
+}
+
+void CDocument::SetErrors(CPart *part, const CParser &parser, size_t end)
+{
+  const vector<CSourceError> &errors = parser.GetErrors();
+
+  part->errors.clear();
+  for (size_t i=0; i<errors.size(); i++) {
+    AddError(part, errors[i].token, errors[i].message);
+  }
+
+  if (errors.empty() && (end != part->end)) {
+    AddError(part, _tokens.GetToken(end),
+             "expected \"procedure\" or \"function\"");
+  }
+}
+
+void CDocument::AddError(CPart *part, const CToken &t, const string &message)
+{
+  unsigned int base = _tokens.GetPosition(part->first);
+  unsigned int pos = t.GetPosition();
+  size_t length = t.GetValue().size();
+  CPartError e;
+
+  // tokens taken from AST nodes only carry a position; look up the length
+  // of the token at that position in the token buffer
+  if ((length == 0) && (pos != CToken::NOPOS)) {
+    size_t i = FindToken(pos);
+    if ((i < _tokens.GetSize()) && (_tokens.GetPosition(i) == pos)) {
+      _tokens.GetValue(i, &length);
+    }
+  }
+
+  e.rel = (pos != CToken::NOPOS) && (pos > base) ? pos - base : 0;
+  e.length = max((int)length, 1);
+  e.message = message;
+  part->errors.push_back(e);
+}
+
+size_t CDocument::FindToken(size_t pos) const
+{
+  size_t lo = 0, hi = _tokens.GetSize();
+
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    if (_tokens.GetPosition(mid) < pos) lo = mid + 1;
+    else hi = mid;
+  }
+
+  return lo;
+}
+
+size_t CDocument::FindLine(size_t pos) const
+{
+  return upper_bound(_lines.begin(), _lines.end(), pos) - _lines.begin() - 1;
+}
+
+size_t CDocument::GetOffset(int line, int charpos) const
+{
+  if (line < 0) return 0;
+  if ((size_t)line >= _lines.size()) return _text.size();
+
+  size_t end = (size_t)line+1 < _lines.size() ? _lines[line+1] - 1
+                                              : _text.size();
+  return min(_lines[line] + (size_t)max(charpos, 0), end);
+}
+
+void CDocument::BuildLines(void)
+{
+  _lines.clear();
+  _lines.push_back(0);
+  for (size_t i=0; i<_text.size(); i++) {
+    if (_text[i] == '\n') _lines.push_back(i + 1);
+  }
+}
+
+void CDocument::Release(void)
+{
+  if (_module != NULL) {
+    for (size_t i=0; i<_module->GetNumChildren(); i++) {
+      delete _module->GetChild(i);
+    }
+    delete _module;
+    _module = NULL;
+  }
+
+  for (size_t i=0; i<_retired.size(); i++) delete _retired[i];
+  _retired.clear();
+}
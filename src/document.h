@@ -0,0 +1,227 @@
+//------------------------------------------------------------------------------
+/// @brief SnuPL incrementally checked source document
+/// @author Bernhard Egger <bernhard@csap.snu.ac.kr>
+/// @section changelog Change Log
+/// 2026/10/16 created: incremental re-lexing/re-parsing for the server mode
+///
+///
+/// @section license_section License
+/// Copyright (c) 2012-2016, Bernhard Egger
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms,  with or without modifi-
+/// cation, are permitted provided that the following conditions are met:
+///
+/// - Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+/// - Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,  BUT NOT LIMITED TO,  THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY  AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER  OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT,  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSE-
+/// QUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF  SUBSTITUTE
+/// GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+/// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN  CONTRACT, STRICT
+/// LIABILITY, OR TORT  (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY
+/// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+/// DAMAGE.
+//------------------------------------------------------------------------------
+
+#ifndef __SnuPL_DOCUMENT_H__
+#define __SnuPL_DOCUMENT_H__
+
+#include <string>
+#include <vector>
+
+#include "scanner.h"
+#include "symtab.h"
+#include "ast.h"
+#include "parser.h"
+#include "compilation.h"
+using namespace std;
+
+
+//------------------------------------------------------------------------------
+/// @brief diagnostic
+///
+/// an error reported for a document. Lines and characters are 0-based.
+///
+struct CDiagnostic {
+  int     line;                     ///< line
+  int     charpos;                  ///< character position
+  int     length;                   ///< length of the offending token
+  string  message;                  ///< error message
+};
+
+
+//------------------------------------------------------------------------------
+/// @brief source document
+///
+/// holds the text, tokens, and AST of a module that is edited interactively.
+/// The module is split into parts: the header (module name and global
+/// variables), one part per subroutine declaration, and the module body.
+/// Each part is parsed and type checked on its own and reports all of its
+/// errors.
+///
+/// An edit re-scans only the lines it touches (tokens never span lines) and
+/// splices the new tokens into the token buffer. If the edit lies within a
+/// subroutine (or the module body), only that part is re-parsed and type
+/// checked; the ASTs and symbol tables of all other parts are kept. Edits
+/// that change the structure of the module (the header, the set of
+/// subroutines, or a subroutine's signature) fall back to a full check.
+///
+/// Each document is checked in a compilation context of its own that holds
+/// its types and the string pool of its tokens; a full check starts over in
+/// a new context.
+///
+/// The calls in other parts keep referring to the symbol of a re-parsed
+/// subroutine. The replaced symbols are retired and freed by the next full
+/// check, which is forced once max_retired symbols have accumulated.
+///
+class CDocument {
+  public:
+    /// @name construction/destruction
+    /// @{
+
+    /// @brief constructor
+    CDocument(void);
+
+    /// @brief destructor
+    ~CDocument(void);
+
+    /// @}
+
+    /// @name editing
+    /// @{
+
+    /// @brief replace the text and check the module from scratch
+    ///
+    /// @param text new text
+    void SetText(const string &text);
+
+    /// @brief replace a range of the text and re-check the module
+    ///
+    /// the range is given by 0-based lines and characters (bytes); positions
+    /// past the end of a line refer to the end of the line.
+    ///
+    /// @param line0 first line of the range
+    /// @param char0 character position in @a line0
+    /// @param line1 last line of the range
+    /// @param char1 character position (exclusive) in @a line1
+    /// @param text replacement text
+    /// @retval true if the module was re-checked incrementally
+    /// @retval false if a full check was necessary
+    bool Edit(int line0, int char0, int line1, int char1, const string &text);
+
+    /// @}
+
+    /// @name querying
+    /// @{
+
+    /// @brief return the text
+    const string& GetText(void) const { return _text; };
+
+    /// @brief return the module AST (NULL if the module header is broken)
+    CAstModule* GetModule(void) const { return _module; };
+
+    /// @brief return the diagnostics of all parts in source order
+    vector<CDiagnostic> GetDiagnostics(void) const;
+
+    /// @}
+
+  private:
+    /// @brief error in a part of the module
+    struct CPartError {
+      unsigned int rel;             ///< error offset relative to first token
+      int     length;               ///< length of the error token
+      string  message;              ///< error message
+    };
+
+    /// @brief part of the module
+    struct CPart {
+      size_t  first;                ///< index of the first token
+      size_t  end;                  ///< index one past the last token
+      CAstProcedure *proc;          ///< subroutine AST (or NULL)
+      CSymProc *symbol;             ///< subroutine symbol in the module symtab
+      vector<CPartError> errors;    ///< errors
+    };
+
+    /// @brief scan, parse, and type check the whole module in a new
+    ///        compilation context
+    void Check(void);
+
+    /// @brief apply an edit to the text and tokens and re-check the part
+    ///        containing it
+    ///
+    /// parameters as in Edit(); the document's context must be current
+    ///
+    /// @retval true if the module was re-checked incrementally
+    /// @retval false if a full check is necessary
+    bool Update(int line0, int char0, int line1, int char1,
+                const string &text);
+
+    /// @brief parse and type check a subroutine or the module body
+    ///
+    /// a subroutine AST is appended to the module's subordinate scopes
+    ///
+    /// @param p part index
+    void ParsePart(size_t p);
+
+    /// @brief re-parse and type check a subroutine or the module body after
+    ///        an edit
+    /// @param p part index
+    /// @retval true if the structure of the module is unchanged
+    /// @retval false if a full check is required
+    bool CheckPart(size_t p);
+
+    /// @brief find the first token of the module body by matching the
+    ///        'end' tokens backwards from the end of the module
+    /// @param from index of the first token to consider
+    /// @retval index of the module's 'begin' token, or npos if not found
+    size_t FindBody(size_t from) const;
+
+    /// @brief record the errors of a parser for a part
+    /// @param part part
+    /// @param parser parser that has parsed the part
+    /// @param end index of the token following the parsed part
+    void SetErrors(CPart *part, const CParser &parser, size_t end);
+
+    /// @brief add an error to a part
+    /// @param part part
+    /// @param t token causing the error
+    /// @param message error message
+    void AddError(CPart *part, const CToken &t, const string &message);
+
+    /// @brief return the index of the first token at or after an offset
+    size_t FindToken(size_t pos) const;
+
+    /// @brief return the line containing a text offset
+    size_t FindLine(size_t pos) const;
+
+    /// @brief convert a line/character position into a text offset
+    size_t GetOffset(int line, int charpos) const;
+
+    /// @brief compute the line starts of the text
+    void BuildLines(void);
+
+    /// @brief delete the AST and symbols
+    void Release(void);
+
+    string                 _text;   ///< text
+    vector<unsigned int>   _lines;  ///< offsets of the line starts
+    CTokenBuffer           _tokens; ///< tokens
+    CAstModule            *_module; ///< module AST
+    vector<CPart>          _part;   ///< header, subroutines, body
+    vector<CSymbol*>       _retired;///< replaced subroutine symbols
+    CCompilation          *_compilation; ///< compilation context
+
+    static const size_t npos = ~(size_t)0;
+    static const size_t max_retired = 64; ///< retired symbols before a full
+                                          ///< check
+};
+
+#endif // __SnuPL_DOCUMENT_H__
@@ -36,6 +36,10 @@
 
 #include <iomanip>
 #include <cassert>
+#include <climits>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "ir.h"
 #include "ast.h"
@@ -90,6 +94,9 @@ char EOperationName[][OPERATION_STRLEN] = {
   "return",                         ///< return: return optional src1
   "param",                          ///< parameter: dst = index, src1 = parameter
 
+  // SSA form
+  "phi",                            ///< phi function: dst = phi(args)
+
   // special
   "label",                          ///< jump label; no arguments
   "nop",                            ///< no operation
@@ -123,6 +130,22 @@ CTac::~CTac(void)
 {
 }
 
+/// @brief run the destructor of an arena-allocated instruction or operand
+static void DestroyTac(void *p)
+{
+  static_cast<CTac*>(p)->~CTac();
+}
+
+void* CTac::operator new(size_t size)
+{
+  return CArena::New(size, DestroyTac);
+}
+
+void CTac::operator delete(void *p)
+{
+  CArena::Delete(p);
+}
+
 ostream& operator<<(ostream &out, const CTac &t)
 {
   return t.print(out);
@@ -194,18 +217,44 @@ ostream& CTacConst::print(ostream &out, int indent) const
 //------------------------------------------------------------------------------
 // CTacTemp
 //
-CTacTemp::CTacTemp(const CSymbol *symbol)
-  : CTacName(symbol)
+CTacTemp::CTacTemp(unsigned int id, const CType *type)
+  : _id(id), _type(type)
+{
+  assert(type != NULL);
+}
+
+unsigned int CTacTemp::GetId(void) const
+{
+  return _id;
+}
+
+const CType* CTacTemp::GetType(void) const
+{
+  return _type;
+}
+
+ostream& CTacTemp::print(ostream &out, int indent) const
 {
+  string ind(indent, ' ');
+
+  out << ind << "t" << _id;
+
+  return out;
 }
 
 
 //------------------------------------------------------------------------------
 // CTacReference
 //
-CTacReference::CTacReference(const CSymbol *symbol, const CSymbol *deref)
-  : CTacName(symbol), _deref(deref)
+CTacReference::CTacReference(CTacTemp *base, const CSymbol *deref)
+  : _base(base), _deref(deref)
 {
+  assert(base != NULL);
+}
+
+CTacTemp* CTacReference::GetBase(void) const
+{
+  return _base;
 }
 
 const CSymbol* CTacReference::GetDerefSymbol(void) const
@@ -217,7 +266,7 @@ ostream& CTacReference::print(ostream &out, int indent) const
 {
   string ind(indent, ' ');
 
-  out << ind << "@" << _symbol->GetName();
+  out << ind << "@" << _base;
 
   return out;
 }
@@ -294,6 +343,15 @@ void CTacInstr::SetDest(CTac* dst)
   _dst = dst;
 }
 
+void CTacInstr::SetSrc(int index, CTacAddr *src)
+{
+  switch (index) {
+    case 1: _src1 = src; break;
+    case 2: _src2 = src; break;
+    default: assert(false);
+  }
+}
+
 ostream& CTacInstr::print(ostream &out, int indent) const
 {
   string ind(indent, ' ');
@@ -372,6 +430,50 @@ ostream& CTacLabel::print(ostream &out, int indent) const
 }
 
 
+//------------------------------------------------------------------------------
+// CTacPhi
+//
+CTacPhi::CTacPhi(CTac *dst, unsigned int nargs)
+  : CTacInstr(opPhi, dst), _args(nargs, NULL)
+{
+}
+
+CTacPhi::~CTacPhi(void)
+{
+}
+
+unsigned int CTacPhi::GetNumArgs(void) const
+{
+  return _args.size();
+}
+
+CTacAddr* CTacPhi::GetArg(unsigned int index) const
+{
+  assert(index < _args.size());
+  return _args[index];
+}
+
+void CTacPhi::SetArg(unsigned int index, CTacAddr *arg)
+{
+  assert(index < _args.size());
+  _args[index] = arg;
+}
+
+ostream& CTacPhi::print(ostream &out, int indent) const
+{
+  string ind(indent, ' ');
+
+  out << ind << right << dec << setw(3) << _id << ": "
+      << "    " << left << setw(6) << _op << " " << _dst << " <- ";
+  for (size_t i=0; i<_args.size(); i++) {
+    if (i > 0) out << ", ";
+    if (_args[i] != NULL) out << _args[i]; else out << "?";
+  }
+
+  return out;
+}
+
+
 //------------------------------------------------------------------------------
 // CScope
 //
@@ -385,6 +487,8 @@ CScope::CScope(CAstNode *ast, CScope *parent)
   _symtab = s->GetSymbolTable();
   _cb = new CCodeBlock(this);
   s->ToTac(_cb);
+  _cb->ToSSA();
+  _cb->PropagateConstants();
 
   for (size_t i=0; i<s->GetNumChildren(); i++) {
     CProcedure *p = new CProcedure(s->GetChild(i), this);
@@ -394,6 +498,7 @@ CScope::CScope(CAstNode *ast, CScope *parent)
 
 CScope::~CScope(void)
 {
+  for (size_t i=0; i<_children.size(); i++) delete _children[i];
   delete _cb;
 }
 
@@ -422,15 +527,14 @@ CCodeBlock* CScope::GetCodeBlock(void) const
   return _cb;
 }
 
-CTacTemp* CScope::CreateTemp(const CType *type)
+unsigned int CScope::GetNumTemps(void) const
 {
-  ostringstream tmp;
-  tmp << "t" << _temp_id++;
-
-  CSymbol *s = new CSymLocal(tmp.str(), type);
-  GetSymbolTable()->AddSymbol(s);
+  return _temp_id;
+}
 
-  return new CTacTemp(s);
+CTacTemp* CScope::CreateTemp(const CType *type)
+{
+  return new CTacTemp(_temp_id++, type);
 }
 
 CTacLabel* CScope::CreateLabel(const char *hint)
@@ -480,7 +584,7 @@ ostream& operator<<(ostream &out, const CScope *t)
 // CModule
 //
 CModule::CModule(CAstNode *ast)
-  : CScope(ast, NULL)
+  : CScope(ast, NULL), _compilation(CCompilation::GetCurrent())
 {
 }
 
@@ -498,7 +602,7 @@ ostream& CModule::print(ostream &out, int indent) const
   string ind(indent, ' ');
 
   out << ind << "[[ module: " << GetName() << endl;
-  CTypeManager::Get()->print(out, indent+2);
+  _compilation->GetTypeManager()->print(out, indent+2);
   GetSymbolTable()->print(out, indent+2);
   _cb->print(out, indent+2);
 
@@ -550,17 +654,202 @@ ostream& CProcedure::print(ostream &out, int indent) const
 }
 
 
+//------------------------------------------------------------------------------
+// CBasicBlock
+//
+CBasicBlock::CBasicBlock(CCodeBlock *owner, unsigned int id)
+  : _owner(owner), _id(id), _rpo(-1), _idom(NULL), _dom_pre(0), _dom_post(0),
+    _loop(NULL)
+{
+  assert(_owner != NULL);
+}
+
+CBasicBlock::~CBasicBlock(void)
+{
+}
+
+unsigned int CBasicBlock::GetId(void) const
+{
+  return _id;
+}
+
+CCodeBlock* CBasicBlock::GetOwner(void) const
+{
+  return _owner;
+}
+
+const list<CTacInstr*>& CBasicBlock::GetInstr(void) const
+{
+  return _instr;
+}
+
+CTacLabel* CBasicBlock::GetLabel(void) const
+{
+  if (_instr.empty()) return NULL;
+  return dynamic_cast<CTacLabel*>(_instr.front());
+}
+
+const vector<CBasicBlock*>& CBasicBlock::GetSucc(void) const
+{
+  return _succ;
+}
+
+const vector<CBasicBlock*>& CBasicBlock::GetPred(void) const
+{
+  return _pred;
+}
+
+bool CBasicBlock::IsReachable(void) const
+{
+  return _rpo >= 0;
+}
+
+int CBasicBlock::GetRPO(void) const
+{
+  return _rpo;
+}
+
+CBasicBlock* CBasicBlock::GetIDom(void) const
+{
+  return _idom;
+}
+
+const vector<CBasicBlock*>& CBasicBlock::GetDomChildren(void) const
+{
+  return _dom_children;
+}
+
+bool CBasicBlock::Dominates(const CBasicBlock *b) const
+{
+  assert(b != NULL);
+
+  // a dominates b iff b lies in the subtree of a in the dominator tree
+  if (!IsReachable() || !b->IsReachable()) return false;
+  return (_dom_pre <= b->_dom_pre) && (b->_dom_post <= _dom_post);
+}
+
+CLoop* CBasicBlock::GetLoop(void) const
+{
+  return _loop;
+}
+
+void CBasicBlock::AddSucc(CBasicBlock *succ)
+{
+  assert(succ != NULL);
+
+  if (find(_succ.begin(), _succ.end(), succ) != _succ.end()) return;
+  _succ.push_back(succ);
+  succ->_pred.push_back(this);
+}
+
+ostream& CBasicBlock::print(ostream &out, int indent) const
+{
+  string ind(indent, ' ');
+
+  out << ind << "B" << _id << ":";
+  out << "  pred:";
+  for (size_t i=0; i<_pred.size(); i++) out << " B" << _pred[i]->_id;
+  out << "  succ:";
+  for (size_t i=0; i<_succ.size(); i++) out << " B" << _succ[i]->_id;
+  if (_idom != NULL) out << "  idom: B" << _idom->_id;
+  if (_loop != NULL) out << "  loop: B" << _loop->GetHeader()->_id;
+  out << endl;
+
+  list<CTacInstr*>::const_iterator it = _instr.begin();
+  while (it != _instr.end()) {
+    (*it++)->print(out, indent+2);
+    out << endl;
+  }
+
+  return out;
+}
+
+string CBasicBlock::dotID(void) const
+{
+  ostringstream o;
+  o << _owner->dotID() << "_" << _id;
+  return o.str();
+}
+
+string CBasicBlock::dotAttr(void) const
+{
+  ostringstream o;
+
+  o << " [label=\"B" << _id << "\\l";
+
+  list<CTacInstr*>::const_iterator it = _instr.begin();
+  while (it != _instr.end()) {
+    (*it++)->print(o, 0);
+    o << "\\l";
+  }
+
+  o << "\",shape=box]";
+
+  return o.str();
+}
+
+
+//------------------------------------------------------------------------------
+// CLoop
+//
+CLoop::CLoop(CBasicBlock *header)
+  : _header(header), _parent(NULL), _depth(1)
+{
+  assert(_header != NULL);
+}
+
+CLoop::~CLoop(void)
+{
+}
+
+CBasicBlock* CLoop::GetHeader(void) const
+{
+  return _header;
+}
+
+const vector<CBasicBlock*>& CLoop::GetBlocks(void) const
+{
+  return _blocks;
+}
+
+const vector<CBasicBlock*>& CLoop::GetLatches(void) const
+{
+  return _latches;
+}
+
+CLoop* CLoop::GetParent(void) const
+{
+  return _parent;
+}
+
+unsigned int CLoop::GetDepth(void) const
+{
+  return _depth;
+}
+
+bool CLoop::Contains(const CBasicBlock *b) const
+{
+  assert(b != NULL);
+
+  for (const CLoop *l = b->GetLoop(); l != NULL; l = l->_parent) {
+    if (l == this) return true;
+  }
+  return false;
+}
+
+
 //------------------------------------------------------------------------------
 // CCodeBlock
 //
 CCodeBlock::CCodeBlock(CScope *owner)
-  : _owner(owner), _inst_id(0)
+  : _owner(owner), _inst_id(0), _ssa(false)
 {
   assert(_owner != NULL);
 }
 
 CCodeBlock::~CCodeBlock(void)
 {
+  ReleaseCFG();
 }
 
 string CCodeBlock::GetName(void) const
@@ -585,7 +874,8 @@ CTacLabel* CCodeBlock::CreateLabel(const char *hint)
 
 CTacInstr* CCodeBlock::AddInstr(CTacInstr *instr)
 {
-  assert(instr != NULL);
+  assert((instr != NULL) && !_ssa);
+  ReleaseCFG();
   instr->SetId(_inst_id++);
   _ops.push_back(instr);
 
@@ -599,6 +889,9 @@ const list<CTacInstr*>& CCodeBlock::GetInstr(void) const
 
 void CCodeBlock::CleanupControlFlow(void)
 {
+  assert(!_ssa);
+  ReleaseCFG();
+
   list<CTacInstr*>::iterator it = _ops.begin();
 
   // 1. pass: delete all branches (absolute/conditional) that jump to the
@@ -637,6 +930,1266 @@ void CCodeBlock::CleanupControlFlow(void)
   while (it != _ops.end()) (*it++)->SetId(_inst_id++);
 }
 
+void CCodeBlock::BuildCFG(void)
+{
+  assert(!_ssa);
+  ReleaseCFG();
+
+  // 1. split the instructions into basic blocks. A block starts at the first
+  //    instruction, at a label following a non-label instruction, and after
+  //    a branch or a return.
+  unordered_map<const CTacLabel*, CBasicBlock*> target;
+  CBasicBlock *bb = NULL;
+  bool body = false;
+
+  list<CTacInstr*>::const_iterator it = _ops.begin();
+  while (it != _ops.end()) {
+    CTacInstr *instr = *it++;
+    bool label = instr->GetOperation() == opLabel;
+
+    if ((bb == NULL) || (label && body)) {
+      bb = new CBasicBlock(this, _blocks.size());
+      _blocks.push_back(bb);
+      body = false;
+    }
+    bb->_instr.push_back(instr);
+
+    if (label) target[dynamic_cast<CTacLabel*>(instr)] = bb;
+    else body = true;
+
+    if (instr->IsBranch() || (instr->GetOperation() == opReturn)) bb = NULL;
+  }
+  if (_blocks.empty()) _blocks.push_back(new CBasicBlock(this, 0));
+
+  // 2. connect the blocks: branches to their target, and all blocks except
+  //    those ending in a goto or return to the next block
+  for (size_t b=0; b<_blocks.size(); b++) {
+    CBasicBlock *bb = _blocks[b];
+    CTacInstr *last = bb->_instr.empty() ? NULL : bb->_instr.back();
+    bool fallthrough = true;
+
+    if ((last != NULL) && last->IsBranch()) {
+      CTacLabel *lbl = dynamic_cast<CTacLabel*>(last->GetDest());
+      unordered_map<const CTacLabel*, CBasicBlock*>::iterator t =
+        target.find(lbl);
+      assert(t != target.end());
+      bb->AddSucc(t->second);
+      fallthrough = last->GetOperation() != opGoto;
+    } else if ((last != NULL) && (last->GetOperation() == opReturn)) {
+      fallthrough = false;
+    }
+
+    if (fallthrough && (b+1 < _blocks.size())) bb->AddSucc(_blocks[b+1]);
+  }
+
+  // 3. code starting with a loop header is entered by the back edge, too; an
+  //    empty entry block keeps the entry free of predecessors
+  if (!_blocks[0]->_pred.empty()) {
+    _blocks.insert(_blocks.begin(), new CBasicBlock(this, 0));
+    for (size_t b=1; b<_blocks.size(); b++) _blocks[b]->_id = b;
+    _blocks[0]->AddSucc(_blocks[1]);
+  }
+
+  ComputeDominators();
+  ComputeLoops();
+}
+
+bool CCodeBlock::HasCFG(void) const
+{
+  return !_blocks.empty();
+}
+
+const vector<CBasicBlock*>& CCodeBlock::GetBlocks(void) const
+{
+  return _blocks;
+}
+
+CBasicBlock* CCodeBlock::GetEntry(void) const
+{
+  return _blocks.empty() ? NULL : _blocks[0];
+}
+
+const vector<CBasicBlock*>& CCodeBlock::GetRPO(void) const
+{
+  return _rpo;
+}
+
+const vector<CLoop*>& CCodeBlock::GetLoops(void) const
+{
+  return _loops;
+}
+
+void CCodeBlock::ReleaseCFG(void)
+{
+  for (size_t i=0; i<_loops.size(); i++) delete _loops[i];
+  for (size_t i=0; i<_blocks.size(); i++) delete _blocks[i];
+  _loops.clear();
+  _rpo.clear();
+  _blocks.clear();
+}
+
+/// @brief return the nearest common dominator of @a a and @a b
+///
+/// walks up the (partial) dominator tree using the reverse postorder numbers
+/// (Cooper, Harvey, and Kennedy: A Simple, Fast Dominance Algorithm)
+static CBasicBlock* Intersect(CBasicBlock *a, CBasicBlock *b)
+{
+  while (a != b) {
+    while (a->GetRPO() > b->GetRPO()) a = a->GetIDom();
+    while (b->GetRPO() > a->GetRPO()) b = b->GetIDom();
+  }
+  return a;
+}
+
+void CCodeBlock::ComputeDominators(void)
+{
+  _rpo.clear();
+  for (size_t b=0; b<_blocks.size(); b++) {
+    _blocks[b]->_rpo = -1;
+    _blocks[b]->_idom = NULL;
+    _blocks[b]->_dom_children.clear();
+  }
+
+  // reverse postorder of an (iterative) depth-first search from the entry
+  vector<pair<CBasicBlock*, size_t> > stack;
+  vector<bool> visited(_blocks.size(), false);
+
+  stack.push_back(make_pair(_blocks[0], 0));
+  visited[0] = true;
+  while (!stack.empty()) {
+    CBasicBlock *bb = stack.back().first;
+    size_t i = stack.back().second++;
+
+    if (i < bb->_succ.size()) {
+      CBasicBlock *s = bb->_succ[i];
+      if (!visited[s->_id]) {
+        visited[s->_id] = true;
+        stack.push_back(make_pair(s, 0));
+      }
+    } else {
+      _rpo.push_back(bb);
+      stack.pop_back();
+    }
+  }
+  reverse(_rpo.begin(), _rpo.end());
+  for (size_t r=0; r<_rpo.size(); r++) _rpo[r]->_rpo = r;
+
+  // immediate dominators: iterate over the blocks in reverse postorder until
+  // a fixpoint is reached. Unreachable predecessors have no dominator and
+  // are ignored.
+  CBasicBlock *entry = _rpo[0];
+  entry->_idom = entry;
+
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (size_t r=1; r<_rpo.size(); r++) {
+      CBasicBlock *bb = _rpo[r];
+      CBasicBlock *idom = NULL;
+
+      for (size_t p=0; p<bb->_pred.size(); p++) {
+        CBasicBlock *pred = bb->_pred[p];
+        if (pred->_idom == NULL) continue;
+        idom = idom == NULL ? pred : Intersect(pred, idom);
+      }
+
+      if (idom != bb->_idom) {
+        bb->_idom = idom;
+        changed = true;
+      }
+    }
+  }
+  entry->_idom = NULL;
+
+  // dominator tree with pre- and postorder numbers for Dominates()
+  for (size_t r=1; r<_rpo.size(); r++) {
+    _rpo[r]->_idom->_dom_children.push_back(_rpo[r]);
+  }
+
+  unsigned int pre = 0, post = 0;
+  entry->_dom_pre = pre++;
+  stack.push_back(make_pair(entry, 0));
+  while (!stack.empty()) {
+    CBasicBlock *bb = stack.back().first;
+    size_t i = stack.back().second++;
+
+    if (i < bb->_dom_children.size()) {
+      CBasicBlock *c = bb->_dom_children[i];
+      c->_dom_pre = pre++;
+      stack.push_back(make_pair(c, 0));
+    } else {
+      bb->_dom_post = post++;
+      stack.pop_back();
+    }
+  }
+}
+
+void CCodeBlock::ComputeLoops(void)
+{
+  for (size_t i=0; i<_loops.size(); i++) delete _loops[i];
+  _loops.clear();
+  for (size_t b=0; b<_blocks.size(); b++) _blocks[b]->_loop = NULL;
+
+  // headers are visited in reverse postorder, so enclosing loops are found
+  // before the loops nested in them. When a loop is found, its header still
+  // belongs to the innermost enclosing loop found so far.
+  vector<size_t> mark(_blocks.size(), 0);
+  vector<CBasicBlock*> work;
+
+  for (size_t r=0; r<_rpo.size(); r++) {
+    CBasicBlock *h = _rpo[r];
+    CLoop *loop = NULL;
+
+    for (size_t p=0; p<h->_pred.size(); p++) {
+      if (h->Dominates(h->_pred[p])) {
+        if (loop == NULL) loop = new CLoop(h);
+        loop->_latches.push_back(h->_pred[p]);
+      }
+    }
+    if (loop == NULL) continue;
+
+    // collect the blocks that reach a latch without passing the header
+    size_t stamp = _loops.size() + 1;
+    mark[h->_id] = stamp;
+    for (size_t l=0; l<loop->_latches.size(); l++) {
+      CBasicBlock *latch = loop->_latches[l];
+      if (mark[latch->_id] != stamp) {
+        mark[latch->_id] = stamp;
+        work.push_back(latch);
+      }
+    }
+    while (!work.empty()) {
+      CBasicBlock *bb = work.back();
+      work.pop_back();
+      loop->_blocks.push_back(bb);
+
+      for (size_t p=0; p<bb->_pred.size(); p++) {
+        CBasicBlock *pred = bb->_pred[p];
+        if (pred->IsReachable() && (mark[pred->_id] != stamp)) {
+          mark[pred->_id] = stamp;
+          work.push_back(pred);
+        }
+      }
+    }
+    sort(loop->_blocks.begin(), loop->_blocks.end(),
+         [](const CBasicBlock *a, const CBasicBlock *b) {
+           return a->GetId() < b->GetId();
+         });
+    loop->_blocks.insert(loop->_blocks.begin(), h);
+
+    loop->_parent = h->_loop;
+    if (loop->_parent != NULL) loop->_depth = loop->_parent->_depth + 1;
+    for (size_t b=0; b<loop->_blocks.size(); b++) {
+      loop->_blocks[b]->_loop = loop;
+    }
+
+    _loops.push_back(loop);
+  }
+}
+
+void CCodeBlock::UpdateInstr(void)
+{
+  _ops.clear();
+  for (size_t b=0; b<_blocks.size(); b++) {
+    _ops.insert(_ops.end(), _blocks[b]->_instr.begin(), _blocks[b]->_instr.end());
+  }
+
+  _inst_id = 0;
+  list<CTacInstr*>::iterator it = _ops.begin();
+  while (it != _ops.end()) (*it++)->SetId(_inst_id++);
+}
+
+/// @brief variables of a code block in SSA construction
+///
+/// temporaries are numbered by their id, symbols follow the temporaries.
+/// Only variables with Renamed() set take part in the SSA form.
+class CSSAVariables {
+  public:
+    CSSAVariables(unsigned int ntemps) : _ntemps(ntemps) {};
+
+    /// @brief register a symbol that may be renamed
+    void AddSymbol(const CSymbol *s)
+    {
+      if (_symbol.find(s) != _symbol.end()) return;
+      _symbol[s] = _ntemps + _symbols.size();
+      _symbols.push_back(s);
+    }
+
+    /// @brief exclude a symbol from renaming (its address is taken)
+    void Exclude(const CSymbol *s) { _excluded.insert(s); }
+
+    /// @brief return the variable of an operand, or -1
+    int Index(const CTac *op) const
+    {
+      const CTacTemp *t = dynamic_cast<const CTacTemp*>(op);
+      if ((t != NULL) && (t->GetId() < _ntemps)) return t->GetId();
+
+      const CTacName *n = dynamic_cast<const CTacName*>(op);
+      if ((n != NULL) && (dynamic_cast<const CTacReference*>(op) == NULL)) {
+        unordered_map<const CSymbol*, unsigned int>::const_iterator it =
+          _symbol.find(n->GetSymbol());
+        if (it != _symbol.end()) return it->second;
+      }
+      return -1;
+    }
+
+    /// @brief return the number of variables
+    unsigned int Size(void) const { return _ntemps + _symbols.size(); }
+
+    /// @brief return true if the variable is a symbol
+    bool IsSymbol(unsigned int v) const { return v >= _ntemps; }
+
+    /// @brief return the symbol of a variable
+    const CSymbol* GetSymbol(unsigned int v) const
+    {
+      return _symbols[v - _ntemps];
+    }
+
+    /// @brief return true if the symbol of a variable may be renamed
+    bool IsEligible(unsigned int v) const
+    {
+      return _excluded.find(GetSymbol(v)) == _excluded.end();
+    }
+
+  private:
+    unsigned int _ntemps;
+    unordered_map<const CSymbol*, unsigned int> _symbol;
+    vector<const CSymbol*> _symbols;
+    unordered_set<const CSymbol*> _excluded;
+};
+
+/// @brief return the operand that defines a variable, or NULL
+///
+/// branches define no variable, and a store through a reference uses the
+/// temporary holding the address.
+static CTac* Definition(const CTacInstr *instr)
+{
+  if (instr->IsBranch() || (instr->GetOperation() == opParam)) return NULL;
+  if (dynamic_cast<CTacReference*>(instr->GetDest()) != NULL) return NULL;
+  return instr->GetDest();
+}
+
+/// @brief return the temporary read through a reference, or NULL
+static CTacTemp* ReferenceBase(const CTac *op)
+{
+  const CTacReference *r = dynamic_cast<const CTacReference*>(op);
+  return r != NULL ? r->GetBase() : NULL;
+}
+
+void CCodeBlock::ToSSA(void)
+{
+  assert(!_ssa);
+  if (!HasCFG()) BuildCFG();
+
+  size_t nblocks = _blocks.size();
+  CSSAVariables var(_owner->GetNumTemps());
+
+  // 1. collect the scalar locals and parameters; those whose address is
+  //    taken stay in memory
+  list<CTacInstr*>::const_iterator it;
+  for (it = _ops.begin(); it != _ops.end(); it++) {
+    const CTacInstr *i = *it;
+    const CTac *op[3] = { i->GetSrc(1), i->GetSrc(2), Definition(i) };
+
+    for (int o=0; o<3; o++) {
+      const CTacName *n = dynamic_cast<const CTacName*>(op[o]);
+      if ((n == NULL) || (dynamic_cast<const CTacReference*>(n) != NULL)) {
+        continue;
+      }
+
+      const CSymbol *s = n->GetSymbol();
+      if (((s->GetSymbolType() == stLocal) || (s->GetSymbolType() == stParam))
+          && !s->GetDataType()->IsArray()) {
+        var.AddSymbol(s);
+        if (i->GetOperation() == opAddress) var.Exclude(s);
+      }
+    }
+  }
+
+  // 2. count the definitions. Temporaries defined once are already in SSA
+  //    form; symbols that are never defined always refer to memory.
+  unsigned int nvars = var.Size();
+  vector<unsigned int> ndefs(nvars, 0);
+  for (it = _ops.begin(); it != _ops.end(); it++) {
+    int v = var.Index(Definition(*it));
+    if (v >= 0) ndefs[v]++;
+  }
+
+  vector<bool> renamed(nvars, false);
+  for (unsigned int v=0; v<nvars; v++) {
+    if (var.IsSymbol(v)) renamed[v] = (ndefs[v] > 0) && var.IsEligible(v);
+    else renamed[v] = ndefs[v] > 1;
+  }
+
+  // 3. find the blocks defining each variable and the variables that are
+  //    live across blocks (used before being defined in a block). Only the
+  //    latter need phi functions (semi-pruned SSA).
+  vector<vector<unsigned int> > defblocks(nvars);
+  vector<bool> global(nvars, false);
+  vector<size_t> defined(nvars, 0);
+
+  for (size_t b=0; b<nblocks; b++) {
+    CBasicBlock *bb = _blocks[b];
+    if (!bb->IsReachable()) continue;
+
+    for (it = bb->_instr.begin(); it != bb->_instr.end(); it++) {
+      const CTacInstr *i = *it;
+      const CTac *use[4] = { i->GetSrc(1), i->GetSrc(2),
+                             ReferenceBase(i->GetSrc(1)),
+                             ReferenceBase(i->GetDest()) };
+      for (int u=0; u<4; u++) {
+        int v = var.Index(use[u]);
+        if ((v >= 0) && renamed[v] && (defined[v] != b+1)) global[v] = true;
+      }
+
+      int v = var.Index(Definition(i));
+      if ((v >= 0) && renamed[v] && (defined[v] != b+1)) {
+        defined[v] = b+1;
+        defblocks[v].push_back(b);
+      }
+    }
+  }
+
+  // 4. dominance frontiers
+  vector<vector<CBasicBlock*> > df(nblocks);
+  for (size_t b=0; b<nblocks; b++) {
+    CBasicBlock *bb = _blocks[b];
+    if (!bb->IsReachable() || (bb->_pred.size() < 2)) continue;
+
+    for (size_t p=0; p<bb->_pred.size(); p++) {
+      CBasicBlock *runner = bb->_pred[p];
+      if (!runner->IsReachable()) continue;
+
+      while (runner != bb->_idom) {
+        vector<CBasicBlock*> &f = df[runner->_id];
+        if (f.empty() || (f.back() != bb)) f.push_back(bb);
+        runner = runner->_idom;
+      }
+    }
+  }
+
+  // 5. place the phi functions at the iterated dominance frontiers of the
+  //    definitions
+  vector<vector<pair<CTacPhi*, unsigned int> > > phis(nblocks);
+  vector<size_t> hasphi(nblocks, 0), inwork(nblocks, 0);
+  vector<CBasicBlock*> work;
+
+  for (unsigned int v=0; v<nvars; v++) {
+    if (!renamed[v] || !global[v]) continue;
+
+    for (size_t d=0; d<defblocks[v].size(); d++) {
+      inwork[defblocks[v][d]] = v+1;
+      work.push_back(_blocks[defblocks[v][d]]);
+    }
+
+    while (!work.empty()) {
+      CBasicBlock *bb = work.back();
+      work.pop_back();
+
+      for (size_t f=0; f<df[bb->_id].size(); f++) {
+        CBasicBlock *y = df[bb->_id][f];
+        if (hasphi[y->_id] == v+1) continue;
+
+        hasphi[y->_id] = v+1;
+        phis[y->_id].push_back(make_pair(new CTacPhi(NULL, y->_pred.size()), v));
+        if (inwork[y->_id] != v+1) {
+          inwork[y->_id] = v+1;
+          work.push_back(y);
+        }
+      }
+    }
+  }
+
+  for (size_t b=0; b<nblocks; b++) {
+    list<CTacInstr*> &instr = _blocks[b]->_instr;
+    list<CTacInstr*>::iterator pos = instr.begin();
+    while ((pos != instr.end()) && ((*pos)->GetOperation() == opLabel)) pos++;
+    for (size_t p=0; p<phis[b].size(); p++) instr.insert(pos, phis[b][p].first);
+  }
+
+  // 6. rename the variables in a preorder walk of the dominator tree. A
+  //    variable read before any definition refers to memory (symbols) or is
+  //    undefined (temporaries, never read on a feasible path).
+  vector<const CType*> type(nvars, NULL);
+  vector<vector<CTacAddr*> > stack(nvars);
+  for (it = _ops.begin(); it != _ops.end(); it++) {
+    const CTacTemp *t = dynamic_cast<const CTacTemp*>(Definition(*it));
+    if (t != NULL) type[t->GetId()] = t->GetType();
+  }
+  for (unsigned int v=0; v<nvars; v++) {
+    if (!renamed[v] || !var.IsSymbol(v)) continue;
+    type[v] = var.GetSymbol(v)->GetDataType();
+    stack[v].push_back(new CTacName(var.GetSymbol(v)));
+  }
+  CTacConst *undefined = new CTacConst(0);
+
+  vector<unsigned int> pushed;
+  vector<pair<CBasicBlock*, size_t> > walk;
+  walk.push_back(make_pair(_blocks[0], 0));
+
+  while (!walk.empty()) {
+    CBasicBlock *bb = walk.back().first;
+    size_t i = walk.back().second++;
+
+    if (i == 0) {
+      // entering the block: mark the definitions to pop on exit
+      pushed.push_back(~0U);
+
+      for (it = bb->_instr.begin(); it != bb->_instr.end(); it++) {
+        CTacInstr *instr = *it;
+        CTacPhi *phi = dynamic_cast<CTacPhi*>(instr);
+
+        if (phi == NULL) {
+          for (int s=1; s<=2; s++) {
+            CTacAddr *src = instr->GetSrc(s);
+            int v = var.Index(src);
+            if ((v >= 0) && renamed[v]) {
+              instr->SetSrc(s, stack[v].empty() ? undefined : stack[v].back());
+            }
+
+            CTacTemp *base = ReferenceBase(src);
+            v = var.Index(base);
+            if ((v >= 0) && renamed[v] && !stack[v].empty()) {
+              CTacTemp *b = dynamic_cast<CTacTemp*>(stack[v].back());
+              assert(b != NULL);
+              instr->SetSrc(s, new CTacReference(b,
+                dynamic_cast<CTacReference*>(src)->GetDerefSymbol()));
+            }
+          }
+
+          CTacReference *ref = dynamic_cast<CTacReference*>(instr->GetDest());
+          int v = var.Index(ReferenceBase(ref));
+          if ((v >= 0) && renamed[v] && !stack[v].empty()) {
+            CTacTemp *b = dynamic_cast<CTacTemp*>(stack[v].back());
+            assert(b != NULL);
+            instr->SetDest(new CTacReference(b, ref->GetDerefSymbol()));
+          }
+        }
+
+        int v = phi != NULL ? -1 : var.Index(Definition(instr));
+        if (phi != NULL) {
+          for (size_t p=0; p<phis[bb->_id].size(); p++) {
+            if (phis[bb->_id][p].first == phi) v = phis[bb->_id][p].second;
+          }
+        }
+        if ((v >= 0) && renamed[v]) {
+          CTacTemp *t = CreateTemp(type[v]);
+          instr->SetDest(t);
+          stack[v].push_back(t);
+          pushed.push_back(v);
+        }
+      }
+
+      // fill in the arguments of the phi functions of the successors
+      for (size_t s=0; s<bb->_succ.size(); s++) {
+        CBasicBlock *succ = bb->_succ[s];
+        size_t j = find(succ->_pred.begin(), succ->_pred.end(), bb) -
+                   succ->_pred.begin();
+
+        for (size_t p=0; p<phis[succ->_id].size(); p++) {
+          unsigned int v = phis[succ->_id][p].second;
+          phis[succ->_id][p].first->SetArg(j,
+            stack[v].empty() ? undefined : stack[v].back());
+        }
+      }
+    }
+
+    if (i < bb->_dom_children.size()) {
+      walk.push_back(make_pair(bb->_dom_children[i], 0));
+    } else {
+      // leaving the block: pop its definitions
+      while (pushed.back() != ~0U) {
+        stack[pushed.back()].pop_back();
+        pushed.pop_back();
+      }
+      pushed.pop_back();
+      walk.pop_back();
+    }
+  }
+
+  // arguments from unreachable predecessors are undefined
+  for (size_t b=0; b<nblocks; b++) {
+    for (size_t p=0; p<phis[b].size(); p++) {
+      CTacPhi *phi = phis[b][p].first;
+      for (size_t a=0; a<phi->GetNumArgs(); a++) {
+        if (phi->GetArg(a) == NULL) phi->SetArg(a, undefined);
+      }
+    }
+  }
+
+  // 7. remove the phi functions whose value is never used: a phi function
+  //    is live if an instruction other than a phi function reads it, or if
+  //    a live phi function does
+  unsigned int ntemps = _owner->GetNumTemps();
+  vector<CTacPhi*> phidef(ntemps, NULL);
+  vector<bool> live(ntemps, false);
+  vector<unsigned int> reached;
+
+  for (size_t b=0; b<nblocks; b++) {
+    for (it = _blocks[b]->_instr.begin(); it != _blocks[b]->_instr.end(); it++) {
+      const CTacInstr *i = *it;
+
+      if (i->GetOperation() == opPhi) {
+        const CTacTemp *t = dynamic_cast<const CTacTemp*>(i->GetDest());
+        phidef[t->GetId()] = dynamic_cast<CTacPhi*>(*it);
+        continue;
+      }
+
+      const CTac *use[5] = { i->GetSrc(1), i->GetSrc(2),
+                             ReferenceBase(i->GetSrc(1)),
+                             ReferenceBase(i->GetSrc(2)),
+                             ReferenceBase(i->GetDest()) };
+      for (int u=0; u<5; u++) {
+        const CTacTemp *t = dynamic_cast<const CTacTemp*>(use[u]);
+        if ((t != NULL) && !live[t->GetId()]) {
+          live[t->GetId()] = true;
+          reached.push_back(t->GetId());
+        }
+      }
+    }
+  }
+
+  while (!reached.empty()) {
+    CTacPhi *phi = phidef[reached.back()];
+    reached.pop_back();
+    if (phi == NULL) continue;
+
+    for (size_t a=0; a<phi->GetNumArgs(); a++) {
+      const CTacTemp *t = dynamic_cast<const CTacTemp*>(phi->GetArg(a));
+      if ((t != NULL) && !live[t->GetId()]) {
+        live[t->GetId()] = true;
+        reached.push_back(t->GetId());
+      }
+    }
+  }
+
+  for (size_t b=0; b<nblocks; b++) {
+    list<CTacInstr*> &instr = _blocks[b]->_instr;
+    list<CTacInstr*>::iterator i = instr.begin();
+    while (i != instr.end()) {
+      if (((*i)->GetOperation() == opPhi) &&
+          !live[dynamic_cast<CTacTemp*>((*i)->GetDest())->GetId()]) {
+        delete *i;
+        i = instr.erase(i);
+      } else i++;
+    }
+  }
+
+  UpdateInstr();
+  _ssa = true;
+}
+
+/// @brief return true if @a src reads the temporary @a t
+static bool Reads(const CTacAddr *src, const CTacTemp *t)
+{
+  const CTacTemp *s = dynamic_cast<const CTacTemp*>(src);
+  return (s != NULL) && (s->GetId() == t->GetId());
+}
+
+/// @brief sequentialize a parallel copy
+///
+/// a copy is emitted once no other pending copy reads its destination; if
+/// only cycles remain, one destination is saved in a new temporary first.
+///
+/// @param cb code block (to create temporaries)
+/// @param copy parallel copy (destination, source)
+/// @param seq sequential copies are appended here
+static void SequentializeCopies(CCodeBlock *cb,
+                                vector<pair<CTacTemp*, CTacAddr*> > copy,
+                                vector<CTacInstr*> &seq)
+{
+  size_t c = 0;
+  while (c < copy.size()) {
+    if (Reads(copy[c].second, copy[c].first)) copy.erase(copy.begin() + c);
+    else c++;
+  }
+
+  while (!copy.empty()) {
+    for (c=0; c<copy.size(); c++) {
+      size_t k;
+      for (k=0; k<copy.size(); k++) {
+        if ((k != c) && Reads(copy[k].second, copy[c].first)) break;
+      }
+      if (k == copy.size()) break;
+    }
+
+    if (c < copy.size()) {
+      seq.push_back(new CTacInstr(opAssign, copy[c].first, copy[c].second));
+      copy.erase(copy.begin() + c);
+    } else {
+      CTacTemp *d = copy[0].first;
+      CTacTemp *save = cb->CreateTemp(d->GetType());
+      seq.push_back(new CTacInstr(opAssign, save, d));
+      for (size_t k=0; k<copy.size(); k++) {
+        if (Reads(copy[k].second, d)) copy[k].second = save;
+      }
+    }
+  }
+}
+
+void CCodeBlock::FromSSA(void)
+{
+  assert(_ssa && HasCFG());
+
+  size_t nblocks = _blocks.size();
+  vector<vector<CTacInstr*> > before(nblocks), after(nblocks);
+  vector<CTacInstr*> tail;
+
+  for (size_t b=0; b<nblocks; b++) {
+    CBasicBlock *bb = _blocks[b];
+
+    vector<CTacPhi*> phi;
+    for (list<CTacInstr*>::iterator it = bb->_instr.begin();
+         it != bb->_instr.end(); it++) {
+      if ((*it)->GetOperation() == opPhi) phi.push_back(dynamic_cast<CTacPhi*>(*it));
+    }
+    if (phi.empty()) continue;
+
+    for (size_t p=0; p<bb->_pred.size(); p++) {
+      CBasicBlock *pred = bb->_pred[p];
+
+      vector<pair<CTacTemp*, CTacAddr*> > copy;
+      for (size_t f=0; f<phi.size(); f++) {
+        CTacTemp *dst = dynamic_cast<CTacTemp*>(phi[f]->GetDest());
+        assert(dst != NULL);
+        copy.push_back(make_pair(dst, phi[f]->GetArg(p)));
+      }
+
+      vector<CTacInstr*> seq;
+      SequentializeCopies(this, copy, seq);
+      if (seq.empty()) continue;
+
+      CTacInstr *last = pred->_instr.empty() ? NULL : pred->_instr.back();
+      if ((last == NULL) || !IsRelOp(last->GetOperation())) {
+        // single successor: copy at the end of the predecessor
+        vector<CTacInstr*> &at =
+          (last != NULL) && (last->GetOperation() == opGoto) ? before[pred->_id]
+                                                             : after[pred->_id];
+        at.insert(at.end(), seq.begin(), seq.end());
+        continue;
+      }
+
+      // conditional branch: split the taken edge into a new block at the end
+      // of the code, and the fall-through edge into a block right after the
+      // predecessor
+      CTacLabel *target = dynamic_cast<CTacLabel*>(last->GetDest());
+      bool taken = find(bb->_instr.begin(), bb->_instr.end(), target) !=
+                   bb->_instr.end();
+      if (taken) {
+        // the branch is replaced rather than retargeted so that it does not
+        // outlive its new label
+        CTacLabel *edge = CreateLabel();
+        CTacInstr *branch = new CTacInstr(last->GetOperation(), edge,
+                                          last->GetSrc(1), last->GetSrc(2));
+        pred->_instr.back() = branch;
+        delete last;
+
+        tail.push_back(edge);
+        tail.insert(tail.end(), seq.begin(), seq.end());
+        tail.push_back(new CTacInstr(opGoto, target));
+      }
+      if ((pred->_id+1 < nblocks) && (_blocks[pred->_id+1] == bb)) {
+        if (taken) {
+          seq.clear();
+          SequentializeCopies(this, copy, seq);
+        }
+        vector<CTacInstr*> &at = after[pred->_id];
+        at.insert(at.end(), seq.begin(), seq.end());
+      }
+    }
+  }
+
+  // the split edges are appended at the end of the code; the last block
+  // must not fall through into them
+  if (!tail.empty()) {
+    CTacInstr *last = _ops.empty() ? NULL : _ops.back();
+    if ((last == NULL) ||
+        ((last->GetOperation() != opGoto) && (last->GetOperation() != opReturn))) {
+      after[nblocks-1].push_back(new CTacInstr(opReturn, NULL));
+    }
+  }
+
+  // rebuild the instruction list without the phi functions
+  _ops.clear();
+  for (size_t b=0; b<nblocks; b++) {
+    list<CTacInstr*> &instr = _blocks[b]->_instr;
+    list<CTacInstr*>::iterator last = instr.end();
+    if (!before[b].empty()) last--;
+
+    for (list<CTacInstr*>::iterator it = instr.begin(); it != instr.end(); it++) {
+      if (it == last) _ops.insert(_ops.end(), before[b].begin(), before[b].end());
+      if ((*it)->GetOperation() == opPhi) delete *it;
+      else _ops.push_back(*it);
+    }
+    _ops.insert(_ops.end(), after[b].begin(), after[b].end());
+  }
+  _ops.insert(_ops.end(), tail.begin(), tail.end());
+
+  _inst_id = 0;
+  list<CTacInstr*>::iterator it = _ops.begin();
+  while (it != _ops.end()) (*it++)->SetId(_inst_id++);
+
+  _ssa = false;
+  BuildCFG();
+}
+
+bool CCodeBlock::IsSSA(void) const
+{
+  return _ssa;
+}
+
+/// @brief lattice value of a temporary in the constant propagation
+///
+/// a value is lowered from top (no value yet) to a constant and from a
+/// constant to bottom (not constant), but never raised.
+struct CConstValue {
+  enum EState { top, constant, bottom };
+
+  EState state;                     ///< position in the lattice
+  int    value;                     ///< value of a constant
+};
+
+/// @brief return the lattice value of an operand
+///
+/// constants are constant, temporaries have the value computed so far, and
+/// everything else (variables in memory, references) is bottom.
+static CConstValue Value(const CTac *op, const vector<CConstValue> &val)
+{
+  CConstValue v = { CConstValue::bottom, 0 };
+
+  const CTacConst *c = dynamic_cast<const CTacConst*>(op);
+  if (c != NULL) {
+    v.state = CConstValue::constant;
+    v.value = c->GetValue();
+  }
+
+  const CTacTemp *t = dynamic_cast<const CTacTemp*>(op);
+  if ((t != NULL) && (t->GetId() < val.size())) v = val[t->GetId()];
+
+  return v;
+}
+
+/// @brief evaluate an arithmetic or logical operation on constants
+///
+/// arithmetic wraps around at 32 bits like the generated code.
+///
+/// @retval true if the result is defined (no division by zero or overflow)
+static bool Fold(EOperation op, int a, int b, int &r)
+{
+  unsigned int ua = a, ub = b;
+
+  switch (op) {
+    case opAdd: r = ua + ub; break;
+    case opSub: r = ua - ub; break;
+    case opMul: r = ua * ub; break;
+    case opDiv:
+      if ((b == 0) || ((a == INT_MIN) && (b == -1))) return false;
+      r = a / b;
+      break;
+    case opAnd: r = a && b; break;
+    case opOr:  r = a || b; break;
+    case opNeg: r = 0U - ua; break;
+    case opPos: r = a; break;
+    case opNot: r = !a; break;
+    default:    return false;
+  }
+  return true;
+}
+
+/// @brief evaluate the condition of a conditional branch on constants
+static bool Compare(EOperation op, int a, int b)
+{
+  switch (op) {
+    case opEqual:       return a == b;
+    case opNotEqual:    return a != b;
+    case opLessThan:    return a <  b;
+    case opLessEqual:   return a <= b;
+    case opBiggerThan:  return a >  b;
+    case opBiggerEqual: return a >= b;
+    default:            assert(false); return false;
+  }
+}
+
+void CCodeBlock::PropagateConstants(void)
+{
+  assert(_ssa && HasCFG());
+
+  size_t nblocks = _blocks.size();
+  unsigned int ntemps = _owner->GetNumTemps();
+  CConstValue top = { CConstValue::top, 0 };
+  CConstValue bottom = { CConstValue::bottom, 0 };
+  vector<CConstValue> val(ntemps, top);
+  vector<vector<CTacInstr*> > uses(ntemps);
+  unordered_map<const CTacInstr*, CBasicBlock*> block;
+  unordered_map<const CTacLabel*, CBasicBlock*> target;
+
+  _const_stats = CConstStats();
+
+  // 1. def-use chains. Temporaries holding addresses are never constant.
+  for (size_t b=0; b<nblocks; b++) {
+    CBasicBlock *bb = _blocks[b];
+    list<CTacInstr*>::iterator it;
+    for (it = bb->_instr.begin(); it != bb->_instr.end(); it++) {
+      CTacInstr *i = *it;
+      block[i] = bb;
+
+      CTacLabel *lbl = dynamic_cast<CTacLabel*>(i);
+      if (lbl != NULL) target[lbl] = bb;
+
+      vector<CTacAddr*> src;
+      CTacPhi *phi = dynamic_cast<CTacPhi*>(i);
+      if (phi != NULL) src = phi->_args;
+      else src = { i->GetSrc(1), i->GetSrc(2) };
+
+      for (size_t s=0; s<src.size(); s++) {
+        CTacTemp *t = dynamic_cast<CTacTemp*>(src[s]);
+        if ((t != NULL) && (t->GetId() < ntemps)) uses[t->GetId()].push_back(i);
+      }
+
+      const CTac *base[3] = { ReferenceBase(i->GetSrc(1)),
+                              ReferenceBase(i->GetSrc(2)),
+                              ReferenceBase(i->GetDest()) };
+      for (int r=0; r<3; r++) {
+        const CTacTemp *t = dynamic_cast<const CTacTemp*>(base[r]);
+        if (t != NULL) val[t->GetId()] = bottom;
+      }
+    }
+  }
+
+  // 2. propagate the values along the executable edges. Blocks are
+  //    evaluated when they are first reached, phi functions whenever one of
+  //    their edges becomes executable, and instructions whenever one of
+  //    their operands is lowered.
+  vector<vector<bool> > executable(nblocks);
+  for (size_t b=0; b<nblocks; b++) {
+    executable[b].assign(_blocks[b]->_pred.size(), false);
+  }
+  vector<bool> reached(nblocks, false);
+  vector<pair<CBasicBlock*, CBasicBlock*> > flow;
+  vector<unsigned int> work;
+
+  // lower the value of the temporary defined by an instruction
+  auto lower = [&](const CTacInstr *i, CConstValue v) {
+    const CTacTemp *t = dynamic_cast<const CTacTemp*>(Definition(i));
+    if ((t == NULL) || (v.state == CConstValue::top)) return;
+
+    CConstValue &cur = val[t->GetId()];
+    if (cur.state == CConstValue::bottom) return;
+
+    if (v.state == CConstValue::constant) {
+      // values narrower than 32 bits are stored truncated
+      int size = t->GetType()->GetSize();
+      if (size < 4) v.value &= (1 << 8*size) - 1;
+      if ((cur.state == CConstValue::constant) && (cur.value == v.value)) return;
+      if (cur.state == CConstValue::constant) v = bottom;
+    }
+    cur = v;
+    work.push_back(t->GetId());
+  };
+
+  // evaluate an instruction of a reached block
+  auto evaluate = [&](CTacInstr *i, CBasicBlock *bb) {
+    EOperation op = i->GetOperation();
+
+    if (op == opPhi) {
+      CTacPhi *phi = dynamic_cast<CTacPhi*>(i);
+      CConstValue v = top;
+      for (size_t a=0; a<phi->_args.size(); a++) {
+        if (!executable[bb->_id][a]) continue;
+
+        CConstValue arg = Value(phi->_args[a], val);
+        if (arg.state == CConstValue::top) continue;
+        if ((v.state == CConstValue::top) ||
+            ((arg.state == CConstValue::constant) && (arg.value == v.value))) {
+          v = arg;
+        } else {
+          v = bottom;
+        }
+      }
+      lower(i, v);
+      return;
+    }
+
+    if (i->IsBranch()) {
+      CBasicBlock *taken = target[dynamic_cast<CTacLabel*>(i->GetDest())];
+      CBasicBlock *next = bb->_id+1 < nblocks ? _blocks[bb->_id+1] : NULL;
+      if (op == opGoto) {
+        flow.push_back(make_pair(bb, taken));
+        return;
+      }
+
+      CConstValue a = Value(i->GetSrc(1), val), b = Value(i->GetSrc(2), val);
+      if ((a.state == CConstValue::top) || (b.state == CConstValue::top)) return;
+
+      bool known = (a.state == CConstValue::constant) &&
+                   (b.state == CConstValue::constant);
+      bool cond = known && Compare(op, a.value, b.value);
+      if (!known || cond) flow.push_back(make_pair(bb, taken));
+      if ((!known || !cond) && (next != NULL)) flow.push_back(make_pair(bb, next));
+      return;
+    }
+
+    CConstValue v = bottom;
+    switch (op) {
+      case opAssign:
+        v = Value(i->GetSrc(1), val);
+        break;
+
+      case opAdd: case opSub: case opMul: case opDiv: case opAnd: case opOr:
+      case opNeg: case opPos: case opNot: {
+        bool unary = (op == opNeg) || (op == opPos) || (op == opNot);
+        CConstValue a = Value(i->GetSrc(1), val);
+        CConstValue b = unary ? a : Value(i->GetSrc(2), val);
+
+        // x*0 is 0 whatever x is
+        if ((op == opMul) &&
+            (((a.state == CConstValue::constant) && (a.value == 0)) ||
+             ((b.state == CConstValue::constant) && (b.value == 0)))) {
+          v.state = CConstValue::constant;
+          v.value = 0;
+        } else if ((a.state == CConstValue::bottom) ||
+                   (b.state == CConstValue::bottom)) {
+          v = bottom;
+        } else if ((a.state == CConstValue::top) ||
+                   (b.state == CConstValue::top)) {
+          v = top;
+        } else if (Fold(op, a.value, b.value, v.value)) {
+          v.state = CConstValue::constant;
+        }
+      } break;
+
+      default:
+        // calls, loads, and addresses are not constant
+        break;
+    }
+    lower(i, v);
+  };
+
+  flow.push_back(make_pair((CBasicBlock*)NULL, _blocks[0]));
+  while (!flow.empty() || !work.empty()) {
+    if (!flow.empty()) {
+      CBasicBlock *from = flow.back().first, *bb = flow.back().second;
+      flow.pop_back();
+
+      if (from != NULL) {
+        size_t p = find(bb->_pred.begin(), bb->_pred.end(), from) -
+                   bb->_pred.begin();
+        assert(p < bb->_pred.size());
+        if (executable[bb->_id][p]) continue;
+        executable[bb->_id][p] = true;
+      }
+
+      list<CTacInstr*>::iterator it;
+      if (reached[bb->_id]) {
+        // a new edge into a reached block only changes its phi functions
+        for (it = bb->_instr.begin(); it != bb->_instr.end(); it++) {
+          if ((*it)->GetOperation() == opPhi) evaluate(*it, bb);
+        }
+        continue;
+      }
+
+      reached[bb->_id] = true;
+      for (it = bb->_instr.begin(); it != bb->_instr.end(); it++) {
+        evaluate(*it, bb);
+      }
+
+      CTacInstr *last = bb->_instr.empty() ? NULL : bb->_instr.back();
+      if ((last == NULL) ||
+          (!last->IsBranch() && (last->GetOperation() != opReturn))) {
+        for (size_t s=0; s<bb->_succ.size(); s++) {
+          flow.push_back(make_pair(bb, bb->_succ[s]));
+        }
+      }
+    } else {
+      unsigned int t = work.back();
+      work.pop_back();
+
+      for (size_t u=0; u<uses[t].size(); u++) {
+        CTacInstr *i = uses[t][u];
+        CBasicBlock *bb = block[i];
+        if (reached[bb->_id]) evaluate(i, bb);
+      }
+    }
+  }
+
+  // 3. fold the conditional branches with constant operands. The jump
+  //    replacing a branch is created after its label and thus deleted
+  //    before it.
+  for (size_t b=0; b<nblocks; b++) {
+    CBasicBlock *bb = _blocks[b];
+    CTacInstr *last = bb->_instr.empty() ? NULL : bb->_instr.back();
+    if (!reached[b] || (last == NULL) || !IsRelOp(last->GetOperation())) {
+      continue;
+    }
+
+    CConstValue x = Value(last->GetSrc(1), val), y = Value(last->GetSrc(2), val);
+    if ((x.state != CConstValue::constant) ||
+        (y.state != CConstValue::constant)) {
+      continue;
+    }
+
+    bb->_instr.pop_back();
+    if (Compare(last->GetOperation(), x.value, y.value)) {
+      bb->_instr.push_back(new CTacInstr(opGoto, last->GetDest()));
+    }
+    delete last;
+    _const_stats.branches++;
+  }
+
+  // 4. remove the edges that are never executed and the corresponding
+  //    arguments of the phi functions
+  for (size_t b=0; b<nblocks; b++) {
+    CBasicBlock *bb = _blocks[b];
+    if (!reached[b]) continue;
+
+    vector<CBasicBlock*> succ;
+    for (size_t s=0; s<bb->_succ.size(); s++) {
+      CBasicBlock *sb = bb->_succ[s];
+      size_t p = find(sb->_pred.begin(), sb->_pred.end(), bb) -
+                 sb->_pred.begin();
+      if (executable[sb->_id][p]) succ.push_back(sb);
+    }
+    bb->_succ.swap(succ);
+  }
+
+  for (size_t b=0; b<nblocks; b++) {
+    CBasicBlock *bb = _blocks[b];
+    if (!reached[b]) continue;
+
+    vector<CBasicBlock*> pred;
+    for (size_t p=0; p<bb->_pred.size(); p++) {
+      if (executable[b][p]) pred.push_back(bb->_pred[p]);
+    }
+
+    list<CTacInstr*>::iterator it;
+    for (it = bb->_instr.begin(); it != bb->_instr.end(); it++) {
+      CTacPhi *phi = dynamic_cast<CTacPhi*>(*it);
+      if (phi == NULL) continue;
+
+      vector<CTacAddr*> args;
+      for (size_t a=0; a<phi->_args.size(); a++) {
+        if (executable[b][a]) args.push_back(phi->_args[a]);
+      }
+      phi->_args.swap(args);
+    }
+    bb->_pred.swap(pred);
+  }
+
+  // 5. remove the blocks that are never executed; branches are deleted
+  //    before the labels they reference
+  for (size_t b=0; b<nblocks; b++) {
+    if (reached[b]) continue;
+
+    list<CTacInstr*> &instr = _blocks[b]->_instr;
+    list<CTacInstr*>::iterator it = instr.begin();
+    while (it != instr.end()) {
+      if ((*it)->GetOperation() != opLabel) {
+        delete *it;
+        it = instr.erase(it);
+        _const_stats.instructions++;
+      } else {
+        it++;
+      }
+    }
+  }
+
+  size_t n = 0;
+  for (size_t b=0; b<nblocks; b++) {
+    CBasicBlock *bb = _blocks[b];
+    if (reached[b]) {
+      bb->_id = n;
+      _blocks[n++] = bb;
+      continue;
+    }
+
+    list<CTacInstr*>::iterator it;
+    for (it = bb->_instr.begin(); it != bb->_instr.end(); it++) {
+      assert(dynamic_cast<CTacLabel*>(*it)->GetRefCnt() == 0);
+      delete *it;
+      _const_stats.labels++;
+    }
+    delete bb;
+    _const_stats.blocks++;
+  }
+  _blocks.resize(n);
+  nblocks = n;
+
+  // 6. replace the uses of constant temporaries by their value and remove
+  //    their definitions
+  for (size_t b=0; b<nblocks; b++) {
+    list<CTacInstr*> &instr = _blocks[b]->_instr;
+    list<CTacInstr*>::iterator it = instr.begin();
+    while (it != instr.end()) {
+      CTacInstr *i = *it;
+
+      CTacPhi *phi = dynamic_cast<CTacPhi*>(i);
+      for (size_t a=0; (phi != NULL) && (a<phi->_args.size()); a++) {
+        CConstValue v = Value(phi->_args[a], val);
+        if ((v.state == CConstValue::constant) &&
+            (dynamic_cast<CTacTemp*>(phi->_args[a]) != NULL)) {
+          phi->_args[a] = new CTacConst(v.value);
+          _const_stats.constants++;
+        }
+      }
+      for (int s=1; (phi == NULL) && (s<=2); s++) {
+        CTacAddr *src = i->GetSrc(s);
+        CConstValue v = Value(src, val);
+        if ((v.state == CConstValue::constant) &&
+            (dynamic_cast<CTacTemp*>(src) != NULL)) {
+          i->SetSrc(s, new CTacConst(v.value));
+          _const_stats.constants++;
+        }
+      }
+
+      const CTacTemp *t = dynamic_cast<const CTacTemp*>(Definition(i));
+      if ((t != NULL) && (val[t->GetId()].state == CConstValue::constant)) {
+        delete i;
+        it = instr.erase(it);
+        _const_stats.folded++;
+      } else {
+        it++;
+      }
+    }
+  }
+
+  // 7. remove the jumps to the next block and the labels that are no longer
+  //    referenced
+  for (size_t b=0; b+1<nblocks; b++) {
+    list<CTacInstr*> &instr = _blocks[b]->_instr;
+    CTacInstr *last = instr.empty() ? NULL : instr.back();
+    if ((last != NULL) && (last->GetOperation() == opGoto) &&
+        (target[dynamic_cast<CTacLabel*>(last->GetDest())] == _blocks[b+1])) {
+      delete last;
+      instr.pop_back();
+      _const_stats.jumps++;
+    }
+  }
+
+  for (size_t b=0; b<nblocks; b++) {
+    list<CTacInstr*> &instr = _blocks[b]->_instr;
+    list<CTacInstr*>::iterator it = instr.begin();
+    while (it != instr.end()) {
+      CTacLabel *lbl = dynamic_cast<CTacLabel*>(*it);
+      if ((lbl != NULL) && (lbl->GetRefCnt() == 0)) {
+        delete lbl;
+        it = instr.erase(it);
+        _const_stats.labels++;
+      } else {
+        it++;
+      }
+    }
+  }
+
+  ComputeDominators();
+  ComputeLoops();
+  UpdateInstr();
+}
+
+const CConstStats& CCodeBlock::GetConstStats(void) const
+{
+  return _const_stats;
+}
+
 ostream& CCodeBlock::print(ostream &out, int indent) const
 {
   string ind(indent, ' ');
@@ -682,7 +2235,32 @@ void CCodeBlock::toDot(ostream &out, int indent) const
 {
   string ind(indent, ' ');
 
-  out << ind << dotID() << dotAttr() << endl;
+  // without a control flow graph, the code is printed as a single box
+  if (!HasCFG()) {
+    out << ind << dotID() << dotAttr() << endl;
+    return;
+  }
+
+  // one node per basic block; back edges are dashed
+  out << ind << "subgraph cluster_" << dotID() << " {" << endl
+      << ind << "  label=\"" << GetName() << "\";" << endl;
+
+  for (size_t b=0; b<_blocks.size(); b++) {
+    out << ind << "  " << _blocks[b]->dotID() << _blocks[b]->dotAttr() << endl;
+  }
+
+  for (size_t b=0; b<_blocks.size(); b++) {
+    const CBasicBlock *bb = _blocks[b];
+    const vector<CBasicBlock*> &succ = bb->GetSucc();
+
+    for (size_t s=0; s<succ.size(); s++) {
+      out << ind << "  " << bb->dotID() << " -> " << succ[s]->dotID();
+      if (succ[s]->Dominates(bb)) out << " [style=dashed]";
+      out << ";" << endl;
+    }
+  }
+
+  out << ind << "}" << endl;
 }
 
 ostream& operator<<(ostream &out, const CCodeBlock &t)
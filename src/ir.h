@@ -41,6 +41,8 @@
 #include <list>
 #include <vector>
 
+#include "arena.h"
+#include "compilation.h"
 #include "symtab.h"
 
 
@@ -90,6 +92,9 @@ enum EOperation {
   opReturn,                         ///< return: return optional src1
   opParam,                          ///< parameter: dst = index,src1 = parameter
 
+  // SSA form
+  opPhi,                            ///< phi function: dst = phi(args)
+
   // special
   opLabel,                          ///< jump label; no arguments
   opNop,                            ///< no operation
@@ -121,6 +126,18 @@ class CTac {
 
     /// @}
 
+    /// @name arena allocation
+    /// @{
+
+    /// @brief allocate an instruction or operand from the current arena (or
+    ///        the heap)
+    static void* operator new(size_t size);
+
+    /// @brief free an instruction or operand allocated by operator new
+    static void operator delete(void *p);
+
+    /// @}
+
 
     /// @name output
     /// @{
@@ -251,35 +268,64 @@ class CTacConst : public CTacAddr {
     int _value;                      ///< constant value
 };
 
-class CTacTemp: public CTacName {
+class CTacTemp: public CTacAddr {
   public:
     /// @name constructors/destructors
     /// @{
 
     /// @brief constructor
     ///
-    /// Temp. values must be entered into the symbol table and are then
-    /// accessed using their symbol.
+    /// temporaries are virtual registers: they are numbered densely per
+    /// scope (see CScope::CreateTemp()) and are not entered into the symbol
+    /// table. Their names are generated when they are printed.
     ///
-    /// param symbol temporary value
-    CTacTemp(const CSymbol *symbol);
+    /// @param id number of the temporary in its scope
+    /// @param type type of the temporary
+    CTacTemp(unsigned int id, const CType *type);
+
+    /// @}
+
+
+    /// @name properties
+    /// @{
+
+    /// @brief return the number of the temporary in its scope
+    unsigned int GetId(void) const;
+
+    /// @brief return the type of the temporary
+    const CType* GetType(void) const;
+
+    /// @}
+
+
+    /// @name output
+    /// @{
+
+    /// @brief print the node to an output stream
+    /// @param out output stream
+    /// @param indent indentation
+    virtual ostream& print(ostream &out, int indent=0) const;
 
     /// @}
+
+  protected:
+    unsigned int _id;                ///< number of the temporary
+    const CType *_type;              ///< type
 };
 
-class CTacReference: public CTacName {
+class CTacReference: public CTacAddr {
   public:
     /// @name constructors/destructors
     /// @{
 
     /// @brief constructor
     ///
-    /// other than CTacName/Temp the symbol of a CTacReference is holding a
-    /// reference to the storage location
+    /// a CTacReference denotes the storage location whose address is held
+    /// by a temporary
     ///
-    /// param symbol value holding the reference
-    /// param deref  the symbol behind the reference
-    CTacReference(const CSymbol *symbol, const CSymbol *deref);
+    /// @param base temporary holding the address of the storage location
+    /// @param deref the symbol behind the reference
+    CTacReference(CTacTemp *base, const CSymbol *deref);
 
     /// @}
 
@@ -287,6 +333,9 @@ class CTacReference: public CTacName {
     /// @name properties
     /// @{
 
+    /// @brief return the temporary holding the address
+    CTacTemp* GetBase(void) const;
+
     /// @brief return the symbol
     const CSymbol* GetDerefSymbol(void) const;
 
@@ -304,6 +353,7 @@ class CTacReference: public CTacName {
     /// @}
 
   protected:
+    CTacTemp      *_base;            ///< temporary holding the address
     const CSymbol *_deref;           ///< symbol this reference is pointing to
 };
 
@@ -376,6 +426,9 @@ class CTacInstr : public CTac {
     /// @brief set the destination operand to @a dst
     void SetDest(CTac *dst);
 
+    /// @brief set source @a index (index = 1/2) to @a src
+    void SetSrc(int index, CTacAddr *src);
+
     unsigned int   _id;              ///< unique instruction id
     EOperation     _op;              ///< opcode
     string         _name;            ///< name (for debugging purposes)
@@ -440,6 +493,63 @@ class CTacLabel : public CTacInstr {
 };
 
 
+//------------------------------------------------------------------------------
+/// @brief phi function
+///
+/// TAC class for phi functions in SSA form. Phi functions are placed at the
+/// beginning of a basic block (after its labels); argument i is the value of
+/// the phi function if the block is entered from the i-th predecessor
+/// (CBasicBlock::GetPred()).
+///
+
+class CTacPhi : public CTacInstr {
+  public:
+    /// @name constructors/destructors
+    /// @{
+
+    /// @brief constructor
+    /// @param dst destination operand
+    /// @param nargs number of arguments (= number of predecessors)
+    CTacPhi(CTac *dst, unsigned int nargs);
+
+    /// @brief destructor
+    virtual ~CTacPhi(void);
+
+    /// @}
+
+
+    /// @name properties
+    /// @{
+
+    /// @brief return the number of arguments
+    unsigned int GetNumArgs(void) const;
+
+    /// @brief return argument @a index
+    CTacAddr* GetArg(unsigned int index) const;
+
+    /// @}
+
+
+    /// @name output
+    /// @{
+
+    /// @brief print the node to an output stream
+    /// @param out output stream
+    /// @param indent indentation
+    virtual ostream& print(ostream &out, int indent=0) const;
+
+    /// @}
+
+  protected:
+    /// @brief set argument @a index to @a arg
+    void SetArg(unsigned int index, CTacAddr *arg);
+
+    vector<CTacAddr*> _args;         ///< arguments
+
+    friend class CCodeBlock;
+};
+
+
 //------------------------------------------------------------------------------
 /// @brief scope class
 ///
@@ -479,6 +589,11 @@ class CScope {
     /// @brief return a reference to the symbol table
     CSymtab* GetSymbolTable(void) const;
 
+    /// @brief return the number of temporaries created in this scope
+    ///
+    /// the temporaries are numbered 0..GetNumTemps()-1
+    unsigned int GetNumTemps(void) const;
+
     /// @brief return the symbol of the scope's declaration
     ///
     /// Only set for procedures/functions; a module will return null.
@@ -578,6 +693,9 @@ class CModule : public CScope {
     /// @{
 
     /// @brief constructor
+    ///
+    /// the module is converted in the current compilation context
+    ///
     /// @param ast abstract syntax tree (must be a CAstModule instance)
     CModule(CAstNode *ast);
 
@@ -604,6 +722,9 @@ class CModule : public CScope {
     virtual ostream&  print(ostream &out, int indent=0) const;
 
     /// @}
+
+  private:
+    CCompilation  *_compilation;    ///< compilation context
 };
 
 
@@ -648,6 +769,211 @@ class CProcedure : public CScope {
 };
 
 
+//------------------------------------------------------------------------------
+/// @brief basic block
+///
+/// a maximal sequence of instructions of a code block that is entered only
+/// at its first and left only at its last instruction. Basic blocks are
+/// created by CCodeBlock::BuildCFG() and reference (but do not own) the
+/// instructions of the code block.
+///
+class CLoop;
+
+class CBasicBlock {
+  public:
+    /// @name constructors/destructors
+    /// @{
+
+    /// @brief constructor
+    /// @param owner code block containing this block
+    /// @param id index of the block in the code block
+    CBasicBlock(CCodeBlock *owner, unsigned int id);
+
+    /// @brief destructor
+    virtual ~CBasicBlock(void);
+
+    /// @}
+
+
+    /// @name properties
+    /// @{
+
+    /// @brief return the index of the block in CCodeBlock::GetBlocks()
+    unsigned int GetId(void) const;
+
+    /// @brief return the code block containing this block
+    CCodeBlock* GetOwner(void) const;
+
+    /// @brief return the instructions of the block
+    const list<CTacInstr*>& GetInstr(void) const;
+
+    /// @brief return the (first) label of the block, or NULL if none
+    CTacLabel* GetLabel(void) const;
+
+    /// @}
+
+
+    /// @name control flow
+    /// @{
+
+    /// @brief return the successors of the block
+    const vector<CBasicBlock*>& GetSucc(void) const;
+
+    /// @brief return the predecessors of the block
+    const vector<CBasicBlock*>& GetPred(void) const;
+
+    /// @brief return true if the block is reachable from the entry block
+    bool IsReachable(void) const;
+
+    /// @brief return the position of the block in reverse postorder
+    /// @retval -1 if the block is unreachable
+    int GetRPO(void) const;
+
+    /// @}
+
+
+    /// @name dominators
+    /// @{
+
+    /// @brief return the immediate dominator (NULL for the entry block and
+    ///        for unreachable blocks)
+    CBasicBlock* GetIDom(void) const;
+
+    /// @brief return the blocks immediately dominated by this block
+    const vector<CBasicBlock*>& GetDomChildren(void) const;
+
+    /// @brief return true if this block dominates @a b
+    ///
+    /// every block dominates itself; unreachable blocks neither dominate nor
+    /// are dominated by any block.
+    bool Dominates(const CBasicBlock *b) const;
+
+    /// @}
+
+
+    /// @name loops
+    /// @{
+
+    /// @brief return the innermost loop containing this block, or NULL
+    CLoop* GetLoop(void) const;
+
+    /// @}
+
+
+    /// @name output
+    /// @{
+
+    /// @brief print the node to an output stream
+    /// @param out output stream
+    /// @param indent indentation
+    virtual ostream&  print(ostream &out, int indent=0) const;
+
+    /// @brief return the node ID in (dot) string format
+    /// @retval string node ID as a string
+    virtual string dotID(void) const;
+
+    /// @brief return the node's attributes in (dot) string format
+    /// @retval string node attributes as a string
+    virtual string dotAttr(void) const;
+
+    /// @}
+
+  protected:
+    /// @brief add an edge to @a succ unless it already exists
+    void AddSucc(CBasicBlock *succ);
+
+    CCodeBlock *_owner;              ///< owning code block
+    unsigned int _id;                ///< index in the code block
+    list<CTacInstr*> _instr;         ///< instructions
+    vector<CBasicBlock*> _succ;      ///< successors
+    vector<CBasicBlock*> _pred;      ///< predecessors
+    int _rpo;                        ///< position in reverse postorder
+    CBasicBlock *_idom;              ///< immediate dominator
+    vector<CBasicBlock*> _dom_children; ///< dominator tree children
+    unsigned int _dom_pre;           ///< preorder number in the dominator tree
+    unsigned int _dom_post;          ///< postorder number in the dominator tree
+    CLoop *_loop;                    ///< innermost loop
+
+    friend class CCodeBlock;
+};
+
+
+//------------------------------------------------------------------------------
+/// @brief natural loop
+///
+/// the natural loop of a header h consists of h and all blocks that can reach
+/// a back edge t->h (h dominates t) without passing through h. Back edges
+/// with the same header form one loop.
+///
+class CLoop {
+  public:
+    /// @name constructors/destructors
+    /// @{
+
+    /// @brief constructor
+    /// @param header loop header
+    CLoop(CBasicBlock *header);
+
+    /// @brief destructor
+    virtual ~CLoop(void);
+
+    /// @}
+
+
+    /// @name properties
+    /// @{
+
+    /// @brief return the loop header
+    CBasicBlock* GetHeader(void) const;
+
+    /// @brief return the blocks of the loop (header first, then in program
+    ///        order), including those of nested loops
+    const vector<CBasicBlock*>& GetBlocks(void) const;
+
+    /// @brief return the sources of the back edges to the header
+    const vector<CBasicBlock*>& GetLatches(void) const;
+
+    /// @brief return the innermost enclosing loop, or NULL
+    CLoop* GetParent(void) const;
+
+    /// @brief return the nesting depth (1 for outermost loops)
+    unsigned int GetDepth(void) const;
+
+    /// @brief return true if @a b belongs to this loop or a nested loop
+    bool Contains(const CBasicBlock *b) const;
+
+    /// @}
+
+  protected:
+    CBasicBlock *_header;            ///< header
+    vector<CBasicBlock*> _blocks;    ///< blocks
+    vector<CBasicBlock*> _latches;   ///< sources of the back edges
+    CLoop *_parent;                  ///< enclosing loop
+    unsigned int _depth;             ///< nesting depth
+
+    friend class CCodeBlock;
+};
+
+
+//------------------------------------------------------------------------------
+/// @brief statistics of the constant propagation
+///
+/// see CCodeBlock::PropagateConstants()
+///
+struct CConstStats {
+  CConstStats(void)
+    : constants(0), folded(0), branches(0), blocks(0), instructions(0),
+      jumps(0), labels(0) {};
+
+  unsigned int constants;           ///< uses replaced by constants
+  unsigned int folded;              ///< definitions of constants removed
+  unsigned int branches;            ///< conditional branches folded
+  unsigned int blocks;              ///< unreachable blocks removed
+  unsigned int instructions;        ///< instructions in unreachable blocks
+  unsigned int jumps;               ///< jumps to the next block removed
+  unsigned int labels;              ///< labels removed
+};
+
 //------------------------------------------------------------------------------
 /// @brief code block
 ///
@@ -711,6 +1037,80 @@ class CCodeBlock {
     /// @}
 
 
+    /// @name control flow graph
+    ///
+    /// the control flow graph is built on request and discarded whenever
+    /// the instructions are modified.
+    ///
+    /// @{
+
+    /// @brief split the instructions into basic blocks and compute the
+    ///        control flow edges, the reverse postorder, the dominator tree,
+    ///        and the natural loops
+    void BuildCFG(void);
+
+    /// @brief return true if the control flow graph is up-to-date
+    bool HasCFG(void) const;
+
+    /// @brief return the basic blocks in program order
+    ///
+    /// the first block is the entry block. It has no predecessors; if the
+    /// code starts with a label that is the target of a branch, the entry
+    /// block is empty.
+    const vector<CBasicBlock*>& GetBlocks(void) const;
+
+    /// @brief return the entry block (NULL if there is no CFG)
+    CBasicBlock* GetEntry(void) const;
+
+    /// @brief return the reachable blocks in reverse postorder
+    const vector<CBasicBlock*>& GetRPO(void) const;
+
+    /// @brief return the natural loops, enclosing loops before nested ones
+    const vector<CLoop*>& GetLoops(void) const;
+
+    /// @}
+
+
+    /// @name SSA form
+    ///
+    /// local variables and parameters whose address is never taken and
+    /// temporaries defined more than once are renamed into temporaries that
+    /// are defined exactly once. A variable that is read before it is
+    /// defined refers to its value in memory (i.e., the argument or the
+    /// zero-initialized local); globals and arrays always stay in memory.
+    /// Unreachable blocks are not renamed.
+    ///
+    /// @{
+
+    /// @brief convert the code into (semi-pruned) SSA form
+    void ToSSA(void);
+
+    /// @brief replace the phi functions by copies on the incoming edges
+    ///
+    /// the copies of an edge form a parallel copy that is sequentialized;
+    /// edges from blocks ending in a conditional branch are split.
+    void FromSSA(void);
+
+    /// @brief return true if the code is in SSA form
+    bool IsSSA(void) const;
+
+    /// @brief sparse conditional constant propagation
+    ///
+    /// propagates constants through assignments, arithmetic, and phi
+    /// functions along the edges that can be executed (Wegman and Zadeck:
+    /// Constant Propagation with Conditional Branches). Uses of constant
+    /// temporaries are replaced by their value and their definitions are
+    /// removed, conditional branches with constant operands become jumps,
+    /// and blocks that are never executed are removed with their labels.
+    /// The code must be in SSA form; the CFG is kept up-to-date.
+    void PropagateConstants(void);
+
+    /// @brief return the statistics of the last constant propagation
+    const CConstStats& GetConstStats(void) const;
+
+    /// @}
+
+
     /// @name output
     /// @{
 
@@ -735,9 +1135,27 @@ class CCodeBlock {
     /// @}
 
   protected:
+    /// @brief discard the control flow graph
+    void ReleaseCFG(void);
+
+    /// @brief compute the reverse postorder and the dominator tree
+    void ComputeDominators(void);
+
+    /// @brief find the natural loops and their nesting
+    void ComputeLoops(void);
+
+    /// @brief rebuild the instruction list from the basic blocks
+    void UpdateInstr(void);
+
     CScope *_owner;                  ///< block owner
     list<CTacInstr*> _ops;           ///< operation list
     unsigned int _inst_id;           ///< next id for instructions
+
+    vector<CBasicBlock*> _blocks;    ///< basic blocks in program order
+    vector<CBasicBlock*> _rpo;       ///< reachable blocks in reverse postorder
+    vector<CLoop*> _loops;           ///< natural loops
+    bool _ssa;                       ///< code is in SSA form
+    CConstStats _const_stats;        ///< constant propagation statistics
 };
 
 /// @name CCodeBlock output operators
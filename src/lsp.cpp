@@ -0,0 +1,460 @@
+//------------------------------------------------------------------------------
+/// @brief SnuPL language server
+/// @author Bernhard Egger <bernhard@csap.snu.ac.kr>
+/// @section changelog Change Log
+/// 2026/10/16 created: stdio server speaking the Language Server Protocol
+///
+///
+/// @section license_section License
+/// Copyright (c) 2012-2016, Bernhard Egger
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms,  with or without modifi-
+/// cation, are permitted provided that the following conditions are met:
+///
+/// - Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+/// - Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,  BUT NOT LIMITED TO,  THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY  AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER  OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT,  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSE-
+/// QUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF  SUBSTITUTE
+/// GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+/// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN  CONTRACT, STRICT
+/// LIABILITY, OR TORT  (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY
+/// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+/// DAMAGE.
+//------------------------------------------------------------------------------
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+#include <sstream>
+#include <vector>
+
+#include "lsp.h"
+using namespace std;
+
+
+//------------------------------------------------------------------------------
+/// @brief JSON value
+///
+/// just enough JSON to read LSP messages. Missing members and out-of-range
+/// elements read as null values.
+///
+class CJson {
+  public:
+    enum EType { jNull, jBool, jNumber, jString, jArray, jObject };
+
+    CJson(void) : _type(jNull), _bool(false), _number(0) {};
+
+    /// @brief parse a JSON text
+    /// @param text JSON text
+    /// @param value (out) parsed value
+    /// @retval true on success
+    static bool Parse(const string &text, CJson *value);
+
+    /// @brief escape a string and add quotes
+    static string Quote(const string &s);
+
+    EType GetType(void) const { return _type; };
+    bool Has(const string &key) const { return _object.count(key) > 0; };
+    const CJson& operator[](const string &key) const;
+    const CJson& operator[](size_t i) const;
+    size_t GetSize(void) const { return _array.size(); };
+    const string& GetString(void) const { return _string; };
+    int GetInt(void) const { return (int)_number; };
+
+    /// @brief serialize the value
+    string ToString(void) const;
+
+  private:
+    /// @brief parse a value starting at text[*pos]
+    static bool Value(const string &text, size_t *pos, CJson *value);
+
+    /// @brief parse a string starting at the opening quote text[*pos]
+    static bool String(const string &text, size_t *pos, string *s);
+
+    /// @brief skip white space
+    static void White(const string &text, size_t *pos);
+
+    EType   _type;
+    bool    _bool;
+    double  _number;
+    string  _string;
+    vector<CJson> _array;
+    map<string, CJson> _object;
+};
+
+bool CJson::Parse(const string &text, CJson *value)
+{
+  size_t pos = 0;
+
+  if (!Value(text, &pos, value)) return false;
+  White(text, &pos);
+  return pos == text.size();
+}
+
+string CJson::Quote(const string &s)
+{
+  ostringstream o;
+
+  o << '"';
+  for (size_t i=0; i<s.size(); i++) {
+    unsigned char c = s[i];
+    switch (c) {
+      case '"':  o << "\\\""; break;
+      case '\\': o << "\\\\"; break;
+      case '\n': o << "\\n"; break;
+      case '\r': o << "\\r"; break;
+      case '\t': o << "\\t"; break;
+      default:
+        if (c < 0x20) {
+          char buf[8];
+          snprintf(buf, sizeof(buf), "\\u%04x", c);
+          o << buf;
+        } else {
+          o << c;
+        }
+    }
+  }
+  o << '"';
+
+  return o.str();
+}
+
+const CJson& CJson::operator[](const string &key) const
+{
+  static const CJson null;
+
+  map<string, CJson>::const_iterator it = _object.find(key);
+  return it != _object.end() ? it->second : null;
+}
+
+const CJson& CJson::operator[](size_t i) const
+{
+  static const CJson null;
+
+  return i < _array.size() ? _array[i] : null;
+}
+
+string CJson::ToString(void) const
+{
+  ostringstream o;
+
+  switch (_type) {
+    case jNull:   o << "null"; break;
+    case jBool:   o << (_bool ? "true" : "false"); break;
+    case jNumber: o.precision(17); o << _number; break;
+    case jString: o << Quote(_string); break;
+    case jArray:
+      o << "[";
+      for (size_t i=0; i<_array.size(); i++) {
+        o << (i > 0 ? "," : "") << _array[i].ToString();
+      }
+      o << "]";
+      break;
+    case jObject:
+      o << "{";
+      for (map<string, CJson>::const_iterator it = _object.begin();
+           it != _object.end(); it++) {
+        o << (it != _object.begin() ? "," : "") << Quote(it->first) << ":"
+          << it->second.ToString();
+      }
+      o << "}";
+      break;
+  }
+
+  return o.str();
+}
+
+bool CJson::Value(const string &text, size_t *pos, CJson *value)
+{
+  White(text, pos);
+  if (*pos >= text.size()) return false;
+
+  char c = text[*pos];
+
+  if (c == '{') {
+    value->_type = jObject;
+    (*pos)++;
+    White(text, pos);
+    if ((*pos < text.size()) && (text[*pos] == '}')) { (*pos)++; return true; }
+    while (true) {
+      string key;
+      White(text, pos);
+      if (!String(text, pos, &key)) return false;
+      White(text, pos);
+      if ((*pos >= text.size()) || (text[*pos] != ':')) return false;
+      (*pos)++;
+      if (!Value(text, pos, &value->_object[key])) return false;
+      White(text, pos);
+      if (*pos >= text.size()) return false;
+      if (text[*pos] == '}') { (*pos)++; return true; }
+      if (text[*pos] != ',') return false;
+      (*pos)++;
+    }
+  } else if (c == '[') {
+    value->_type = jArray;
+    (*pos)++;
+    White(text, pos);
+    if ((*pos < text.size()) && (text[*pos] == ']')) { (*pos)++; return true; }
+    while (true) {
+      value->_array.push_back(CJson());
+      if (!Value(text, pos, &value->_array.back())) return false;
+      White(text, pos);
+      if (*pos >= text.size()) return false;
+      if (text[*pos] == ']') { (*pos)++; return true; }
+      if (text[*pos] != ',') return false;
+      (*pos)++;
+    }
+  } else if (c == '"') {
+    value->_type = jString;
+    return String(text, pos, &value->_string);
+  } else if (text.compare(*pos, 4, "true") == 0) {
+    value->_type = jBool;
+    value->_bool = true;
+    *pos += 4;
+  } else if (text.compare(*pos, 5, "false") == 0) {
+    value->_type = jBool;
+    *pos += 5;
+  } else if (text.compare(*pos, 4, "null") == 0) {
+    value->_type = jNull;
+    *pos += 4;
+  } else {
+    const char *start = text.c_str() + *pos;
+    char *end;
+    value->_type = jNumber;
+    value->_number = strtod(start, &end);
+    if (end == start) return false;
+    *pos += end - start;
+  }
+
+  return true;
+}
+
+bool CJson::String(const string &text, size_t *pos, string *s)
+{
+  if ((*pos >= text.size()) || (text[*pos] != '"')) return false;
+  (*pos)++;
+
+  while (*pos < text.size()) {
+    char c = text[(*pos)++];
+
+    if (c == '"') return true;
+    if (c != '\\') { *s += c; continue; }
+    if (*pos >= text.size()) return false;
+
+    c = text[(*pos)++];
+    switch (c) {
+      case 'b': *s += '\b'; break;
+      case 'f': *s += '\f'; break;
+      case 'n': *s += '\n'; break;
+      case 'r': *s += '\r'; break;
+      case 't': *s += '\t'; break;
+      case 'u': {
+        if (*pos + 4 > text.size()) return false;
+        unsigned int u = strtoul(text.substr(*pos, 4).c_str(), NULL, 16);
+        *pos += 4;
+        // surrogate pair
+        if ((u >= 0xd800) && (u < 0xdc00) && (*pos + 6 <= text.size()) &&
+            (text.compare(*pos, 2, "\\u") == 0)) {
+          unsigned int l = strtoul(text.substr(*pos+2, 4).c_str(), NULL, 16);
+          if ((l >= 0xdc00) && (l < 0xe000)) {
+            u = 0x10000 + ((u - 0xd800) << 10) + (l - 0xdc00);
+            *pos += 6;
+          }
+        }
+        // encode as UTF-8
+        if (u < 0x80) {
+          *s += (char)u;
+        } else if (u < 0x800) {
+          *s += (char)(0xc0 | (u >> 6));
+          *s += (char)(0x80 | (u & 0x3f));
+        } else if (u < 0x10000) {
+          *s += (char)(0xe0 | (u >> 12));
+          *s += (char)(0x80 | ((u >> 6) & 0x3f));
+          *s += (char)(0x80 | (u & 0x3f));
+        } else {
+          *s += (char)(0xf0 | (u >> 18));
+          *s += (char)(0x80 | ((u >> 12) & 0x3f));
+          *s += (char)(0x80 | ((u >> 6) & 0x3f));
+          *s += (char)(0x80 | (u & 0x3f));
+        }
+        break;
+      }
+      default: *s += c; break;
+    }
+  }
+
+  return false;
+}
+
+void CJson::White(const string &text, size_t *pos)
+{
+  while ((*pos < text.size()) &&
+         ((text[*pos] == ' ') || (text[*pos] == '\t') ||
+          (text[*pos] == '\n') || (text[*pos] == '\r'))) (*pos)++;
+}
+
+
+//------------------------------------------------------------------------------
+// CLspServer
+//
+CLspServer::CLspServer(istream *in, ostream *out)
+  : _in(in), _out(out), _shutdown(false), _exit(false)
+{
+  assert((in != NULL) && (out != NULL));
+}
+
+CLspServer::~CLspServer(void)
+{
+  map<string, CDocument*>::iterator it = _doc.begin();
+  while (it != _doc.end()) delete (*it++).second;
+}
+
+int CLspServer::Run(void)
+{
+  string body;
+
+  while (!_exit && Read(&body)) {
+    CJson msg;
+
+    if (!CJson::Parse(body, &msg) || (msg.GetType() != CJson::jObject)) {
+      SendError("null", -32700, "parse error");
+      continue;
+    }
+
+    Dispatch(msg);
+  }
+
+  return _shutdown ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+bool CLspServer::Read(string *body)
+{
+  long length = -1;
+  string line;
+
+  // header fields, terminated by an empty line
+  while (getline(*_in, line)) {
+    if (!line.empty() && (line[line.size()-1] == '\r')) line.erase(line.size()-1);
+    if (line.empty()) {
+      if (length >= 0) break;
+      continue;
+    }
+    if (strncasecmp(line.c_str(), "Content-Length:", 15) == 0) {
+      length = atol(line.c_str() + 15);
+    }
+  }
+  if (length < 0) return false;
+
+  body->resize(length);
+  _in->read(&(*body)[0], length);
+  return _in->gcount() == length;
+}
+
+void CLspServer::Send(const string &body)
+{
+  *_out << "Content-Length: " << body.size() << "\r\n\r\n" << body;
+  _out->flush();
+}
+
+void CLspServer::SendResult(const string &id, const string &result)
+{
+  Send("{\"jsonrpc\":\"2.0\",\"id\":" + id + ",\"result\":" + result + "}");
+}
+
+void CLspServer::SendError(const string &id, int code, const string &message)
+{
+  ostringstream o;
+
+  o << "{\"jsonrpc\":\"2.0\",\"id\":" << id << ",\"error\":{\"code\":" << code
+    << ",\"message\":" << CJson::Quote(message) << "}}";
+  Send(o.str());
+}
+
+void CLspServer::Dispatch(const CJson &msg)
+{
+  const string &method = msg["method"].GetString();
+  const CJson &params = msg["params"];
+  bool request = msg.Has("id");
+  string id = msg["id"].ToString();
+
+  if (method == "initialize") {
+    SendResult(id, "{\"capabilities\":{\"textDocumentSync\":"
+                   "{\"openClose\":true,\"change\":2}},"
+                   "\"serverInfo\":{\"name\":\"snuplc\"}}");
+  } else if (method == "shutdown") {
+    _shutdown = true;
+    SendResult(id, "null");
+  } else if (method == "exit") {
+    _exit = true;
+  } else if (method == "textDocument/didOpen") {
+    const CJson &td = params["textDocument"];
+    const string &uri = td["uri"].GetString();
+
+    if (_doc.count(uri) == 0) _doc[uri] = new CDocument();
+    _doc[uri]->SetText(td["text"].GetString());
+    Publish(uri);
+  } else if (method == "textDocument/didChange") {
+    const string &uri = params["textDocument"]["uri"].GetString();
+    const CJson &changes = params["contentChanges"];
+
+    map<string, CDocument*>::iterator it = _doc.find(uri);
+    if (it == _doc.end()) return;
+
+    for (size_t i=0; i<changes.GetSize(); i++) {
+      const CJson &c = changes[i];
+      if (c.Has("range")) {
+        const CJson &start = c["range"]["start"], &end = c["range"]["end"];
+        it->second->Edit(start["line"].GetInt(), start["character"].GetInt(),
+                         end["line"].GetInt(), end["character"].GetInt(),
+                         c["text"].GetString());
+      } else {
+        it->second->SetText(c["text"].GetString());
+      }
+    }
+    Publish(uri);
+  } else if (method == "textDocument/didClose") {
+    const string &uri = params["textDocument"]["uri"].GetString();
+
+    map<string, CDocument*>::iterator it = _doc.find(uri);
+    if (it == _doc.end()) return;
+
+    delete it->second;
+    _doc.erase(it);
+    Send("{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/publishDiagnostics\","
+         "\"params\":{\"uri\":" + CJson::Quote(uri) + ",\"diagnostics\":[]}}");
+  } else if (request) {
+    SendError(id, -32601, "method not found: " + method);
+  }
+  // other notifications are ignored
+}
+
+void CLspServer::Publish(const string &uri)
+{
+  vector<CDiagnostic> diag = _doc[uri]->GetDiagnostics();
+  ostringstream o;
+
+  o << "{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/publishDiagnostics\","
+    << "\"params\":{\"uri\":" << CJson::Quote(uri) << ",\"diagnostics\":[";
+  for (size_t i=0; i<diag.size(); i++) {
+    const CDiagnostic &d = diag[i];
+    o << (i > 0 ? "," : "")
+      << "{\"range\":{\"start\":{\"line\":" << d.line << ",\"character\":"
+      << d.charpos << "},\"end\":{\"line\":" << d.line << ",\"character\":"
+      << d.charpos + d.length << "}},\"severity\":1,\"source\":\"snuplc\","
+      << "\"message\":" << CJson::Quote(d.message) << "}";
+  }
+  o << "]}}";
+
+  Send(o.str());
+}
@@ -0,0 +1,118 @@
+//------------------------------------------------------------------------------
+/// @brief SnuPL language server
+/// @author Bernhard Egger <bernhard@csap.snu.ac.kr>
+/// @section changelog Change Log
+/// 2026/10/16 created: stdio server speaking the Language Server Protocol
+///
+///
+/// @section license_section License
+/// Copyright (c) 2012-2016, Bernhard Egger
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms,  with or without modifi-
+/// cation, are permitted provided that the following conditions are met:
+///
+/// - Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+/// - Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,  BUT NOT LIMITED TO,  THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY  AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER  OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT,  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSE-
+/// QUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF  SUBSTITUTE
+/// GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+/// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN  CONTRACT, STRICT
+/// LIABILITY, OR TORT  (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY
+/// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+/// DAMAGE.
+//------------------------------------------------------------------------------
+
+#ifndef __SnuPL_LSP_H__
+#define __SnuPL_LSP_H__
+
+#include <iostream>
+#include <map>
+#include <string>
+
+#include "document.h"
+using namespace std;
+
+class CJson;
+
+//------------------------------------------------------------------------------
+/// @brief language server
+///
+/// a long-running server that reads JSON-RPC messages framed by a
+/// 'Content-Length' header from an input stream (the Language Server
+/// Protocol over stdio). Open documents are kept as CDocument instances;
+/// 'textDocument/didChange' notifications with ranges are applied as
+/// incremental edits, and the diagnostics of the document are published
+/// after every change.
+///
+/// Supported messages: initialize, initialized, shutdown, exit,
+/// textDocument/didOpen, textDocument/didChange, textDocument/didClose.
+/// Character positions are counted in bytes (SnuPL sources are ASCII).
+///
+class CLspServer {
+  public:
+    /// @name construction/destruction
+    /// @{
+
+    /// @brief constructor
+    ///
+    /// @param in input stream
+    /// @param out output stream
+    CLspServer(istream *in, ostream *out);
+
+    /// @brief destructor
+    ~CLspServer(void);
+
+    /// @}
+
+    /// @brief serve requests until 'exit' is received or the input ends
+    ///
+    /// @retval exit code (0 if 'shutdown' was received before 'exit')
+    int Run(void);
+
+  private:
+    /// @brief read the body of the next message
+    /// @param body (out) message body
+    /// @retval true if a message has been read
+    /// @retval false at the end of the input
+    bool Read(string *body);
+
+    /// @brief send a message
+    /// @param body message body
+    void Send(const string &body);
+
+    /// @brief send the result of a request
+    /// @param id request id (JSON)
+    /// @param result result (JSON)
+    void SendResult(const string &id, const string &result);
+
+    /// @brief send an error response
+    /// @param id request id (JSON)
+    /// @param code error code
+    /// @param message error message
+    void SendError(const string &id, int code, const string &message);
+
+    /// @brief handle a message
+    /// @param msg message
+    void Dispatch(const CJson &msg);
+
+    /// @brief publish the diagnostics of a document
+    /// @param uri document URI
+    void Publish(const string &uri);
+
+    istream *_in;                   ///< input stream
+    ostream *_out;                  ///< output stream
+    map<string, CDocument*> _doc;   ///< open documents
+    bool    _shutdown;              ///< 'shutdown' received
+    bool    _exit;                  ///< 'exit' received
+};
+
+#endif // __SnuPL_LSP_H__
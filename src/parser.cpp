@@ -37,10 +37,12 @@
 #include <limits.h>
 #include <cassert>
 #include <errno.h>
+#include <algorithm>
 #include <cstdlib>
 #include <vector>
 #include <iostream>
 #include <exception>
+#include <thread>
 
 #include "parser.h"
 using namespace std;
@@ -49,67 +51,468 @@ using namespace std;
 //------------------------------------------------------------------------------
 // CParser
 //
-CParser::CParser(CScanner *scanner)
+CParser::CParser(CScanner *scanner, CCompilation *compilation)
 {
+  _compilation = compilation != NULL ? compilation :
+                                       CCompilation::GetCurrent();
   _scanner = scanner;
+  _tokens = NULL;
+  _pos = 0;
   _module = NULL;
+  _order = NULL;
+  _current = 0;
+  _strings = NULL;
+  _panic = false;
+  _error_pos = CToken::NOPOS;
 }
 
-CAstNode* CParser::Parse(void)
+CParser::CParser(CTokenBuffer *tokens, CCompilation *compilation)
 {
-  _abort = false;
+  _compilation = compilation != NULL ? compilation :
+                                       CCompilation::GetCurrent();
+  _scanner = NULL;
+  _tokens = tokens;
+  _pos = 0;
+  _module = NULL;
+  _order = NULL;
+  _current = 0;
+  _strings = NULL;
+  _panic = false;
+  _error_pos = CToken::NOPOS;
+}
+
+CAstNode* CParser::Parse(unsigned int nthreads)
+{
+  CCompilation *prev = CCompilation::SetCurrent(_compilation);
+
+  _errors.clear();
+  _panic = false;
+  _error_pos = CToken::NOPOS;
+  _pos = 0;
 
   if (_module != NULL) { delete _module; _module = NULL; }
 
-  try {
-    if (_scanner != NULL) _module = module();
+  if ((nthreads <= 1) || (_tokens == NULL) || !ParseParallel(nthreads)) {
+    // register the string constants after all other global symbols, in
+    // source order, as a parallel parse does; the module's symbol table then
+    // lists its symbols in the same order after either parse
+    vector<CAstStringConstant*> strings;
+
+    _strings = &strings;
+    if ((_scanner != NULL) || (_tokens != NULL)) module();
+    _strings = NULL;
 
     if (_module != NULL) {
-      CToken t;
-      string msg;
-      if (!_module->TypeCheck(&t, &msg)) SetError(t, msg);
+      for (size_t i=0; i<strings.size(); i++) strings[i]->Register(_module);
     }
-  } catch (...) {
-    _module = NULL;
+
+    // type check the module even if it has syntax errors
+    if (_module != NULL) _module->TypeCheckAll(&_errors);
+    if (HasError()) _module = NULL;
   }
 
+  SortErrors();
+
+  CCompilation::SetCurrent(prev);
+
   return _module;
 }
 
+CAstModule* CParser::ParseModuleHeader(size_t pos, size_t *end)
+{
+  assert((_tokens != NULL) && (end != NULL));
+
+  _errors.clear();
+  _panic = false;
+  _error_pos = CToken::NOPOS;
+  _pos = pos;
+  _module = NULL;
+
+  CCompilation *prev = CCompilation::SetCurrent(_compilation);
+  moduleHeader();
+  CCompilation::SetCurrent(prev);
+
+  SortErrors();
+  *end = _pos;
+  return _module;
+}
+
+CAstProcedure* CParser::ParseSubroutine(CAstModule *m, size_t pos,
+                                        size_t *end)
+{
+  assert((_tokens != NULL) && (m != NULL) && (end != NULL));
+
+  _errors.clear();
+  _panic = false;
+  _error_pos = CToken::NOPOS;
+  _pos = pos;
+
+  // the procedure node registers with the module as soon as it is created
+  size_t nchildren = m->GetNumChildren();
+  CAstProcedure *proc = NULL;
+
+  CCompilation *prev = CCompilation::SetCurrent(_compilation);
+  CAstProcedure *p = subroutineDecl(m);
+  if (p != NULL) p->TypeCheckAll(&_errors);
+  CCompilation::SetCurrent(prev);
+
+  SortErrors();
+
+  if (m->GetNumChildren() > nchildren) {
+    proc = dynamic_cast<CAstProcedure*>(m->GetChild(nchildren));
+  }
+
+  *end = _pos;
+  return proc;
+}
+
+bool CParser::ParseModuleBody(CAstModule *m, size_t pos)
+{
+  assert((_tokens != NULL) && (m != NULL));
+
+  _errors.clear();
+  _panic = false;
+  _error_pos = CToken::NOPOS;
+  _pos = pos;
+
+  CCompilation *prev = CCompilation::SetCurrent(_compilation);
+  moduleBody(m);
+  m->TypeCheckStatementsAll(&_errors);
+  CCompilation::SetCurrent(prev);
+
+  SortErrors();
+  return !HasError();
+}
+
+void CParser::SetOrder(const map<const CSymbol*, size_t> *order,
+                       size_t current)
+{
+  _order = order;
+  _current = current;
+}
+
+//
+// parallel parsing
+//
+// the parts of a module are numbered in the order a sequential parse
+// processes them: the header, the signature and the body of each subroutine,
+// the module body, and the type checks of the module body and of each
+// subroutine. The numbers serve as order keys for the type manager.
+//
+static inline unsigned int SignatureKey(size_t i) { return 2*i + 1; }
+static inline unsigned int BodyKey(size_t i) { return 2*i + 2; }
+static inline unsigned int ModuleKey(size_t n) { return 2*n + 1; }
+static inline unsigned int ModuleCheckKey(size_t n) { return 2*n + 2; }
+static inline unsigned int CheckKey(size_t n, size_t i) { return 2*n + 3 + i; }
+
+bool CParser::ParseParallel(unsigned int nthreads)
+{
+  CTypeManager *tm = CTypeManager::Get();
+  vector<CBodyPart> bodies;
+  map<const CSymbol*, size_t> order;
+
+  tm->BeginOrder();
+
+  // skim pass: parse the header and the signatures, skip the bodies
+  CTypeManager::SetOrder(0);
+  moduleHeader();
+
+  while (!HasError() && (PeekType() != tBegin)) {
+    size_t i = bodies.size();
+    CTypeManager::SetOrder(SignatureKey(i));
+    CAstProcedure *proc = subroutineHead(_module);
+    if (HasError()) break;
+
+    bodies.push_back(CBodyPart(proc, _pos, SkipBody(_pos)));
+    order[proc->GetSymbol()] = i;
+
+    // a malformed body stops the skim pass
+    if (bodies.back().end == npos) break;
+    _pos = bodies.back().end;
+  }
+
+  // parse and type check the bodies
+  size_t n = bodies.size();
+  bool skimmed = !HasError() && ((n == 0) || (bodies.back().end != npos));
+  size_t nworkers = skimmed ? min((size_t)nthreads, n) : 0;
+  atomic<size_t> next(0);
+  CArena *arena = CArena::GetCurrent();
+  vector<CParser*> worker;
+  vector<CArena*> warena;
+  vector<thread> wthread;
+
+  for (size_t w=0; w<nworkers; w++) {
+    worker.push_back(new CParser(_tokens, _compilation));
+    worker[w]->_order = &order;
+    warena.push_back(((w > 0) && (arena != NULL)) ?
+                     new CArena(arena->GetBlockSize()) : arena);
+  }
+  for (size_t w=1; w<nworkers; w++) {
+    wthread.push_back(thread(&CParser::ParseBodies, worker[w], &bodies, &next,
+                             warena[w]));
+  }
+  if (nworkers > 0) worker[0]->ParseBodies(&bodies, &next, arena);
+  for (size_t w=0; w<wthread.size(); w++) wthread[w].join();
+
+  for (size_t w=0; w<nworkers; w++) {
+    if ((w > 0) && (arena != NULL)) {
+      arena->Adopt(warena[w]);
+      delete warena[w];
+    }
+    delete worker[w];
+  }
+
+  // a body whose parse did not end where the skim pass found its end (a
+  // syntax error has been recovered from beyond it) is not delimited
+  // correctly; neither is a module whose skim pass failed. Discard the
+  // module and its types and parse it sequentially.
+  for (size_t i=0; i<n; i++) skimmed &= bodies[i].parsed == bodies[i].end;
+
+  if (!skimmed) {
+    CTypeManager::SetOrder(CTypeManager::NOORDER);
+    tm->EndOrder(0);
+
+    delete _module;
+    _module = NULL;
+    _errors.clear();
+    _panic = false;
+    _error_pos = CToken::NOPOS;
+    _pos = 0;
+    return false;
+  }
+
+  // name the string constants of the bodies in source order and collect
+  // the errors in the order of a sequential parse: the syntax errors of the
+  // bodies and the module body, then the type errors of the module body and
+  // of the bodies (Parse() sorts them by position)
+  for (size_t i=0; i<n; i++) {
+    for (size_t j=0; j<bodies[i].strings.size(); j++) {
+      bodies[i].strings[j]->Register(bodies[i].proc);
+    }
+    _errors.insert(_errors.end(), bodies[i].errors.begin(),
+                   bodies[i].errors.end());
+  }
+
+  CTypeManager::SetOrder(ModuleKey(n));
+  moduleBody(_module);
+
+  CTypeManager::SetOrder(ModuleCheckKey(n));
+  _module->TypeCheckStatementsAll(&_errors);
+
+  for (size_t i=0; i<n; i++) {
+    _errors.insert(_errors.end(), bodies[i].type_errors.begin(),
+                   bodies[i].type_errors.end());
+  }
+
+  CTypeManager::SetOrder(CTypeManager::NOORDER);
+  tm->EndOrder();
+
+  if (HasError()) _module = NULL;
+  return true;
+}
+
+void CParser::ParseBodies(vector<CBodyPart> *bodies, atomic<size_t> *next,
+                          CArena *arena)
+{
+  CArena *prev = CArena::SetCurrent(arena);
+  CCompilation *prev_compilation = CCompilation::SetCurrent(_compilation);
+  size_t n = bodies->size();
+  size_t i;
+
+  while ((i = (*next)++) < n) ParseBody(&(*bodies)[i], i, n);
+
+  CTypeManager::SetOrder(CTypeManager::NOORDER);
+  CCompilation::SetCurrent(prev_compilation);
+  CArena::SetCurrent(prev);
+}
+
+void CParser::ParseBody(CBodyPart *body, size_t index, size_t n)
+{
+  _errors.clear();
+  _panic = false;
+  _error_pos = CToken::NOPOS;
+  _pos = body->first;
+  _current = index;
+  _strings = &body->strings;
+
+  CTypeManager::SetOrder(BodyKey(index));
+  subroutineBody(body->proc);
+  body->parsed = _pos;
+  body->errors.swap(_errors);
+
+  // a body that is parsed again sequentially need not be type checked
+  if (body->parsed == body->end) {
+    CTypeManager::SetOrder(CheckKey(n, index));
+    body->proc->TypeCheckAll(&body->type_errors);
+  }
+
+  _strings = NULL;
+}
+
+size_t CParser::SkipBody(size_t pos) const
+{
+  // subroutineBody ::= varDeclaration "begin" statSequence "end" ident ";"
+  // 'begin', 'if', and 'while' are each closed by an 'end'
+  int depth = 0;
+
+  while (true) {
+    switch (_tokens->GetType(pos++)) {
+      case tBegin:
+      case tIf:
+      case tWhile:
+        depth++;
+        break;
+
+      case tEnd:
+        if (--depth == 0) return pos + 2;
+        if (depth < 0) return npos;
+        break;
+
+      case tProcedure:
+      case tFunction:
+      case tModule:
+      case tEOF:
+      case tIOError:
+        return npos;
+
+      default:
+        break;
+    }
+  }
+}
+
+const CSymbol* CParser::FindSymbol(CAstScope *s, const string *name) const
+{
+  const CSymbol *sb = s->GetSymbolTable()->FindSymbol(name);
+
+  if ((sb != NULL) && (_order != NULL) &&
+      (sb->GetSymbolType() == stProcedure)) {
+    map<const CSymbol*, size_t>::const_iterator it = _order->find(sb);
+    if ((it != _order->end()) && (it->second > _current)) sb = NULL;
+  }
+
+  return sb;
+}
+
 const CToken* CParser::GetErrorToken(void) const
 {
-  if (_abort) return &_error_token;
+  if (HasError()) return &_errors[0].token;
   else return NULL;
 }
 
 string CParser::GetErrorMessage(void) const
 {
-  if (_abort) return _message;
+  if (HasError()) return _errors[0].message;
   else return "";
 }
 
 void CParser::SetError(CToken t, const string message)
 {
-  _error_token = t;
-  _message = message;
-  _abort = true;
-  throw message;
+  // errors found while skipping a syntax error are most likely caused by
+  // it, and so are errors at the same token after a recovery that did not
+  // skip any tokens
+  unsigned int pos = t.GetPosition();
+  if (!_panic && ((pos == CToken::NOPOS) || (pos != _error_pos))) {
+    _errors.push_back(CSourceError(t, message));
+    _error_pos = pos;
+  }
+  _panic = true;
+}
+
+void CParser::AddError(CToken t, const string message)
+{
+  _errors.push_back(CSourceError(t, message));
+}
+
+/// @brief order two errors by their source position
+static bool ErrorBefore(const CSourceError &a, const CSourceError &b)
+{
+  return a.token.GetPosition() < b.token.GetPosition();
+}
+
+void CParser::SortErrors(void)
+{
+  stable_sort(_errors.begin(), _errors.end(), ErrorBefore);
+}
+
+static inline TTokenSet TokenSet(EToken t) { return 1ULL << t; }
+
+// end of the input
+static const TTokenSet EndSet = TokenSet(tEOF) | TokenSet(tIOError);
+
+// tokens that start a statement or end a statement sequence
+static const TTokenSet StatementSync =
+  TokenSet(tSemicolon) | TokenSet(tEnd) | TokenSet(tElse) | TokenSet(tIf) |
+  TokenSet(tWhile) | TokenSet(tReturn) | TokenSet(tBreak);
+
+// tokens that cannot occur in a statement sequence
+static const TTokenSet StatementStop =
+  TokenSet(tModule) | TokenSet(tVar) | TokenSet(tBegin) |
+  TokenSet(tProcedure) | TokenSet(tFunction);
+
+bool CParser::Recover(TTokenSet sync, TTokenSet stop)
+{
+  bool skipped = false;
+  while ((TokenSet(PeekType()) & (sync | stop | EndSet)) == 0) {
+    Get();
+    skipped = true;
+  }
+
+  if (skipped) _error_pos = CToken::NOPOS;
+  if ((TokenSet(PeekType()) & sync) != 0) _panic = false;
+  return !_panic;
+}
+
+CToken CParser::Get(void)
+{
+  if (_tokens != NULL) {
+    CToken t = _tokens->GetToken(_pos);
+    if (_pos < _tokens->GetSize()-1) _pos++;
+    return t;
+  } else {
+    return _scanner->Get();
+  }
+}
+
+CToken CParser::Peek(size_t k) const
+{
+  if (_tokens != NULL) return _tokens->GetToken(_pos + k);
+
+  assert(k == 0);   // the scanner only supports a lookahead of one token
+  return _scanner->Peek();
+}
+
+EToken CParser::PeekType(size_t k) const
+{
+  if (_tokens != NULL) return _tokens->GetType(_pos + k);
+
+  assert(k == 0);   // the scanner only supports a lookahead of one token
+  return _scanner->Peek().GetType();
 }
 
 bool CParser::Consume(EToken type, CToken *token)
 {
-  if (_abort) return false;
+  if (_panic) return false;
 
-  CToken t = _scanner->Get();
+  // in token buffer mode, only materialize a CToken if it is needed
+  if ((_tokens != NULL) && (token == NULL) && (PeekType() == type)) {
+    Get();
+    return true;
+  }
 
-  if (t.GetType() != type) {
+  // an unexpected token is left for error recovery
+  if (PeekType() != type) {
+    CToken t = Peek();
     SetError(t, "expected '" + CToken::Name(type) + "', got '" +
              t.GetName() + "'");
+    if (token != NULL) *token = t;
+    return false;
   }
 
+  CToken t = Get();
   if (token != NULL) *token = t;
 
-  return t.GetType() == type;
+  return true;
 }
 
 void CParser::InitSymbolTable(CSymtab *s)
@@ -150,104 +553,220 @@ CAstModule* CParser::module(void)
   //
   // module ::= "module" ident ";" varDeclaration { subroutineDecl } "begin" statSequence "end" ident "."
   //
+  CAstModule *m = moduleHeader();
+
+  while (true) {
+    // skip to the next subroutine or the module body after a syntax error
+    if (_panic) {
+      Recover(TokenSet(tProcedure) | TokenSet(tFunction) | TokenSet(tBegin));
+    }
+
+    EToken tt = PeekType();
+    if (tt == tBegin) break; // FIRST(subroutineDecl) does not have tBegin
+
+    if ((tt == tProcedure) || (tt == tFunction)) {
+      subroutineDecl(m);
+    } else {
+      SetError(Peek(), "expected \"procedure\" or \"function\"");
+      if ((tt == tEOF) || (tt == tIOError)) break;
+      Get();
+    }
+  }
+
+  moduleBody(m);
+
+  return m;
+}
+
+CAstModule* CParser::moduleHeader(void)
+{
   CToken idToken;
   Consume(tModule);
-  Consume(tId, &idToken);
+  bool named = Consume(tId, &idToken);
   Consume(tSemicolon);
 
-  CAstModule *m = new CAstModule(idToken, idToken.GetValue());
+  // a module without a name is still created to parse the declarations
+  CAstModule *m = new CAstModule(idToken, named ? idToken.GetValue() : "");
+  _module = m;
   InitSymbolTable(m->GetSymbolTable());
 
+  if (_panic) {
+    Recover(TokenSet(tVar) | TokenSet(tProcedure) | TokenSet(tFunction) |
+            TokenSet(tBegin));
+  }
+
   varDeclaration(m);
 
-  while(_scanner->Peek().GetType() != tBegin) { // FIRST(subroutineDecl) does not have tBegin
-    CAstProcedure *proc = subroutineDecl(m);
-  }
+  return m;
+}
 
-  Consume(tBegin);
-  CAstStatement *statseq = statSequence(m, false);
-  m->SetStatementSequence(statseq);
+void CParser::moduleBody(CAstModule *m)
+{
+  if (Consume(tBegin)) {
+    m->SetStatementSequence(statSequence(m, false));
+  }
   Consume(tEnd);
   CToken idToken2;
-  Consume(tId, &idToken2);
 
   // check for matching identifier
-  if (idToken.GetValue() != idToken2.GetValue()) {
-    SetError(idToken2, "invalid end identifier");
+  if (Consume(tId, &idToken2) && !m->GetName().empty() &&
+      (m->GetName() != idToken2.GetValue())) {
+    AddError(idToken2, "invalid end identifier");
   }
 
   Consume(tDot);
-
-  return m;
 }
 
-CAstStatement* CParser::statSequence(CAstScope *s, bool isInLoop)
+vector<CAstStatement*> CParser::statSequence(CAstScope *s, bool isInLoop)
 {
   //
   // statSequence ::= [ statement { ";" statement } ].
   // statement ::= assignment | subroutineCall
   // statement ::= ifStatement | whileStatement | returnStatement | breakStatement
+  // ifStatement ::= "if" "(" expression ")" "then" statSequence
+  //                 [ "else" statSequence ] "end"
+  // whileStatement ::= "while" "(" expression ")" "do" statSequence "end"
   // FIRST(statSequence) = { tId, tIf, tWhile, tReturn, tBreak }
   // FOLLOW(statSequence) = { tElse, tEnd }
   //
-  CAstStatement *head = NULL;
+  // the statement sequences of nested if and while statements are kept on
+  // an explicit stack; the nesting depth is not limited by the native stack.
+  //
+  // a malformed statement is skipped up to the next ';', 'end', 'else', or
+  // statement keyword. A malformed if or while header is skipped up to its
+  // 'then' or 'do'; its body is parsed, but the statement is dropped.
+  // Tokens that cannot occur in a statement sequence (e.g., 'procedure')
+  // end the sequence in panic mode.
+  //
+  vector<CStatFrame> frame(1, CStatFrame(tBegin, CToken(), NULL, isInLoop));
+  bool start = true;                // at the start of a statement sequence
 
-  EToken tt = _scanner->Peek().GetType();
-  if (!(tt == tEnd || tt == tElse)) { // FOLLOW(statSequence)
-    CAstStatement *tail = NULL;
+  while (true) {
+    CStatFrame *f = &frame.back();
+    EToken tt = PeekType();
 
-    do {
+    if (!(start && (tt == tEnd || tt == tElse))) { // FOLLOW(statSequence)
       CToken t;
-      EToken tt = _scanner->Peek().GetType();
       CAstStatement *st = NULL;
+      CAstExpression *cond = NULL;
 
       switch (tt) {
         // statement ::= assignment | subroutineCall
         case tId:
           Consume(tId, &t);
-          if (_scanner->Peek().GetType() == tLBrak ) { //subroutineCall starts with tId, tLBrak
+          if (PeekType() == tLBrak ) { //subroutineCall starts with tId, tLBrak
             st = subroutineCall(s, t);
           } else {
             st = assignment(s, t); // assignment does not starts with tId, tLBrak
           }
           break;
-        // statement ::= ifStatement
+        // statement ::= ifStatement | whileStatement
         case tIf:
-          st = ifStatement(s, isInLoop);
-          break;
-        // statement ::= whileStatement
         case tWhile:
-          st = whileStatement(s);
-          break;
+          {
+            EToken kind = tt == tIf ? tThen : tDo;
+            Consume(tt, &t);
+            Consume(tLBrak);
+            cond = expression(s);
+            Consume(tRBrak);
+            Consume(kind);
+            if (_panic &&
+                Recover(TokenSet(kind), StatementSync | StatementStop)) {
+              Consume(kind);
+              cond = NULL;
+            }
+            if (_panic) break;
+            frame.push_back(CStatFrame(kind, t, cond,
+                                       tt == tWhile || f->inLoop));
+            start = true;
+            continue;
+          }
         // statement ::= returnStatement
         case tReturn:
           st = returnStatement(s);
           break;
         case tBreak:
           Consume(tBreak, &t);
-          if (!isInLoop) {
-            SetError(t, "break statement should be in loop");
+          if (!f->inLoop) {
+            AddError(t, "break statement should be in loop");
+          } else {
+            st = new CAstStatBreak(t);
           }
-          st = new CAstStatBreak(t);
           break;
         default:
-          SetError(_scanner->Peek(), "statement expected.");
+          SetError(Peek(), "statement expected.");
           break;
       }
 
-      assert(st != NULL);
-      if (head == NULL) head = st;
-      else tail->SetNext(st);
-      tail = st;
+      if (_panic) {
+        // skip the malformed statement
+        if (!Recover(StatementSync, StatementStop)) return frame[0].seq;
+        if (PeekType() == tSemicolon) Consume(tSemicolon);
+        start = true;
+        continue;
+      }
+
+      if (st != NULL) f->Append(st);
 
-      tt = _scanner->Peek().GetType();
-      if (tt != tSemicolon) break;
+      if (PeekType() == tSemicolon) {
+        Consume(tSemicolon);
+        start = false;
+        continue;
+      }
+    }
 
-      Consume(tSemicolon);
-    } while (!_abort);
-  }
+    // the statement sequence has ended: close the enclosing if and while
+    // statements until one is followed by a semicolon or an else branch
+    while (true) {
+      f = &frame.back();
+
+      if ((f->kind == tThen) && (PeekType() == tElse)) {
+        Consume(tElse);
+        f->kind = tElse;
+        f->body.swap(f->seq);
+        start = true;
+        break;
+      }
 
-  return head;
+      // the caller consumes the 'end' of the outermost sequence
+      if ((f->kind == tBegin) && (PeekType() == tEnd)) return f->seq;
+
+      if (!Consume(tEnd)) {
+        // a missing ';' or 'end': skip to the next statement of the sequence
+        if (!Recover(StatementSync & ~TokenSet(tElse), StatementStop)) {
+          return frame[0].seq;
+        }
+        if (PeekType() == tSemicolon) Consume(tSemicolon);
+        start = true;
+        break;
+      }
+
+      CAstStatement *st = NULL;
+      if (f->cond == NULL) {
+        // an if or while statement with a malformed header is dropped; the
+        // statements of its bodies are moved to the enclosing sequence to be
+        // type checked
+        CStatFrame &outer = frame[frame.size()-2];
+        outer.seq.insert(outer.seq.end(), f->body.begin(), f->body.end());
+        outer.seq.insert(outer.seq.end(), f->seq.begin(), f->seq.end());
+      } else if (f->kind == tDo) {
+        st = new CAstStatWhile(f->token, f->cond, f->seq);
+      } else if (f->kind == tThen) {
+        st = new CAstStatIf(f->token, f->cond, f->seq, f->body);
+      } else {
+        st = new CAstStatIf(f->token, f->cond, f->body, f->seq);
+      }
+
+      frame.pop_back();
+      if (st != NULL) frame.back().Append(st);
+
+      if (PeekType() == tSemicolon) {
+        Consume(tSemicolon);
+        start = false;
+        break;
+      }
+    }
+  }
 }
 
 CAstStatAssign* CParser::assignment(CAstScope *s, CToken idToken)
@@ -257,9 +776,11 @@ CAstStatAssign* CParser::assignment(CAstScope *s, CToken idToken)
   //
   CToken t;
   CAstDesignator *lhs = qualident(s, idToken);
-  Consume(tAssign, &t);
+  if (!Consume(tAssign, &t)) return NULL;
 
   CAstExpression *rhs = expression(s);
+  if (rhs == NULL) return NULL;
+
   return new CAstStatAssign(t, lhs, rhs);
 }
 
@@ -268,43 +789,36 @@ CAstStatCall* CParser::subroutineCall(CAstScope *s, CToken idToken)
   //
   // subroutineCall ::= ident "(" [ expression {"," expression} ] ")"
   //
-  CAstStatCall* n = NULL;
+  const CSymProc *sb = subroutine(s, idToken);
+  if (sb == NULL) return NULL;
 
-  const CSymbol *tsb = s->GetSymbolTable()->FindSymbol(idToken.GetValue());
-  const CSymProc *sb = dynamic_cast<const CSymProc *>(tsb);
-  if (sb == NULL) { // symbol must be procedure type
-    SetError(idToken, "invalid symbol.");
-    return NULL;
-  }
   CAstFunctionCall* fc = new CAstFunctionCall(idToken, sb);
 
   Consume(tLBrak);
 
-  if(_scanner->Peek().GetType() != tRBrak) { // there can be no parameters
-    CAstExpression* arg = parameter(s);
-    fc->AddArg(arg);
-    while(_scanner->Peek().GetType() == tComma) {
+  if(PeekType() != tRBrak) { // there can be no parameters
+    CAstExpression *arg = expression(s);
+    while (arg != NULL) {
+      fc->AddArg(parameter(arg));
+      if (PeekType() != tComma) break;
       Consume(tComma);
-      arg = parameter(s);
-      fc->AddArg(arg);
+      arg = expression(s);
     }
   }
 
-  Consume(tRBrak);
+  if (!Consume(tRBrak)) return NULL;
 
-  n = new CAstStatCall(idToken, fc);
-  return n;
+  return new CAstStatCall(idToken, fc);
 }
 
-CAstExpression* CParser::parameter(CAstScope* s)
+CAstExpression* CParser::parameter(CAstExpression *arg)
 {
   //
-  // this function is for subroutineCall's parameter
   // though parameter is same as expression, we need to put opAddress for array parameter
   //
-  CAstExpression* arg = expression(s);
-  CAstDesignator* dsn = dynamic_cast<CAstDesignator*>(arg);
-  if (dsn != NULL) {
+  if ((arg != NULL) && ((arg->GetKind() == akDesignator) ||
+                         (arg->GetKind() == akArrayDesignator))) {
+    CAstDesignator *dsn = static_cast<CAstDesignator*>(arg);
     if (dsn->GetType() == NULL) return arg;
     if (dsn->GetType()->IsArray()) { // if expression's type is array, wrap it with opAddress
       CToken defaultToken;
@@ -314,165 +828,249 @@ CAstExpression* CParser::parameter(CAstScope* s)
   return arg;
 }
 
-CAstExpression* CParser::expression(CAstScope* s)
-{
-  //
-  // expression ::= simpleexpr [ relOp simpleexpression ].
-  //
-  CToken t;
-  EOperation relop;
-  CAstExpression *left = NULL, *right = NULL;
-
-  left = simpleexpr(s);
-
-  if (_scanner->Peek().GetType() == tRelOp) {
-    Consume(tRelOp, &t);
-    right = simpleexpr(s);
-
-    if (t.GetValue() == "=")       relop = opEqual;
-    else if (t.GetValue() == "#")  relop = opNotEqual;
-    else if (t.GetValue() == "<")  relop = opLessThan;
-    else if (t.GetValue() == "<=")  relop = opLessEqual;
-    else if (t.GetValue() == ">")  relop = opBiggerThan;
-    else if (t.GetValue() == ">=")  relop = opBiggerEqual;
-    else SetError(t, "invalid relation."); // Normally, this should not happen
-
-    return new CAstBinaryOp(t, relop, left, right);
-  } else {
-    return left;
-  }
-}
-
-CAstExpression* CParser::simpleexpr(CAstScope *s)
+void CParser::Reduce(size_t nops, EExprOp kind)
 {
-  //
-  // simpleexpr ::= ["+" | "-"] term { termOp term }.
-  //
-  CAstExpression *n = NULL;
-  if (_scanner->Peek().GetType() == tTermOp) { // FIRST(term) does not have tTermOp
-    if (_scanner->Peek().GetValue() == "||") { // FIRST(term) does not have "||" operator
-      SetError(_scanner->Peek(), "'+' or '-' expected");
-      return n;
-    }
-    CToken t;
-    Consume(tTermOp, &t);
-    n = term(s);
-    CAstConstant* constant = dynamic_cast<CAstConstant*>(n);
-    if (constant != NULL && constant->GetType()->Match(CTypeManager::Get()->GetInt())) {
-      if (t.GetValue() == "-") constant->SetValue(-(constant->GetValue()));
+  // the sign applies to the whole first term of a simple expression and
+  // thus binds like a term operator
+  int prec = kind == eoSign ? eoTerm : kind;
+
+  while (_ops.size() > nops) {
+    const CExprOp &op = _ops.back();
+    if ((op.kind == eoSign ? eoTerm : op.kind) < prec) break;
+
+    CAstExpression *n = _vals.back();
+    _vals.pop_back();
+
+    if (op.kind == eoSign) {
+      CAstConstant* constant = (n != NULL) && (n->GetKind() == akConstant) ?
+        static_cast<CAstConstant*>(n) : NULL;
+      if (constant != NULL && constant->GetType()->Match(CTypeManager::Get()->GetInt())) {
+        if (op.op == opNeg) constant->SetValue(-(constant->GetValue()));
+      } else {
+        n = new CAstUnaryOp(op.token, op.op, n); // wrap the term with unary operator
+      }
+    } else if (op.kind == eoNot) {
+      n = new CAstUnaryOp(op.token, op.op, n);
     } else {
-      n = new CAstUnaryOp(t, t.GetValue() == "+" ? opPos : opNeg, n ); // wrap the term with unary operator
+      n = new CAstBinaryOp(op.token, op.op, _vals.back(), n);
+      _vals.pop_back();
     }
-  } else {
-    n = term(s);
-  }
-
-  while (_scanner->Peek().GetType() == tTermOp) {
-    CToken t;
-    CAstExpression *l = n, *r;
-
-    Consume(tTermOp, &t);
 
-    r = term(s);
-
-    n = new CAstBinaryOp(t, t.GetValue() == "+" ? opAdd : t.GetValue() == "-" ? opSub : opOr, l, r);
+    _vals.push_back(n);
+    _ops.pop_back();
   }
-
-
-  return n;
 }
 
-CAstExpression* CParser::term(CAstScope *s)
+CAstExpression* CParser::expression(CAstScope* s)
 {
   //
+  // expression ::= simpleexpr [ relOp simpleexpr ].
+  // simpleexpr ::= ["+" | "-"] term { termOp term }.
   // term ::= factor { ("*"|"/"|"&&") factor }.
+  // factor ::= number | "(" expression ")" | number | boolean | character | string | "!" factor
+  // factor ::= qualident | subroutineCall
   //
-  CAstExpression *n = NULL;
+  // parsed by operator precedence with explicit operand and operator stacks.
+  // Parenthesized expressions, subroutine arguments, and array indices open
+  // a new frame instead of recursing, so neither the number of operands nor
+  // the nesting depth is limited by the native stack. A syntax error
+  // abandons the whole expression.
+  //
+  size_t base = _frames.size();
+  _frames.push_back(CExprFrame(efExpression, _ops.size(), _vals.size()));
 
-  n = factor(s);
+  bool start = true;                // at the start of a simple expression
+  CToken t;
 
-  EToken tt = _scanner->Peek().GetType();
+  while (!_panic) {
+    CAstExpression *n = NULL;
 
-  while (tt == tFactOp) {
-    CToken t;
-    CAstExpression *l = n, *r;
+    // simpleexpr ::= ["+" | "-"] ...
+    if (start && (PeekType() == tTermOp)) { // FIRST(term) does not have tTermOp
+      if (Peek().GetValue() == "||") { // FIRST(term) does not have "||" operator
+        SetError(Peek(), "'+' or '-' expected");
+        break;
+      }
+      Consume(tTermOp, &t);
+      _ops.push_back(CExprOp(eoSign, t.GetValue() == "+" ? opPos : opNeg, t));
+    }
+    start = false;
+
+    switch (PeekType()) {
+      // factor ::= number
+      case tNumber:
+        n = number();
+        break;
+
+      // factor ::= "(" expression ")"
+      case tLBrak:
+        Consume(tLBrak);
+        _frames.push_back(CExprFrame(efParen, _ops.size(), _vals.size()));
+        start = true;
+        continue;
+
+      // factor ::= boolean
+      case tBoolean:
+        n = boolean();
+        break;
+
+      // factor ::= char
+      case tChar:
+        n = character();
+        break;
+
+      // factor ::= string
+      case tString:
+        n = strConstant(s);
+        break;
+
+      // factor ::= "!" factor
+      case tCompl:
+        Consume(tCompl, &t);
+        _ops.push_back(CExprOp(eoNot, opNot, t));
+        continue;
+
+      // factor ::= qualident | subroutineCall
+      // qualident and subroutineCall starts with Identifier.
+      // Make lookahead to 2 for this case
+      case tId:
+        Consume(tId, &t);
+        if (PeekType() == tLBrak) {
+          const CSymProc *sb = subroutine(s, t);
+          if (sb == NULL) break;
+          CAstFunctionCall *fc = new CAstFunctionCall(t, sb);
+          Consume(tLBrak);
+          if (PeekType() != tRBrak) { // there can be no parameters
+            _frames.push_back(CExprFrame(efArgument, _ops.size(), _vals.size()));
+            _frames.back().call = fc;
+            start = true;
+            continue;
+          }
+          Consume(tRBrak);
+          n = fc;
+        } else {
+          const CSymbol *sb = variable(s, t);
+          if (_panic) break;
+          if (PeekType() == tLSBrak) {
+            Consume(tLSBrak);
+            _frames.push_back(CExprFrame(efIndex, _ops.size(), _vals.size()));
+            _frames.back().token = t;
+            _frames.back().symbol = sb;
+            start = true;
+            continue;
+          }
+          n = new CAstDesignator(t, sb);
+        }
+        break;
 
-    Consume(tFactOp, &t);
+      default:
+        SetError(Peek(), "factor expected.");
+        break;
+    }
 
-    r = factor(s);
+    if (_panic) break;
+
+    // an operand is complete: read the next operator or close the frames
+    // whose expression has ended
+    _vals.push_back(n);
+
+    while (!start && !_panic) {
+      CExprFrame *f = &_frames.back();
+
+      // "!" binds to the factor
+      Reduce(f->nops, eoNot);
+
+      EToken tt = PeekType();
+      if ((tt == tFactOp) || (tt == tTermOp) || ((tt == tRelOp) && !f->relop)) {
+        Consume(tt, &t);
+
+        const string &v = t.GetValue();
+        EExprOp kind;
+        EOperation op = opNop;
+
+        if (tt == tFactOp) {
+          kind = eoFact;
+          op = v == "*" ? opMul : v == "/" ? opDiv : opAnd;
+        } else if (tt == tTermOp) {
+          kind = eoTerm;
+          op = v == "+" ? opAdd : v == "-" ? opSub : opOr;
+        } else {
+          kind = eoRel;
+          if (v == "=")       op = opEqual;
+          else if (v == "#")  op = opNotEqual;
+          else if (v == "<")  op = opLessThan;
+          else if (v == "<=") op = opLessEqual;
+          else if (v == ">")  op = opBiggerThan;
+          else if (v == ">=") op = opBiggerEqual;
+          else SetError(t, "invalid relation."); // Normally, this should not happen
+          f->relop = true;
+          start = true;
+        }
 
-    n = new CAstBinaryOp(t, t.GetValue() == "*" ? opMul : t.GetValue() == "/" ? opDiv : opAnd , l, r);
+        Reduce(f->nops, kind);
+        _ops.push_back(CExprOp(kind, op, t));
+        break;
+      }
 
-    tt = _scanner->Peek().GetType();
-  }
+      // the expression of the frame has ended
+      Reduce(f->nops, eoNone);
+      assert(_vals.size() == f->nvals + 1);
 
-  return n;
-}
+      switch (f->kind) {
+        case efExpression:
+          n = _vals.back();
+          _vals.pop_back();
+          _frames.pop_back();
+          assert(_frames.size() == base);
+          return n;
 
-CAstExpression* CParser::factor(CAstScope *s)
-{
-  //
-  // factor ::= number | "(" expression ")" | number | boolean | character | string | "!" factor
-  // factor ::= qualident | subroutineCall
-  //
+        case efParen:
+          Consume(tRBrak);
+          break;
 
-  CToken t;
-  EToken tt = _scanner->Peek().GetType();
-  CAstExpression *unary = NULL, *n = NULL;
-
-  switch (tt) {
-    // factor ::= number
-    case tNumber:
-      n = number();
-      break;
-
-    // factor ::= "(" expression ")"
-    case tLBrak:
-      Consume(tLBrak);
-      n = expression(s);
-      Consume(tRBrak);
-      break;
-
-    // factor ::= boolean
-    case tBoolean:
-      n = boolean();
-      break;
-
-    // factor ::= char
-    case tChar:
-      n = character();
-      break;
-
-    // factor ::= string
-    case tString:
-      n = strConstant(s);
-      break;
-
-    // factor ::= "!" factor
-    case tCompl:
-      Consume(tCompl, &t);
-      n = new CAstUnaryOp(t, opNot, factor(s));
-      break;
-
-    // factor ::= qualident | subroutineCall
-    // qualident and subroutineCall starts with Identifier.
-    // Make lookahead to 2 for this case
-    case tId:
-      Consume(tId, &t);
-      if (_scanner->Peek().GetType() == tLBrak ) {
-        n = subroutineCall(s, t)->GetCall();
-      } else {
-        n = qualident(s, t);
+        case efArgument:
+          f->call->AddArg(parameter(_vals.back()));
+          _vals.pop_back();
+          if (PeekType() == tComma) {
+            Consume(tComma);
+            f->relop = false;
+            start = true;
+            continue;
+          }
+          Consume(tRBrak);
+          _vals.push_back(f->call);
+          break;
+
+        case efIndex:
+          Consume(tRSBrak);
+          // keep the index on the operand stack below the next one
+          f->nvals++;
+          f->nidx++;
+          if (PeekType() == tLSBrak) {
+            Consume(tLSBrak);
+            f->relop = false;
+            start = true;
+            continue;
+          }
+          {
+            vector<CAstExpression*> ev(_vals.end() - f->nidx, _vals.end());
+            _vals.resize(_vals.size() - f->nidx);
+            _vals.push_back(designator(f->token, f->symbol, ev));
+          }
+          break;
       }
-      break;
 
-    default:
-      cout << "got " << _scanner->Peek() << endl;
-      SetError(_scanner->Peek(), "factor expected.");
-      break;
+      // the frame's result is an operand of the enclosing frame
+      _frames.pop_back();
+    }
   }
 
-  return n;
+  // a syntax error: discard the partial expression
+  _ops.erase(_ops.begin() + _frames[base].nops, _ops.end());
+  _vals.erase(_vals.begin() + _frames[base].nvals, _vals.end());
+  _frames.erase(_frames.begin() + base, _frames.end());
+
+  return NULL;
 }
 
 CAstConstant* CParser::number(void)
@@ -489,7 +1087,7 @@ CAstConstant* CParser::number(void)
 
   errno = 0;
   long long v = strtoll(t.GetValue().c_str(), NULL, 10);
-  if (errno != 0) SetError(t, "invalid number.");
+  if (errno != 0) AddError(t, "invalid number.");
 
   return new CAstConstant(t, CTypeManager::Get()->GetInt(), v);
 }
@@ -508,7 +1106,7 @@ CAstConstant* CParser::boolean(void)
 
   errno = 0;
   bool v = t.GetValue() == "true";
-  if (errno != 0) SetError(t, "invalid boolean.");
+  if (errno != 0) AddError(t, "invalid boolean.");
 
   return new CAstConstant(t, CTypeManager::Get()->GetBool(), v);
 }
@@ -526,8 +1124,8 @@ CAstConstant* CParser::character(void)
   Consume(tChar, &t);
 
   errno = 0;
-  char v = CToken::unescape(t.GetValue()).c_str()[0]; // need to unescape before taking first character
-  if (errno != 0) SetError(t, "invalid character.");
+  char v = t.GetValue().c_str()[0];
+  if (errno != 0) AddError(t, "invalid character.");
 
   return new CAstConstant(t, CTypeManager::Get()->GetChar(), v);
 }
@@ -546,42 +1144,14 @@ CAstSpecialOp* CParser::strConstant(CAstScope *s)
 
   errno = 0;
   string v = t.GetValue();
-  if (errno != 0) SetError(t, "invalid string.");
-  CAstStringConstant* stringConstant = new CAstStringConstant(t, v, s);
+  if (errno != 0) AddError(t, "invalid string.");
+  // string constants of a module parsed by Parse() are registered later
+  CAstStringConstant* stringConstant =
+    new CAstStringConstant(t, v, _strings == NULL ? s : NULL);
+  if (_strings != NULL) _strings->push_back(stringConstant);
   return new CAstSpecialOp(t, opAddress, stringConstant); // wrap string by opAddress
 }
 
-CAstStatIf* CParser::ifStatement(CAstScope *s, bool isInLoop)
-{
-  //
-  // ifStatement ::= "if" "(" expression ")" "then" stateSequence [ "else" stateSequence ] "end"
-  //
-
-  CToken t;
-
-  CAstExpression* condition = NULL;
-  CAstStatement* ifBody = NULL;
-  CAstStatement* elseBody = NULL;
-
-  EToken tt;
-
-  Consume(tIf, &t);
-  Consume(tLBrak);
-  condition = expression(s);
-  Consume(tRBrak);
-  Consume(tThen);
-  ifBody = statSequence(s, isInLoop);
-
-  tt = _scanner->Peek().GetType();
-  if (tt == tElse){
-    Consume(tElse);
-    elseBody = statSequence(s, isInLoop);
-  }
-  Consume(tEnd);
-
-  return new CAstStatIf(t, condition, ifBody, elseBody);
-}
-
 CAstStatReturn* CParser::returnStatement(CAstScope *s)
 {
   //
@@ -594,36 +1164,15 @@ CAstStatReturn* CParser::returnStatement(CAstScope *s)
 
   Consume(tReturn, &t);
 
-  EToken tt = _scanner->Peek().GetType();
+  EToken tt = PeekType();
   if (!(tt == tElse || tt == tEnd || tt == tSemicolon)) { // FOLLOW(returnStatement) = {tElse, tEnd, tSemicolon}
     retval = expression(s);
+    if (retval == NULL) return NULL;
   }
 
   return new CAstStatReturn(t, s, retval);
 }
 
-CAstStatWhile* CParser::whileStatement(CAstScope *s)
-{
-  //
-  // whileStatement ::= "while" "(" expression ")" "do" statSequence "end"
-  //
-
-  CToken t;
-
-  CAstExpression* condition = NULL;
-  CAstStatement* body = NULL;
-
-  Consume(tWhile, &t);
-  Consume(tLBrak);
-  condition = expression(s);
-  Consume(tRBrak);
-  Consume(tDo);
-  body = statSequence(s, true);
-  Consume(tEnd);
-
-  return new CAstStatWhile(t, condition, body);
-}
-
 const CType* CParser::type()
 {
   //
@@ -632,27 +1181,29 @@ const CType* CParser::type()
   // type ::= basetype {"[" [number] "]"}
   //
   CToken t, bt;
-  Consume(tBaseType, &bt);
+  if (!Consume(tBaseType, &bt)) return NULL;
   const CType* n = NULL;
   if (bt.GetValue() == "char") n = CTypeManager::Get()->GetChar();
   else if (bt.GetValue() == "boolean") n = CTypeManager::Get()->GetBool();
   else if (bt.GetValue() == "integer") n = CTypeManager::Get()->GetInt();
   else SetError(bt, "invalid base type"); // Normally, this should not happen
   vector<long long> v;
-  while(_scanner->Peek().GetType() == tLSBrak) { // tLSBrak is only used in this case
+  while(!_panic && (PeekType() == tLSBrak)) { // tLSBrak is only used in this case
     Consume(tLSBrak);
-    if (_scanner->Peek().GetType() == tNumber) {
+    if (PeekType() == tNumber) {
       CAstConstant* c = number();
       if (c->GetValue() <= 0) {
-        SetError(c->GetToken(), "array dimension must be bigger than zero");
+        AddError(c->GetToken(), "array dimension must be bigger than zero");
       }
       v.push_back(c->GetValue());
+      CArena::Dispose(c);
     } else {
       v.push_back(CArrayType::OPEN); // if there is no number between square brackets, it is OPEN Dimension
     }
 
     Consume(tRSBrak);
   }
+  if (_panic) return NULL;
   for (int i = v.size() - 1; i >= 0; i--) {
     n = CTypeManager::Get()->GetArray((int) v[i], n); // make array type as linked list
   }
@@ -668,13 +1219,29 @@ void CParser::varDecl(CAstScope *s, bool asParam)
   Consume(tId, &t);
   vector<CToken> v;
   v.push_back(t);
-  while(_scanner->Peek().GetType() == tComma) {
+  while(!_panic && (PeekType() == tComma)) {
     Consume(tComma);
     Consume(tId, &t);
     v.push_back(t);
   }
   Consume(tColon);
   const CType* ct = type();
+  if (ct == NULL) return;
+
+  // if the type is array, check for the explicit dimension
+  if (!asParam && ct->IsArray()) {
+    const CType* type = ct;
+    while(type->IsArray()) {
+      const CArrayType* at = dynamic_cast<const CArrayType*>(type);
+      assert(at != NULL);
+      if (at->GetNElem() == CArrayType::OPEN) {
+        AddError(t, "array variable must have explicit dimension");
+        break;
+      }
+      type = at->GetInnerType();
+    }
+  }
+
   for (CToken it : v) {
     if (asParam) { // if varDecl is used for declaration of parameter
       if (ct->IsArray()) {
@@ -685,26 +1252,14 @@ void CParser::varDecl(CAstScope *s, bool asParam)
       CSymProc* procSymb = proc->GetSymbol();
       int paramIndex = procSymb->GetNParams();
       if (!(s->GetSymbolTable()->AddSymbol(new CSymParam(paramIndex, it.GetValue(), ct)))) { // add symbol as CSymParam
-        SetError(it, "Duplicated identifier in parameter"); // if AddSymbol fails, it means duplicated identifier
+        AddError(it, "Duplicated identifier in parameter"); // if AddSymbol fails, it means duplicated identifier
       }
       procSymb->AddParam(new CSymParam(paramIndex, it.GetValue(), ct));
 
     } else { // if varDecl is not used for declaration of parameter
-      // if the type is array, check for the explicit dimension
-      if (ct->IsArray()) {
-        const CType* type = ct;
-        while(type->IsArray()) {
-          const CArrayType* at = dynamic_cast<const CArrayType*>(type);
-          assert(at != NULL);
-          if (at->GetNElem() == CArrayType::OPEN) {
-            SetError(t, "array variable must have explicit dimension");
-          }
-          type = at->GetInnerType();
-        }
-      }
       CSymbol * sb = s->CreateVar(it.GetValue(), ct); // just create variable and add symbol
       if(!(s->GetSymbolTable()->AddSymbol(sb))) {
-        SetError(it, "Duplicated variable declaration"); // if AddSymbol fails, it means duplicated identifier
+        AddError(it, "Duplicated variable declaration"); // if AddSymbol fails, it means duplicated identifier
       }
     }
   }
@@ -719,7 +1274,7 @@ void CParser::varDeclSequence(CAstScope *s)
   // so, asParam is true
   //
   varDecl(s, true);
-  while (_scanner->Peek().GetType() == tSemicolon) {
+  while (!_panic && (PeekType() == tSemicolon)) {
     Consume(tSemicolon);
     varDecl(s, true);
   }
@@ -733,17 +1288,20 @@ void CParser::varDeclaration(CAstScope *s)
   // varDeclaration ::= [ "var" varDecl ";" { varDecl ";" } ]
   // varDeclaration is used for variables
   // so, asParam is false
+  // a malformed declaration is skipped up to its ';'
   //
 
-  if (_scanner->Peek().GetType() != tVar)
+  if (PeekType() != tVar)
     return;
   Consume(tVar);
-  varDecl(s, false);
-  Consume(tSemicolon);
-  while (_scanner->Peek().GetType() == tId) {
+  do {
     varDecl(s, false);
     Consume(tSemicolon);
-  }
+    if (_panic && Recover(TokenSet(tSemicolon) | TokenSet(tBegin),
+                          TokenSet(tProcedure) | TokenSet(tFunction))) {
+      if (PeekType() == tSemicolon) Consume(tSemicolon);
+    }
+  } while (!_panic && (PeekType() == tId));
 }
 
 CAstProcedure* CParser::subroutineDecl(CAstScope *s)
@@ -758,26 +1316,45 @@ CAstProcedure* CParser::subroutineDecl(CAstScope *s)
   // since variable other than subroutineDecl are used only in subroutineDecl,
   // we decided not to make functions of those variables
   //
+  // a malformed signature is skipped up to the body. The body of a
+  // subroutine without a name is skipped as well.
+  //
+  CAstProcedure *n = subroutineHead(s);
+
+  if (_panic && !Recover(TokenSet(tVar) | TokenSet(tBegin),
+                         TokenSet(tProcedure) | TokenSet(tFunction))) {
+    return n;
+  }
+
+  if (n != NULL) subroutineBody(n);
+  else skipBody();
+
+  return n;
+}
+
+CAstProcedure* CParser::subroutineHead(CAstScope *s)
+{
   CToken idToken;
   CAstProcedure* n;
   bool isProc;
-  if (_scanner->Peek().GetType() == tProcedure) {
+  if (PeekType() == tProcedure) {
     Consume(tProcedure);
     isProc = true;
-  } else if (_scanner->Peek().GetType() == tFunction) {
+  } else if (PeekType() == tFunction) {
     Consume(tFunction);
     isProc = false;
   } else {
-    SetError(_scanner->Peek(), "expected \"procedure\" or \"function\"");
+    SetError(Peek(), "expected \"procedure\" or \"function\"");
+    return NULL;
   }
-  Consume (tId, &idToken);
+  if (!Consume (tId, &idToken)) return NULL;
 
   CSymProc* symb = new CSymProc(idToken.GetValue(), CTypeManager::Get()->GetNull()); // first, we set type of procedure as NULL
   n = new CAstProcedure(idToken, idToken.GetValue(), s, symb);
 
-  if (_scanner->Peek().GetType() == tLBrak) {
+  if (PeekType() == tLBrak) {
     Consume(tLBrak);
-    if (_scanner->Peek().GetType() != tRBrak)
+    if (PeekType() != tRBrak)
       varDeclSequence(n);
     Consume(tRBrak);
   }
@@ -787,31 +1364,81 @@ CAstProcedure* CParser::subroutineDecl(CAstScope *s)
   } else {
     Consume(tColon);
     const CType* t = type();
-    if (!t->IsScalar()) {
-      SetError(idToken, "Return type should be scalar type");
+    if (t != NULL) {
+      if (!t->IsScalar()) {
+        AddError(idToken, "Return type should be scalar type");
+      }
+      n->GetSymbol()->SetReturnType(t); // we set return type here
     }
     Consume(tSemicolon);
-    n->GetSymbol()->SetReturnType(t); // we set return type here
   }
 
+  // a subroutine with a malformed signature is declared nevertheless so
+  // that calls to it can be resolved
   if(!(s->GetSymbolTable()->AddSymbol(n->GetSymbol()))) {
-    SetError(idToken, "Duplicated subroutine name");
+    AddError(idToken, "Duplicated subroutine name");
   }
 
+  return n;
+}
+
+void CParser::subroutineBody(CAstProcedure *n)
+{
   varDeclaration(n);
 
-  Consume(tBegin);
-  CAstStatement* body = statSequence(n, false);
-  n->SetStatementSequence(body);
+  if (Consume(tBegin)) {
+    n->SetStatementSequence(statSequence(n, false));
+  }
   Consume(tEnd);
 
   CToken idToken2;
-  Consume(tId, &idToken2);
-  if (idToken.GetValue() != idToken2.GetValue()) {
-    SetError(idToken2, "invalid end identifier");
+  if (Consume(tId, &idToken2) && (n->GetName() != idToken2.GetValue())) {
+    AddError(idToken2, "invalid end identifier");
   }
   Consume(tSemicolon);
-  return n;
+
+  // skip to the next subroutine or the module body after a syntax error
+  if (_panic) {
+    Recover(TokenSet(tProcedure) | TokenSet(tFunction) | TokenSet(tBegin));
+  }
+}
+
+void CParser::skipBody(void)
+{
+  // subroutineBody ::= varDeclaration "begin" statSequence "end" ident ";"
+  // 'begin', 'if', and 'while' are each closed by an 'end'
+  int depth = 0;
+
+  while (true) {
+    switch (PeekType()) {
+      case tBegin:
+      case tIf:
+      case tWhile:
+        depth++;
+        break;
+
+      case tEnd:
+        if (--depth <= 0) {
+          Get();
+          if (PeekType() == tId) Get();
+          if (PeekType() == tSemicolon) Get();
+          return;
+        }
+        break;
+
+      case tProcedure:
+      case tFunction:
+      case tModule:
+      case tEOF:
+      case tIOError:
+        return;
+
+      default:
+        break;
+    }
+
+    Get();
+  }
 }
 
 CAstDesignator* CParser::qualident(CAstScope *s, CToken idToken)
@@ -819,20 +1446,21 @@ CAstDesignator* CParser::qualident(CAstScope *s, CToken idToken)
   //
   // qualident ::= ident {"[" expression "]"}
   //
-
-  const CSymbol *sb = s->GetSymbolTable()->FindSymbol(idToken.GetValue());
-  if (sb == NULL) SetError(idToken, "undefined identifier");
-  // check if the qualident's identifier is procedure
-  if (dynamic_cast<const CSymProc*>(sb) != NULL) {
-    SetError(idToken, "Qualident should not be procedure type");
-  }
-  const CType *st = sb->GetDataType();
+  const CSymbol *sb = variable(s, idToken);
   vector<CAstExpression*> ev;
-  while (_scanner->Peek().GetType() == tLSBrak) {
+  while (!_panic && (PeekType() == tLSBrak)) {
     Consume(tLSBrak);
     ev.push_back(expression(s));
     Consume(tRSBrak);
   }
+  if (_panic) return NULL;
+
+  return designator(idToken, sb, ev);
+}
+
+CAstDesignator* CParser::designator(CToken idToken, const CSymbol *sb,
+                                    const vector<CAstExpression*> &ev)
+{
   if (ev.size() == 0) { // if there is no "[" and "]", return as AstDesignator
     return new CAstDesignator(idToken, sb);
   }
@@ -845,3 +1473,24 @@ CAstDesignator* CParser::qualident(CAstScope *s, CToken idToken)
   return n;
 }
 
+const CSymbol* CParser::variable(CAstScope *s, CToken idToken)
+{
+  const CSymbol *sb = FindSymbol(s, idToken.GetInternedValue());
+  if (sb == NULL) SetError(idToken, "undefined identifier");
+  // check if the qualident's identifier is procedure
+  else if (dynamic_cast<const CSymProc*>(sb) != NULL) {
+    SetError(idToken, "Qualident should not be procedure type");
+  }
+  return sb;
+}
+
+const CSymProc* CParser::subroutine(CAstScope *s, CToken idToken)
+{
+  const CSymbol *tsb = FindSymbol(s, idToken.GetInternedValue());
+  const CSymProc *sb = dynamic_cast<const CSymProc *>(tsb);
+  if (sb == NULL) { // symbol must be procedure type
+    SetError(idToken, "invalid symbol.");
+  }
+  return sb;
+}
+
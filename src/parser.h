@@ -36,10 +36,117 @@
 #ifndef __SnuPL_PARSER_H__
 #define __SnuPL_PARSER_H__
 
+#include <atomic>
+#include <map>
+#include <vector>
+
+#include "arena.h"
+#include "compilation.h"
 #include "scanner.h"
 #include "symtab.h"
 #include "ast.h"
 
+//------------------------------------------------------------------------------
+/// @brief kinds of operators on the expression parser's operator stack, in
+///        order of increasing precedence
+///
+enum EExprOp {
+  eoNone,                           ///< none (end of expression)
+  eoRel,                            ///< relational operator
+  eoTerm,                           ///< term operator (+, -, ||)
+  eoSign,                           ///< sign of a simple expression
+  eoFact,                           ///< factor operator (*, /, &&)
+  eoNot,                            ///< complement
+};
+
+//------------------------------------------------------------------------------
+/// @brief operator on the expression parser's operator stack
+///
+struct CExprOp {
+  CExprOp(EExprOp k, EOperation o, const CToken &t)
+    : kind(k), op(o), token(t) {};
+
+  EExprOp    kind;                  ///< kind of operator
+  EOperation op;                    ///< operation
+  CToken     token;                 ///< operator token
+};
+
+//------------------------------------------------------------------------------
+/// @brief kinds of frames on the expression parser's frame stack
+///
+enum EExprFrame {
+  efExpression,                     ///< the expression being parsed
+  efParen,                          ///< "(" expression ")"
+  efArgument,                       ///< argument of a subroutine call
+  efIndex,                          ///< array index
+};
+
+//------------------------------------------------------------------------------
+/// @brief frame on the expression parser's frame stack
+///
+/// a (sub)expression whose operators and operands are on top of the
+/// operator and operand stacks. The completed indices of an array
+/// designator stay on the operand stack below the frame.
+///
+struct CExprFrame {
+  CExprFrame(EExprFrame k, size_t o, size_t v)
+    : kind(k), nops(o), nvals(v), nidx(0), relop(false), symbol(NULL),
+      call(NULL) {};
+
+  EExprFrame kind;                  ///< kind of frame
+  size_t     nops;                  ///< operators below the frame
+  size_t     nvals;                 ///< operands below the frame
+  size_t     nidx;                  ///< completed indices of an array
+  bool       relop;                 ///< relational operator seen
+  CToken     token;                 ///< identifier of an array designator
+  const CSymbol *symbol;            ///< symbol of an array designator
+  CAstFunctionCall *call;           ///< subroutine call of an argument
+};
+
+//------------------------------------------------------------------------------
+/// @brief frame on the statement parser's stack
+///
+/// a statement sequence and the if or while statement it belongs to
+///
+struct CStatFrame {
+  CStatFrame(EToken k, const CToken &t, CAstExpression *c, bool l)
+    : kind(k), token(t), cond(c), inLoop(l) {};
+
+  /// @brief append a statement to the sequence
+  void Append(CAstStatement *st)
+  {
+    seq.push_back(st);
+  };
+
+  EToken     kind;                  ///< tBegin (outermost), tThen, tElse, tDo
+  CToken     token;                 ///< if/while token
+  CAstExpression *cond;             ///< condition
+  vector<CAstStatement*> body;      ///< if body (while parsing the else body)
+  vector<CAstStatement*> seq;       ///< statements of the sequence
+  bool       inLoop;                ///< sequence is in a loop
+};
+
+//------------------------------------------------------------------------------
+/// @brief subroutine body found by the skim pass of a parallel parse
+///
+struct CBodyPart {
+  CBodyPart(CAstProcedure *p, size_t f, size_t e)
+    : proc(p), first(f), end(e), parsed(~(size_t)0) {};
+
+  CAstProcedure *proc;              ///< subroutine (signature parsed)
+  size_t     first;                 ///< index of the first token of the body
+  size_t     end;                   ///< index following the body (or npos)
+  size_t     parsed;                ///< index following the parsed body
+  vector<CAstStringConstant*> strings; ///< unregistered string constants
+  vector<CSourceError> errors;      ///< parse errors
+  vector<CSourceError> type_errors; ///< type errors
+};
+
+//------------------------------------------------------------------------------
+/// @brief set of token types (bit @a t is set for token type @a t)
+///
+typedef unsigned long long TTokenSet;
+
 //------------------------------------------------------------------------------
 /// @brief parser
 ///
@@ -50,11 +157,82 @@ class CParser {
     /// @brief constructor
     ///
     /// @param scanner  CScanner from which the input stream is read
-    CParser(CScanner *scanner);
+    /// @param compilation compilation context of the module (NULL: the
+    ///        current context)
+    CParser(CScanner *scanner, CCompilation *compilation=NULL);
+
+    /// @brief constructor
+    ///
+    /// @param tokens pre-lexed tokens of the module (see CScanner::Tokenize)
+    /// @param compilation compilation context of the module (NULL: the
+    ///        current context)
+    CParser(CTokenBuffer *tokens, CCompilation *compilation=NULL);
 
     /// @brief parse a module
+    ///
+    /// when parsing from a token buffer with @a nthreads > 1, a skim pass
+    /// parses the module header and the subroutine signatures and skips the
+    /// subroutine bodies by matching their 'end' tokens. The bodies are then
+    /// parsed and type checked by a pool of @a nthreads threads. Symbols,
+    /// string constants, types, and the reported errors are the same as
+    /// those of a sequential parse; only the ids of the AST nodes differ.
+    /// The AST and the types are created in the parser's compilation
+    /// context, also by the worker threads.
+    /// A module whose header or signatures are malformed, or whose bodies
+    /// cannot be delimited, is parsed sequentially.
+    ///
+    /// Syntax errors do not stop the parse: the parser skips to the next
+    /// statement or declaration and continues. The module is type checked
+    /// even if it contains syntax errors. All errors are collected (see
+    /// GetErrors()); if there are any, no AST is returned.
+    ///
+    /// @param nthreads number of threads parsing subroutine bodies
     /// @retval CAstNode program node
-    CAstNode* Parse(void);
+    CAstNode* Parse(unsigned int nthreads=1);
+
+    /// @name incremental parsing
+    ///
+    /// parse the parts of a module (header, subroutines, body) separately
+    /// from a token buffer so that a subroutine can be re-parsed after an
+    /// edit (see CDocument). Each method parses from token @a pos, type
+    /// checks the part in the parser's compilation context, and reports its
+    /// errors through GetErrors() & co.
+    /// @{
+
+    /// @brief parse the module header and the global variable declarations
+    /// @param pos index of the first token
+    /// @param end (out) index of the token following the header
+    /// @retval CAstModule module node (also if the header has errors; the
+    ///         module name is then empty if it is missing)
+    CAstModule* ParseModuleHeader(size_t pos, size_t *end);
+
+    /// @brief parse and type check a subroutine declaration
+    /// @param m module scope the subroutine is declared in
+    /// @param pos index of the first token
+    /// @param end (out) index of the token following the subroutine
+    /// @retval CAstProcedure procedure node (also if an error occurred after
+    ///         the node was created; it is then registered with @a m) or NULL
+    CAstProcedure* ParseSubroutine(CAstModule *m, size_t pos, size_t *end);
+
+    /// @brief parse and type check the module body
+    /// @param m module scope
+    /// @param pos index of the first token
+    /// @retval true if the body was parsed and type checked without errors
+    /// @retval false otherwise
+    bool ParseModuleBody(CAstModule *m, size_t pos);
+
+    /// @brief restrict the subroutines visible to the part being parsed
+    ///
+    /// a subroutine is only visible after its declaration. The symbols of
+    /// the module's subroutines are mapped to their declaration indices; a
+    /// subroutine in @a order whose index is greater than @a current cannot
+    /// be called from the part.
+    ///
+    /// @param order declaration indices of the subroutines (or NULL)
+    /// @param current declaration index of the part being parsed
+    void SetOrder(const map<const CSymbol*, size_t> *order, size_t current);
+
+    /// @}
 
     /// @name error handling
     ///@{
@@ -62,24 +240,78 @@ class CParser {
     /// @brief indicates whether there was an error while parsing the source
     /// @retval true if the parser detected an error
     /// @retval false otherwise
-    bool HasError(void) const { return _abort; };
+    bool HasError(void) const { return !_errors.empty(); };
 
-    /// @brief returns the token that caused the error
+    /// @brief returns the token that caused the first error
     /// @retval CToken containing the error token
     const CToken* GetErrorToken(void) const;
 
-    /// @brief returns a human-readable error message
+    /// @brief returns a human-readable message of the first error
     /// @retval error message
     string GetErrorMessage(void) const;
+
+    /// @brief returns all errors (syntax and type errors) in source order
+    /// @retval vector of errors
+    const vector<CSourceError>& GetErrors(void) const { return _errors; };
     ///@}
 
   private:
-    /// @brief sets the token causing a parse error along with a message
+    /// @brief report a syntax error and enter panic mode
+    ///
+    /// in panic mode, no further errors are reported and Consume() fails
+    /// until Recover() finds a synchronizing token. An error at the token
+    /// of the previous error is not reported either unless Recover() has
+    /// skipped tokens since.
+    ///
     /// @param t token causing the error
     /// @param message human-readable error message
     void SetError(CToken t, const string message);
 
+    /// @brief report an error that does not disturb the parse (e.g., a
+    ///        duplicate declaration)
+    /// @param t token causing the error
+    /// @param message human-readable error message
+    void AddError(CToken t, const string message);
+
+    /// @brief order the errors by their source position; errors at the same
+    ///        position keep the order in which they were reported
+    void SortErrors(void);
+
+    /// @brief leave panic mode by skipping to a synchronizing token
+    ///
+    /// skips tokens until the next token is in @a sync or @a stop or the
+    /// end of the input has been reached. Panic mode ends only if a token
+    /// in @a sync has been found; a token in @a stop is left to an
+    /// enclosing construct to recover from.
+    ///
+    /// @param sync synchronizing tokens
+    /// @param stop tokens that end the construct being parsed
+    /// @retval true if a token in @a sync has been found
+    /// @retval false otherwise
+    bool Recover(TTokenSet sync, TTokenSet stop=0);
+
+    /// @brief return and remove the next token
+    /// @retval token token
+    CToken Get(void);
+
+    /// @brief peek at the @a k-th next token (without removing it)
+    ///
+    /// arbitrary lookahead is only supported when parsing from a token
+    /// buffer; the scanner supports k = 0 only
+    /// @param k lookahead (0 = next token)
+    /// @retval token token
+    CToken Peek(size_t k=0) const;
+
+    /// @brief peek at the type of the @a k-th next token
+    /// @param k lookahead (0 = next token)
+    /// @retval token type
+    EToken PeekType(size_t k=0) const;
+
     /// @brief consume a token given type and optionally store the token
+    ///
+    /// a token of another type is not consumed; it is reported as an error
+    /// unless the parser is in panic mode
+    ///
     /// @param type expected token type
     /// @param token If not null, the consumed token is stored in 'token'
     /// @retval true if a token has been consumed
@@ -91,6 +323,50 @@ class CParser {
     ///        global variables
     void InitSymbolTable(CSymtab *s);
 
+    /// @name parallel parsing
+    /// @{
+
+    /// @brief parse a module, parsing the subroutine bodies in parallel
+    /// @param nthreads number of threads
+    /// @retval true if the module has been parsed
+    /// @retval false if the module must be parsed sequentially
+    bool ParseParallel(unsigned int nthreads);
+
+    /// @brief parse and type check subroutine bodies until none are left
+    ///
+    /// run by each thread of a parallel parse
+    ///
+    /// @param bodies subroutine bodies
+    /// @param next index of the next body to parse
+    /// @param arena arena to allocate from (or NULL)
+    void ParseBodies(vector<CBodyPart> *bodies, atomic<size_t> *next,
+                     CArena *arena);
+
+    /// @brief parse and type check a subroutine body
+    /// @param body subroutine body
+    /// @param index index of the subroutine
+    /// @param n number of subroutines
+    void ParseBody(CBodyPart *body, size_t index, size_t n);
+
+    /// @brief find the end of a subroutine body by matching 'end' tokens
+    /// @param pos index of the first token of the body
+    /// @retval index of the token following the body, or npos if the body
+    ///         is malformed
+    size_t SkipBody(size_t pos) const;
+
+    /// @brief look up a symbol visible at the current position
+    ///
+    /// subroutines declared after the subroutine being parsed are not
+    /// visible (they are already in the module's symbol table during a
+    /// parallel parse)
+    ///
+    /// @param s scope
+    /// @param name identifier (interned, see CToken::GetInternedValue())
+    /// @retval CSymbol symbol or NULL
+    const CSymbol*    FindSymbol(CAstScope *s, const string *name) const;
+
+    /// @}
+
     /// @name methods for recursive-descent parsing
     /// @{
 
@@ -98,11 +374,29 @@ class CParser {
     /// @retval CAstModule module ast
     CAstModule*       module(void);
 
+    /// @brief make module ast node from the module header and the global
+    ///        variable declarations
+    /// @retval CAstModule module ast
+    CAstModule*       moduleHeader(void);
+
+    /// @brief parse the module body
+    /// @param m module scope
+    void              moduleBody(CAstModule *m);
+
+    /// @brief apply the operators on top of the operator stack that bind at
+    ///        least as tightly as an operator of kind @a kind
+    /// @param nops number of operators below the current frame
+    /// @param kind kind of the next operator (eoNone: reduce all)
+    void              Reduce(size_t nops, EExprOp kind);
+
     /// @brief make statement sequence ast node
+    ///
+    /// parses nested if and while statements with an explicit stack
+    ///
     /// @param CAstScope scope which ast node exists
     /// @param bool isInLoop whether the statement is in loop
-    /// @retval CAstStatement statement ast
-    CAstStatement*    statSequence(CAstScope *s, bool isInLoop);
+    /// @retval vector<CAstStatement*> statements of the sequence
+    vector<CAstStatement*> statSequence(CAstScope *s, bool isInLoop);
 
     /// @brief make assignment ast node
     /// @param CAstScope scope which ast node exists
@@ -116,31 +410,21 @@ class CParser {
     /// @retval CAstStatCall subroutine call ast
     CAstStatCall*     subroutineCall(CAstScope *s, CToken idToken);
 
-    /// @brief make parameter ast node with address operator on the array parameter
-    /// @param CAstScope scope which ast node exists
+    /// @brief wrap an array argument of a subroutine call with the address
+    ///        operator
+    /// @param arg argument expression
     /// @retval CAstExpression parameter ast
-    CAstExpression*   parameter(CAstScope* s);
+    CAstExpression*   parameter(CAstExpression *arg);
 
     /// @brief make expression ast node
+    ///
+    /// parses expressions, including nested subexpressions, subroutine
+    /// calls, and array designators, with explicit stacks (no recursion)
+    ///
     /// @param CAstScope scope which ast node exists
     /// @retval CAstExpression expression ast
     CAstExpression*   expression(CAstScope *s);
 
-    /// @brief make simple expression ast node
-    /// @param CAstScope scope which ast node exists
-    /// @retval CAstExpression simple expression ast
-    CAstExpression*   simpleexpr(CAstScope *s);
-
-    /// @brief make term ast node
-    /// @param CAstScope scope which ast node exists
-    /// @retval CAstExpression term ast
-    CAstExpression*   term(CAstScope *s);
-
-    /// @brief make factor ast node
-    /// @param CAstScope scope which ast node exists
-    /// @retval CAstExpression factor ast
-    CAstExpression*   factor(CAstScope *s);
-
     /// @brief convert number token to CAstConstant
     /// @param CAstScope scope which ast node exists
     /// @retval CAstConstant number ast
@@ -161,22 +445,11 @@ class CParser {
     /// @retval CAstSpecialOp opAddress on CAstStringConstant
     CAstSpecialOp* strConstant(CAstScope *s);
 
-    /// @brief make if statement ast node
-    /// @param CAstScope scope which ast node exists
-    /// @param bool isInLoop whether the statement is in loop
-    /// @retval CAstStatIf if statement ast
-    CAstStatIf* ifStatement(CAstScope *s, bool isInLoop);
-
     /// @brief make return statement ast node
     /// @param CAstScope scope which ast node exists
     /// @retval CAstStatReturn return statement ast
     CAstStatReturn* returnStatement(CAstScope *s);
 
-    /// @brief make while statement ast node
-    /// @param CAstScope scope which ast node exists
-    /// @retval CAstStatWhile while statement ast
-    CAstStatWhile* whileStatement(CAstScope *s);
-
     /// @brief make type from tokens
     /// @param CAstScope scope which ast node exists
     /// @retval CType type
@@ -200,23 +473,71 @@ class CParser {
     /// @retval CAstProcedure subroutine Declaration ast
     CAstProcedure*    subroutineDecl(CAstScope *s);
 
+    /// @brief make subroutine ast node from the signature and declare the
+    ///        subroutine in the scope
+    /// @param CAstScope scope which ast node exists
+    /// @retval CAstProcedure subroutine ast (without body)
+    CAstProcedure*    subroutineHead(CAstScope *s);
+
+    /// @brief parse the local variables and the body of a subroutine
+    /// @param n subroutine ast
+    void              subroutineBody(CAstProcedure *n);
+
+    /// @brief skip the body of a subroutine whose signature is malformed
+    void              skipBody(void);
+
     /// @brief make qualident ast node
     /// @param CAstScope scope which ast node exists
     /// @param token identifier token for qualident start
     /// @retval CAstDesignator qualident ast
     CAstDesignator*   qualident(CAstScope *s, CToken idToken);
+
+    /// @brief make designator ast node
+    /// @param token identifier token
+    /// @param sb symbol of the identifier
+    /// @param ev index expressions (empty for scalars)
+    /// @retval CAstDesignator (array) designator ast
+    CAstDesignator*   designator(CToken idToken, const CSymbol *sb,
+                                 const vector<CAstExpression*> &ev);
+
+    /// @brief look up a variable
+    /// @param CAstScope scope which ast node exists
+    /// @param token identifier token
+    /// @retval CSymbol symbol (not a subroutine)
+    const CSymbol*    variable(CAstScope *s, CToken idToken);
+
+    /// @brief look up a subroutine
+    /// @param CAstScope scope which ast node exists
+    /// @param token identifier token
+    /// @retval CSymProc subroutine symbol
+    const CSymProc*   subroutine(CAstScope *s, CToken idToken);
     /// @}
 
 
     CScanner     *_scanner;       ///< CScanner instance
+    CTokenBuffer *_tokens;        ///< pre-lexed tokens (instead of _scanner)
+    size_t        _pos;           ///< index of the next token in _tokens
     CAstModule   *_module;        ///< root node of the program
     CToken        _token;         ///< current token
 
+    /// @name expression parser stacks
+    vector<CExprFrame> _frames;   ///< open (sub)expressions
+    vector<CExprOp> _ops;         ///< operators
+    vector<CAstExpression*> _vals;///< operands
+
+    CCompilation *_compilation;   ///< compilation context
+
+    /// @name parallel parsing
+    const map<const CSymbol*, size_t> *_order; ///< subroutine indices
+    size_t        _current;       ///< index of the subroutine being parsed
+    vector<CAstStringConstant*> *_strings; ///< unregistered string constants
+
     /// @name error handling
-    CToken        _error_token;   ///< error token
-    string        _message;       ///< error message
-    bool          _abort;         ///< error flag
+    vector<CSourceError> _errors; ///< errors
+    bool          _panic;         ///< panic mode (skipping a syntax error)
+    unsigned int  _error_pos;     ///< position of the last reported error
 
+    static const size_t npos = ~(size_t)0; ///< no token index
 };
 
 #endif // __SnuPL_PARSER_H__
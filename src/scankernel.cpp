@@ -0,0 +1,319 @@
+//------------------------------------------------------------------------------
+/// @brief SnuPL scanner kernels
+/// @author Bernhard Egger <bernhard@csap.snu.ac.kr>
+/// @section changelog Change Log
+/// 2026/10/16 created: SIMD character run kernels
+///
+///
+/// @section license_section License
+/// Copyright (c) 2012-2016, Bernhard Egger
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms,  with or without modifi-
+/// cation, are permitted provided that the following conditions are met:
+///
+/// - Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+/// - Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,  BUT NOT LIMITED TO,  THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY  AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER  OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT,  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSE-
+/// QUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF  SUBSTITUTE
+/// GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+/// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN  CONTRACT, STRICT
+/// LIABILITY, OR TORT  (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY
+/// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+/// DAMAGE.
+//------------------------------------------------------------------------------
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SCAN_X86
+#include <immintrin.h>
+#endif
+
+#include "scankernel.h"
+using namespace std;
+
+//------------------------------------------------------------------------------
+// scalar kernels
+//
+static inline bool IsWhite(char c)
+{
+  return (c == ' ') || (c == '\t') || (c == '\n');
+}
+
+static inline bool IsDigit(char c)
+{
+  return (c >= '0') && (c <= '9');
+}
+
+static inline bool IsIdent(char c)
+{
+  return ((c >= 'a') && (c <= 'z')) || ((c >= 'A') && (c <= 'Z')) ||
+         (c == '_') || IsDigit(c);
+}
+
+static const char* SkipWhiteScalar(const char *p, const char *end)
+{
+  while ((p < end) && IsWhite(*p)) p++;
+  return p;
+}
+
+static const char* FindEOLScalar(const char *p, const char *end)
+{
+  while ((p < end) && (*p != '\n')) p++;
+  return p;
+}
+
+static const char* SkipIdentScalar(const char *p, const char *end)
+{
+  while ((p < end) && IsIdent(*p)) p++;
+  return p;
+}
+
+static const char* SkipDigitsScalar(const char *p, const char *end)
+{
+  while ((p < end) && IsDigit(*p)) p++;
+  return p;
+}
+
+
+#ifdef SCAN_X86
+//------------------------------------------------------------------------------
+// SIMD kernels
+//
+// each stride computes a bit mask of the characters that belong to the run;
+// the run ends at the first zero bit. Characters >= 0x80 are negative in the
+// signed byte compares and thus never part of a range.
+//
+#define SSE2_TARGET __attribute__((target("sse2")))
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+SSE2_TARGET
+static const char* SkipWhiteSSE2(const char *p, const char *end)
+{
+  const __m128i sp = _mm_set1_epi8(' '), tab = _mm_set1_epi8('\t'),
+                lf = _mm_set1_epi8('\n');
+
+  while (end - p >= 16) {
+    __m128i v = _mm_loadu_si128((const __m128i*)p);
+    unsigned int white = _mm_movemask_epi8(
+      _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, sp), _mm_cmpeq_epi8(v, tab)),
+                   _mm_cmpeq_epi8(v, lf)));
+
+    if (white != 0xffff) return p + __builtin_ctz(~white);
+    p += 16;
+  }
+
+  return SkipWhiteScalar(p, end);
+}
+
+SSE2_TARGET
+static const char* FindEOLSSE2(const char *p, const char *end)
+{
+  const __m128i lf = _mm_set1_epi8('\n');
+
+  while (end - p >= 16) {
+    __m128i v = _mm_loadu_si128((const __m128i*)p);
+    unsigned int nl = _mm_movemask_epi8(_mm_cmpeq_epi8(v, lf));
+    if (nl != 0) return p + __builtin_ctz(nl);
+    p += 16;
+  }
+
+  return FindEOLScalar(p, end);
+}
+
+SSE2_TARGET
+static inline __m128i InRangeSSE2(__m128i v, char lo, char hi)
+{
+  return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(lo - 1)),
+                       _mm_cmplt_epi8(v, _mm_set1_epi8(hi + 1)));
+}
+
+SSE2_TARGET
+static const char* SkipIdentSSE2(const char *p, const char *end)
+{
+  const __m128i lower = _mm_set1_epi8(0x20);
+
+  while (end - p >= 16) {
+    __m128i v = _mm_loadu_si128((const __m128i*)p);
+    __m128i m = _mm_or_si128(
+      _mm_or_si128(InRangeSSE2(_mm_or_si128(v, lower), 'a', 'z'),
+                   InRangeSSE2(v, '0', '9')),
+      _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+    unsigned int ident = _mm_movemask_epi8(m);
+
+    if (ident != 0xffff) return p + __builtin_ctz(~ident);
+    p += 16;
+  }
+
+  return SkipIdentScalar(p, end);
+}
+
+SSE2_TARGET
+static const char* SkipDigitsSSE2(const char *p, const char *end)
+{
+  while (end - p >= 16) {
+    __m128i v = _mm_loadu_si128((const __m128i*)p);
+    unsigned int digit = _mm_movemask_epi8(InRangeSSE2(v, '0', '9'));
+
+    if (digit != 0xffff) return p + __builtin_ctz(~digit);
+    p += 16;
+  }
+
+  return SkipDigitsScalar(p, end);
+}
+
+AVX2_TARGET
+static const char* SkipWhiteAVX2(const char *p, const char *end)
+{
+  const __m256i sp = _mm256_set1_epi8(' '), tab = _mm256_set1_epi8('\t'),
+                lf = _mm256_set1_epi8('\n');
+
+  while (end - p >= 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)p);
+    unsigned int white = _mm256_movemask_epi8(
+      _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, sp),
+                                      _mm256_cmpeq_epi8(v, tab)),
+                      _mm256_cmpeq_epi8(v, lf)));
+
+    if (white != 0xffffffff) return p + __builtin_ctz(~white);
+    p += 32;
+  }
+
+  return SkipWhiteSSE2(p, end);
+}
+
+AVX2_TARGET
+static const char* FindEOLAVX2(const char *p, const char *end)
+{
+  const __m256i lf = _mm256_set1_epi8('\n');
+
+  while (end - p >= 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)p);
+    unsigned int nl = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, lf));
+    if (nl != 0) return p + __builtin_ctz(nl);
+    p += 32;
+  }
+
+  return FindEOLSSE2(p, end);
+}
+
+AVX2_TARGET
+static inline __m256i InRangeAVX2(__m256i v, char lo, char hi)
+{
+  return _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8(lo - 1)),
+                          _mm256_cmpgt_epi8(_mm256_set1_epi8(hi + 1), v));
+}
+
+AVX2_TARGET
+static const char* SkipIdentAVX2(const char *p, const char *end)
+{
+  const __m256i lower = _mm256_set1_epi8(0x20);
+
+  while (end - p >= 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)p);
+    __m256i m = _mm256_or_si256(
+      _mm256_or_si256(InRangeAVX2(_mm256_or_si256(v, lower), 'a', 'z'),
+                      InRangeAVX2(v, '0', '9')),
+      _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+    unsigned int ident = _mm256_movemask_epi8(m);
+
+    if (ident != 0xffffffff) return p + __builtin_ctz(~ident);
+    p += 32;
+  }
+
+  return SkipIdentSSE2(p, end);
+}
+
+AVX2_TARGET
+static const char* SkipDigitsAVX2(const char *p, const char *end)
+{
+  while (end - p >= 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)p);
+    unsigned int digit = _mm256_movemask_epi8(InRangeAVX2(v, '0', '9'));
+
+    if (digit != 0xffffffff) return p + __builtin_ctz(~digit);
+    p += 32;
+  }
+
+  return SkipDigitsSSE2(p, end);
+}
+#endif // SCAN_X86
+
+
+//------------------------------------------------------------------------------
+// CScanKernels
+//
+EScanISA CScanKernels::_isa = isaScalar;
+const char* (*CScanKernels::_skip_white)(const char*, const char*) =
+  SkipWhiteScalar;
+const char* (*CScanKernels::_find_eol)(const char*, const char*) =
+  FindEOLScalar;
+const char* (*CScanKernels::_skip_ident)(const char*, const char*) =
+  SkipIdentScalar;
+const char* (*CScanKernels::_skip_digits)(const char*, const char*) =
+  SkipDigitsScalar;
+
+/// select the best kernels before main() runs
+static bool kernels_selected =
+  CScanKernels::SetISA(CScanKernels::GetBestISA());
+
+EScanISA CScanKernels::GetBestISA(void)
+{
+#ifdef SCAN_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return isaAVX2;
+  if (__builtin_cpu_supports("sse2")) return isaSSE2;
+#endif
+  return isaScalar;
+}
+
+bool CScanKernels::SetISA(EScanISA isa)
+{
+  if (isa > GetBestISA()) return false;
+
+  switch (isa) {
+#ifdef SCAN_X86
+    case isaAVX2:
+      _skip_white = SkipWhiteAVX2;
+      _find_eol = FindEOLAVX2;
+      _skip_ident = SkipIdentAVX2;
+      _skip_digits = SkipDigitsAVX2;
+      break;
+
+    case isaSSE2:
+      _skip_white = SkipWhiteSSE2;
+      _find_eol = FindEOLSSE2;
+      _skip_ident = SkipIdentSSE2;
+      _skip_digits = SkipDigitsSSE2;
+      break;
+#endif
+
+    default:
+      _skip_white = SkipWhiteScalar;
+      _find_eol = FindEOLScalar;
+      _skip_ident = SkipIdentScalar;
+      _skip_digits = SkipDigitsScalar;
+      break;
+  }
+
+  _isa = isa;
+  return true;
+}
+
+const char* CScanKernels::GetISAName(EScanISA isa)
+{
+  switch (isa) {
+    case isaSSE2: return "sse2";
+    case isaAVX2: return "avx2";
+    default:      return "scalar";
+  }
+}
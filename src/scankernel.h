@@ -0,0 +1,128 @@
+//------------------------------------------------------------------------------
+/// @brief SnuPL scanner kernels
+/// @author Bernhard Egger <bernhard@csap.snu.ac.kr>
+/// @section changelog Change Log
+/// 2026/10/16 created: SIMD character run kernels
+///
+///
+/// @section license_section License
+/// Copyright (c) 2012-2016, Bernhard Egger
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms,  with or without modifi-
+/// cation, are permitted provided that the following conditions are met:
+///
+/// - Redistributions of source code must retain the above copyright notice,
+///   this list of conditions and the following disclaimer.
+/// - Redistributions in binary form must reproduce the above copyright notice,
+///   this list of conditions and the following disclaimer in the documentation
+///   and/or other materials provided with the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,  BUT NOT LIMITED TO,  THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY  AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER  OR CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT,  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSE-
+/// QUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF  SUBSTITUTE
+/// GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+/// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN  CONTRACT, STRICT
+/// LIABILITY, OR TORT  (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY
+/// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+/// DAMAGE.
+//------------------------------------------------------------------------------
+
+#ifndef __SnuPL_SCANKERNEL_H__
+#define __SnuPL_SCANKERNEL_H__
+
+//------------------------------------------------------------------------------
+/// @brief instruction set used by the scanner kernels
+///
+enum EScanISA {
+  isaScalar = 0,                    ///< portable fallback
+  isaSSE2,                          ///< 16-byte strides
+  isaAVX2,                          ///< 32-byte strides
+};
+
+
+//------------------------------------------------------------------------------
+/// @brief character run kernels
+///
+/// the kernels skip runs of characters in a source buffer in 16/32 byte
+/// strides. The best instruction set supported by the CPU is selected at
+/// startup; all kernels fall back to a scalar loop for the last bytes of the
+/// buffer. A kernel never reads beyond @a end.
+///
+class CScanKernels {
+  public:
+    /// @name instruction set selection
+    /// @{
+
+    /// @brief return the best instruction set supported by the CPU
+    static EScanISA GetBestISA(void);
+
+    /// @brief return the instruction set currently in use
+    static EScanISA GetISA(void) { return _isa; };
+
+    /// @brief select the instruction set
+    ///
+    /// @param isa instruction set
+    /// @retval true if @a isa is supported and has been selected
+    /// @retval false otherwise (the selection remains unchanged)
+    static bool SetISA(EScanISA isa);
+
+    /// @brief return the name of an instruction set
+    static const char* GetISAName(EScanISA isa);
+
+    /// @}
+
+    /// @name kernels
+    /// @{
+
+    /// @brief skip a run of white space (' ', '\t', '\n')
+    ///
+    /// @param p first character
+    /// @param end end of buffer
+    /// @retval first non-white character or @a end
+    static const char* SkipWhite(const char *p, const char *end)
+    { return _skip_white(p, end); };
+
+    /// @brief find the end of the line
+    ///
+    /// @param p first character
+    /// @param end end of buffer
+    /// @retval first newline character or @a end
+    static const char* FindEOL(const char *p, const char *end)
+    { return _find_eol(p, end); };
+
+    /// @brief skip a run of letters, digits and underscores
+    ///
+    /// @param p first character
+    /// @param end end of buffer
+    /// @retval first character not part of the identifier or @a end
+    static const char* SkipIdent(const char *p, const char *end)
+    { return _skip_ident(p, end); };
+
+    /// @brief skip a run of digits
+    ///
+    /// @param p first character
+    /// @param end end of buffer
+    /// @retval first non-digit or @a end
+    static const char* SkipDigits(const char *p, const char *end)
+    { return _skip_digits(p, end); };
+
+    /// @}
+
+  private:
+    static EScanISA _isa;           ///< selected instruction set
+    static const char* (*_skip_white)(const char*, const char*);
+                                    ///< white space kernel
+    static const char* (*_find_eol)(const char*, const char*);
+                                    ///< end of line kernel
+    static const char* (*_skip_ident)(const char*, const char*);
+                                    ///< identifier kernel
+    static const char* (*_skip_digits)(const char*, const char*);
+                                    ///< number kernel
+};
+
+
+#endif // __SnuPL_SCANKERNEL_H__
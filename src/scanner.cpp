@@ -40,8 +40,16 @@
 #include <cstring>
 #include <cassert>
 #include <cstdio>
+#include <algorithm>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "scanner.h"
+#include "scankernel.h"
 using namespace std;
 
 //------------------------------------------------------------------------------
@@ -140,10 +148,469 @@ char ETokenStr[][TOKEN_STRLEN] = {
 //------------------------------------------------------------------------------
 // reserved keywords
 //
-pair<const char*, EToken> Keywords[] =
+constexpr pair<const char*, EToken> Keywords[] =
 {
+  { "module",    tModule    },
+  { "begin",     tBegin     },
+  { "end",       tEnd       },
+  { "true",      tBoolean   },
+  { "false",     tBoolean   },
+  { "char",      tBaseType  },
+  { "boolean",   tBaseType  },
+  { "integer",   tBaseType  },
+  { "if",        tIf        },
+  { "then",      tThen      },
+  { "else",      tElse      },
+  { "while",     tWhile     },
+  { "do",        tDo        },
+  { "return",    tReturn    },
+  { "var",       tVar       },
+  { "procedure", tProcedure },
+  { "function",  tFunction  },
+  { "break",     tBreak     },
 };
 
+#define NUM_KEYWORDS (int)(sizeof(Keywords) / sizeof(Keywords[0]))
+#define KEYWORD_SLOTS 32
+
+
+//------------------------------------------------------------------------------
+// scanner automaton
+//
+// The scanner core is a DFA over character classes. The character class
+// table, the transition table, the accepting tokens and the keyword hash
+// table are all generated at compile time from the constexpr functions below.
+//
+
+/// @brief character classes
+enum ECharClass {
+  ccOther = 0,                      ///< any other character (incl. EOF)
+  ccWhite,                          ///< ' ', '\t', '\n'
+  ccLetter,                         ///< 'a'-'z', 'A'-'Z', '_'
+  ccDigit,                          ///< '0'-'9'
+  ccPlusMinus,                      ///< '+', '-'
+  ccPipe,                           ///< '|'
+  ccAmp,                            ///< '&'
+  ccStar,                           ///< '*'
+  ccSlash,                          ///< '/'
+  ccColon,                          ///< ':'
+  ccEqual,                          ///< '='
+  ccLessGreater,                    ///< '<', '>'
+  ccHash,                           ///< '#'
+  ccSemicolon,                      ///< ';'
+  ccDot,                            ///< '.'
+  ccComma,                          ///< ','
+  ccLBrak,                          ///< '('
+  ccRBrak,                          ///< ')'
+  ccLSBrak,                         ///< '['
+  ccRSBrak,                         ///< ']'
+  ccBang,                           ///< '!'
+  ccDQuote,                         ///< '"'
+  ccSQuote,                         ///< '\''
+  ccNumClasses
+};
+
+/// @brief automaton states
+///
+/// only the states up to sLastOpen have outgoing transitions. sComment,
+/// sString, sChar and sInvalid trigger special actions in ScanToken().
+enum EState {
+  sStart = 0,                       ///< initial state
+  sIdent,                           ///< identifier or keyword
+  sNumber,                          ///< number
+  sPipe,                            ///< '|'
+  sAmp,                             ///< '&'
+  sSlash,                           ///< '/'
+  sColon,                           ///< ':'
+  sLessGreater,                     ///< '<' or '>'
+  sLastOpen = sLessGreater,
+
+  sTermOp,                          ///< '+', '-', '||'
+  sFactOp,                          ///< '*', '&&'
+  sRelOp,                           ///< '=', '#', '<=', '>='
+  sAssign,                          ///< ':='
+  sSemicolon,                       ///< ';'
+  sDot,                             ///< '.'
+  sComma,                           ///< ','
+  sLBrak,                           ///< '('
+  sRBrak,                           ///< ')'
+  sLSBrak,                          ///< '['
+  sRSBrak,                          ///< ']'
+  sCompl,                           ///< '!'
+  sComment,                         ///< '//'
+  sString,                          ///< '"'
+  sChar,                            ///< '\''
+  sInvalid,                         ///< invalid character
+  sError,                           ///< no transition
+  sNumStates
+};
+
+/// @brief character class of character @a c
+constexpr ECharClass MakeCharClass(int c)
+{
+  return ((c >= 'a') && (c <= 'z')) || ((c >= 'A') && (c <= 'Z')) ||
+           (c == '_')                   ? ccLetter :
+         (c >= '0') && (c <= '9')       ? ccDigit :
+         (c == ' ') || (c == '\t') ||
+           (c == '\n')                  ? ccWhite :
+         (c == '+') || (c == '-')       ? ccPlusMinus :
+         (c == '|')                     ? ccPipe :
+         (c == '&')                     ? ccAmp :
+         (c == '*')                     ? ccStar :
+         (c == '/')                     ? ccSlash :
+         (c == ':')                     ? ccColon :
+         (c == '=')                     ? ccEqual :
+         (c == '<') || (c == '>')       ? ccLessGreater :
+         (c == '#')                     ? ccHash :
+         (c == ';')                     ? ccSemicolon :
+         (c == '.')                     ? ccDot :
+         (c == ',')                     ? ccComma :
+         (c == '(')                     ? ccLBrak :
+         (c == ')')                     ? ccRBrak :
+         (c == '[')                     ? ccLSBrak :
+         (c == ']')                     ? ccRSBrak :
+         (c == '!')                     ? ccBang :
+         (c == '"')                     ? ccDQuote :
+         (c == '\'')                    ? ccSQuote :
+                                          ccOther;
+}
+
+/// @brief state reached from the initial state on character class @a cc
+constexpr EState MakeStartTransition(int cc)
+{
+  return cc == ccLetter      ? sIdent :
+         cc == ccDigit       ? sNumber :
+         cc == ccPlusMinus   ? sTermOp :
+         cc == ccPipe        ? sPipe :
+         cc == ccAmp         ? sAmp :
+         cc == ccStar        ? sFactOp :
+         cc == ccSlash       ? sSlash :
+         cc == ccColon       ? sColon :
+         cc == ccEqual       ? sRelOp :
+         cc == ccLessGreater ? sLessGreater :
+         cc == ccHash        ? sRelOp :
+         cc == ccSemicolon   ? sSemicolon :
+         cc == ccDot         ? sDot :
+         cc == ccComma       ? sComma :
+         cc == ccLBrak       ? sLBrak :
+         cc == ccRBrak       ? sRBrak :
+         cc == ccLSBrak      ? sLSBrak :
+         cc == ccRSBrak      ? sRSBrak :
+         cc == ccBang        ? sCompl :
+         cc == ccDQuote      ? sString :
+         cc == ccSQuote      ? sChar :
+                               sInvalid;
+}
+
+/// @brief state reached from state @a s on character class @a cc
+constexpr EState MakeTransition(int s, int cc)
+{
+  return s == sStart       ? MakeStartTransition(cc) :
+         s == sIdent       ? ((cc == ccLetter) || (cc == ccDigit) ? sIdent
+                                                                  : sError) :
+         s == sNumber      ? (cc == ccDigit ? sNumber : sError) :
+         s == sPipe        ? (cc == ccPipe  ? sTermOp : sError) :
+         s == sAmp         ? (cc == ccAmp   ? sFactOp : sError) :
+         s == sSlash       ? (cc == ccSlash ? sComment : sError) :
+         s == sColon       ? (cc == ccEqual ? sAssign : sError) :
+         s == sLessGreater ? (cc == ccEqual ? sRelOp : sError) :
+                             sError;
+}
+
+/// @brief token accepted in state @a s
+///
+/// a lone '|' or '&' is accepted as tUndefined with the character as value
+constexpr EToken MakeAccept(int s)
+{
+  return s == sIdent       ? tId :
+         s == sNumber      ? tNumber :
+         s == sTermOp      ? tTermOp :
+         s == sSlash       ? tFactOp :
+         s == sFactOp      ? tFactOp :
+         s == sColon       ? tColon :
+         s == sAssign      ? tAssign :
+         s == sLessGreater ? tRelOp :
+         s == sRelOp       ? tRelOp :
+         s == sSemicolon   ? tSemicolon :
+         s == sDot         ? tDot :
+         s == sComma       ? tComma :
+         s == sLBrak       ? tLBrak :
+         s == sRBrak       ? tRBrak :
+         s == sLSBrak      ? tLSBrak :
+         s == sRSBrak      ? tRSBrak :
+         s == sCompl       ? tCompl :
+                             tUndefined;
+}
+
+/// @brief length of a NUL-terminated string
+constexpr size_t KeywordLength(const char *s)
+{
+  return *s == '\0' ? 0 : 1 + KeywordLength(s + 1);
+}
+
+/// @brief keyword hash function
+///
+/// perfect for the reserved keywords (see the static_assert below)
+constexpr unsigned int KeywordHash(const char *s, size_t len)
+{
+  return (2*len + (unsigned char)s[0] + 7*(unsigned char)s[len-1])
+         % KEYWORD_SLOTS;
+}
+
+/// @brief slot of the keyword hash table
+struct CKeywordSlot {
+  const char   *name;               ///< keyword ("" if the slot is empty)
+  unsigned int  length;             ///< length of the keyword
+  EToken        token;              ///< token of the keyword
+};
+
+/// @brief keyword (starting at index @a k) that hashes to slot @a slot
+constexpr CKeywordSlot MakeKeywordSlot(unsigned int slot, int k = 0)
+{
+  return k == NUM_KEYWORDS ? CKeywordSlot{ "", 0, tId } :
+         KeywordHash(Keywords[k].first,
+                     KeywordLength(Keywords[k].first)) == slot
+           ? CKeywordSlot{ Keywords[k].first,
+                           (unsigned int)KeywordLength(Keywords[k].first),
+                           Keywords[k].second }
+           : MakeKeywordSlot(slot, k + 1);
+}
+
+/// @brief number of keywords that map to a distinct slot
+constexpr int CountKeywordSlots(unsigned int slot = 0)
+{
+  return slot == KEYWORD_SLOTS ? 0 :
+         (MakeKeywordSlot(slot).length > 0 ? 1 : 0) +
+           CountKeywordSlots(slot + 1);
+}
+
+static_assert(CountKeywordSlots() == NUM_KEYWORDS,
+              "keyword hash function is not perfect");
+
+/// @name compile-time table generation
+/// @{
+template<int... I> struct CIndexList {};
+template<int N, int... I> struct CMakeIndexList : CMakeIndexList<N-1, N-1, I...> {};
+template<int... I> struct CMakeIndexList<0, I...> {
+  typedef CIndexList<I...> type;
+};
+
+struct CCharClassTable { unsigned char cls[256]; };
+struct CTransitionTable { unsigned char next[sLastOpen+1][ccNumClasses]; };
+struct CAcceptTable { unsigned char token[sNumStates]; };
+struct CKeywordTable { CKeywordSlot slot[KEYWORD_SLOTS]; };
+
+template<int... I>
+constexpr CCharClassTable MakeCharClassTable(CIndexList<I...>)
+{
+  return CCharClassTable{ { (unsigned char)MakeCharClass(I)... } };
+}
+
+template<int... I>
+constexpr CTransitionTable MakeTransitionTable(CIndexList<I...>)
+{
+  return CTransitionTable{ {
+    (unsigned char)MakeTransition(I / ccNumClasses, I % ccNumClasses)... } };
+}
+
+template<int... I>
+constexpr CAcceptTable MakeAcceptTable(CIndexList<I...>)
+{
+  return CAcceptTable{ { (unsigned char)MakeAccept(I)... } };
+}
+
+template<int... I>
+constexpr CKeywordTable MakeKeywordTable(CIndexList<I...>)
+{
+  return CKeywordTable{ { MakeKeywordSlot(I)... } };
+}
+/// @}
+
+static constexpr CCharClassTable CharClasses =
+  MakeCharClassTable(CMakeIndexList<256>::type());
+static constexpr CTransitionTable Transitions =
+  MakeTransitionTable(CMakeIndexList<(sLastOpen+1)*ccNumClasses>::type());
+static constexpr CAcceptTable Accepts =
+  MakeAcceptTable(CMakeIndexList<sNumStates>::type());
+static constexpr CKeywordTable KeywordTable =
+  MakeKeywordTable(CMakeIndexList<KEYWORD_SLOTS>::type());
+
+/// @brief character class of @a c
+static inline int CharClass(char c)
+{
+  return CharClasses.cls[(unsigned char)c];
+}
+
+
+//------------------------------------------------------------------------------
+// CStringPool
+//
+CStringPool::CStringPool(void)
+  : _slot(1024, NULL), _count(0)
+{
+}
+
+CStringPool::~CStringPool(void)
+{
+  for (size_t i=0; i<_slot.size(); i++) delete _slot[i];
+}
+
+/// @brief string pool of the calling thread (NULL: default)
+static thread_local CStringPool *_current_pool = NULL;
+
+CStringPool* CStringPool::Get(void)
+{
+  static CStringPool _global_pool;
+
+  return _current_pool != NULL ? _current_pool : &_global_pool;
+}
+
+CStringPool* CStringPool::SetCurrent(CStringPool *pool)
+{
+  CStringPool *prev = _current_pool;
+
+  _current_pool = pool;
+
+  return prev;
+}
+
+/// @brief FNV-1a hash of a string
+static inline size_t HashString(const char *s, size_t len)
+{
+  size_t h = 2166136261u;
+  for (size_t i=0; i<len; i++) h = (h ^ (unsigned char)s[i]) * 16777619u;
+  return h;
+}
+
+const string* CStringPool::Intern(const char *s, size_t len)
+{
+  lock_guard<mutex> guard(_lock);
+
+  size_t mask = _slot.size() - 1;
+  size_t i = HashString(s, len) & mask;
+
+  while (_slot[i] != NULL) {
+    const string *str = _slot[i];
+    if ((str->size() == len) && (memcmp(str->data(), s, len) == 0)) return str;
+    i = (i + 1) & mask;
+  }
+
+  const string *str = new string(s, len);
+  _slot[i] = str;
+  if (++_count * 2 > _slot.size()) Grow();
+
+  return str;
+}
+
+void CStringPool::Grow(void)
+{
+  vector<const string*> slot(_slot.size() * 2, NULL);
+  size_t mask = slot.size() - 1;
+
+  for (size_t i=0; i<_slot.size(); i++) {
+    const string *str = _slot[i];
+    if (str == NULL) continue;
+
+    size_t j = HashString(str->data(), str->size()) & mask;
+    while (slot[j] != NULL) j = (j + 1) & mask;
+    slot[j] = str;
+  }
+
+  _slot.swap(slot);
+}
+
+
+//------------------------------------------------------------------------------
+// CLineTable
+//
+CLineTable::CLineTable(void)
+  : _data(NULL), _size(0)
+{
+  _start.push_back(0);
+}
+
+/// @brief line table of the calling thread (NULL: default)
+static thread_local CLineTable *_current_lines = NULL;
+
+CLineTable* CLineTable::Get(void)
+{
+  static CLineTable _global_lines;
+
+  return _current_lines != NULL ? _current_lines : &_global_lines;
+}
+
+CLineTable* CLineTable::SetCurrent(CLineTable *lines)
+{
+  CLineTable *prev = _current_lines;
+
+  _current_lines = lines;
+
+  return prev;
+}
+
+void CLineTable::Reset(void)
+{
+  lock_guard<mutex> guard(_lock);
+
+  _start.assign(1, 0);
+  _data = NULL;
+  _size = 0;
+}
+
+void CLineTable::SetSource(const char *data, size_t size)
+{
+  lock_guard<mutex> guard(_lock);
+
+  _start.assign(1, 0);
+  _data = data;
+  _size = size;
+}
+
+void CLineTable::Release(const char *data)
+{
+  lock_guard<mutex> guard(_lock);
+
+  if ((_data != NULL) && (_data == data)) Build();
+}
+
+void CLineTable::AddLine(unsigned int pos)
+{
+  lock_guard<mutex> guard(_lock);
+
+  _start.push_back(pos);
+}
+
+void CLineTable::GetPosition(unsigned int pos, int *line, int *charpos)
+{
+  lock_guard<mutex> guard(_lock);
+
+  if (_data != NULL) Build();
+
+  size_t l = upper_bound(_start.begin(), _start.end(), pos) - _start.begin();
+  *line = l;
+  *charpos = pos - _start[l-1] + 1;
+}
+
+void CLineTable::GetLineStarts(vector<unsigned int> *start)
+{
+  lock_guard<mutex> guard(_lock);
+
+  if (_data != NULL) Build();
+
+  *start = _start;
+}
+
+void CLineTable::Build(void)
+{
+  const char *p = _data, *end = _data + _size;
+
+  while ((p = (const char*)memchr(p, '\n', end - p)) != NULL) {
+    p++;
+    _start.push_back(p - _data);
+  }
+
+  _data = NULL;
+}
 
 
 //------------------------------------------------------------------------------
@@ -151,33 +618,34 @@ pair<const char*, EToken> Keywords[] =
 //
 CToken::CToken()
 {
+  // default tokens are created all the time and outside of any compilation;
+  // their empty value is not interned in a (per-compilation) pool
+  static const string empty;
+
   _type = tUndefined;
-  _value = "";
-  _line = _char = 0;
+  _pos = NOPOS;
+  _value = &empty;
 }
 
-CToken::CToken(int line, int charpos, EToken type, const string value)
+CToken::CToken(unsigned int pos, EToken type, const string &value)
 {
   _type = type;
-  _value = escape(value);
-  _line = line;
-  _char = charpos;
+  _pos = pos;
+  _value = CStringPool::Get()->Intern(value.c_str(), strlen(value.c_str()));
 }
 
 CToken::CToken(const CToken &token)
 {
-  _type = token.GetType();
-  _value = token.GetValue();
-  _line = token.GetLineNumber();
-  _char = token.GetCharPosition();
+  _type = token._type;
+  _pos = token._pos;
+  _value = token._value;
 }
 
 CToken::CToken(const CToken *token)
 {
-  _type = token->GetType();
-  _value = token->GetValue();
-  _line = token->GetLineNumber();
-  _char = token->GetCharPosition();
+  _type = token->_type;
+  _pos = token->_pos;
+  _value = token->_value;
 }
 
 const string CToken::Name(EToken type)
@@ -190,13 +658,32 @@ const string CToken::GetName(void) const
   return string(ETokenName[GetType()]);
 }
 
+int CToken::GetLineNumber(void) const
+{
+  int line = 0, charpos;
+
+  if (_pos != NOPOS) CLineTable::Get()->GetPosition(_pos, &line, &charpos);
+  return line;
+}
+
+int CToken::GetCharPosition(void) const
+{
+  int line, charpos = 0;
+
+  if (_pos != NOPOS) CLineTable::Get()->GetPosition(_pos, &line, &charpos);
+  return charpos;
+}
+
 ostream& CToken::print(ostream &out) const
 {
-  int str_len = _value.length();
+  string value = escape(*_value);
+  int str_len = value.length();
   str_len = TOKEN_STRLEN + (str_len < 64 ? str_len : 64);
   char *str = (char*)malloc(str_len);
-  snprintf(str, str_len, ETokenStr[GetType()], _value.c_str());
-  out << dec << _line << ":" << _char << ": " << str;
+  snprintf(str, str_len, ETokenStr[GetType()], value.c_str());
+  int line = 0, charpos = 0;
+  if (_pos != NOPOS) CLineTable::Get()->GetPosition(_pos, &line, &charpos);
+  out << dec << line << ":" << charpos << ": " << str;
   free(str);
   return out;
 }
@@ -259,53 +746,444 @@ ostream& operator<<(ostream &out, const CToken *t)
 
 
 //------------------------------------------------------------------------------
-// CScanner
+// CTokenBuffer
+//
+CTokenBuffer::CTokenBuffer(void)
+{
+}
+
+void CTokenBuffer::Add(EToken type, const string &value, unsigned int pos)
+{
+  _type.push_back((unsigned char)type);
+  _value.push_back(CStringPool::Get()->Intern(value.data(),
+                                              strlen(value.c_str())));
+  _pos.push_back(pos);
+}
+
+void CTokenBuffer::Add(const CToken &token)
+{
+  _type.push_back((unsigned char)token._type);
+  _value.push_back(token._value);
+  _pos.push_back(token._pos);
+}
+
+void CTokenBuffer::Append(const CTokenBuffer &tokens, unsigned int pos_ofs,
+                          bool keep_eof)
+{
+  size_t n = tokens.GetSize();
+  if ((n > 0) && !keep_eof && (tokens.GetType(n-1) == tEOF)) n--;
+
+  _type.insert(_type.end(), tokens._type.begin(), tokens._type.begin() + n);
+  _value.insert(_value.end(), tokens._value.begin(),
+                tokens._value.begin() + n);
+
+  _pos.reserve(_pos.size() + n);
+  for (size_t i=0; i<n; i++) _pos.push_back(tokens._pos[i] + pos_ofs);
+}
+
+void CTokenBuffer::Replace(size_t first, size_t last,
+                           const CTokenBuffer &tokens, unsigned int pos_ofs,
+                           int shift, bool keep_eof)
+{
+  assert((first <= last) && (last <= GetSize()));
+
+  size_t n = tokens.GetSize();
+  if ((n > 0) && !keep_eof && (tokens.GetType(n-1) == tEOF)) n--;
+
+  for (size_t i=last; i<_pos.size(); i++) _pos[i] += shift;
+
+  vector<unsigned int> pos(n);
+  for (size_t i=0; i<n; i++) pos[i] = tokens._pos[i] + pos_ofs;
+
+  _type.erase(_type.begin() + first, _type.begin() + last);
+  _type.insert(_type.begin() + first, tokens._type.begin(),
+               tokens._type.begin() + n);
+  _value.erase(_value.begin() + first, _value.begin() + last);
+  _value.insert(_value.begin() + first, tokens._value.begin(),
+                tokens._value.begin() + n);
+  _pos.erase(_pos.begin() + first, _pos.begin() + last);
+  _pos.insert(_pos.begin() + first, pos.begin(), pos.end());
+}
+
+void CTokenBuffer::Clear(void)
+{
+  _type.clear();
+  _value.clear();
+  _pos.clear();
+}
+
+int CTokenBuffer::GetLineNumber(size_t i) const
+{
+  int line, charpos;
+
+  CLineTable::Get()->GetPosition(_pos[Index(i)], &line, &charpos);
+  return line;
+}
+
+int CTokenBuffer::GetCharPosition(size_t i) const
+{
+  int line, charpos;
+
+  CLineTable::Get()->GetPosition(_pos[Index(i)], &line, &charpos);
+  return charpos;
+}
+
+string CTokenBuffer::GetValue(size_t i) const
+{
+  return *_value[Index(i)];
+}
+
+CToken CTokenBuffer::GetToken(size_t i) const
+{
+  CToken t;
+
+  i = Index(i);
+  t._type = (EToken)_type[i];
+  t._value = _value[i];
+  t._pos = _pos[i];
+
+  return t;
+}
+
+/// @brief magic number of a binary token dump
+static const char TokenDumpMagic[8] = { 'S', 'n', 'u', 'P', 'L', 't', 'k', 1 };
+
+/// @brief append an unsigned LEB128 varint to a string
+static void PutVarint(string *s, unsigned long long v)
+{
+  while (v >= 0x80) {
+    *s += (char)(v | 0x80);
+    v >>= 7;
+  }
+  *s += (char)v;
+}
+
+/// @brief read an unsigned LEB128 varint
+/// @param p (in/out) read position
+/// @param end end of the input
+/// @param v (out) value
+/// @retval false if the input is truncated
+static bool GetVarint(const char **p, const char *end, unsigned long long *v)
+{
+  *v = 0;
+  for (int shift=0; (*p < end) && (shift < 64); shift += 7) {
+    unsigned char b = *(*p)++;
+    *v |= (unsigned long long)(b & 0x7f) << shift;
+    if (b < 0x80) return true;
+  }
+  return false;
+}
+
+bool CTokenBuffer::Save(ostream &out, CLineTable *lines) const
+{
+  assert(lines != NULL);
+
+  vector<unsigned int> start;
+  lines->GetLineStarts(&start);
+
+  string s(TokenDumpMagic, sizeof(TokenDumpMagic));
+  s.reserve(s.size() + 2*start.size() + 8*GetSize() + 16);
+
+  PutVarint(&s, start.size());
+  PutVarint(&s, GetSize());
+
+  for (size_t i=1; i<start.size(); i++) PutVarint(&s, start[i] - start[i-1]);
+
+  unsigned int prev = 0;
+  for (size_t i=0; i<GetSize(); i++) {
+    s += (char)_type[i];
+    PutVarint(&s, _pos[i] - prev);    // modulo 2^32; NOPOS stays lossless
+    prev = _pos[i];
+    PutVarint(&s, _value[i]->size());
+    s += *_value[i];
+  }
+
+  out.write(s.data(), s.size());
+  return out.good();
+}
+
+bool CTokenBuffer::Load(istream &in, CLineTable *lines)
+{
+  assert(lines != NULL);
+
+  string s;
+  char block[1 << 16];
+  while (in.read(block, sizeof(block)) || (in.gcount() > 0)) {
+    s.append(block, in.gcount());
+  }
+  const char *p = s.data(), *end = p + s.size();
+
+  Clear();
+
+  if ((s.size() < sizeof(TokenDumpMagic)) ||
+      (memcmp(p, TokenDumpMagic, sizeof(TokenDumpMagic)) != 0)) return false;
+  p += sizeof(TokenDumpMagic);
+
+  unsigned long long nlines, ntokens, v;
+  if (!GetVarint(&p, end, &nlines) || !GetVarint(&p, end, &ntokens) ||
+      (nlines == 0) || (nlines > s.size()) || (ntokens > s.size())) {
+    return false;
+  }
+
+  lines->Reset();
+  unsigned int start = 0;
+  for (size_t i=1; i<nlines; i++) {
+    if (!GetVarint(&p, end, &v)) return false;
+    start += v;
+    lines->AddLine(start);
+  }
+
+  _type.reserve(ntokens);
+  _value.reserve(ntokens);
+  _pos.reserve(ntokens);
+  CStringPool *pool = CStringPool::Get();
+
+  unsigned int pos = 0;
+  for (size_t i=0; i<ntokens; i++) {
+    if (p >= end) return false;
+    unsigned char type = *p++;
+    if (type > tUndefined) return false;
+
+    unsigned long long len;
+    if (!GetVarint(&p, end, &v) || !GetVarint(&p, end, &len) ||
+        (len > (unsigned long long)(end - p))) return false;
+    pos += v;
+
+    _type.push_back(type);
+    _pos.push_back(pos);
+    _value.push_back(pool->Intern(p, len));
+    p += len;
+  }
+
+  return p == end;
+}
+
+
+//------------------------------------------------------------------------------
+// CTokenPrinter
 //
-map<string, EToken> CScanner::keywords;
+CTokenPrinter::CTokenPrinter(ostream *out, size_t size)
+  : _out(out), _buf(max(size, (size_t)256)), _len(0)
+{
+  assert(out != NULL);
+}
 
+CTokenPrinter::~CTokenPrinter(void)
+{
+  Flush();
+}
+
+void CTokenPrinter::Print(const CToken &token)
+{
+  const string &value = token.GetValue();
+
+  Format(token.GetType(), value.data(), value.size(), token.GetPosition());
+}
+
+void CTokenPrinter::Print(const CTokenBuffer &tokens, size_t i)
+{
+  size_t length;
+  const char *value = tokens.GetValue(i, &length);
+
+  Format(tokens.GetType(i), value, length, tokens.GetPosition(i));
+}
+
+void CTokenPrinter::Print(const char *s)
+{
+  size_t n = strlen(s);
+
+  if (_len + n > _buf.size()) {
+    Flush();
+    if (n > _buf.size()) {
+      _out->write(s, n);
+      return;
+    }
+  }
+
+  memcpy(&_buf[_len], s, n);
+  _len += n;
+}
+
+void CTokenPrinter::Flush(void)
+{
+  if (_len > 0) _out->write(&_buf[0], _len);
+  _len = 0;
+}
+
+/// @brief write the decimal representation of @a v to @a p
+/// @retval pointer past the last digit
+static char* PutDecimal(char *p, unsigned int v)
+{
+  char digits[10];
+  int n = 0;
+
+  do {
+    digits[n++] = '0' + v % 10;
+    v /= 10;
+  } while (v > 0);
+
+  while (n > 0) *p++ = digits[--n];
+  return p;
+}
+
+void CTokenPrinter::Format(EToken type, const char *value, size_t length,
+                           unsigned int pos)
+{
+  // a formatted token is at most 2*10 + 3 + TOKEN_STRLEN + 64 characters
+  if (_buf.size() - _len < 128) Flush();
+
+  char *p = &_buf[_len];
+
+  int line = 0, charpos = 0;
+  if (pos != CToken::NOPOS) CLineTable::Get()->GetPosition(pos, &line, &charpos);
+  p = PutDecimal(p, line);
+  *p++ = ':';
+  p = PutDecimal(p, charpos);
+  *p++ = ':';
+  *p++ = ' ';
+
+  // CToken::print() formats into a buffer of TOKEN_STRLEN + min(escaped
+  // length, 64) characters; reproduce its truncation
+  size_t elen = length;
+  for (size_t i=0; i<length; i++) {
+    switch (value[i]) {
+      case '\n': case '\t': case '\'': case '\"': case '\\': elen++;
+    }
+  }
+  char *limit = p + TOKEN_STRLEN + min(elen, (size_t)64) - 1;
+
+  const char *fmt = ETokenStr[type];
+  while ((*fmt != '\0') && (p < limit)) {
+    if ((fmt[0] == '%') && (fmt[1] == 's')) {
+      for (size_t i=0; (i<length) && (p < limit); i++) {
+        char c = value[i];
+        switch (c) {
+          case '\n': c = 'n'; break;
+          case '\t': c = 't'; break;
+          case '\'': case '\"': case '\\': break;
+          default:
+            *p++ = c;
+            continue;
+        }
+        *p++ = '\\';
+        if (p < limit) *p++ = c;
+      }
+      fmt += 2;
+    } else {
+      *p++ = *fmt++;
+    }
+  }
+
+  _len = p - &_buf[0];
+}
+
+
+//------------------------------------------------------------------------------
+// CSourceBuffer
+//
+CSourceBuffer::CSourceBuffer(const string filename)
+  : _data(NULL), _size(0), _mapped(false), _good(false)
+{
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) return;
+
+  struct stat st;
+  if ((fstat(fd, &st) == 0) && S_ISREG(st.st_mode)) {
+    if (st.st_size == 0) {
+      // mmap() does not support empty mappings
+      _good = true;
+    } else {
+      void *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (p != MAP_FAILED) {
+        madvise(p, st.st_size, MADV_SEQUENTIAL);
+        _data = (const char*)p;
+        _size = st.st_size;
+        _mapped = true;
+        _good = true;
+      }
+    }
+  }
+
+  close(fd);
+}
+
+CSourceBuffer::CSourceBuffer(const char *data, size_t size)
+  : _data(data), _size(size), _mapped(false), _good(data != NULL || size == 0)
+{
+}
+
+CSourceBuffer::~CSourceBuffer()
+{
+  CLineTable::Get()->Release(_data);
+  if (_mapped) munmap((void*)_data, _size);
+}
+
+
+//------------------------------------------------------------------------------
+// CScanner
+//
 CScanner::CScanner(istream *in)
 {
-  InitKeywords();
   _in = in;
   _delete_in = false;
-  _line = _char = 1;
-  _token = NULL;
+  _begin = _cur = _end = NULL;
+  _eof = false;
+  _pos = 0;
+  _lines = CLineTable::Get();
+  _lines->Reset();
   _good = in->good();
   NextToken();
 }
 
 CScanner::CScanner(string in)
 {
-  InitKeywords();
   _in = new istringstream(in);
   _delete_in = true;
-  _line = _char = 1;
-  _token = NULL;
+  _begin = _cur = _end = NULL;
+  _eof = false;
+  _pos = 0;
+  _lines = CLineTable::Get();
+  _lines->Reset();
   _good = true;
   NextToken();
 }
 
-CScanner::~CScanner()
+CScanner::CScanner(const CSourceBuffer *in)
 {
-  if (_token != NULL) delete _token;
-  if (_delete_in) delete _in;
+  assert(in != NULL);
+  _lines = CLineTable::Get();
+  _lines->SetSource(in->GetData(), in->GetSize());
+  InitBuffer(in->GetData(), in->GetSize(), in->Good());
 }
 
-void CScanner::InitKeywords(void)
+CScanner::CScanner(const char *data, size_t size)
 {
-  if (keywords.size() == 0) {
-    int size = sizeof(Keywords) / sizeof(Keywords[0]);
-    for (int i=0; i<size; i++) {
-      keywords[Keywords[i].first] = Keywords[i].second;
-    }
-  }
+  _lines = NULL;
+  InitBuffer(data, size, true);
+}
+
+void CScanner::InitBuffer(const char *data, size_t size, bool good)
+{
+  _in = NULL;
+  _delete_in = false;
+  _begin = _cur = data;
+  _end = _cur + size;
+  _eof = false;
+  _pos = 0;
+  _good = good;
+  NextToken();
+}
+
+CScanner::~CScanner()
+{
+  if (_delete_in) delete _in;
 }
 
 CToken CScanner::Get()
 {
   CToken result(_token);
 
-  EToken type = _token->GetType();
+  EToken type = _token.GetType();
   _good = !(type == tIOError);
 
   NextToken();
@@ -317,123 +1195,176 @@ CToken CScanner::Peek() const
   return CToken(_token);
 }
 
+void CScanner::Tokenize(CTokenBuffer *tokens)
+{
+  assert(tokens != NULL);
+
+  // the next token has already been scanned
+  tokens->Add(_token);
+
+  EToken type = _token.GetType();
+
+  while ((type != tEOF) && (type != tIOError)) {
+    type = ScanToken(_tokval);
+    tokens->Add(type, _tokval, _saved_pos);
+  }
+
+  // leave the scanner positioned at the last token
+  _token = tokens->GetToken(tokens->GetSize()-1);
+}
+
 void CScanner::NextToken()
 {
-  if (_token != NULL) delete _token;
+  EToken type = ScanToken(_tokval);
 
-  _token = Scan();
+  _token = CToken(_saved_pos, type, _tokval);
 }
 
 void CScanner::RecordStreamPosition()
 {
-  _saved_line = _line;
-  _saved_char = _char;
+  _saved_pos = GetPosition();
+}
+
+void CScanner::GetRecordedStreamPosition(int *lineno, int *charpos) const
+{
+  *lineno = *charpos = 0;
+  if (_lines != NULL) _lines->GetPosition(_saved_pos, lineno, charpos);
+}
+
+int CScanner::GetLineNumber(void) const
+{
+  int line = 0, charpos = 0;
+
+  if (_lines != NULL) _lines->GetPosition(GetPosition(), &line, &charpos);
+  return line;
+}
+
+int CScanner::GetCharPosition(void) const
+{
+  int line = 0, charpos = 0;
+
+  if (_lines != NULL) _lines->GetPosition(GetPosition(), &line, &charpos);
+  return charpos;
+}
+
+void CScanner::Tokenize(const CSourceBuffer *in, CTokenBuffer *tokens,
+                        int nthreads)
+{
+  assert((in != NULL) && (tokens != NULL));
+
+  const char *data = in->GetData();
+  size_t size = in->GetSize();
+
+  CLineTable::Get()->SetSource(data, size);
+
+  // split the source into chunks that start at the beginning of a line
+  vector<size_t> split;
+  split.push_back(0);
+  for (int i=1; (i<nthreads) && in->Good(); i++) {
+    size_t pos = max(size / nthreads * i, split.back());
+    const char *nl = (const char*)memchr(data + pos, '\n', size - pos);
+    if (nl == NULL) break;
+    pos = nl - data + 1;
+    if ((pos > split.back()) && (pos < size)) split.push_back(pos);
+  }
+  split.push_back(size);
+
+  size_t nchunks = split.size() - 1;
+  if (nchunks == 1) {
+    CScanner s(in);
+    s.Tokenize(tokens);
+    return;
+  }
+
+  // scan the chunks in parallel; the workers intern the token values in the
+  // string pool of the calling thread
+  vector<CTokenBuffer> chunk(nchunks);
+  vector<thread> worker;
+  CStringPool *pool = CStringPool::Get();
+
+  for (size_t i=0; i<nchunks; i++) {
+    const char *cdata = data + split[i];
+    size_t csize = split[i+1] - split[i];
+    CTokenBuffer *ctokens = &chunk[i];
+    worker.push_back(thread([=]() {
+      CStringPool::SetCurrent(pool);
+      TokenizeChunk(cdata, csize, ctokens);
+    }));
+  }
+  for (size_t i=0; i<nchunks; i++) worker[i].join();
+
+  // stitch the chunks together; the source offsets of a chunk are relative
+  // to its start
+  for (size_t i=0; i<nchunks; i++) {
+    tokens->Append(chunk[i], split[i], i == nchunks-1);
+  }
 }
 
-void CScanner::GetRecordedStreamPosition(int *lineno, int *charpos)
+void CScanner::TokenizeLines(const char *data, size_t size,
+                             CTokenBuffer *tokens)
 {
-  *lineno = _saved_line;
-  *charpos = _saved_char;
+  assert(tokens != NULL);
+
+  TokenizeChunk(data, size, tokens);
 }
 
-CToken* CScanner::NewToken(EToken type, const string token)
+void CScanner::TokenizeChunk(const char *data, size_t size,
+                             CTokenBuffer *tokens)
 {
-  return new CToken(_saved_line, _saved_char, type, token);
+  CScanner s(data, size);
+
+  s.Tokenize(tokens);
 }
 
-CToken* CScanner::Scan()
+EToken CScanner::ScanToken(string &tokval)
 {
-  EToken token;
-  string tokval;
+  int state, next;
   char c;
+
+  tokval.clear();
+
   while (true) {
-    while (_in->good() && IsWhite(_in->peek())) GetChar();
+    SkipWhite();
 
     RecordStreamPosition();
 
-    if (_in->eof()) return NewToken(tEOF);
-    if (!_in->good()) return NewToken(tIOError);
+    if (AtEOF()) return tEOF;
+    if (!InputGood()) return tIOError;
 
+    // run the automaton as long as there is a transition (longest match)
     c = GetChar();
-    if (c == '/' && _in->peek() == '/') {
-      while(_in->peek() != '\n' && !(_in->eof())) GetChar();
-      continue;
-    }
-    break;
-  }
-
-  tokval = c;
-  token = tUndefined;
+    tokval = c;
+    state = Transitions.next[sStart][CharClass(c)];
 
-  switch (c) {
-    case '|':
-      if (_in->peek() != '|')
+    while (state <= sLastOpen) {
+      if ((_in == NULL) && ((state == sIdent) || (state == sNumber))) {
+        GetRun(tokval, state == sNumber);
         break;
-      tokval += GetChar();
-    case '+':
-    case '-':
-      token = tTermOp;
-      break;
-
-    case '&':
-      if (_in->peek() != '&')
-        break;
-      tokval += GetChar();
-    case '*':
-    case '/':
-      token = tFactOp;
-      break;
-
-    case ':':
-      if (_in->peek() == '=') {
-        tokval += GetChar();
-        token = tAssign;
-      } else {
-        token = tColon;
       }
-      break;
 
-    case ';':
-      token = tSemicolon;
-      break;
+      next = Transitions.next[state][CharClass(PeekChar())];
+      if (next == sError) break;
 
-    case '.':
-      token = tDot;
-      break;
-    case ',':
-      token = tComma;
-      break;
+      tokval += GetChar();
+      state = next;
+    }
 
-    case '(':
-      token = tLBrak;
-      break;
-    case ')':
-      token = tRBrak;
-      break;
-    case '[':
-      token = tLSBrak;
-      break;
-    case ']':
-      token = tRSBrak;
-      break;
+    if (state != sComment) break;
 
-    case '!':
-      token = tCompl;
-      break;
+    SkipLine();
+    tokval.clear();
+  }
 
-    case '<':
-    case '>':
-      if (_in->peek() == '=') {
-        tokval += GetChar();
-      }
-    case '#':
-    case '=':
-      token = tRelOp;
+  EToken token = (EToken)Accepts.token[state];
+
+  switch (state) {
+    case sIdent:
+      token = TokenForIdentifier(tokval);
       break;
 
-    case '"': {
+    case sString: {
       string str = GetCharactersUntil('"');
-      if (_in->peek() == '"') {
+      if (PeekChar() == '"') {
         GetChar();
         if (!IsUnescapable(str)) {
           tokval = "unescapable string \"";
@@ -449,9 +1380,9 @@ CToken* CScanner::Scan()
       break;
     }
 
-    case '\'': {
+    case sChar: {
       string str = GetCharactersUntil('\'');
-      if (_in->peek() == '\'') {
+      if (PeekChar() == '\'') {
         GetChar();
         if (!IsUnescapable(str)) {
           tokval = "unescapable string \"";
@@ -474,85 +1405,107 @@ CToken* CScanner::Scan()
       break;
     }
 
-    default:
-      if (IsDigit(c)) {
-        while (true) {
-          char lookAhead = _in->peek();
-          if (IsDigit(lookAhead)) {
-            tokval += GetChar();
-          } else {
-            break;
-          }
-        }
-        token = tNumber;
-      } else
-      if (IsLetter(c)) {
-        while (true) {
-          char lookAhead = _in->peek();
-          if (IsLetter(lookAhead) || IsDigit(lookAhead)) {
-            tokval += GetChar();
-          } else {
-            break;
-          }
-        }
-        token = TokenForIdentifier(tokval);
-      } else {
-        tokval = "invalid character '";
-        tokval += c;
-        tokval += "'";
-      }
+    case sInvalid:
+      tokval = "invalid character '";
+      tokval += c;
+      tokval += "'";
       break;
   }
 
-  return NewToken(token, tokval);
+  return token;
 }
 
 char CScanner::GetChar()
 {
-  char c = _in->get();
-  if (c == '\n') { _line++; _char = 1; } else _char++;
+  char c;
+
+  if (_in != NULL) {
+    c = _in->get();
+    _pos++;
+    if ((c == '\n') && (_lines != NULL)) _lines->AddLine(_pos);
+  } else if (_cur < _end) {
+    c = *_cur++;
+  } else {
+    // reads past the end advance the position like in stream mode
+    _eof = true;
+    _pos++;
+    c = EOF;
+  }
+
   return c;
 }
 
-string CScanner::GetChar(int n)
+char CScanner::PeekChar()
 {
-  string str;
-  for (int i=0; i<n; i++) str += GetChar();
-  return str;
+  if (_in != NULL) return _in->peek();
+
+  if (_cur < _end) return *_cur;
+  _eof = true;
+  return EOF;
 }
 
-bool CScanner::IsWhite(char c) const
+bool CScanner::AtEOF() const
 {
-  return ((c == ' ') || (c == '\n') || (c == '\t'));
+  if (_in != NULL) return _in->eof();
+  return _eof;
 }
 
-bool CScanner::IsLetter(char c) const
+bool CScanner::InputGood() const
 {
-  return ((c >= 'a') && (c <= 'z')) || ((c >= 'A') && (c <= 'Z')) || (c == '_');
+  if (_in != NULL) return _in->good();
+  return _good && !_eof;
 }
 
-bool CScanner::IsDigit(char c) const
+void CScanner::GetRun(string &s, bool digits_only)
 {
-  return (c >= '0') && (c <= '9');
+  const char *p = digits_only ? CScanKernels::SkipDigits(_cur, _end)
+                              : CScanKernels::SkipIdent(_cur, _end);
+
+  s.append(_cur, p - _cur);
+  _cur = p;
 }
-EToken CScanner::TokenForIdentifier(string s) const
+
+void CScanner::SkipWhite(void)
 {
-  if (s == "module") return tModule;
-  else if (s == "begin") return tBegin;
-  else if (s == "end") return tEnd;
-  else if (s == "true" || s == "false") return tBoolean;
-  else if (s == "char" || s == "boolean" || s == "integer") return tBaseType;
-  else if (s == "if") return tIf;
-  else if (s == "then") return tThen;
-  else if (s == "else") return tElse;
-  else if (s == "while") return tWhile;
-  else if (s == "do") return tDo;
-  else if (s == "return") return tReturn;
-  else if (s == "var") return tVar;
-  else if (s == "procedure") return tProcedure;
-  else if (s == "function") return tFunction;
-  else if (s == "break") return tBreak;
-  else return tId;
+  if (_in != NULL) {
+    while (InputGood() && (CharClass(PeekChar()) == ccWhite)) GetChar();
+    return;
+  }
+
+  if (!InputGood()) return;
+
+  _cur = CScanKernels::SkipWhite(_cur, _end);
+
+  // the character loop peeks past the end of the buffer
+  if (_cur == _end) _eof = true;
+}
+
+void CScanner::SkipLine(void)
+{
+  if (_in != NULL) {
+    while(PeekChar() != '\n' && !AtEOF()) GetChar();
+    return;
+  }
+
+  _cur = CScanKernels::FindEOL(_cur, _end);
+  if (_cur == _end) _eof = true;
+}
+
+string CScanner::GetChar(int n)
+{
+  string str;
+  for (int i=0; i<n; i++) str += GetChar();
+  return str;
+}
+
+EToken CScanner::TokenForIdentifier(const string &s) const
+{
+  const CKeywordSlot &k = KeywordTable.slot[KeywordHash(s.data(), s.size())];
+
+  if ((k.length == s.size()) && (memcmp(k.name, s.data(), k.length) == 0)) {
+    return k.token;
+  }
+  return tId;
 }
 
 bool CScanner::IsUnescapable(string s) const
@@ -603,11 +1556,11 @@ string CScanner::Unescape(string s) const
 
 string CScanner::GetCharactersUntil(char stopc) {
   string str;
-  while (!(_in->eof()) && _in->peek() != '\n' && _in->peek() != stopc) {
+  while (!AtEOF() && PeekChar() != '\n' && PeekChar() != stopc) {
     char c = GetChar();
     str += c;
     if (c == '\\') {
-      if (!(_in->eof()) && _in->peek() != '\n') {
+      if (!AtEOF() && PeekChar() != '\n') {
         str += GetChar();
       }
       else return str;
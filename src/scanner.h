@@ -41,6 +41,9 @@
 #include <ostream>
 #include <iomanip>
 #include <map>
+#include <mutex>
+#include <string>
+#include <vector>
 
 using namespace std;
 
@@ -91,15 +94,167 @@ enum EToken {
 };
 
 
+//------------------------------------------------------------------------------
+/// @brief string pool
+///
+/// interns token values: equal strings are stored only once and never move,
+/// i.e., tokens can refer to an interned string instead of owning a copy.
+/// Looking up an already interned string does not allocate memory. The pool
+/// is thread-safe.
+///
+/// Each compilation context owns a pool (see CCompilation); its strings are
+/// freed with the context. Like the line table, the pool of the current
+/// context is set per thread; a thread without a context uses the default
+/// pool.
+///
+class CStringPool {
+  public:
+    /// @name construction/destruction
+    /// @{
+
+    /// @brief constructor
+    CStringPool(void);
+
+    /// @brief destructor
+    ~CStringPool(void);
+
+    /// @}
+
+    /// @brief return the string pool of the current compilation
+    static CStringPool* Get(void);
+
+    /// @brief set the string pool of the calling thread
+    ///
+    /// called by CCompilation::SetCurrent()
+    ///
+    /// @param pool string pool (NULL for the default string pool)
+    /// @retval previous string pool of the calling thread (NULL: default)
+    static CStringPool* SetCurrent(CStringPool *pool);
+
+    /// @brief intern a string
+    ///
+    /// @param s first character
+    /// @param len length of the string
+    /// @retval interned string
+    const string* Intern(const char *s, size_t len);
+
+    /// @brief intern a string
+    ///
+    /// @param s string
+    /// @retval interned string
+    const string* Intern(const string &s)
+    {
+      return Intern(s.data(), s.size());
+    };
+
+    /// @brief return the number of interned strings
+    size_t GetSize(void) const { return _count; };
+
+  private:
+    /// @brief double the number of hash table slots
+    void Grow(void);
+
+    vector<const string*> _slot;    ///< open-addressing hash table
+    size_t _count;                  ///< number of interned strings
+    mutex  _lock;                   ///< protects the hash table
+};
+
+
+//------------------------------------------------------------------------------
+/// @brief line table
+///
+/// maps the 32-bit source offsets stored in tokens to line numbers and
+/// character positions. The line starts are either recorded while scanning
+/// (stream mode) or built lazily from the source buffer the first time a
+/// position is queried (buffer mode). The table is thread-safe.
+///
+class CLineTable {
+  public:
+    /// @name construction/destruction
+    /// @{
+
+    /// @brief constructor
+    CLineTable(void);
+
+    /// @}
+
+    /// @brief return the line table of the current compilation
+    static CLineTable* Get(void);
+
+    /// @brief set the line table of the calling thread
+    ///
+    /// called by CCompilation::SetCurrent()
+    ///
+    /// @param lines line table (NULL for the default line table)
+    /// @retval previous line table of the calling thread (NULL: default)
+    static CLineTable* SetCurrent(CLineTable *lines);
+
+    /// @name table construction
+    /// @{
+
+    /// @brief start an empty table; line starts are added with AddLine()
+    void Reset(void);
+
+    /// @brief start a table for a source buffer; the line starts are computed
+    ///        when the table is first queried
+    ///
+    /// the buffer must remain valid until the table has been built (see
+    /// Release())
+    ///
+    /// @param data source
+    /// @param size size of the source
+    void SetSource(const char *data, size_t size);
+
+    /// @brief build the table now if it still refers to @a data
+    ///
+    /// called before a source buffer is released
+    ///
+    /// @param data source
+    void Release(const char *data);
+
+    /// @brief record the start of a new line
+    ///
+    /// @param pos offset of the first character of the line
+    void AddLine(unsigned int pos);
+
+    /// @}
+
+    /// @brief convert a source offset into a line number/character position
+    ///
+    /// @param pos source offset
+    /// @param line (out) line number (1-based)
+    /// @param charpos (out) character position (1-based)
+    void GetPosition(unsigned int pos, int *line, int *charpos);
+
+    /// @brief return the offsets of the line starts
+    ///
+    /// @param start (out) offsets of the line starts
+    void GetLineStarts(vector<unsigned int> *start);
+
+  private:
+    /// @brief compute the line starts of the source buffer
+    void Build(void);
+
+    vector<unsigned int> _start;    ///< offsets of the line starts
+    const char *_data;              ///< source (NULL once built)
+    size_t  _size;                  ///< size of the source
+    mutex   _lock;                  ///< protects the table
+};
+
+
 //------------------------------------------------------------------------------
 /// @brief token
 ///
 /// used to represent a token. Each token has a type (EToken), a value for
 /// tokens that in fact subsume a number of terminals, and the exact position
-/// in the input stream (line/column).
+/// in the input stream. The position is stored as a 32-bit source offset and
+/// converted to line/column through the line table. The (unescaped) value is
+/// interned in the string pool, so tokens are cheap to copy; values are
+/// escaped only when a token is printed.
 ///
 class CToken {
   friend class CScanner;
+  friend class CTokenBuffer;
   public:
     /// @name constructors
     /// @{
@@ -109,11 +264,11 @@ class CToken {
 
     /// @brief constructor taking initialization values
     ///
-    /// @param line line number in the input stream
-    /// @param charpos character position in the input stream
+    /// @param pos source offset
     /// @param type token type
-    /// @param value token value
-    CToken(int line, int charpos, EToken type, const string value="");
+    /// @param value (unescaped) token value; the value ends at the first NUL
+    ///        character
+    CToken(unsigned int pos, EToken type, const string &value="");
 
     /// @brief copy contructor
     ///
@@ -146,25 +301,37 @@ class CToken {
 
     /// @brief return the token value
     ///
-    /// @retval token value
-    string GetValue(void) const { return _value; };
+    /// @retval (unescaped) token value
+    const string& GetValue(void) const { return *_value; };
+
+    /// @brief return the token value interned in the string pool
+    ///
+    /// @retval (unescaped) token value (interned)
+    const string* GetInternedValue(void) const { return _value; };
     /// @}
 
     /// @name stream attributes
     /// @{
 
+    /// @brief return the source offset
+    ///
+    /// @retval source offset of the token (NOPOS if the token has none)
+    unsigned int GetPosition(void) const { return _pos; };
+
     /// @brief return the line number
     ///
     /// @retval line number of the token in the input stream
-    int GetLineNumber(void) const { return _line; };
+    int GetLineNumber(void) const;
 
     /// @brief return the character position
     ///
     /// @retval character position of the token in the input stream
-    int GetCharPosition(void) const { return _char; };
+    int GetCharPosition(void) const;
 
     /// @}
 
+    static const unsigned int NOPOS = ~0u; ///< no source position
+
     /// @name string escape/unescaping (static methods)
     /// @{
 
@@ -188,9 +355,8 @@ class CToken {
 
   private:
     EToken _type;                   ///< token type
-    string _value;                  ///< token value
-    int    _line;                   ///< input stream position (line)
-    int    _char;                   ///< input stream position (character pos)
+    unsigned int _pos;              ///< source offset
+    const string *_value;           ///< token value (interned)
 };
 
 /// @name CToken output operators
@@ -213,11 +379,302 @@ ostream& operator<<(ostream &out, const CToken *t);
 /// @}
 
 
+//------------------------------------------------------------------------------
+/// @brief token buffer
+///
+/// a flat array holding all tokens of a module. The token attributes are
+/// stored in separate arrays (structure-of-arrays). The (unescaped) token
+/// values are interned in the string pool of the current compilation once,
+/// when a token is added, so GetToken() does not touch the pool.
+/// Filled by CScanner::Tokenize(); used by CParser for O(1) lookahead.
+///
+class CTokenBuffer {
+  public:
+    /// @name construction/destruction
+    /// @{
+
+    /// @brief constructor
+    CTokenBuffer(void);
+
+    /// @}
+
+    /// @name buffer manipulation
+    /// @{
+
+    /// @brief append a token
+    ///
+    /// @param type token type
+    /// @param value (unescaped) token value; the value ends at the first NUL
+    ///        character
+    /// @param pos source offset
+    void Add(EToken type, const string &value, unsigned int pos);
+
+    /// @brief append a token
+    ///
+    /// @param token token to append
+    void Add(const CToken &token);
+
+    /// @brief append the tokens of another buffer
+    ///
+    /// used to stitch together separately scanned chunks of a source file.
+    ///
+    /// @param tokens token buffer to append
+    /// @param pos_ofs value added to the source offsets of the appended tokens
+    /// @param keep_eof if false, a trailing tEOF of @a tokens is dropped
+    void Append(const CTokenBuffer &tokens, unsigned int pos_ofs,
+                bool keep_eof);
+
+    /// @brief replace a range of tokens by the tokens of another buffer
+    ///
+    /// used to splice re-scanned lines into the tokens of an edited source.
+    ///
+    /// @param first index of the first token to replace
+    /// @param last index one past the last token to replace
+    /// @param tokens replacement tokens
+    /// @param pos_ofs value added to the source offsets of the new tokens
+    /// @param shift value added to the source offsets of the tokens
+    ///        following the replaced range
+    /// @param keep_eof if false, a trailing tEOF of @a tokens is dropped
+    void Replace(size_t first, size_t last, const CTokenBuffer &tokens,
+                 unsigned int pos_ofs, int shift, bool keep_eof);
+
+    /// @brief remove all tokens
+    void Clear(void);
+
+    /// @}
+
+    /// @name token attributes
+    ///
+    /// indices past the end of the buffer refer to the last token (which is
+    /// always tEOF or tIOError once the buffer has been filled)
+    /// @{
+
+    /// @brief return the number of tokens in the buffer
+    ///
+    /// @retval number of tokens
+    size_t GetSize(void) const { return _type.size(); };
+
+    /// @brief return the type of token @a i
+    ///
+    /// @param i token index
+    /// @retval token type
+    EToken GetType(size_t i) const { return (EToken)_type[Index(i)]; };
+
+    /// @brief return the value of token @a i
+    ///
+    /// @param i token index
+    /// @retval (unescaped) token value
+    string GetValue(size_t i) const;
+
+    /// @brief return the value of token @a i without copying it
+    ///
+    /// @param i token index
+    /// @param length (out) length of the value
+    /// @retval pointer to the (unescaped, not NUL-terminated) value
+    const char* GetValue(size_t i, size_t *length) const
+    {
+      const string *value = _value[Index(i)];
+      *length = value->size();
+      return value->data();
+    };
+
+    /// @brief return the source offset of token @a i
+    ///
+    /// @param i token index
+    /// @retval source offset
+    unsigned int GetPosition(size_t i) const { return _pos[Index(i)]; };
+
+    /// @brief return the line number of token @a i
+    ///
+    /// @param i token index
+    /// @retval line number
+    int GetLineNumber(size_t i) const;
+
+    /// @brief return the character position of token @a i
+    ///
+    /// @param i token index
+    /// @retval character position
+    int GetCharPosition(size_t i) const;
+
+    /// @brief return token @a i as a CToken instance
+    ///
+    /// @param i token index
+    /// @retval token
+    CToken GetToken(size_t i) const;
+
+    /// @}
+
+    /// @name binary token dump
+    ///
+    /// a compact binary form of the token buffer and the line table:
+    /// a magic number, the number of line starts and tokens, the line
+    /// starts, and for each token the type, the source offset (delta to the
+    /// previous token), and the value. Integers are stored as LEB128
+    /// varints.
+    /// @{
+
+    /// @brief write the tokens and a line table
+    ///
+    /// @param out output stream
+    /// @param lines line table (e.g., CLineTable::Get())
+    /// @retval true on success
+    bool Save(ostream &out, CLineTable *lines) const;
+
+    /// @brief read tokens written by Save(); replaces the contents of the
+    ///        buffer and the line table
+    ///
+    /// @param in input stream
+    /// @param lines line table (e.g., CLineTable::Get())
+    /// @retval true on success
+    /// @retval false if the input is not a valid token dump
+    bool Load(istream &in, CLineTable *lines);
+
+    /// @}
+
+  private:
+    /// @brief clamp a token index to the buffer
+    size_t Index(size_t i) const
+    {
+      return i < _type.size() ? i : _type.size() - 1;
+    };
+
+    vector<unsigned char> _type;    ///< token types
+    vector<const string*> _value;   ///< values (interned)
+    vector<unsigned int>  _pos;     ///< source offsets
+};
+
+
+//------------------------------------------------------------------------------
+/// @brief token printer
+///
+/// prints tokens in the same textual form as CToken::print(). The text is
+/// formatted into a reusable output buffer that is written to the output
+/// stream when it fills up, i.e., printing a token does not allocate.
+///
+class CTokenPrinter {
+  public:
+    /// @name construction/destruction
+    /// @{
+
+    /// @brief constructor
+    ///
+    /// @param out output stream
+    /// @param size size of the output buffer
+    CTokenPrinter(ostream *out, size_t size=1<<16);
+
+    /// @brief destructor; flushes the output buffer
+    ~CTokenPrinter(void);
+
+    /// @}
+
+    /// @name output
+    /// @{
+
+    /// @brief print a token
+    ///
+    /// @param token token
+    void Print(const CToken &token);
+
+    /// @brief print token @a i of a token buffer
+    ///
+    /// @param tokens token buffer
+    /// @param i token index
+    void Print(const CTokenBuffer &tokens, size_t i);
+
+    /// @brief print a string
+    ///
+    /// @param s string
+    void Print(const char *s);
+
+    /// @brief write the output buffer to the output stream
+    void Flush(void);
+
+    /// @}
+
+  private:
+    /// @brief format a token into the output buffer
+    ///
+    /// @param type token type
+    /// @param value (unescaped) token value
+    /// @param length length of the value
+    /// @param pos source offset
+    void Format(EToken type, const char *value, size_t length,
+                unsigned int pos);
+
+    ostream     *_out;              ///< output stream
+    vector<char> _buf;              ///< output buffer
+    size_t       _len;              ///< number of characters in _buf
+};
+
+
+//------------------------------------------------------------------------------
+/// @brief source buffer
+///
+/// a contiguous, read-only range of source code. The buffer either maps a
+/// file into memory or wraps a range of characters owned by the caller. The
+/// scanner operates directly on the characters of the buffer (no copying).
+///
+class CSourceBuffer {
+  public:
+    /// @name construction/destruction
+    /// @{
+
+    /// @brief constructor: map a file into memory
+    ///
+    /// @param filename name of the file to map
+    CSourceBuffer(const string filename);
+
+    /// @brief constructor: wrap a range of characters
+    ///
+    /// The characters are not copied, i.e., @a data must remain valid for
+    /// the lifetime of the buffer.
+    ///
+    /// @param data pointer to the first character
+    /// @param size number of characters
+    CSourceBuffer(const char *data, size_t size);
+
+    /// @brief destructor
+    ~CSourceBuffer();
+
+    /// @}
+
+    /// @brief check the status of the buffer
+    ///
+    /// @retval true if the buffer is valid
+    /// @retval false if the file could not be opened or mapped
+    bool Good(void) const { return _good; };
+
+    /// @brief return a pointer to the first character of the buffer
+    ///
+    /// @retval pointer to the first character
+    const char* GetData(void) const { return _data; };
+
+    /// @brief return the number of characters in the buffer
+    ///
+    /// @retval buffer size
+    size_t GetSize(void) const { return _size; };
+
+  private:
+    /// @brief copying is not supported
+    CSourceBuffer(const CSourceBuffer &);
+    CSourceBuffer& operator=(const CSourceBuffer &);
+
+    const char *_data;              ///< first character
+    size_t  _size;                  ///< number of characters
+    bool    _mapped;                ///< data is mapped and must be unmapped
+    bool    _good;                  ///< buffer status flag
+};
+
+
 //------------------------------------------------------------------------------
 /// @brief scanner
 ///
 /// used by CParser to scan (tokenize) SnuPL/0 code
 ///
+/// The scanner either reads from an input stream or scans a CSourceBuffer
+/// in place with raw pointers. The latter is considerably faster for large
+/// inputs since no character is pulled through the stream interface.
+///
 class CScanner {
   public:
     /// @name construction/destruction
@@ -233,6 +690,14 @@ class CScanner {
     /// @param in input stream containing the source code
     CScanner(string in);
 
+    /// @brief constructor
+    ///
+    /// scans the source buffer in place. The buffer is not owned by the
+    /// scanner and must outlive it.
+    ///
+    /// @param in source buffer containing the source code
+    CScanner(const CSourceBuffer *in);
+
     /// @brief destructor
     ~CScanner();
 
@@ -248,25 +713,88 @@ class CScanner {
     /// @retval token token
     CToken Peek(void) const;
 
+    /// @brief scan all remaining tokens into a token buffer
+    ///
+    /// appends the next token and all following tokens up to and including
+    /// tEOF (or tIOError) to @a tokens. Afterwards, the scanner is positioned
+    /// at the end of the input.
+    ///
+    /// @param tokens token buffer
+    void Tokenize(CTokenBuffer *tokens);
+
+    /// @brief scan a source buffer into a token buffer using several threads
+    ///
+    /// SnuPL tokens never span lines. The source is thus split into chunks
+    /// at newline boundaries; the chunks are scanned in parallel and then
+    /// stitched together with corrected line numbers. The result is identical
+    /// to scanning the buffer with a single scanner.
+    ///
+    /// @param in source buffer
+    /// @param tokens token buffer
+    /// @param nthreads number of threads (= chunks) to use
+    static void Tokenize(const CSourceBuffer *in, CTokenBuffer *tokens,
+                         int nthreads);
+
+    /// @brief scan a range of lines of a source
+    ///
+    /// used to re-scan the lines touched by an edit. The range must start at
+    /// the beginning of a line and end after a newline or at the end of the
+    /// source. Does not touch the line table.
+    ///
+    /// @param data first character of the range
+    /// @param size size of the range
+    /// @param tokens (out) tokens of the range; the source offsets are
+    ///        relative to @a data
+    static void TokenizeLines(const char *data, size_t size,
+                              CTokenBuffer *tokens);
+
     /// @brief check the status of the scanner
     ///
     /// @retval true if the scanner is in an operating (i.e., normal) state
     /// @retval false if an error has occurred
     bool Good(void) const { return _good; };
 
-    /// @brief get the line number of the next token in the input stream
+    /// @brief get the line number of the current position in the input stream
     ///
     /// @retval line number
-    int GetLineNumber(void) const { return _line; };
+    int GetLineNumber(void) const;
 
-    /// @brief get the character position of the next token in the input stream
+    /// @brief get the character position of the current position in the input
+    ///        stream
     ///
     /// @retval character position
-    int GetCharPosition() const { return _char; };
+    int GetCharPosition() const;
 
   private:
-    /// @brief initialize list of reserved keywords
-    void InitKeywords(void);
+    /// @brief constructor for a chunk of a source buffer
+    ///
+    /// does not touch the line table; the source offsets are relative to
+    /// @a data
+    ///
+    /// @param data first character of the chunk
+    /// @param size size of the chunk
+    CScanner(const char *data, size_t size);
+
+    /// @brief initialize the scanner for buffer mode
+    ///
+    /// @param data first character
+    /// @param size size of the buffer
+    /// @param good buffer status
+    void InitBuffer(const char *data, size_t size, bool good);
+
+    /// @brief scan a chunk of a source buffer (thread entry point)
+    ///
+    /// @param data first character of the chunk
+    /// @param size size of the chunk
+    /// @param tokens (out) tokens of the chunk
+    static void TokenizeChunk(const char *data, size_t size,
+                              CTokenBuffer *tokens);
+
+    /// @brief return the current source offset
+    unsigned int GetPosition(void) const
+    {
+      return _in != NULL ? _pos : (unsigned int)(_cur - _begin) + _pos;
+    };
 
     /// @brief scan the next token
     void NextToken(void);
@@ -278,62 +806,80 @@ class CScanner {
     ///
     /// @param lineno line number
     /// @param charpos character position
-    void GetRecordedStreamPosition(int *lineno, int *charpos);
-
-    /// @brief create and return a new token
-    ///
-    /// @param type token type
-    /// @param token  token value
-    /// @retval CToken instance
-    CToken* NewToken(EToken type, const string token="");
+    void GetRecordedStreamPosition(int *lineno, int *charpos) const;
 
 
     /// @name low-level scanner routines
     /// @{
 
-    /// @brief scan the input stream and return the next token
+    /// @brief scan the input stream and return the type of the next token
     ///
-    /// @retval CToken instance
-    CToken* Scan(void);
+    /// the position of the token is available through
+    /// GetRecordedStreamPosition()
+    ///
+    /// @param tokval (out) unescaped token value
+    /// @retval token type
+    EToken ScanToken(string &tokval);
 
     /// @brief return the next character from the input stream
     ///
     /// @retval next character in the input stream
     char GetChar(void);
 
-    /// @brief return the next 'n' characters from the input stream
+    /// @brief peek at the next character in the input stream
     ///
-    /// @param n number of characters to read
-    /// @retval string containing the characters read
-    string GetChar(int n);
+    /// @retval next character in the input stream (EOF at the end)
+    char PeekChar(void);
+
+    /// @brief check whether the end of the input has been reached
+    ///
+    /// mimics istream::eof(), i.e., only returns true after an attempt to
+    /// read past the end of the input
+    ///
+    /// @retval true end of input has been reached
+    /// @retval false otherwise
+    bool AtEOF(void) const;
+
+    /// @brief check whether the input is in a good state
+    ///
+    /// @retval true no error and end of input not yet reached
+    /// @retval false otherwise
+    bool InputGood(void) const;
+
+    /// @brief consume a run of letters and digits from the source buffer
+    ///
+    /// only used in buffer mode for the self-looping identifier and number
+    /// states of the scanner automaton. Appends the run to @a s.
+    ///
+    /// @param s string to append the characters to
+    /// @param digits_only stop at the first non-digit character
+    void GetRun(string &s, bool digits_only);
 
-    /// @brief check if a character is a white character
+    /// @brief skip white space
     ///
-    /// @param c character
-    /// @retval true character is white space
-    /// @retval false character is not white space
-    bool IsWhite(char c) const;
+    /// uses the SIMD kernels in buffer mode
+    void SkipWhite(void);
 
-    /// @brief check if a character is a letter
+    /// @brief skip the remainder of the current line (up to the newline)
     ///
-    /// @param c character
-    /// @retval true character is a letter
-    /// @retval false character is not a letter
-    bool IsLetter(char c) const;
+    /// uses the SIMD kernels in buffer mode
+    void SkipLine(void);
 
-    /// @brief check if a character is a digit
+    /// @brief return the next 'n' characters from the input stream
     ///
-    /// @param c character
-    /// @retval true character is a digit
-    /// @retval false character is not a digit
-    bool IsDigit(char c) const;
+    /// @param n number of characters to read
+    /// @retval string containing the characters read
+    string GetChar(int n);
 
     /// @brief make token for identifier string
     ///
+    /// keywords are looked up in a perfect hash table, i.e., at most one
+    /// comparison is performed per identifier
+    ///
     /// @param s string
     /// @retval tId s is not a keyword
     /// @retval EToken token s is a keyword
-    EToken TokenForIdentifier(string s) const;
+    EToken TokenForIdentifier(const string &s) const;
 
     /// @brief check if a string is unescapable
     ///
@@ -359,15 +905,19 @@ class CScanner {
 
 
   private:
-    static map<string, EToken> keywords;///< reserved keywords with corr. tokens
-    istream *_in;                   ///< input stream
+    istream *_in;                   ///< input stream (NULL in buffer mode)
     bool    _delete_in;             ///< delete input stream upon destruction
+    const char *_begin;             ///< buffer mode: start of buffer
+    const char *_cur;               ///< buffer mode: next character
+    const char *_end;               ///< buffer mode: end of buffer
+    bool    _eof;                   ///< buffer mode: read past end of buffer
     bool    _good;                  ///< scanner status flag
-    int     _line;                  ///< current stream position (line)
-    int     _char;                  ///< current stream position (character pos)
-    int     _saved_line;            ///< saved stream position (line)
-    int     _saved_char;            ///< saved stream position (character pos)
-    CToken *_token;                 ///< next token in input stream
+    unsigned int _pos;              ///< stream mode: current source offset;
+                                    ///< buffer mode: reads past the end
+    unsigned int _saved_pos;        ///< saved source offset
+    CLineTable *_lines;             ///< line table (NULL for chunk scanners)
+    CToken  _token;                 ///< next token in input stream
+    string  _tokval;                ///< value buffer reused by NextToken()
 };
 
 
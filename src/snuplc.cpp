@@ -33,16 +33,30 @@
 //------------------------------------------------------------------------------
 
 #include <cassert>
+#include <cerrno>
 #include <cstring>
 #include <cstdlib>
 #include <iostream>
 #include <fstream>
+#include <iomanip>
+#include <sstream>
 #include <vector>
+#include <atomic>
+#include <mutex>
+#include <thread>
 
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "arena.h"
+#include "compilation.h"
 #include "scanner.h"
 #include "parser.h"
 #include "ir.h"
 #include "backend.h"
+#include "lsp.h"
+#include "astcache.h"
 using namespace std;
 
 
@@ -52,7 +66,14 @@ bool dump_asm = true;
 bool dump_dot = true;
 bool run_dot  = true;
 bool run_gcc  = false;
+bool use_mmap = false;
+bool prelex   = false;
+int  lex_threads = 0;
+int  parse_threads = 1;
+int  jobs     = 1;
+bool server   = false;
 string rte_path = "rte/IA32/";
+string cache_dir = "";
 vector<string> files;
 
 
@@ -66,11 +87,18 @@ void Syntax(string msg)
        << endl
        << "Options:" << endl
        << "  --ast          output the AST in textual/graphical form. Default: off" << endl
-       << "  --tac          output the IR in textual/graphical form. Default: off" << endl
+       << "  --tac          output the IR (textual/graphical) and constant propagation statistics. Default: off" << endl
        << "  --exe          generate executable from compiled assembly file. Default: off" << endl
        << "  --no-asm       output assembly code to console instead of a file. Default: file" << endl
        << "  --no-dot       do not output the AST/IR in graphical form. Default: output in graphical form" << endl
        << "  --no-run-dot   do not run the dot command automatically. Default: run automatically" << endl
+       << "  --mmap         scan the source from a memory-mapped buffer. Default: istream" << endl
+       << "  --prelex       scan the whole source into a token buffer before parsing. Default: off" << endl
+       << "  --lex-threads N  pre-lex the memory-mapped source with N threads. Default: off" << endl
+       << "  --parse-threads N  parse subroutine bodies with N threads (implies --prelex). Default: 1" << endl
+       << "  --server       run as a language server (LSP over stdin/stdout). Default: off" << endl
+       << "  --cache DIR    load/store type checked ASTs in the cache directory DIR. Default: off" << endl
+       << "  -j N           compile N files in parallel. Default: 1" << endl
        << endl
        << endl
        << "Examples:" << endl
@@ -85,8 +113,12 @@ void Syntax(string msg)
        << "  $ snuplc --ast fibonacci.mod" << endl
        << endl
        << "  compile fibonacci.mod and also output the IR in textual and graphical form" << endl
-       << "  The IR is saved in fibonacci.mod.tac (textual) and fibonacci.mod.tac.dot (graphical form)" << endl
+       << "  The IR is saved in fibonacci.mod.tac (textual, followed by the constant propagation statistics)" << endl
+       << "  and fibonacci.mod.tac.dot (graphical form)" << endl
        << "  $ snuplc --tac fibonacci.mod" << endl
+       << endl
+       << "  compile all modules in the current directory with 8 threads" << endl
+       << "  $ snuplc -j 8 *.mod" << endl
        << endl;
 
   exit(EXIT_FAILURE);
@@ -104,6 +136,27 @@ void ParseArgs(int argc, char *argv[])
       else if (strcmp(argv[i], "--no-dot") == 0) dump_dot = false;
       else if (strcmp(argv[i], "--no-run-dot") == 0) run_dot = false;
       else if (strcmp(argv[i], "--exe") == 0) run_gcc = true;
+      else if (strcmp(argv[i], "--mmap") == 0) use_mmap = true;
+      else if (strcmp(argv[i], "--prelex") == 0) prelex = true;
+      else if (strcmp(argv[i], "--server") == 0) server = true;
+      else if (strcmp(argv[i], "--lex-threads") == 0) {
+        i++;
+        if (i == argc) Syntax("Missing argument after --lex-threads");
+        lex_threads = atoi(argv[i]);
+        if (lex_threads < 1) Syntax("Invalid argument after --lex-threads");
+      }
+      else if (strcmp(argv[i], "--parse-threads") == 0) {
+        i++;
+        if (i == argc) Syntax("Missing argument after --parse-threads");
+        parse_threads = atoi(argv[i]);
+        if (parse_threads < 1) Syntax("Invalid argument after --parse-threads");
+        if (parse_threads > 1) prelex = true;
+      }
+      else if (strcmp(argv[i], "--cache") == 0) {
+        i++;
+        if (i == argc) Syntax("Missing argument after --cache");
+        cache_dir = string(argv[i]);
+      }
       else if (strcmp(argv[i], "--rte") == 0) {
         i++;
         if (i == argc) Syntax("Missing argument after --rte");
@@ -112,25 +165,83 @@ void ParseArgs(int argc, char *argv[])
       else if (strcmp(argv[i], "--help") == 0) Syntax("");
       else Syntax("Unknown command line option '" + string(argv[i]) + "'.");
     }
+    else if (strcmp(argv[i], "-j") == 0) {
+      i++;
+      if (i == argc) Syntax("Missing argument after -j");
+      jobs = atoi(argv[i]);
+      if (jobs < 1) Syntax("Invalid argument after -j");
+    }
     else files.push_back(string(argv[i]));
     i++;
   }
 }
 
-void RunDOT(string file)
+mutex  commands_lock;               ///< protects commands_running
+size_t commands_running = 0;        ///< number of running external commands
+
+/// @brief wait for one of the running external commands to terminate
+///
+/// must be called with commands_lock held
+void WaitCommand(void)
+{
+  int status;
+
+  while (waitpid(-1, &status, 0) < 0) {
+    if (errno != EINTR) {
+      commands_running = 0;
+      return;
+    }
+  }
+  commands_running--;
+}
+
+/// @brief wait for all external commands to terminate
+void WaitCommands(void)
+{
+  lock_guard<mutex> guard(commands_lock);
+  while (commands_running > 0) WaitCommand();
+}
+
+/// @brief start an external command without waiting for it to terminate
+///
+/// the command runs in a child process (through the shell) while the
+/// compilation continues. At most 2*jobs commands run at the same time;
+/// if the limit is reached, one of them is waited for first.
+///
+/// @param cmd command
+/// @param log output stream for messages
+/// @retval true if the command has been started
+bool RunCommand(const string &cmd, ostream &log)
+{
+  const char *argv[] = { "sh", "-c", cmd.c_str(), NULL };
+  lock_guard<mutex> guard(commands_lock);
+  pid_t pid;
+
+  while (commands_running >= 2*(size_t)jobs) WaitCommand();
+
+  log << "  running command '" << cmd << "'..." << endl;
+  if (posix_spawn(&pid, "/bin/sh", NULL, NULL, (char* const*)argv,
+                  environ) != 0) {
+    return false;
+  }
+
+  commands_running++;
+  return true;
+}
+
+void RunDOT(string file, ostream &log)
 {
   if (run_dot) {
     ostringstream cmd;
     cmd << "dot -Tpdf -o" << file << ".pdf " << file;
 
-    cout << "  running command '" << cmd.str() << "'..." << endl;
-    if (system(cmd.str().c_str()) < 0) {
-      cout << "  failed to run dot." << endl;
+    if (!RunCommand(cmd.str(), log)) {
+      log << "  failed to run dot." << endl;
     }
   }
 }
 
-void RunCompile(string file)
+void RunCompile(string file, ostream &log)
 {
   if (run_gcc) {
     ostringstream cmd;
@@ -143,14 +254,13 @@ void RunCompile(string file)
         << rte_path << "ARRAY.s" << " "
         << file;
 
-    cout << "  running command '" << cmd.str() << "'..." << endl;
-    if (system(cmd.str().c_str()) < 0) {
-      cout << "  failed to run gcc." << endl;
+    if (!RunCommand(cmd.str(), log)) {
+      log << "  failed to run gcc." << endl;
     }
   }
 }
 
-void DumpAST(string file, CAstModule *ast)
+void DumpAST(string file, CAstModule *ast, ostream &log)
 {
   if (dump_ast) {
     assert(ast != NULL);
@@ -177,20 +287,59 @@ void DumpAST(string file, CAstModule *ast)
       dot << "}" << endl;
       dot.flush();
 
-      RunDOT(fn);
+      RunDOT(fn, log);
     }
   }
 }
 
-void DumpTAC(string file, CModule *m)
+/// @brief print what the constant propagation removed from each scope
+void DumpConstStats(ostream &out, CModule *m)
+{
+  vector<CScope*> scope(1, m);
+  const vector<CScope*> &proc = m->GetSubscopes();
+  scope.insert(scope.end(), proc.begin(), proc.end());
+
+  out << "constant propagation:" << endl
+      << "  " << left << setw(16) << "scope" << right
+      << setw(8) << "uses" << setw(8) << "defs" << setw(10) << "branches"
+      << setw(8) << "blocks" << setw(8) << "instrs" << setw(8) << "jumps"
+      << setw(8) << "labels" << endl;
+
+  CConstStats total;
+  for (size_t s=0; s<=scope.size(); s++) {
+    CConstStats st = total;
+    if (s < scope.size()) {
+      st = scope[s]->GetCodeBlock()->GetConstStats();
+      total.constants    += st.constants;
+      total.folded       += st.folded;
+      total.branches     += st.branches;
+      total.blocks       += st.blocks;
+      total.instructions += st.instructions;
+      total.jumps        += st.jumps;
+      total.labels       += st.labels;
+    }
+
+    out << "  " << left << setw(16)
+        << (s < scope.size() ? scope[s]->GetName() : "total") << right
+        << setw(8) << st.constants << setw(8) << st.folded
+        << setw(10) << st.branches << setw(8) << st.blocks
+        << setw(8) << st.instructions << setw(8) << st.jumps
+        << setw(8) << st.labels << endl;
+  }
+  out << endl;
+}
+
+void DumpTAC(string file, CModule *m, ostream &log)
 {
   if (dump_tac) {
     assert(m != NULL);
 
-    // output TAC in textual form
+    // output TAC in textual form followed by the constant propagation
+    // statistics
     ofstream out(file + ".tac");
     out << file << ":" << endl
         << m << endl;
+    DumpConstStats(out, m);
 
     // output TAC in graphical form
     if (dump_dot) {
@@ -210,65 +359,223 @@ void DumpTAC(string file, CModule *m)
       dot<< "}" << endl;
       dot.flush();
 
-      RunDOT(fn);
+      RunDOT(fn, log);
     }
   }
 }
 
-int main(int argc, char *argv[])
+/// @brief compile a module
+///
+/// the module is compiled in a compilation context of its own, i.e., its
+/// types and the names of its string constants do not depend on the other
+/// modules. Its AST, symbols, and TAC are allocated from the current arena
+/// which is released after the module has been compiled.
+///
+/// @param file source file
+/// @param cache AST cache (or NULL)
+/// @param log output stream for messages (and the assembly if !dump_asm)
+void Compile(const string &file, const CAstCache *cache, ostream &log)
 {
-  ParseArgs(argc, argv);
+  CCompilation *compilation = new CCompilation();
+  CCompilation *prev = CCompilation::SetCurrent(compilation);
+
+  // scanning, parsing & semantical analysis
+  CSourceBuffer *buf = NULL;
+  CTokenBuffer *tokens = NULL;
+  ifstream *in = NULL;
+  CScanner *s = NULL;
+  CParser *p = NULL;
+  CAstNode *ast = NULL;
+
+  if (use_mmap || (lex_threads > 0) || (cache != NULL)) {
+    buf = new CSourceBuffer(file);
+  }
 
-  vector<string>::const_iterator it = files.begin();
+  // a module whose source is unchanged is loaded from the cache; scanning,
+  // parsing, and type checking are skipped
+  if ((cache != NULL) && buf->Good()) {
+    ast = cache->Load(buf->GetData(), buf->GetSize());
+    if (ast != NULL) {
+      CLineTable::Get()->SetSource(buf->GetData(), buf->GetSize());
+      CLineTable::Get()->Release(buf->GetData());
+    }
+  }
 
-  if (it == files.end()) Syntax("No input files.");
+  if (ast != NULL) {
+    // skip scanning and parsing
+  } else if (lex_threads > 0) {
+    tokens = new CTokenBuffer();
+    CScanner::Tokenize(buf, tokens, lex_threads);
+    p = new CParser(tokens);
+  } else {
+    if (buf != NULL) s = new CScanner(buf);
+    else s = new CScanner(in = new ifstream(file));
+
+    if (prelex) {
+      tokens = new CTokenBuffer();
+      s->Tokenize(tokens);
+      p = new CParser(tokens);
+    } else {
+      p = new CParser(s);
+    }
+  }
 
-  while (it != files.end()) {
-    string file = *it++;
+  log << "compiling " << file << "..." << endl;
+  if (ast == NULL) {
+    ast = p->Parse(parse_threads);
 
-    // scanning, parsing & semantical analysis
-    CScanner *s = new CScanner(new ifstream(file));
-    CParser *p = new CParser(s);
+    if (!p->HasError() && (cache != NULL) && buf->Good()) {
+      cache->Save(buf->GetData(), buf->GetSize(),
+                  dynamic_cast<CAstModule*>(ast));
+    }
+  }
 
-    cout << "compiling " << file << "..." << endl;
-    CAstNode *ast = p->Parse();
+  if ((p != NULL) && p->HasError()) {
+    const vector<CSourceError> &errors = p->GetErrors();
+    for (size_t i=0; i<errors.size(); i++) {
+      log << "parse error at " << errors[i].token.GetLineNumber() << ":"
+          << errors[i].token.GetCharPosition() << " : "
+          << errors[i].message << endl;
+    }
+  } else {
+    DumpAST(file, dynamic_cast<CAstModule*>(ast), log);
 
-    if (p->HasError()) {
-      const CToken *error = p->GetErrorToken();
-      cout << "parse error at " << error->GetLineNumber() << ":"
-           << error->GetCharPosition() << " : "
-           << p->GetErrorMessage() << endl;
-    } else {
-      DumpAST(file, dynamic_cast<CAstModule*>(ast));
+    // AST to TAC conversion
+    CModule *m = new CModule(ast);
 
-      // AST to TAC conversion
-      CModule *m = new CModule(ast);
+    DumpTAC(file, m, log);
 
-      DumpTAC(file, m);
+    // leave SSA form before code generation
+    m->GetCodeBlock()->FromSSA();
+    const vector<CScope*> &proc = m->GetSubscopes();
+    for (size_t p=0; p<proc.size(); p++) proc[p]->GetCodeBlock()->FromSSA();
 
-      // output x86 assembly to console or file
-      ostream *out = &cout;
-      ofstream *sout = NULL;
+    // output x86 assembly to console or file
+    ostream *out = &log;
+    ofstream *sout = NULL;
 
-      if (dump_asm) {
-        sout = new ofstream(file + ".s");
-        out = sout;
-      }
+    if (dump_asm) {
+      sout = new ofstream(file + ".s");
+      out = sout;
+    }
 
-      CBackend *be = new CBackendx86(*out);
-      be->Emit(m);
+    CBackend *be = new CBackendx86(*out, compilation);
+    be->Emit(m);
 
-      if (sout != NULL) {
-        sout->flush();
-        delete sout;
-      }
+    if (sout != NULL) {
+      sout->flush();
+      delete sout;
+    }
 
-      RunCompile(file + ".s");
+    RunCompile(file + ".s", log);
 
-      delete be;
-      delete m;
-    }
+    delete be;
+    delete m;
+  }
+
+  delete p;
+  delete s;
+  delete in;
+  delete tokens;
+  delete buf;
+  CArena::GetCurrent()->Release();
+
+  CCompilation::SetCurrent(prev);
+  delete compilation;
+}
+
+/// @brief output of the compiled modules
+///
+/// the modules are compiled in any order, but their output is written to
+/// the console in the order of the input files as soon as the output of all
+/// preceding modules has been written.
+struct COutput {
+  mutex  lock;                      ///< lock
+  vector<string> text;              ///< output of the modules
+  vector<bool> done;                ///< modules that have been compiled
+  size_t written;                   ///< number of modules written
+};
+
+/// @brief record the output of a compiled module and write all output that
+///        is due
+/// @param output output of the modules
+/// @param i index of the module
+/// @param text output of module @a i
+void Report(COutput *output, size_t i, const string &text)
+{
+  lock_guard<mutex> guard(output->lock);
+
+  output->text[i] = text;
+  output->done[i] = true;
+
+  while ((output->written < output->done.size()) &&
+         output->done[output->written]) {
+    cout << output->text[output->written];
+    string().swap(output->text[output->written]);
+    output->written++;
+  }
+  cout.flush();
+}
+
+/// @brief compile modules until no module is left
+///
+/// each worker compiles from an arena of its own that is released after
+/// each module. The workers take the next module from a shared counter, so
+/// that modules are started in input order and little output is held back.
+///
+/// @param next index of the next module to compile
+/// @param cache AST cache (or NULL)
+/// @param output output of the modules
+void CompileFiles(atomic<size_t> *next, const CAstCache *cache,
+                  COutput *output)
+{
+  CArena arena;
+  CArena *prev = CArena::SetCurrent(&arena);
+  size_t i;
+
+  while ((i = (*next)++) < files.size()) {
+    ostringstream log;
+    Compile(files[i], cache, log);
+    Report(output, i, log.str());
   }
 
+  CArena::SetCurrent(prev);
+}
+
+int main(int argc, char *argv[])
+{
+  ParseArgs(argc, argv);
+
+  if (server) {
+    CLspServer lsp(&cin, &cout);
+    return lsp.Run();
+  }
+
+  if (files.empty()) Syntax("No input files.");
+
+  CAstCache *cache = NULL;
+  if (cache_dir != "") cache = new CAstCache(cache_dir);
+
+  // compile the modules on a pool of threads (the calling thread included)
+  size_t nworkers = min((size_t)jobs, files.size());
+  atomic<size_t> next(0);
+  COutput output;
+  vector<thread> worker;
+
+  output.text.resize(files.size());
+  output.done.resize(files.size(), false);
+  output.written = 0;
+
+  for (size_t w=1; w<nworkers; w++) {
+    worker.push_back(thread(CompileFiles, &next, cache, &output));
+  }
+  CompileFiles(&next, cache, &output);
+  for (size_t w=0; w<worker.size(); w++) worker[w].join();
+
+  // wait for dot and gcc
+  WaitCommands();
+
+  delete cache;
+
   return EXIT_SUCCESS;
 }
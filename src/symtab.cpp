@@ -33,7 +33,9 @@
 
 #include <cassert>
 #include <iomanip>
+#include <algorithm>
 
+#include "scanner.h"
 #include "symtab.h"
 using namespace std;
 
@@ -42,20 +44,32 @@ using namespace std;
 // CSymbol
 //
 CSymbol::CSymbol(const string name, ESymbolType stype, const CType *dtype)
-  : _name(name), _symboltype(stype), _datatype(dtype), _data(NULL), 
-    _rbase(""), _offset(0), _symtab(NULL)
+  : _symtab(NULL), _id(-1), _name(CStringPool::Get()->Intern(name)),
+    _symboltype(stype), _datatype(dtype), _data(NULL), _rbase(""), _offset(0)
 {
-  assert(_name != "");
+  assert(*_name != "");
   assert(_datatype != NULL);
 }
 
 CSymbol::~CSymbol(void)
 {
+  delete _data;
 }
 
-string CSymbol::GetName(void) const
+/// @brief run the destructor of an arena-allocated symbol
+static void DestroySymbol(void *p)
 {
-  return _name;
+  static_cast<CSymbol*>(p)->~CSymbol();
+}
+
+void* CSymbol::operator new(size_t size)
+{
+  return CArena::New(size, DestroySymbol);
+}
+
+void CSymbol::operator delete(void *p)
+{
+  CArena::Delete(p);
 }
 
 ESymbolType CSymbol::GetSymbolType(void) const
@@ -73,9 +87,10 @@ const CType* CSymbol::GetDataType(void) const
   return _datatype;
 }
 
-void CSymbol::SetSymbolTable(CSymtab *symtab)
+void CSymbol::SetSymbolTable(CSymtab *symtab, int id)
 {
   _symtab = symtab;
+  _id = id;
 }
 
 CSymtab* CSymbol::GetSymbolTable(void) const
@@ -85,6 +100,7 @@ CSymtab* CSymbol::GetSymbolTable(void) const
 
 void CSymbol::SetData(const CDataInitializer *data)
 {
+  if (_data != data) delete _data;
   _data = data;
 }
 
@@ -219,6 +235,11 @@ CSymProc::CSymProc(const string name, const CType *return_type)
 {
 }
 
+CSymProc::~CSymProc(void)
+{
+  for (size_t i=0; i<_param.size(); i++) CArena::Dispose(_param[i]);
+}
+
 void CSymProc::SetReturnType(const CType *return_type)
 {
   SetDataType(return_type);
@@ -273,9 +294,9 @@ CSymtab::CSymtab(CSymtab *parent)
 
 CSymtab::~CSymtab(void)
 {
-  map<string, CSymbol*>::const_iterator it = _symtab.begin();
-  while (it != _symtab.end()) delete (*it++).second;
-  _symtab.clear();
+  for (size_t i=0; i<_symbols.size(); i++) CArena::Dispose(_symbols[i]);
+  _symbols.clear();
+  _index.clear();
 }
 
 bool CSymtab::AddSymbol(CSymbol *s)
@@ -287,37 +308,74 @@ bool CSymtab::AddSymbol(CSymbol *s)
     return _parent->AddSymbol(s);
   }
 
-  if (!FindSymbol(s->GetName(), sLocal)) {
-    _symtab[s->GetName()] = s;
-    s->SetSymbolTable(this);
-    return true;
-  } else {
-    return false;
-  }
+  if (!_index.insert(make_pair(s->GetInternedName(), s)).second) return false;
+
+  s->SetSymbolTable(this, (int)_symbols.size());
+  _symbols.push_back(s);
+  return true;
+}
+
+const CSymbol* CSymtab::FindSymbol(const string &name, EScope scope) const
+{
+  return FindSymbol(CStringPool::Get()->Intern(name), scope);
 }
 
-const CSymbol* CSymtab::FindSymbol(const string name, EScope scope) const
+const CSymbol* CSymtab::FindSymbol(const string *name, EScope scope) const
 {
-  map<string, CSymbol*>::const_iterator it = _symtab.find(name);
+  const CSymtab *st = this;
 
-  if (it != _symtab.end()) return (*it).second;
-  else {
-    if ((scope == sLocal) || (_parent == NULL)) return NULL;
-    else return _parent->FindSymbol(name, scope);
+  do {
+    unordered_map<const string*, CSymbol*>::const_iterator it =
+      st->_index.find(name);
+    if (it != st->_index.end()) return it->second;
+
+    st = st->_parent;
+  } while ((scope != sLocal) && (st != NULL));
+
+  return NULL;
+}
+
+bool CSymtab::RemoveSymbol(const CSymbol *s)
+{
+  assert(s != NULL);
+
+  unordered_map<const string*, CSymbol*>::iterator it =
+    _index.find(s->GetInternedName());
+
+  if ((it == _index.end()) || (it->second != s)) return false;
+
+  CSymbol *sym = it->second;
+  size_t id = sym->GetID();
+
+  _index.erase(it);
+  _symbols.erase(_symbols.begin() + id);
+  for (size_t i=id; i<_symbols.size(); i++) {
+    _symbols[i]->SetSymbolTable(this, (int)i);
   }
+  sym->SetSymbolTable(this, -1);
+
+  return true;
 }
 
-vector<CSymbol*> CSymtab::GetSymbols(void) const
+bool CSymtab::MoveSymbol(const CSymbol *s, int id)
 {
-  vector<CSymbol*> _res;
+  assert((s != NULL) && (id >= 0));
+
+  unordered_map<const string*, CSymbol*>::iterator it =
+    _index.find(s->GetInternedName());
+
+  if ((it == _index.end()) || (it->second != s)) return false;
+
+  CSymbol *sym = it->second;
+  size_t from = sym->GetID(), to = min((size_t)id, _symbols.size()-1);
 
-  map<string, CSymbol*>::const_iterator it = _symtab.begin();
-  while (it != _symtab.end()) {
-    _res.push_back(it->second);
-    it++;
+  _symbols.erase(_symbols.begin() + from);
+  _symbols.insert(_symbols.begin() + to, sym);
+  for (size_t i=min(from, to); i<=max(from, to); i++) {
+    _symbols[i]->SetSymbolTable(this, (int)i);
   }
 
-  return _res;
+  return true;
 }
 
 ostream& CSymtab::print(ostream &out, int indent) const
@@ -325,11 +383,10 @@ ostream& CSymtab::print(ostream &out, int indent) const
   string ind(indent, ' ');
 
   out << ind << "[[";
-  map<string, CSymbol*>::const_iterator it = _symtab.begin();
-  while (it != _symtab.end()) {
+  for (size_t i=0; i<_symbols.size(); i++) {
     out << endl;
 
-    const CSymbol *s = (*it++).second;
+    const CSymbol *s = _symbols[i];
     s->print(out, indent+2);
 
     const CDataInitializer *di = s->GetData();
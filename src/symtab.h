@@ -34,9 +34,10 @@
 #define __SnuPL_SYMTAB_H__
 
 #include <iostream>
-#include <map>
+#include <unordered_map>
 #include <vector>
 
+#include "arena.h"
 #include "data.h"
 #include "type.h"
 using namespace std;
@@ -77,12 +78,41 @@ class CSymbol {
 
     /// @}
 
+    /// @name arena allocation
+    /// @{
+
+    /// @brief allocate a symbol from the current arena (or the heap)
+    static void* operator new(size_t size);
+
+    /// @brief free a symbol allocated by operator new
+    static void operator delete(void *p);
+
+    /// @}
+
     /// @name symbol handling
     /// @{
 
     /// @brief return the symbol's identifier
     /// @retval string name
-    string GetName(void) const;
+    const string& GetName(void) const { return *_name; };
+
+    /// @brief return the symbol's identifier interned in the string pool
+    ///
+    /// symbols with the same name have the same interned name, i.e., names
+    /// can be compared and hashed by address (see CStringPool).
+    ///
+    /// @retval string interned name
+    const string* GetInternedName(void) const { return _name; };
+
+    /// @brief return the symbol's ID
+    ///
+    /// the IDs of the symbols of a symbol table are dense and follow the
+    /// declaration order: the n-th symbol added to a symbol table has the
+    /// ID n-1. They can be used to index arrays or bit sets of the symbols of
+    /// a scope.
+    ///
+    /// @retval int ID (-1 if the symbol is not in a symbol table)
+    int GetID(void) const { return _id; };
 
     /// @brief return the symbol's type
     /// @retval ESymbolType symbol type
@@ -106,6 +136,9 @@ class CSymbol {
     /// @{
 
     /// @brief set the symbol's value (for initialized symbols)
+    ///
+    /// the symbol takes ownership of the data initializer
+    ///
     /// @param data data initializer
     virtual void SetData(const CDataInitializer *data);
 
@@ -143,12 +176,14 @@ class CSymbol {
 
     /// @brief set the symbol table owning this symbol
     /// @param symtab symbol table
-    void SetSymbolTable(CSymtab *symtab);
+    /// @param id ID of the symbol in @a symtab
+    void SetSymbolTable(CSymtab *symtab, int id);
 
     /// @}
 
     CSymtab       *_symtab;       ///< symbol table owning this symbol
-    string         _name;         ///< name
+    int            _id;           ///< ID in the symbol table
+    const string  *_name;         ///< name (interned)
     ESymbolType    _symboltype;   ///< symbol type
     const CType   *_datatype;     ///< data type
     const CDataInitializer *_data;///< data initializer
@@ -300,6 +335,9 @@ class CSymProc : public CSymbol {
     /// @param return_type return type (NULL if none)
     CSymProc(const string name, const CType *return_type);
 
+    /// @brief destructor
+    virtual ~CSymProc(void);
+
     /// @}
 
     /// @name property handling
@@ -344,7 +382,9 @@ enum EScope {
 //------------------------------------------------------------------------------
 /// @brief SnuPL symbol table
 ///
-/// hierarchical symbol table
+/// hierarchical symbol table. The symbols of a table are kept in declaration
+/// order and numbered densely (see CSymbol::GetID()); a hash table on the
+/// interned names maps names to symbols.
 ///
 class CSymtab {
   public:
@@ -375,10 +415,45 @@ class CSymtab {
     /// @param name symbol name (identifier)
     /// @param scope search scope (default: sGlobal)
     /// @retval CSymbol matching symbol or NULL if not found
-    const CSymbol* FindSymbol(const string name, EScope scope=sGlobal) const;
+    const CSymbol* FindSymbol(const string &name, EScope scope=sGlobal) const;
+
+    /// @brief return a symbol with a given interned name
+    ///
+    /// faster than looking up a name that has yet to be interned, e.g., for
+    /// the values of tokens (see CToken::GetInternedValue())
+    ///
+    /// @param name symbol name (identifier) interned in the string pool
+    /// @param scope search scope (default: sGlobal)
+    /// @retval CSymbol matching symbol or NULL if not found
+    const CSymbol* FindSymbol(const string *name, EScope scope=sGlobal) const;
+
+    /// @brief remove a symbol from the local symbol table
+    ///
+    /// the symbol is not deleted; its ownership passes to the caller. The
+    /// symbols declared after @a s are renumbered.
+    ///
+    /// @param s symbol
+    /// @retval true if the symbol was removed
+    /// @retval false if @a s is not in the local symbol table
+    bool RemoveSymbol(const CSymbol *s);
+
+    /// @brief move a symbol to another position in the declaration order
+    ///
+    /// the symbols between the old and the new position are renumbered.
+    ///
+    /// @param s symbol
+    /// @param id new ID of @a s (clamped to the last position)
+    /// @retval true if the symbol was moved
+    /// @retval false if @a s is not in the local symbol table
+    bool MoveSymbol(const CSymbol *s, int id);
+
+    /// @brief return all symbols in declaration order
+    ///
+    /// the symbol with the ID i is at index i.
+    const vector<CSymbol*>& GetSymbols(void) const { return _symbols; };
 
-    /// @brief return a list of all symbols
-    vector<CSymbol*> GetSymbols(void) const;
+    /// @brief return the number of symbols
+    size_t GetNumSymbols(void) const { return _symbols.size(); };
 
     /// @}
 
@@ -389,7 +464,8 @@ class CSymtab {
     ostream&  print(ostream &out, int indent=0) const;
 
   private:
-    map<string, CSymbol*> _symtab;///< local symbol table
+    vector<CSymbol*> _symbols;    ///< local symbols in declaration order
+    unordered_map<const string*, CSymbol*> _index; ///< interned name -> symbol
     CSymtab       *_parent;       ///< parent
 };
 
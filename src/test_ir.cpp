@@ -30,19 +30,1441 @@
 /// DAMAGE.
 //------------------------------------------------------------------------------
 
+#include <algorithm>
 #include <cstdlib>
+#include <atomic>
+#include <cstring>
 #include <iostream>
+#include <map>
+#include <set>
 #include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <thread>
 
+#include "arena.h"
+#include "compilation.h"
 #include "scanner.h"
 #include "parser.h"
 #include "ir.h"
+#include "backend.h"
 using namespace std;
 
+/// @brief convert a module to TAC in a compilation context of its own
+///
+/// @param file source file
+/// @retval string TAC (or the parse errors) in textual form
+string CompileTAC(const string &file)
+{
+  CCompilation compilation;
+  CArena arena;
+  CCompilation *prev = CCompilation::SetCurrent(&compilation);
+  CArena *prev_arena = CArena::SetCurrent(&arena);
+  ostringstream out;
+
+  ifstream in(file);
+  CScanner *s = new CScanner(&in);
+  CParser *p = new CParser(s);
+  CAstNode *ast = p->Parse();
+
+  if (p->HasError()) {
+    const vector<CSourceError> &errors = p->GetErrors();
+    for (size_t i=0; i<errors.size(); i++) {
+      out << "parse error : at " << errors[i].token.GetLineNumber() << ":"
+          << errors[i].token.GetCharPosition() << " : "
+          << errors[i].message << endl;
+    }
+  } else {
+    CModule *m = new CModule(ast);
+    out << m << endl;
+    delete m;
+  }
+
+  delete p;
+  delete s;
+  arena.Release();
+
+  CArena::SetCurrent(prev_arena);
+  CCompilation::SetCurrent(prev);
+
+  return out.str();
+}
+
+/// @brief convert modules to TAC concurrently and compare the result with a
+///        sequential conversion
+///
+/// each module is converted in a compilation context of its own; the
+/// output must not depend on the other modules or on the thread schedule.
+///
+/// @param files source files
+/// @param nthreads number of threads
+/// @retval true if the outputs are identical
+bool TestConcurrent(const vector<string> &files, int nthreads)
+{
+  vector<string> seq(files.size()), par(files.size());
+  atomic<size_t> next(0);
+  vector<thread> worker;
+
+  for (size_t i=0; i<files.size(); i++) seq[i] = CompileTAC(files[i]);
+
+  for (int t=0; t<nthreads; t++) {
+    worker.push_back(thread([&]() {
+      size_t i;
+      while ((i = next++) < files.size()) par[i] = CompileTAC(files[i]);
+    }));
+  }
+  for (size_t t=0; t<worker.size(); t++) worker[t].join();
+
+  size_t mismatches = 0;
+  for (size_t i=0; i<files.size(); i++) {
+    if (seq[i] != par[i]) {
+      cout << "  " << files[i] << ": concurrent output differs." << endl;
+      mismatches++;
+    }
+  }
+
+  cout << "concurrent conversion (" << nthreads << " threads):" << endl
+       << "  modules:     " << files.size() << endl
+       << "  mismatches:  " << mismatches << endl;
+
+  return mismatches == 0;
+}
+
+/// @brief check the control flow graph of a code block
+///
+/// the dominators are recomputed with the iterative data-flow formulation
+/// dom(b) = {b} + intersection of dom(p) over all predecessors p and compared
+/// with Dominates() and the immediate dominators. The blocks must partition
+/// the instructions, the edges must be symmetric, and every back edge must
+/// belong to a loop with the proper nesting.
+///
+/// @param cb code block
+/// @param out output stream for error messages
+/// @retval number of errors
+size_t CheckCFG(const CCodeBlock *cb, ostream &out)
+{
+  const vector<CBasicBlock*> &bb = cb->GetBlocks();
+  size_t n = bb.size(), errors = 0;
+  string name = cb->GetName();
+
+  // blocks partition the instructions in order
+  list<CTacInstr*> instr;
+  for (size_t b=0; b<n; b++) {
+    instr.insert(instr.end(), bb[b]->GetInstr().begin(), bb[b]->GetInstr().end());
+  }
+  if (instr != cb->GetInstr()) {
+    out << "  " << name << ": blocks do not partition the instructions" << endl;
+    errors++;
+  }
+
+  // edges are symmetric
+  for (size_t b=0; b<n; b++) {
+    const vector<CBasicBlock*> &succ = bb[b]->GetSucc();
+    for (size_t s=0; s<succ.size(); s++) {
+      const vector<CBasicBlock*> &pred = succ[s]->GetPred();
+      if (find(pred.begin(), pred.end(), bb[b]) == pred.end()) {
+        out << "  " << name << ": edge B" << b << "->B" << succ[s]->GetId()
+            << " missing in pred" << endl;
+        errors++;
+      }
+    }
+  }
+
+  // dominator sets
+  vector<vector<bool> > dom(n, vector<bool>(n, true));
+  dom[0].assign(n, false);
+  dom[0][0] = true;
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (size_t b=1; b<n; b++) {
+      vector<bool> d(n, true);
+      const vector<CBasicBlock*> &pred = bb[b]->GetPred();
+      for (size_t p=0; p<pred.size(); p++) {
+        if (!pred[p]->IsReachable()) continue;
+        for (size_t i=0; i<n; i++) d[i] = d[i] && dom[pred[p]->GetId()][i];
+      }
+      d[b] = true;
+      if (d != dom[b]) { dom[b] = d; changed = true; }
+    }
+  }
+
+  for (size_t b=0; b<n; b++) {
+    if (!bb[b]->IsReachable()) continue;
+    for (size_t a=0; a<n; a++) {
+      if (!bb[a]->IsReachable()) continue;
+      if (bb[a]->Dominates(bb[b]) != dom[b][a]) {
+        out << "  " << name << ": B" << a << " dom B" << b << " is "
+            << dom[b][a] << endl;
+        errors++;
+      }
+    }
+
+    // the immediate dominator is the strict dominator closest to b
+    CBasicBlock *idom = bb[b]->GetIDom();
+    if ((b == 0) != (idom == NULL)) {
+      out << "  " << name << ": B" << b << " has a wrong idom" << endl;
+      errors++;
+    } else if (idom != NULL) {
+      for (size_t a=0; a<n; a++) {
+        if ((a != b) && dom[b][a] && !dom[idom->GetId()][a]) {
+          out << "  " << name << ": B" << b << " has a wrong idom" << endl;
+          errors++;
+          break;
+        }
+      }
+    }
+  }
+
+  // every back edge belongs to the loop of its header
+  const vector<CLoop*> &loops = cb->GetLoops();
+  for (size_t b=0; b<n; b++) {
+    const vector<CBasicBlock*> &succ = bb[b]->GetSucc();
+    for (size_t s=0; s<succ.size(); s++) {
+      if (!succ[s]->Dominates(bb[b])) continue;
+      bool found = false;
+      for (size_t l=0; l<loops.size(); l++) {
+        if ((loops[l]->GetHeader() == succ[s]) && loops[l]->Contains(bb[b])) {
+          found = true;
+        }
+      }
+      if (!found) {
+        out << "  " << name << ": back edge B" << b << "->B"
+            << succ[s]->GetId() << " not in a loop" << endl;
+        errors++;
+      }
+    }
+  }
+  for (size_t l=0; l<loops.size(); l++) {
+    const CLoop *loop = loops[l];
+    const vector<CBasicBlock*> &blocks = loop->GetBlocks();
+    for (size_t b=0; b<blocks.size(); b++) {
+      if (!loop->GetHeader()->Dominates(blocks[b]) ||
+          !loop->Contains(blocks[b])) {
+        out << "  " << name << ": loop B" << loop->GetHeader()->GetId()
+            << " contains B" << blocks[b]->GetId() << endl;
+        errors++;
+      }
+    }
+    if ((loop->GetParent() != NULL) &&
+        (!loop->GetParent()->Contains(loop->GetHeader()) ||
+         (loop->GetDepth() != loop->GetParent()->GetDepth() + 1))) {
+      out << "  " << name << ": loop B" << loop->GetHeader()->GetId()
+          << " is not nested properly" << endl;
+      errors++;
+    }
+  }
+
+  return errors;
+}
+
+/// @brief build and check the control flow graphs of modules
+///
+/// @param files source files
+/// @param verbose print the basic blocks
+/// @retval true if all control flow graphs are consistent
+bool TestCFG(const vector<string> &files, bool verbose)
+{
+  size_t nblocks = 0, nloops = 0, errors = 0;
+
+  for (size_t f=0; f<files.size(); f++) {
+    CCompilation compilation;
+    CArena arena;
+    CCompilation *prev = CCompilation::SetCurrent(&compilation);
+    CArena *prev_arena = CArena::SetCurrent(&arena);
+
+    ifstream in(files[f]);
+    CScanner *s = new CScanner(&in);
+    CParser *p = new CParser(s);
+    CAstNode *ast = p->Parse();
+
+    if (!p->HasError()) {
+      CModule *m = new CModule(ast);
+      vector<CScope*> scopes(1, m);
+      scopes.insert(scopes.end(), m->GetSubscopes().begin(),
+                    m->GetSubscopes().end());
+
+      for (size_t i=0; i<scopes.size(); i++) {
+        const CCodeBlock *cb = scopes[i]->GetCodeBlock();
+        if (verbose) {
+          cout << "[[ " << cb->GetName() << endl;
+          for (size_t b=0; b<cb->GetBlocks().size(); b++) {
+            cb->GetBlocks()[b]->print(cout, 2);
+          }
+          cout << "]]" << endl;
+        }
+        nblocks += cb->GetBlocks().size();
+        nloops += cb->GetLoops().size();
+        errors += CheckCFG(cb, cout);
+      }
+      delete m;
+    }
+
+    delete p;
+    delete s;
+    arena.Release();
+
+    CArena::SetCurrent(prev_arena);
+    CCompilation::SetCurrent(prev);
+  }
+
+  cout << "control flow graphs:" << endl
+       << "  modules:     " << files.size() << endl
+       << "  blocks:      " << nblocks << endl
+       << "  loops:       " << nloops << endl
+       << "  errors:      " << errors << endl;
+
+  return errors == 0;
+}
+
+/// @brief check the SSA form of a code block
+///
+/// in reachable code, every temporary is defined at most once and its
+/// definition dominates its uses (for phi functions: the end of the
+/// corresponding predecessor). Phi
+/// functions have one argument per predecessor and are placed at the
+/// beginning of their block. Locals and parameters whose address is not
+/// taken are never written.
+///
+/// @param cb code block
+/// @param out output stream for error messages
+/// @retval number of errors
+size_t CheckSSA(const CCodeBlock *cb, ostream &out)
+{
+  const vector<CBasicBlock*> &bb = cb->GetBlocks();
+  string name = cb->GetName();
+  size_t errors = 0;
+  map<unsigned int, pair<const CBasicBlock*, size_t> > def;
+  set<const CSymbol*> taken;
+
+  for (size_t b=0; b<bb.size(); b++) {
+    const list<CTacInstr*> &instr = bb[b]->GetInstr();
+    size_t pos = 0;
+    bool body = false;
+
+    for (list<CTacInstr*>::const_iterator it = instr.begin();
+         it != instr.end(); it++, pos++) {
+      const CTacInstr *i = *it;
+      const CTacPhi *phi = dynamic_cast<const CTacPhi*>(i);
+
+      if (i->GetOperation() == opAddress) {
+        taken.insert(dynamic_cast<CTacName*>(i->GetSrc(1))->GetSymbol());
+      }
+      if ((phi != NULL) && (body ||
+                            (phi->GetNumArgs() != bb[b]->GetPred().size()))) {
+        out << "  " << name << ": misplaced phi " << phi->GetId() << endl;
+        errors++;
+      }
+      if ((i->GetOperation() != opLabel) && (phi == NULL)) body = true;
+
+      const CTacTemp *t = dynamic_cast<const CTacTemp*>(i->GetDest());
+      if ((t != NULL) && !i->IsBranch() && bb[b]->IsReachable()) {
+        if (def.find(t->GetId()) != def.end()) {
+          out << "  " << name << ": t" << t->GetId() << " defined twice"
+              << endl;
+          errors++;
+        }
+        def[t->GetId()] = make_pair(bb[b], pos);
+      }
+    }
+  }
+
+  for (size_t b=0; b<bb.size(); b++) {
+    if (!bb[b]->IsReachable()) continue;
+
+    const list<CTacInstr*> &instr = bb[b]->GetInstr();
+    size_t pos = 0;
+
+    for (list<CTacInstr*>::const_iterator it = instr.begin();
+         it != instr.end(); it++, pos++) {
+      const CTacInstr *i = *it;
+      const CTacPhi *phi = dynamic_cast<const CTacPhi*>(i);
+      vector<pair<const CTac*, const CBasicBlock*> > use;
+
+      if (phi != NULL) {
+        for (size_t a=0; a<phi->GetNumArgs(); a++) {
+          use.push_back(make_pair(phi->GetArg(a), bb[b]->GetPred()[a]));
+        }
+      } else {
+        const CTac *op[3] = { i->GetSrc(1), i->GetSrc(2), i->GetDest() };
+        for (int o=0; o<3; o++) {
+          const CTacReference *r = dynamic_cast<const CTacReference*>(op[o]);
+          if (r != NULL) use.push_back(make_pair(r->GetBase(), bb[b]));
+          else if (o < 2) use.push_back(make_pair(op[o], bb[b]));
+        }
+
+        const CTacName *n = dynamic_cast<const CTacName*>(i->GetDest());
+        if ((n != NULL) && !i->IsBranch() &&
+            (dynamic_cast<const CTacReference*>(n) == NULL)) {
+          const CSymbol *s = n->GetSymbol();
+          if (((s->GetSymbolType() == stLocal) ||
+               (s->GetSymbolType() == stParam)) &&
+              !s->GetDataType()->IsArray() && (taken.count(s) == 0)) {
+            out << "  " << name << ": " << s->GetName() << " written" << endl;
+            errors++;
+          }
+        }
+      }
+
+      for (size_t u=0; u<use.size(); u++) {
+        const CTacTemp *t = dynamic_cast<const CTacTemp*>(use[u].first);
+        const CBasicBlock *at = use[u].second;
+        if ((t == NULL) || !at->IsReachable()) continue;
+
+        map<unsigned int, pair<const CBasicBlock*, size_t> >::const_iterator d =
+          def.find(t->GetId());
+        bool ok = (d != def.end()) &&
+                  (d->second.first->Dominates(at) &&
+                   ((d->second.first != bb[b]) || (phi != NULL) ||
+                    (d->second.second < pos)));
+        if (!ok) {
+          out << "  " << name << ": use of t" << t->GetId() << " in "
+              << i->GetId() << " not dominated by its definition" << endl;
+          errors++;
+        }
+      }
+    }
+  }
+
+  return errors;
+}
+
+/// @brief convert modules into SSA form and back and check the code
+///
+/// @param files source files
+/// @param verbose print the code in SSA form
+/// @retval true if the SSA form and the code after leaving it are consistent
+bool TestSSA(const vector<string> &files, bool verbose)
+{
+  size_t nphis = 0, errors = 0;
+
+  for (size_t f=0; f<files.size(); f++) {
+    CCompilation compilation;
+    CArena arena;
+    CCompilation *prev = CCompilation::SetCurrent(&compilation);
+    CArena *prev_arena = CArena::SetCurrent(&arena);
+
+    ifstream in(files[f]);
+    CScanner *s = new CScanner(&in);
+    CParser *p = new CParser(s);
+    CAstNode *ast = p->Parse();
+
+    if (!p->HasError()) {
+      CModule *m = new CModule(ast);
+      vector<CScope*> scopes(1, m);
+      scopes.insert(scopes.end(), m->GetSubscopes().begin(),
+                    m->GetSubscopes().end());
+
+      for (size_t i=0; i<scopes.size(); i++) {
+        CCodeBlock *cb = scopes[i]->GetCodeBlock();
+        if (verbose) cout << cb << endl;
+
+        const list<CTacInstr*> &instr = cb->GetInstr();
+        for (list<CTacInstr*>::const_iterator it = instr.begin();
+             it != instr.end(); it++) {
+          if ((*it)->GetOperation() == opPhi) nphis++;
+        }
+        errors += CheckSSA(cb, cout);
+
+        cb->FromSSA();
+        for (list<CTacInstr*>::const_iterator it = cb->GetInstr().begin();
+             it != cb->GetInstr().end(); it++) {
+          if ((*it)->GetOperation() == opPhi) {
+            cout << "  " << cb->GetName() << ": phi left" << endl;
+            errors++;
+          }
+        }
+        errors += CheckCFG(cb, cout);
+      }
+      delete m;
+    }
+
+    delete p;
+    delete s;
+    arena.Release();
+
+    CArena::SetCurrent(prev_arena);
+    CCompilation::SetCurrent(prev);
+  }
+
+  cout << "SSA form:" << endl
+       << "  modules:     " << files.size() << endl
+       << "  phis:        " << nphis << endl
+       << "  errors:      " << errors << endl;
+
+  return errors == 0;
+}
+
+/// @brief check the code of a code block after the constant propagation
+///
+/// all blocks are reachable, no conditional branch compares two constants,
+/// all labels are referenced, and the successors of each block are those
+/// implied by its last instruction.
+///
+/// @param cb code block
+/// @param out output stream for error messages
+/// @retval number of errors
+size_t CheckConstants(const CCodeBlock *cb, ostream &out)
+{
+  const vector<CBasicBlock*> &bb = cb->GetBlocks();
+  string name = cb->GetName();
+  size_t errors = 0;
+  map<const CTacLabel*, const CBasicBlock*> target;
+
+  for (size_t b=0; b<bb.size(); b++) {
+    const list<CTacInstr*> &instr = bb[b]->GetInstr();
+    for (list<CTacInstr*>::const_iterator it = instr.begin();
+         it != instr.end(); it++) {
+      const CTacLabel *lbl = dynamic_cast<const CTacLabel*>(*it);
+      if (lbl == NULL) continue;
+
+      target[lbl] = bb[b];
+      if (lbl->GetRefCnt() == 0) {
+        out << "  " << name << ": label " << lbl->GetLabel()
+            << " not referenced" << endl;
+        errors++;
+      }
+    }
+  }
+
+  for (size_t b=0; b<bb.size(); b++) {
+    if (!bb[b]->IsReachable()) {
+      out << "  " << name << ": B" << b << " is unreachable" << endl;
+      errors++;
+    }
+
+    const CTacInstr *last = bb[b]->GetInstr().empty() ?
+                            NULL : bb[b]->GetInstr().back();
+    set<const CBasicBlock*> succ;
+    bool fallthrough = true;
+
+    if ((last != NULL) && last->IsBranch()) {
+      succ.insert(target[dynamic_cast<const CTacLabel*>(last->GetDest())]);
+      fallthrough = last->GetOperation() != opGoto;
+
+      if (IsRelOp(last->GetOperation()) &&
+          (dynamic_cast<const CTacConst*>(last->GetSrc(1)) != NULL) &&
+          (dynamic_cast<const CTacConst*>(last->GetSrc(2)) != NULL)) {
+        out << "  " << name << ": branch " << last->GetId()
+            << " not folded" << endl;
+        errors++;
+      }
+    } else if ((last != NULL) && (last->GetOperation() == opReturn)) {
+      fallthrough = false;
+    }
+    if (fallthrough && (b+1 < bb.size())) succ.insert(bb[b+1]);
+
+    const vector<CBasicBlock*> &s = bb[b]->GetSucc();
+    if (set<const CBasicBlock*>(s.begin(), s.end()) != succ) {
+      out << "  " << name << ": B" << b << " has wrong successors" << endl;
+      errors++;
+    }
+  }
+
+  return errors;
+}
+
+/// @brief check the code after the constant propagation, convert it out of
+///        SSA form, and check it again
+///
+/// @param files source files
+/// @param verbose print the code after the constant propagation
+/// @retval true if the code is consistent
+bool TestConstants(const vector<string> &files, bool verbose)
+{
+  size_t errors = 0;
+  CConstStats total;
+
+  for (size_t f=0; f<files.size(); f++) {
+    CCompilation compilation;
+    CArena arena;
+    CCompilation *prev = CCompilation::SetCurrent(&compilation);
+    CArena *prev_arena = CArena::SetCurrent(&arena);
+
+    ifstream in(files[f]);
+    CScanner *s = new CScanner(&in);
+    CParser *p = new CParser(s);
+    CAstNode *ast = p->Parse();
+
+    if (!p->HasError()) {
+      CModule *m = new CModule(ast);
+      vector<CScope*> scopes(1, m);
+      scopes.insert(scopes.end(), m->GetSubscopes().begin(),
+                    m->GetSubscopes().end());
+
+      for (size_t i=0; i<scopes.size(); i++) {
+        CCodeBlock *cb = scopes[i]->GetCodeBlock();
+        if (verbose) cout << cb << endl;
+
+        const CConstStats &st = cb->GetConstStats();
+        total.constants += st.constants;
+        total.folded += st.folded;
+        total.branches += st.branches;
+        total.blocks += st.blocks;
+        total.labels += st.labels;
+
+        errors += CheckConstants(cb, cout);
+        errors += CheckCFG(cb, cout);
+        errors += CheckSSA(cb, cout);
+
+        cb->FromSSA();
+        errors += CheckCFG(cb, cout);
+      }
+      delete m;
+    }
+
+    delete p;
+    delete s;
+    arena.Release();
+
+    CArena::SetCurrent(prev_arena);
+    CCompilation::SetCurrent(prev);
+  }
+
+  cout << "constant propagation:" << endl
+       << "  modules:     " << files.size() << endl
+       << "  constants:   " << total.constants << endl
+       << "  folded:      " << total.folded << endl
+       << "  branches:    " << total.branches << endl
+       << "  blocks:      " << total.blocks << endl
+       << "  labels:      " << total.labels << endl
+       << "  errors:      " << errors << endl;
+
+  return errors == 0;
+}
+
+//------------------------------------------------------------------------------
+// TAC interpreter
+//
+
+/// @brief x86 backend that only lays out the stack frames of the scopes
+///
+/// the interpreter keeps parameters, locals and temporaries at the offsets
+/// the backend assigns, so temporaries share stack slots as in the
+/// generated code.
+///
+class CFrameLayout : public CBackendx86 {
+  public:
+    CFrameLayout(ostream &out, CCompilation *compilation)
+      : CBackendx86(out, compilation) {};
+
+    /// @brief lay out the frame of @a scope
+    /// @param scope scope
+    /// @param temp_ofs (out) offsets of the temporaries from the frame base
+    /// @retval size of the locals and temporaries
+    size_t Layout(CScope *scope, vector<int> *temp_ofs)
+    {
+      size_t size = ComputeFrameSize(scope);
+      *temp_ofs = _temp_ofs;
+      return size;
+    };
+
+    /// @brief return the size of an operand in bytes
+    int Size(CTac *t) const { return OperandSize(t); };
+};
+
+/// @brief frame layout and labels of a scope
+struct CFrameInfo {
+  CScope *scope;                    ///< scope
+  size_t size;                      ///< size of the locals and temporaries
+  vector<int> temp_ofs;             ///< offsets of the temporaries
+  size_t nslots;                    ///< number of temporary slots
+  map<const CTac*, list<CTacInstr*>::const_iterator> label; ///< labels
+};
+
+/// @brief interpreter for the TAC of a module
+///
+/// runs the module's code after all IR passes, i.e., the code the backend
+/// emits, on a flat 32-bit memory with the backend's frame layout. Every
+/// read of a temporary checks that its slot was last written by the same
+/// temporary.
+///
+class CTacInterpreter {
+  public:
+    CTacInterpreter(CModule *m, CCompilation *compilation)
+      : _layout(_null, compilation), _mem(MemSize, 0),
+        _owner(MemSize / 4, -1), _sp(MemSize), _heap(16), _steps(0)
+    {
+      Prepare(m);
+      for (size_t i=0; i<m->GetSubscopes().size(); i++) {
+        Prepare(m->GetSubscopes()[i]);
+      }
+      AllocateGlobals(m);
+    };
+
+    /// @brief run the module body
+    /// @retval true if the module ran without error
+    bool Run(void)
+    {
+      Call(&_frame[0], vector<int>());
+      return _error.empty();
+    };
+
+    /// @brief return the output of the module
+    string GetOutput(void) const { return _output.str(); };
+
+    /// @brief return the error that stopped the module (or "")
+    string GetError(void) const { return _error; };
+
+    /// @brief return the number of executed instructions
+    unsigned long long GetSteps(void) const { return _steps; };
+
+    /// @brief return the frame layouts (module first)
+    const vector<CFrameInfo>& GetFrames(void) const { return _frame; };
+
+  private:
+    static const unsigned int MemSize = 4 << 20;
+    static const unsigned long long MaxSteps = 200000000;
+
+    void Prepare(CScope *scope)
+    {
+      CFrameInfo fi;
+      fi.scope = scope;
+      fi.size = _layout.Layout(scope, &fi.temp_ofs);
+
+      set<int> slots(fi.temp_ofs.begin(), fi.temp_ofs.end());
+      fi.nslots = slots.size();
+
+      const list<CTacInstr*> &instr = scope->GetCodeBlock()->GetInstr();
+      for (list<CTacInstr*>::const_iterator it = instr.begin();
+           it != instr.end(); it++) {
+        if ((*it)->GetOperation() == opLabel) fi.label[*it] = it;
+      }
+      _frame.push_back(fi);
+      _proc[scope->GetName()] = _frame.size() - 1;
+    };
+
+    void AllocateGlobals(CModule *m)
+    {
+      const vector<CSymbol*> &slist = m->GetSymbolTable()->GetSymbols();
+
+      for (size_t i=0; i<slist.size(); i++) {
+        const CSymbol *s = slist[i];
+        if (s->GetSymbolType() != stGlobal) continue;
+
+        const CType *t = s->GetDataType();
+        unsigned int align = max(t->GetAlign(), 1);
+        _heap = (_heap + align - 1) / align * align;
+        _global[s] = _heap;
+
+        unsigned int data = Dope(_heap, t);
+        const CDataInitString *di =
+          dynamic_cast<const CDataInitString*>(s->GetData());
+        if (di != NULL) {
+          string v = CToken::unescape(di->GetData());
+          for (size_t c=0; c<v.size(); c++) _mem[data + c] = v[c];
+        }
+        _heap += t->GetSize();
+      }
+    };
+
+    /// @brief write the dope vector of an array at @a addr
+    /// @retval address of the data
+    unsigned int Dope(unsigned int addr, const CType *t)
+    {
+      const CArrayType *a = dynamic_cast<const CArrayType*>(t);
+      if (a == NULL) return addr;
+
+      Write(addr, 4, a->GetNDim());
+      for (int d=0; a != NULL; d++) {
+        Write(addr + 4 + 4*d, 4, a->GetNElem());
+        a = dynamic_cast<const CArrayType*>(a->GetInnerType());
+      }
+      return addr + 4 + 4*dynamic_cast<const CArrayType*>(t)->GetNDim();
+    };
+
+    int Read(unsigned int addr, int size)
+    {
+      if ((addr < 16) || (addr + size > MemSize)) {
+        Fail("invalid memory access at " + to_string(addr));
+        return 0;
+      }
+      if (size == 1) return _mem[addr];
+      return (int)(_mem[addr] | (_mem[addr+1] << 8) | (_mem[addr+2] << 16) |
+                   ((unsigned int)_mem[addr+3] << 24));
+    };
+
+    void Write(unsigned int addr, int size, int value)
+    {
+      if ((addr < 16) || (addr + size > MemSize)) {
+        Fail("invalid memory access at " + to_string(addr));
+        return;
+      }
+      for (int b=0; b<size; b++) _mem[addr + b] = (value >> (8*b)) & 0xff;
+    };
+
+    void Fail(const string &message)
+    {
+      if (_error.empty()) _error = message;
+    };
+
+    /// @brief return the address of a variable
+    unsigned int Address(const CFrameInfo &f, unsigned int ebp, CTac *op)
+    {
+      const CTacReference *r = dynamic_cast<const CTacReference*>(op);
+      if (r != NULL) return Load(f, ebp, r->GetBase());
+
+      const CTacName *n = dynamic_cast<const CTacName*>(op);
+      if (n != NULL) {
+        const CSymbol *s = n->GetSymbol();
+        switch (s->GetSymbolType()) {
+          case stGlobal: return _global[s];
+          case stLocal:
+          case stParam:  return ebp + s->GetOffset();
+          default:       break;
+        }
+      }
+
+      Fail(f.scope->GetName() + ": no address");
+      return 0;
+    };
+
+    int Load(const CFrameInfo &f, unsigned int ebp, CTac *op)
+    {
+      const CTacConst *c = dynamic_cast<const CTacConst*>(op);
+      if (c != NULL) return c->GetValue();
+
+      const CTacTemp *t = dynamic_cast<const CTacTemp*>(op);
+      if (t != NULL) {
+        unsigned int addr = ebp + f.temp_ofs[t->GetId()];
+        if (_owner[addr / 4] != (int)t->GetId()) {
+          Fail(f.scope->GetName() + ": the slot of t" + to_string(t->GetId()) +
+               " was overwritten (last written by " +
+               (_owner[addr / 4] < 0 ? string("none") :
+                "t" + to_string(_owner[addr / 4])) + ")");
+        }
+        return Read(addr, _layout.Size(op));
+      }
+
+      return Read(Address(f, ebp, op), _layout.Size(op));
+    };
+
+    void Store(const CFrameInfo &f, unsigned int ebp, CTac *op, int value)
+    {
+      const CTacTemp *t = dynamic_cast<const CTacTemp*>(op);
+      if (t != NULL) {
+        unsigned int addr = ebp + f.temp_ofs[t->GetId()];
+        _owner[addr / 4] = t->GetId();
+        Write(addr, _layout.Size(op), value);
+        return;
+      }
+
+      Write(Address(f, ebp, op), _layout.Size(op), value);
+    };
+
+    /// @brief call a runtime procedure
+    int CallRuntime(const string &name, const vector<int> &args)
+    {
+      if ((name == "WriteInt") && (args.size() == 1)) {
+        _output << args[0];
+      } else if ((name == "WriteChar") && (args.size() == 1)) {
+        _output << (char)args[0];
+      } else if (name == "WriteLn") {
+        _output << endl;
+      } else if ((name == "WriteStr") && (args.size() == 1)) {
+        unsigned int addr = args[0] + 4 + 4*Read(args[0], 4);
+        for (int ch; _error.empty() && ((ch = Read(addr, 1)) != 0); addr++) {
+          _output << (char)ch;
+        }
+      } else {
+        Fail("unexpected call to " + name);
+      }
+      return 0;
+    };
+
+    int Call(const CFrameInfo *f, const vector<int> &args)
+    {
+      unsigned int sp = _sp;
+
+      // parameters, return address, saved ebp, saved registers
+      _sp -= 4 * args.size();
+      for (size_t i=0; i<args.size(); i++) Write(_sp + 4*i, 4, args[i]);
+      _sp -= 8;
+      unsigned int ebp = _sp;
+      _sp -= 12 + f->size;
+      if (_sp < _heap + 4096) {
+        Fail("stack overflow");
+        _sp = sp;
+        return 0;
+      }
+
+      // the prologue clears the locals and temporaries and initializes the
+      // dope vectors of local arrays
+      for (unsigned int a=_sp; a<ebp; a++) _mem[a] = 0;
+      for (unsigned int a=_sp; a<ebp; a+=4) _owner[a / 4] = -1;
+
+      const vector<CSymbol*> &slist = f->scope->GetSymbolTable()->GetSymbols();
+      for (size_t i=0; i<slist.size(); i++) {
+        if (slist[i]->GetSymbolType() == stLocal) {
+          Dope(ebp + slist[i]->GetOffset(), slist[i]->GetDataType());
+        }
+      }
+
+      const list<CTacInstr*> &instr = f->scope->GetCodeBlock()->GetInstr();
+      list<CTacInstr*>::const_iterator it = instr.begin();
+      vector<int> param;
+      int result = 0;
+
+      while (_error.empty() && (it != instr.end())) {
+        CTacInstr *i = *it++;
+        EOperation op = i->GetOperation();
+
+        if (++_steps > MaxSteps) Fail("too many instructions");
+
+        switch (op) {
+          case opAdd:
+          case opSub:
+          case opMul:
+          case opDiv: {
+            unsigned int a = Load(*f, ebp, i->GetSrc(1));
+            unsigned int b = Load(*f, ebp, i->GetSrc(2));
+            int v = 0;
+            if (op == opAdd) v = (int)(a + b);
+            else if (op == opSub) v = (int)(a - b);
+            else if (op == opMul) v = (int)(a * b);
+            else if (b == 0) Fail("division by zero");
+            else v = (int)a / (int)b;
+            Store(*f, ebp, i->GetDest(), v);
+          } break;
+
+          case opNeg:
+            Store(*f, ebp, i->GetDest(),
+                  (int)(0u - (unsigned int)Load(*f, ebp, i->GetSrc(1))));
+            break;
+
+          case opAssign:
+            Store(*f, ebp, i->GetDest(), Load(*f, ebp, i->GetSrc(1)));
+            break;
+
+          case opAddress:
+            Store(*f, ebp, i->GetDest(), Address(*f, ebp, i->GetSrc(1)));
+            break;
+
+          case opDeref: {
+            unsigned int addr = Load(*f, ebp, i->GetSrc(1));
+            Store(*f, ebp, i->GetDest(),
+                  Read(addr, _layout.Size(i->GetDest())));
+          } break;
+
+          case opGoto:
+            it = f->label.find(i->GetDest())->second;
+            break;
+
+          case opEqual:
+          case opNotEqual:
+          case opLessThan:
+          case opLessEqual:
+          case opBiggerThan:
+          case opBiggerEqual: {
+            int a = Load(*f, ebp, i->GetSrc(1));
+            int b = Load(*f, ebp, i->GetSrc(2));
+            bool taken =
+              (op == opEqual) ? a == b : (op == opNotEqual) ? a != b :
+              (op == opLessThan) ? a < b : (op == opLessEqual) ? a <= b :
+              (op == opBiggerThan) ? a > b : a >= b;
+            if (taken) it = f->label.find(i->GetDest())->second;
+          } break;
+
+          case opParam: {
+            size_t index = dynamic_cast<CTacConst*>(i->GetDest())->GetValue();
+            if (param.size() <= index) param.resize(index + 1);
+            param[index] = Load(*f, ebp, i->GetSrc(1));
+          } break;
+
+          case opCall: {
+            string name = dynamic_cast<CTacName*>(i->GetSrc(1))->
+                            GetSymbol()->GetName();
+            map<string, size_t>::const_iterator p = _proc.find(name);
+            int v = (p != _proc.end()) && (p->second > 0) ?
+                    Call(&_frame[p->second], param) : CallRuntime(name, param);
+            param.clear();
+            if (i->GetDest() != NULL) Store(*f, ebp, i->GetDest(), v);
+          } break;
+
+          case opReturn:
+            if (i->GetSrc(1) != NULL) result = Load(*f, ebp, i->GetSrc(1));
+            it = instr.end();
+            break;
+
+          case opLabel:
+          case opNop:
+            break;
+
+          default:
+            Fail(f->scope->GetName() + ": unexpected operation " +
+                 to_string((int)op));
+        }
+      }
+
+      _sp = sp;
+      return result;
+    };
+
+    ostringstream _null;            ///< output of the frame layout
+    CFrameLayout _layout;           ///< frame layout
+    vector<CFrameInfo> _frame;      ///< frames (module first)
+    map<string, size_t> _proc;      ///< frame index by scope name
+    map<const CSymbol*, unsigned int> _global; ///< addresses of the globals
+    vector<unsigned char> _mem;     ///< memory
+    vector<int> _owner;             ///< temporary last stored to a slot
+    unsigned int _sp;               ///< stack pointer
+    unsigned int _heap;             ///< end of the global data
+    unsigned long long _steps;      ///< executed instructions
+    ostringstream _output;          ///< output of the module
+    string _error;                  ///< error that stopped the module
+};
+
+/// @brief a module with its expected output
+struct CProgram {
+  const char *name;                 ///< name
+  string text;                      ///< source
+  string expected;                  ///< expected output
+};
+
+/// @brief matrix multiplication on global and open arrays
+static const char *MatMul =
+  "module matmul;\n"
+  "var a, b, c: integer[40][40];\n"
+  "    i, j, k, n, sum, rep: integer;\n"
+  "\n"
+  "procedure init(m: integer[][]; s: integer);\n"
+  "var i, j: integer;\n"
+  "begin\n"
+  "  i := 0;\n"
+  "  while (i < 40) do\n"
+  "    j := 0;\n"
+  "    while (j < 40) do\n"
+  "      m[i][j] := (i * s + j * 7) / 3 - 5;\n"
+  "      j := j + 1\n"
+  "    end;\n"
+  "    i := i + 1\n"
+  "  end\n"
+  "end init;\n"
+  "\n"
+  "function trace(m: integer[][]): integer;\n"
+  "var i, t: integer;\n"
+  "begin\n"
+  "  i := 0; t := 0;\n"
+  "  while (i < 40) do t := t + m[i][i]; i := i + 1 end;\n"
+  "  return t\n"
+  "end trace;\n"
+  "\n"
+  "begin\n"
+  "  n := 40;\n"
+  "  init(a, 3); init(b, 5);\n"
+  "  rep := 0;\n"
+  "  while (rep < 2) do\n"
+  "    i := 0;\n"
+  "    while (i < n) do\n"
+  "      j := 0;\n"
+  "      while (j < n) do\n"
+  "        sum := 0; k := 0;\n"
+  "        while (k < n) do\n"
+  "          sum := sum + a[i][k] * b[k][j];\n"
+  "          k := k + 1\n"
+  "        end;\n"
+  "        c[i][j] := sum + rep;\n"
+  "        j := j + 1\n"
+  "      end;\n"
+  "      i := i + 1\n"
+  "    end;\n"
+  "    rep := rep + 1\n"
+  "  end;\n"
+  "  WriteInt(trace(c)); WriteLn();\n"
+  "  WriteInt(c[3][7]); WriteLn();\n"
+  "  WriteInt(c[39][0] - c[0][39]); WriteLn()\n"
+  "end matmul.\n";
+
+/// @brief sieve of Eratosthenes on a boolean array
+static const char *Sieve =
+  "module sieve;\n"
+  "var p: boolean[50000];\n"
+  "    i, j, cnt, rep, last: integer;\n"
+  "begin\n"
+  "  rep := 0;\n"
+  "  while (rep < 2) do\n"
+  "    i := 2;\n"
+  "    while (i < 50000) do p[i] := true; i := i + 1 end;\n"
+  "    i := 2; cnt := 0;\n"
+  "    while (i < 50000) do\n"
+  "      if (p[i]) then\n"
+  "        cnt := cnt + 1; last := i;\n"
+  "        j := i + i;\n"
+  "        while (j < 50000) do p[j] := false; j := j + i end\n"
+  "      end;\n"
+  "      i := i + 1\n"
+  "    end;\n"
+  "    rep := rep + 1\n"
+  "  end;\n"
+  "  WriteInt(cnt); WriteLn(); WriteInt(last); WriteLn()\n"
+  "end sieve.\n";
+
+/// @brief nested loops, recursion, short-circuit conditions and strings
+static const char *Loops =
+  "module loops;\n"
+  "var x, y, z: integer;\n"
+  "    b, c: boolean;\n"
+  "    s: char[20];\n"
+  "    v: integer[10][3];\n"
+  "\n"
+  "function f(n: integer): integer;\n"
+  "begin\n"
+  "  if (n <= 1) then return 1 end;\n"
+  "  return n * f(n - 1)\n"
+  "end f;\n"
+  "\n"
+  "function g(a: integer; b: boolean): boolean;\n"
+  "begin\n"
+  "  return b && (a > 3) || !b && (a < 2)\n"
+  "end g;\n"
+  "\n"
+  "procedure show(t: char[]; n: integer);\n"
+  "begin\n"
+  "  WriteStr(t); WriteInt(n); WriteLn()\n"
+  "end show;\n"
+  "\n"
+  "function cnt(m: integer[][]; k: integer): integer;\n"
+  "var i, j, r: integer; t: boolean;\n"
+  "begin\n"
+  "  i := 0; r := 0;\n"
+  "  while (i < 10) do\n"
+  "    j := 0;\n"
+  "    while (j < 3) do\n"
+  "      t := (m[i][j] > k) && (m[i][j] # 2 * k) || (i = j);\n"
+  "      if (t) then r := r + 1 end;\n"
+  "      if (!t && (i + j > 8)) then r := r + 100 end;\n"
+  "      j := j + 1\n"
+  "    end;\n"
+  "    i := i + 1\n"
+  "  end;\n"
+  "  return r\n"
+  "end cnt;\n"
+  "\n"
+  "begin\n"
+  "  x := 0;\n"
+  "  while (x < 10) do\n"
+  "    y := 0;\n"
+  "    while (y < 3) do\n"
+  "      v[x][y] := f(x + y) - x * y * (y + 1) / 2;\n"
+  "      y := y + 1\n"
+  "    end;\n"
+  "    x := x + 1\n"
+  "  end;\n"
+  "  show(\"cnt=\", cnt(v, 5));\n"
+  "  show(\"f(10)=\", f(10));\n"
+  "  x := 0; z := 0; b := true;\n"
+  "  while (x < 20) do\n"
+  "    c := g(x, b);\n"
+  "    if (c) then z := z + x else z := z - 1 end;\n"
+  "    b := !b || (x = 7);\n"
+  "    x := x + 1\n"
+  "  end;\n"
+  "  show(\"z=\", z);\n"
+  "  s[0] := 'h'; s[1] := 'i'; s[2] := '!'; s[3] := '\\n';\n"
+  "  WriteStr(s);\n"
+  "  x := 0; y := 100;\n"
+  "  while ((x < y) && !(x * x > 300)) do x := x + 1; y := y - 2 end;\n"
+  "  show(\"x=\", x); show(\"y=\", y)\n"
+  "end loops.\n";
+
+/// @brief return the programs used by TestRun() and TestArrays()
+///
+/// the expected outputs are those of the x86 code of the compiler before
+/// temporaries shared stack slots (and before array addressing was folded)
+///
+/// @param nstats number of statements in the loop of the generated
+///        program 'temps'
+static vector<CProgram> Programs(int nstats)
+{
+  vector<CProgram> programs;
+  CProgram p;
+
+  p.name = "matmul";
+  p.text = MatMul;
+  p.expected = "8264711\n95841\n-103844\n";
+  programs.push_back(p);
+
+  p.name = "sieve";
+  p.text = Sieve;
+  p.expected = "5133\n49999\n";
+  programs.push_back(p);
+
+  p.name = "loops";
+  p.text = Loops;
+  p.expected = "cnt=24\nf(10)=3628800\nz=78\nhi!\nx=18\ny=64\n";
+  programs.push_back(p);
+
+  // one procedure with many statements in a loop; each statement needs a
+  // few temporaries
+  ostringstream text;
+  long long sum = 0;
+  text << "module temps;" << endl
+       << "var s: integer;" << endl
+       << "procedure run();" << endl
+       << "var i: integer;" << endl
+       << "begin" << endl
+       << "  i := 0;" << endl
+       << "  while (i < 10) do" << endl;
+  for (int k=1; k<=nstats; k++) {
+    text << "    s := s + i * " << k << " - i / " << k << ";" << endl;
+    for (int i=0; i<10; i++) sum += i * k - i / k;
+  }
+  text << "    i := i + 1" << endl
+       << "  end" << endl
+       << "end run;" << endl
+       << "begin" << endl
+       << "  s := 0; run(); WriteInt(s); WriteLn()" << endl
+       << "end temps." << endl;
+
+  p.name = "temps";
+  p.text = text.str();
+  p.expected = to_string(sum) + "\n";
+  programs.push_back(p);
+
+  return programs;
+}
+
+/// @brief compile the programs of Programs() and run their TAC with the
+///        temporaries in the stack slots the backend assigns
+///
+/// the output of each program must match its expected output, no
+/// temporary may be read from a slot another temporary overwrote, and the
+/// temporaries of the generated program must fit in a few slots.
+///
+/// @param verbose print the frame layouts
+/// @retval true if all programs passed
+bool TestRun(bool verbose)
+{
+  const int nstats = 2000;
+  const size_t maxslots = 8;
+  vector<CProgram> programs = Programs(nstats);
+  size_t errors = 0;
+
+  cout << "running the TAC of " << programs.size() << " programs..." << endl;
+
+  for (size_t n=0; n<programs.size(); n++) {
+    CCompilation compilation;
+    CArena arena;
+    CCompilation *prev = CCompilation::SetCurrent(&compilation);
+    CArena *prev_arena = CArena::SetCurrent(&arena);
+
+    CScanner *s = new CScanner(programs[n].text);
+    CParser *p = new CParser(s);
+    CAstNode *ast = p->Parse();
+    string result;
+
+    if (p->HasError()) {
+      result = "parse error: " + p->GetErrorMessage();
+    } else {
+      CModule *m = new CModule(ast);
+      vector<CScope*> scopes(1, m);
+      scopes.insert(scopes.end(), m->GetSubscopes().begin(),
+                    m->GetSubscopes().end());
+      for (size_t i=0; i<scopes.size(); i++) {
+        scopes[i]->GetCodeBlock()->FromSSA();
+      }
+
+      CTacInterpreter tac(m, &compilation);
+      if (!tac.Run()) result = tac.GetError();
+      else if (tac.GetOutput() != programs[n].expected) {
+        result = "output '" + tac.GetOutput() + "', expected '" +
+                 programs[n].expected + "'";
+      }
+
+      size_t ntemps = 0, nslots = 0;
+      const vector<CFrameInfo> &frame = tac.GetFrames();
+      for (size_t f=0; f<frame.size(); f++) {
+        ntemps += frame[f].temp_ofs.size();
+        nslots = max(nslots, frame[f].nslots);
+        if (verbose) {
+          cout << "    " << frame[f].scope->GetName() << ": "
+               << frame[f].temp_ofs.size() << " temporaries in "
+               << frame[f].nslots << " slots, frame " << frame[f].size
+               << " bytes" << endl;
+        }
+      }
+      if (result.empty() && (string(programs[n].name) == "temps") &&
+          ((ntemps < nstats) || (nslots > maxslots))) {
+        result = to_string(ntemps) + " temporaries in " + to_string(nslots) +
+                 " slots, expected at most " + to_string(maxslots);
+      }
+
+      cout << "  " << left << setw(8) << programs[n].name << right
+           << (result.empty() ? "ok" : result) << " (" << tac.GetSteps()
+           << " instructions, " << ntemps << " temporaries in at most "
+           << nslots << " slots)" << endl;
+      delete m;
+    }
+
+    if (!result.empty()) errors++;
+
+    delete p;
+    delete s;
+    arena.Release();
+
+    CArena::SetCurrent(prev_arena);
+    CCompilation::SetCurrent(prev);
+  }
+
+  cout << "  errors: " << errors << endl;
+
+  return errors == 0;
+}
+
+/// @brief check the array addressing in the TAC of the programs of
+///        Programs()
+///
+/// array accesses must not call DIM or DOFS, and only scopes with open
+/// array parameters may load dimensions from a dope vector (opDeref).
+///
+/// @param verbose print the TAC of the programs
+/// @retval true if all programs passed
+bool TestArrays(bool verbose)
+{
+  vector<CProgram> programs = Programs(10);
+  size_t errors = 0;
+
+  cout << "checking the array addressing of " << programs.size()
+       << " programs..." << endl;
+
+  for (size_t n=0; n<programs.size(); n++) {
+    CCompilation compilation;
+    CArena arena;
+    CCompilation *prev = CCompilation::SetCurrent(&compilation);
+    CArena *prev_arena = CArena::SetCurrent(&arena);
+
+    CScanner *s = new CScanner(programs[n].text);
+    CParser *p = new CParser(s);
+    CAstNode *ast = p->Parse();
+    string result;
+    size_t ninstr = 0, nderef = 0;
+
+    if (p->HasError()) {
+      result = "parse error: " + p->GetErrorMessage();
+    } else {
+      CModule *m = new CModule(ast);
+      vector<CScope*> scopes(1, m);
+      scopes.insert(scopes.end(), m->GetSubscopes().begin(),
+                    m->GetSubscopes().end());
+      if (verbose) cout << m << endl;
+
+      for (size_t i=0; i<scopes.size(); i++) {
+        const string &scope = scopes[i]->GetName();
+
+        bool open = false;
+        const vector<CSymbol*> &slist =
+          scopes[i]->GetSymbolTable()->GetSymbols();
+        for (size_t k=0; k<slist.size(); k++) {
+          open = open || ((slist[k]->GetSymbolType() == stParam) &&
+                          slist[k]->GetDataType()->IsPointer());
+        }
+
+        const list<CTacInstr*> &instr =
+          scopes[i]->GetCodeBlock()->GetInstr();
+        for (list<CTacInstr*>::const_iterator it = instr.begin();
+             it != instr.end(); it++) {
+          CTacInstr *t = *it;
+          ninstr++;
+
+          if (t->GetOperation() == opCall) {
+            const string &name = dynamic_cast<CTacName*>(t->GetSrc(1))->
+                                   GetSymbol()->GetName();
+            if (((name == "DIM") || (name == "DOFS")) && result.empty()) {
+              result = scope + ": calls " + name;
+            }
+          } else if (t->GetOperation() == opDeref) {
+            nderef++;
+            if (!open && result.empty()) {
+              result = scope + ": loads from a dope vector without open "
+                       "array parameters";
+            }
+          }
+        }
+      }
+      delete m;
+    }
+
+    cout << "  " << left << setw(8) << programs[n].name << right
+         << (result.empty() ? "ok" : result) << " (" << ninstr
+         << " instructions, " << nderef << " loads from dope vectors)"
+         << endl;
+    if (!result.empty()) errors++;
+
+    delete p;
+    delete s;
+    arena.Release();
+
+    CArena::SetCurrent(prev_arena);
+    CCompilation::SetCurrent(prev);
+  }
+
+  cout << "  errors: " << errors << endl;
+
+  return errors == 0;
+}
+
 int main(int argc, char *argv[])
 {
   int i = 1;
 
+  // --concurrent N: convert all modules on N threads and compare the output
+  // with a sequential conversion
+  if ((argc > 2) && (strcmp(argv[1], "--concurrent") == 0)) {
+    vector<string> files(argv + 3, argv + argc);
+    bool ok = TestConcurrent(files, max(atoi(argv[2]), 1));
+
+    cout << "Done." << endl;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  // --cfg [-v]: build and check the control flow graphs of all modules
+  if ((argc > 1) && (strcmp(argv[1], "--cfg") == 0)) {
+    bool verbose = (argc > 2) && (strcmp(argv[2], "-v") == 0);
+    vector<string> files(argv + (verbose ? 3 : 2), argv + argc);
+    bool ok = TestCFG(files, verbose);
+
+    cout << "Done." << endl;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  // --ssa [-v]: convert all modules into SSA form and back and check them
+  if ((argc > 1) && (strcmp(argv[1], "--ssa") == 0)) {
+    bool verbose = (argc > 2) && (strcmp(argv[2], "-v") == 0);
+    vector<string> files(argv + (verbose ? 3 : 2), argv + argc);
+    bool ok = TestSSA(files, verbose);
+
+    cout << "Done." << endl;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  // --sccp [-v]: check the code after the constant propagation
+  if ((argc > 1) && (strcmp(argv[1], "--sccp") == 0)) {
+    bool verbose = (argc > 2) && (strcmp(argv[2], "-v") == 0);
+    vector<string> files(argv + (verbose ? 3 : 2), argv + argc);
+    bool ok = TestConstants(files, verbose);
+
+    cout << "Done." << endl;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  // --run [-v]: run the TAC of the built-in programs and check their output
+  if ((argc > 1) && (strcmp(argv[1], "--run") == 0)) {
+    bool verbose = (argc > 2) && (strcmp(argv[2], "-v") == 0);
+    bool ok = TestRun(verbose);
+
+    cout << "Done." << endl;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  // --arrays [-v]: check the array addressing of the built-in programs
+  if ((argc > 1) && (strcmp(argv[1], "--arrays") == 0)) {
+    bool verbose = (argc > 2) && (strcmp(argv[2], "-v") == 0);
+    bool ok = TestArrays(verbose);
+
+    cout << "Done." << endl;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
   while (i < argc) {
     // scanning, parsing & semantical analysis
     CScanner *s = new CScanner(new ifstream(argv[i]));
@@ -52,10 +1474,12 @@ int main(int argc, char *argv[])
     CAstNode *ast = p->Parse();
 
     if (p->HasError()) {
-      const CToken *error = p->GetErrorToken();
-      cout << "parse error : at " << error->GetLineNumber() << ":"
-           << error->GetCharPosition() << " : "
-           << p->GetErrorMessage() << endl;
+      const vector<CSourceError> &errors = p->GetErrors();
+      for (size_t i=0; i<errors.size(); i++) {
+        cout << "parse error : at " << errors[i].token.GetLineNumber() << ":"
+             << errors[i].token.GetCharPosition() << " : "
+             << errors[i].message << endl;
+      }
     } else {
       // AST to TAC conversion
       cout << "converting to TAC..." << endl;
@@ -32,30 +32,605 @@
 //------------------------------------------------------------------------------
 
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <fstream>
+#include <iomanip>
 #include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <iterator>
+#include <vector>
+#include <algorithm>
+#include <atomic>
 
+#include "arena.h"
 #include "scanner.h"
 #include "parser.h"
+#include "document.h"
+#include "astcache.h"
+#include "ir.h"
 using namespace std;
 
+bool prelex = false;               ///< --prelex: parse from a token buffer
+bool benchmark = false;            ///< --bench: time lexing and parsing
+bool allocs = false;               ///< --allocs: count heap allocations
+int  edits = 0;                    ///< --edits N: time incremental edits
+int  threads = 1;                  ///< --threads N: parse bodies in parallel
+bool cache = false;                ///< --cache: AST cache round trip
+
+atomic<unsigned long long> nalloc(0); ///< number of calls to operator new
+atomic<unsigned long long> nalloc_bytes(0); ///< number of bytes allocated
+
+//------------------------------------------------------------------------------
+// global operator new/delete with allocation counting
+//
+void* operator new(size_t size)
+{
+  nalloc++;
+  nalloc_bytes += size;
+
+  void *p = malloc(size > 0 ? size : 1);
+  if (p == NULL) throw bad_alloc();
+  return p;
+}
+
+void operator delete(void *p) noexcept
+{
+  free(p);
+}
+
+/// @brief print the allocations since @a n0 / @a b0
+void PrintAllocs(string phase, unsigned long long n0, unsigned long long b0)
+{
+  cout << "  " << left << setw(8) << phase << right
+       << setw(12) << nalloc - n0 << " allocations "
+       << setw(14) << nalloc_bytes - b0 << " bytes" << endl;
+}
+
+/// @brief count the heap allocations of scanning and parsing a file
+void CountAllocs(const char *fn)
+{
+  cout << "counting allocations for '" << fn << "'..." << endl;
+
+  CSourceBuffer *buf = new CSourceBuffer(fn);
+  if (!buf->Good()) {
+    cout << "  cannot open input file." << endl;
+    delete buf;
+    return;
+  }
+
+  // scanning only
+  unsigned long long n0 = nalloc, b0 = nalloc_bytes;
+  CScanner *s = new CScanner(buf);
+  long long ntok = 0;
+  while (s->Good()) {
+    CToken t = s->Get();
+    ntok++;
+    if (t.GetType() == tEOF) break;
+  }
+  delete s;
+  PrintAllocs("scan", n0, b0);
+
+  // scanning, parsing, AST and symbol table construction
+  n0 = nalloc; b0 = nalloc_bytes;
+  s = new CScanner(buf);
+  CParser *p = new CParser(s);
+  p->Parse();
+  PrintAllocs("parse", n0, b0);
+  cout << "  (" << ntok << " tokens" << (p->HasError() ? ", parse error" : "")
+       << ")" << endl;
+  CArena *a = CArena::GetCurrent();
+  if (a != NULL) {
+    cout << "  arena: " << a->GetObjects() << " objects, " << a->GetSize()
+         << " bytes" << endl;
+  }
+  delete p;
+  delete s;
+
+  delete buf;
+}
+
+/// @brief time scanning and parsing of a file, once with the scanner
+///        driving the parser and once with a pre-lexed token buffer
+void Benchmark(const char *fn)
+{
+  typedef chrono::steady_clock clock;
+
+  cout << "benchmarking '" << fn << "'..." << endl;
+
+  CSourceBuffer *buf = new CSourceBuffer(fn);
+  if (!buf->Good()) {
+    cout << "  cannot open input file." << endl;
+    delete buf;
+    return;
+  }
+
+  // scanner-driven parsing
+  clock::time_point start = clock::now();
+  CScanner *s = new CScanner(buf);
+  CParser *p = new CParser(s);
+  p->Parse();
+  double sec = chrono::duration<double>(clock::now() - start).count();
+  cout << "  scanner:  scan+parse " << fixed << setprecision(3) << sec << " s"
+       << (p->HasError() ? " (parse error)" : "") << endl;
+  delete p;
+  delete s;
+
+  // pre-lexed parsing
+  start = clock::now();
+  s = new CScanner(buf);
+  CTokenBuffer *tokens = new CTokenBuffer();
+  s->Tokenize(tokens);
+  double lex = chrono::duration<double>(clock::now() - start).count();
+  start = clock::now();
+  p = new CParser(tokens);
+  p->Parse();
+  sec = chrono::duration<double>(clock::now() - start).count();
+  cout << "  prelex:   scan " << lex << " s, parse " << sec << " s, total "
+       << lex + sec << " s  (" << tokens->GetSize() << " tokens)"
+       << (p->HasError() ? " (parse error)" : "") << endl;
+  delete p;
+
+  // parsing the subroutine bodies in parallel
+  if (threads > 1) {
+    start = clock::now();
+    p = new CParser(tokens);
+    p->Parse(threads);
+    sec = chrono::duration<double>(clock::now() - start).count();
+    cout << "  parallel: parse " << sec << " s  (" << threads << " threads)"
+         << (p->HasError() ? " (parse error)" : "") << endl;
+    delete p;
+  }
+  delete tokens;
+  delete s;
+
+  delete buf;
+}
+
+/// @brief convert a text offset into a 0-based line/character position
+void GetLineChar(const string &text, size_t pos, int *line, int *charpos)
+{
+  *line = 0;
+  size_t ls = 0;
+  for (size_t i=0; i<pos; i++) {
+    if (text[i] == '\n') { (*line)++; ls = i+1; }
+  }
+  *charpos = (int)(pos - ls);
+}
+
+/// @brief compare the diagnostics of @a doc with those of a full check
+bool CompareDiagnostics(const CDocument &doc)
+{
+  CDocument full;
+  full.SetText(doc.GetText());
+
+  vector<CDiagnostic> a = doc.GetDiagnostics(), b = full.GetDiagnostics();
+  bool same = a.size() == b.size();
+  for (size_t i=0; same && (i<a.size()); i++) {
+    same = (a[i].line == b[i].line) && (a[i].charpos == b[i].charpos) &&
+           (a[i].message == b[i].message);
+  }
+
+  if (!same) {
+    cout << "  diagnostics differ from a full check:" << endl;
+    for (size_t i=0; i<a.size(); i++) {
+      cout << "    incremental " << a[i].line+1 << ":" << a[i].charpos+1
+           << " : " << a[i].message << endl;
+    }
+    for (size_t i=0; i<b.size(); i++) {
+      cout << "    full        " << b[i].line+1 << ":" << b[i].charpos+1
+           << " : " << b[i].message << endl;
+    }
+  }
+
+  return same;
+}
+
+/// @brief time @a n random edits (each followed by its undo) of a file in a
+///        CDocument and compare the diagnostics against full checks
+bool BenchmarkEdits(const char *fn, int n)
+{
+  typedef chrono::steady_clock clock;
+
+  cout << "editing '" << fn << "'..." << endl;
+
+  ifstream in(fn);
+  if (!in.good()) {
+    cout << "  cannot open input file." << endl;
+    return false;
+  }
+  string text((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+
+  CDocument doc;
+  clock::time_point start = clock::now();
+  doc.SetText(text);
+  double full = chrono::duration<double>(clock::now() - start).count();
+
+  const char *snippet[] = { "x", " ", ";", "1", "+", "(", "end", "\n",
+                            "// c", "i := 0;" };
+  const int nsnippets = sizeof(snippet) / sizeof(snippet[0]);
+
+  srand(1);
+  double total = 0, worst = 0, incremental = 0;
+  int nincr = 0, nedits = 0, ndiff = 0;
+
+  for (int e=0; e<n; e++) {
+    const string &t = doc.GetText();
+    size_t pos = t.empty() ? 0 : rand() % t.size();
+    size_t len = 0;
+    string ins;
+
+    if (rand() % 2) ins = snippet[rand() % nsnippets];
+    else len = min((size_t)(1 + rand() % 3), t.size() - pos);
+
+    // the edit and its undo
+    for (int u=0; u<2; u++) {
+      int l0, c0, l1, c1;
+      GetLineChar(doc.GetText(), pos, &l0, &c0);
+      GetLineChar(doc.GetText(), pos + len, &l1, &c1);
+      string removed = doc.GetText().substr(pos, len);
+
+      start = clock::now();
+      bool incr = doc.Edit(l0, c0, l1, c1, ins);
+      double sec = chrono::duration<double>(clock::now() - start).count();
+
+      total += sec;
+      worst = max(worst, sec);
+      if (incr) incremental += sec;
+      nincr += incr;
+      nedits++;
+
+      len = ins.size();
+      ins = removed;
+
+      if ((nedits % 20 == 1) && !CompareDiagnostics(doc)) ndiff++;
+    }
+  }
+  if (!CompareDiagnostics(doc)) ndiff++;
+  if (doc.GetText() != text) {
+    cout << "  text differs after undoing all edits." << endl;
+    ndiff++;
+  }
+
+  cout << fixed << setprecision(3)
+       << "  full check:  " << full * 1000 << " ms" << endl
+       << "  edits:       " << nedits << " (" << nincr << " incremental)"
+       << endl
+       << "  per edit:    " << (nedits > 0 ? total / nedits * 1000 : 0)
+       << " ms average, " << worst * 1000 << " ms worst" << endl
+       << "  incremental: " << (nincr > 0 ? incremental / nincr * 1000 : 0)
+       << " ms average" << endl
+       << "  mismatches:  " << ndiff << endl;
+
+  return ndiff == 0;
+}
+
+/// @brief write @a m in the binary form of the AST cache, read it back, and
+///        compare the binary form of the copy with the original
+///
+/// (the ASTs themselves differ in the names of the string constants)
+bool CacheRoundTrip(CAstModule *m)
+{
+  ostringstream dump, redump;
+
+  CAstCache::Write(dump, 0, m);
+  istringstream load(dump.str());
+  CAstModule *copy = CAstCache::Read(load, 0);
+
+  bool ok = copy != NULL;
+  if (ok) {
+    CAstCache::Write(redump, 0, copy);
+    ok = dump.str() == redump.str();
+    delete copy;
+  }
+
+  if (ok) cout << "  (AST cache: " << dump.str().size() << " bytes)" << endl;
+  else cout << "  AST cache entry does not round-trip." << endl;
+  cout << endl;
+
+  return ok;
+}
+
+/// @brief edit a subroutine that calls a subroutine declared after it and
+///        check that the call is still rejected and the declaration order
+///        of the subroutines is kept
+bool TestForwardCall(void)
+{
+  const char *text =
+    "module fwd;\n"
+    "\n"
+    "procedure a();\n"
+    "begin\n"
+    "  b()\n"
+    "end a;\n"
+    "\n"
+    "procedure b();\n"
+    "begin\n"
+    "  a()\n"
+    "end b;\n"
+    "\n"
+    "begin\n"
+    "  a()\n"
+    "end fwd.\n";
+
+  cout << "editing a subroutine with a forward call..." << endl;
+
+  CDocument doc;
+  doc.SetText(text);
+
+  int nfail = 0, nincr = 0;
+  for (int e=0; e<100; e++) {
+    // insert a blank in front of the call in 'a' and remove it again
+    if (e % 2 == 0) nincr += doc.Edit(4, 0, 4, 0, " ");
+    else nincr += doc.Edit(4, 0, 4, 1, "");
+
+    vector<CDiagnostic> d = doc.GetDiagnostics();
+    bool ok = (d.size() == 1) && (d[0].line == 4) &&
+              (d[0].charpos == 2 + (e % 2 == 0)) &&
+              (d[0].message == "invalid symbol.");
+
+    // (the names are interned in the document's string pool; compare them
+    // by value)
+    const vector<CSymbol*> &st =
+      doc.GetModule()->GetSymbolTable()->GetSymbols();
+    int a = -1, b = -1;
+    for (size_t i=0; i<st.size(); i++) {
+      if (st[i]->GetName() == "a") a = st[i]->GetID();
+      if (st[i]->GetName() == "b") b = st[i]->GetID();
+    }
+    ok = ok && (a >= 0) && (b >= 0) && (a < b);
+
+    if (!ok) {
+      cout << "  edit " << e << ": unexpected diagnostics or symbols." << endl;
+      CompareDiagnostics(doc);
+      nfail++;
+    }
+  }
+
+  cout << "  edits: 100 (" << nincr << " incremental), failures: " << nfail
+       << endl;
+
+  return nfail == 0;
+}
+
+/// @brief parse a module with seven known mistakes sequentially and in
+///        parallel and check that each mistake is reported exactly once and
+///        that the syntax and type errors are reported in source order
+bool TestErrorCount(void)
+{
+  const char *text =
+    "module errors;\n"
+    "\n"
+    "var i: integer; b: boolean;\n"
+    "\n"
+    "procedure p(x: integer);\n"
+    "begin\n"
+    "  while (x > 0) do\n"
+    "    x := x - 1;\n"
+    "  else\n"                         // stray 'else'
+    "  end\n"
+    "end p;\n"
+    "\n"
+    "function f(): integer;\n"
+    "begin\n"
+    "  i := 1 + ;\n"                   // missing operand
+    "  return i\n"
+    "end f;\n"
+    "\n"
+    "begin\n"
+    "  i := true;\n"                   // type mismatch
+    "  i := (b + 1) * (b - 2);\n"      // two wrong operands
+    "  if (i > 0 then i := 2 end;\n"   // missing ')'
+    "  p(i)\n"                         // missing ';'
+    "  i := 3\n"
+    "end errors.\n";
+  const int expected[][2] = {
+    { 9, 3 }, { 15, 12 }, { 20, 8 }, { 21, 9 }, { 21, 19 }, { 22, 13 },
+    { 24, 3 }
+  };
+  const size_t nexpected = sizeof(expected) / sizeof(expected[0]);
+
+  cout << "counting the errors of a module with " << nexpected
+       << " mistakes..." << endl;
+
+  bool ok = true;
+  for (int threads=1; threads<=2; threads++) {
+    CScanner s(text);
+    CTokenBuffer tokens;
+    s.Tokenize(&tokens);
+    CParser p(&tokens);
+    p.Parse(threads);
+
+    const vector<CSourceError> &errors = p.GetErrors();
+    bool same = errors.size() == nexpected;
+    for (size_t e=0; same && (e<nexpected); e++) {
+      same = (errors[e].token.GetLineNumber() == expected[e][0]) &&
+             (errors[e].token.GetCharPosition() == expected[e][1]);
+    }
+
+    cout << "  " << threads << " thread(s): " << errors.size() << " errors"
+         << (same ? "" : " (expected " + to_string(nexpected) +
+                         " in source order)") << endl;
+    for (size_t e=0; !same && (e<errors.size()); e++) {
+      cout << "    " << errors[e].token.GetLineNumber() << ":"
+           << errors[e].token.GetCharPosition() << " : "
+           << errors[e].message << endl;
+    }
+    ok = ok && same;
+  }
+
+  return ok;
+}
+
+/// @brief parse modules with a very wide expression, very deep expressions
+///        and deeply nested statements and run the passes that follow the
+///        parser: type checking, printing, dot output, conversion into TAC
+///        and the destruction of the AST
+bool TestDeep(void)
+{
+  const int n = 100000;
+  const char *head =
+    "module deep;\n"
+    "var a: integer; b: boolean; v: integer[10];\n"
+    "function f(x: integer): integer;\n"
+    "begin\n"
+    "  return x\n"
+    "end f;\n"
+    "begin\n";
+  const char *tail = "\nend deep.\n";
+
+  string wide, paren, neg, call, index, nest, ends;
+  for (int i=0; i<n; i++) {
+    wide += " + a";
+    paren += "(";
+    neg += "!(";
+    call += "f(";
+    index += "v[";
+  }
+  // (the IR of nested loops takes super-linear time; 20000 levels are deep
+  // enough to overflow a recursive walk)
+  for (int i=0; i<n/5; i++) {
+    nest += (i % 1000 == 0) ? "while (b) do " : "if (b) then ";
+    ends += " end";
+  }
+  struct { const char *name; string body; } modules[] = {
+    { "wide", "  a := a" + wide },
+    { "parentheses", "  a := " + paren + "a" + string(n, ')') },
+    { "negations", "  b := " + neg + "b" + string(n, ')') },
+    { "calls", "  a := " + call + "a" + string(n, ')') },
+    { "indices", "  a := " + index + "0" + string(n, ']') },
+    { "statements", nest + "a := 1" + ends },
+  };
+  const size_t nmodules = sizeof(modules) / sizeof(modules[0]);
+
+  cout << "running the passes over modules with " << n << " operators..."
+       << endl;
+
+  bool ok = true;
+  for (size_t m=0; m<nmodules; m++) {
+    CScanner s(string(head) + modules[m].body + tail);
+    CTokenBuffer tokens;
+    s.Tokenize(&tokens);
+    CParser p(&tokens);
+    CAstModule *module = dynamic_cast<CAstModule*>(p.Parse());
+
+    CToken t;
+    string msg;
+    bool chk = !p.HasError() && (module != NULL) &&
+               module->TypeCheck(&t, &msg);
+
+    if (chk) {
+      // discard the output; printing and dot output still visit every node
+      ostream null(NULL);
+      module->print(null);
+      module->toDot(null);
+
+      // the AST is on the heap; the TAC goes into an arena (as in snuplc)
+      CArena arena;
+      CArena *prev = CArena::SetCurrent(&arena);
+      CModule *ir = new CModule(module);
+      delete ir;
+      CArena::SetCurrent(prev);
+      arena.Release();
+    }
+    delete module;
+
+    cout << "  " << modules[m].name << ": " << (chk ? "ok" : "failed")
+         << endl;
+    ok = ok && chk;
+  }
+
+  return ok;
+}
+
 int main(int argc, char *argv[])
 {
   int i = 1;
+  int result = EXIT_SUCCESS;
+  CArena pool;
+
+  // --forward: edit a subroutine containing a forward call
+  if ((argc > 1) && (strcmp(argv[1], "--forward") == 0)) {
+    return TestForwardCall() ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  // --errors: check that each mistake is reported once, in source order
+  if ((argc > 1) && (strcmp(argv[1], "--errors") == 0)) {
+    return TestErrorCount() ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  // --deep: run the passes over very wide and very deep trees
+  if ((argc > 1) && (strcmp(argv[1], "--deep") == 0)) {
+    return TestDeep() ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
 
   while (i < argc) {
+    if (strcmp(argv[i], "--prelex") == 0) { prelex = true; i++; continue; }
+    if (strcmp(argv[i], "--bench") == 0) { benchmark = true; i++; continue; }
+    if (strcmp(argv[i], "--allocs") == 0) { allocs = true; i++; continue; }
+    if (strcmp(argv[i], "--cache") == 0) { cache = true; i++; continue; }
+    if (strcmp(argv[i], "--arena") == 0) {     // allocate the AST from
+      CArena::SetCurrent(&pool);               // a per-file arena
+      i++;
+      continue;
+    }
+    if (strcmp(argv[i], "--edits") == 0) {
+      if (++i < argc) edits = atoi(argv[i++]);
+      continue;
+    }
+    if (strcmp(argv[i], "--threads") == 0) {  // parse subroutine bodies
+      if (++i < argc) threads = atoi(argv[i++]); // in parallel
+      if (threads > 1) prelex = true;
+      continue;
+    }
+
+    // release the AST of the previous file
+    pool.Release();
+
+    if (edits > 0) {
+      if (!BenchmarkEdits(argv[i], edits)) result = EXIT_FAILURE;
+      cout << endl;
+      i++;
+      continue;
+    }
+
+    if (allocs) {
+      CountAllocs(argv[i]);
+      cout << endl;
+      i++;
+      continue;
+    }
+
+    if (benchmark) {
+      Benchmark(argv[i]);
+      cout << endl;
+      i++;
+      continue;
+    }
+
     CScanner *s = new CScanner(new ifstream(argv[i]));
-    CParser *p = new CParser(s);
+    CTokenBuffer *tokens = NULL;
+    CParser *p;
+    if (prelex) {
+      tokens = new CTokenBuffer();
+      s->Tokenize(tokens);
+      p = new CParser(tokens);
+    } else {
+      p = new CParser(s);
+    }
 
     cout << "parsing '" << argv[i] << "'..." << endl;
-    CAstNode *n = p->Parse();
+    CAstNode *n = p->Parse(threads);
 
     if (p->HasError()) {
-      const CToken *error = p->GetErrorToken();
-      cout << "parse error : at " << error->GetLineNumber() << ":"
-           << error->GetCharPosition() << " : "
-           << p->GetErrorMessage() << endl;
+      const vector<CSourceError> &errors = p->GetErrors();
+      for (size_t i=0; i<errors.size(); i++) {
+        cout << "parse error : at " << errors[i].token.GetLineNumber() << ":"
+             << errors[i].token.GetCharPosition() << " : "
+             << errors[i].message << endl;
+      }
     } else {
       CAstModule *m = dynamic_cast<CAstModule*>(n);
       assert(m != NULL);
@@ -65,6 +640,8 @@ int main(int argc, char *argv[])
       m->print(cout, 4);
       cout << endl << endl;
 
+      if (cache && !CacheRoundTrip(m)) result = EXIT_FAILURE;
+
       string outf = string(argv[i]) + ".ast.dot";
       ofstream out(outf.c_str());
       out << "digraph AST {" << endl
@@ -92,5 +669,5 @@ int main(int argc, char *argv[])
 
   cout << "Done." << endl;
 
-  return EXIT_SUCCESS;
+  return result;
 }
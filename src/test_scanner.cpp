@@ -31,35 +31,585 @@
 //------------------------------------------------------------------------------
 
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <fstream>
+#include <iomanip>
+#include <chrono>
+#include <sstream>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
 
 #include "scanner.h"
+#include "scankernel.h"
 using namespace std;
 
+bool use_mmap = false;             ///< --mmap: scan from a source buffer
+bool benchmark = false;            ///< --bench: compare scanner throughput
+bool bench_parallel = false;       ///< --bench-parallel: parallel scaling
+int  nthreads = 0;                 ///< --threads N: parallel scanning
+bool check = false;                ///< --check: verify the scanner
+                                   ///< --isa NAME: select scanner kernels
+                                   ///< --bench-kernels: kernel bytes/cycle
+bool dump_bin = false;             ///< --tokens=bin: write binary dumps
+int  nfailed = 0;                  ///< number of failed checks
+
+/// @brief scan all tokens without printing them
+/// @param s scanner
+/// @retval number of tokens scanned
+long long ScanAll(CScanner *s)
+{
+  long long ntok = 0;
+
+  while (s->Good()) {
+    CToken t = s->Get();
+    ntok++;
+    if (t.GetType() == tEOF) break;
+  }
+
+  return ntok;
+}
+
+/// @brief print the throughput of a scanner run
+void PrintThroughput(string mode, size_t bytes, long long ntok, double sec)
+{
+  double mb = bytes / (1024.0*1024.0);
+
+  cout << "  " << left << setw(8) << mode << right << fixed << setprecision(3)
+       << setw(10) << sec << " s  "
+       << setw(10) << setprecision(2) << (sec > 0 ? mb/sec : 0) << " MB/s  "
+       << setw(12) << setprecision(0) << (sec > 0 ? ntok/sec : 0) << " tokens/s"
+       << "  (" << ntok << " tokens)" << endl;
+}
+
+/// @brief scan a file with the istream and the buffer scanner and compare
+///        the throughput
+void Benchmark(const char *fn)
+{
+  typedef chrono::steady_clock clock;
+
+  cout << "benchmarking '" << fn << "'..." << endl;
+
+  CSourceBuffer *buf = new CSourceBuffer(fn);
+  if (!buf->Good()) {
+    cout << "  cannot open input file." << endl;
+    delete buf;
+    return;
+  }
+
+  // istream
+  ifstream *in = new ifstream(fn);
+  clock::time_point start = clock::now();
+  CScanner *s = new CScanner(in);
+  long long ntok = ScanAll(s);
+  double sec = chrono::duration<double>(clock::now() - start).count();
+  PrintThroughput("istream", buf->GetSize(), ntok, sec);
+  delete s;
+  delete in;
+
+  // memory-mapped buffer
+  start = clock::now();
+  s = new CScanner(buf);
+  ntok = ScanAll(s);
+  sec = chrono::duration<double>(clock::now() - start).count();
+  PrintThroughput("mmap", buf->GetSize(), ntok, sec);
+  delete s;
+
+  // token output: CToken::print, CTokenPrinter, binary dump
+  CTokenBuffer tokens;
+  CScanner(buf).Tokenize(&tokens);
+  ofstream null("/dev/null");
+
+  start = clock::now();
+  for (size_t t=0; t<tokens.GetSize(); t++) {
+    null << "  " << tokens.GetToken(t) << endl;
+  }
+  sec = chrono::duration<double>(clock::now() - start).count();
+  PrintThroughput("print", buf->GetSize(), tokens.GetSize(), sec);
+
+  start = clock::now();
+  {
+    CTokenPrinter printer(&null);
+    for (size_t t=0; t<tokens.GetSize(); t++) {
+      printer.Print("  ");
+      printer.Print(tokens, t);
+      printer.Print("\n");
+    }
+  }
+  sec = chrono::duration<double>(clock::now() - start).count();
+  PrintThroughput("printer", buf->GetSize(), tokens.GetSize(), sec);
+
+  ostringstream dump;
+  start = clock::now();
+  tokens.Save(dump, CLineTable::Get());
+  sec = chrono::duration<double>(clock::now() - start).count();
+  PrintThroughput("save", buf->GetSize(), tokens.GetSize(), sec);
+
+  istringstream load(dump.str());
+  start = clock::now();
+  tokens.Load(load, CLineTable::Get());
+  sec = chrono::duration<double>(clock::now() - start).count();
+  PrintThroughput("load", buf->GetSize(), tokens.GetSize(), sec);
+  cout << "  (binary dump: " << dump.str().size() << " bytes)" << endl;
+
+  delete buf;
+}
+
+/// @brief time scanning a source buffer into a token buffer with 1 to
+///        @a maxthreads threads
+void BenchmarkParallel(const CSourceBuffer *buf, int maxthreads)
+{
+  typedef chrono::steady_clock clock;
+  double base = 0;
+
+  for (int n=1; n<=maxthreads; n++) {
+    CTokenBuffer tokens;
+    clock::time_point start = clock::now();
+    CScanner::Tokenize(buf, &tokens, n);
+    double sec = chrono::duration<double>(clock::now() - start).count();
+    if (n == 1) base = sec;
+
+    cout << "  " << setw(3) << n << " thread(s) " << fixed << setprecision(3)
+         << setw(10) << sec << " s  "
+         << setw(10) << setprecision(2)
+         << (sec > 0 ? buf->GetSize()/(1024.0*1024.0)/sec : 0) << " MB/s  "
+         << "speedup " << (sec > 0 ? base/sec : 0)
+         << "  (" << tokens.GetSize() << " tokens)" << endl;
+  }
+}
+
+/// @brief read the time stamp counter (nanoseconds if not available)
+unsigned long long Cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return chrono::duration_cast<chrono::nanoseconds>(
+           chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+/// @brief measure the bytes/cycle of each scanner kernel for all supported
+///        instruction sets
+void BenchmarkKernels(void)
+{
+  const size_t size = 1 << 20;
+  const int reps = 32;
+  const char *names[] = { "white", "eol", "ident", "digits" };
+  string data[4];
+
+  // one buffer per kernel that consists of a single run
+  for (size_t i=0; i<size; i++) {
+    data[0] += (i % 9 == 0) ? '\n' : ((i % 9 == 1) ? '\t' : ' ');
+    data[1] += "// comment banner "[i % 18];
+    data[2] += "compute_Value_0123"[i % 18];
+    data[3] += '0' + i % 10;
+  }
+
+  EScanISA best = CScanKernels::GetBestISA(), saved = CScanKernels::GetISA();
+
+  cout << "benchmarking scanner kernels (" << (size >> 10) << " KB x "
+       << reps << ", bytes/cycle)..." << endl
+       << "  " << left << setw(8) << "kernel" << right;
+  for (int isa=isaScalar; isa<=best; isa++) {
+    cout << setw(10) << CScanKernels::GetISAName((EScanISA)isa);
+  }
+  cout << endl;
+
+  for (int k=0; k<4; k++) {
+    const char *p = data[k].data(), *end = p + size;
+
+    cout << "  " << left << setw(8) << names[k] << right;
+    for (int isa=isaScalar; isa<=best; isa++) {
+      CScanKernels::SetISA((EScanISA)isa);
+
+      unsigned long long start = Cycles();
+      for (int r=0; r<reps; r++) {
+        const char *q = NULL;
+        switch (k) {
+          case 0: q = CScanKernels::SkipWhite(p, end); break;
+          case 1: q = CScanKernels::FindEOL(p, end); break;
+          case 2: q = CScanKernels::SkipIdent(p, end); break;
+          case 3: q = CScanKernels::SkipDigits(p, end); break;
+        }
+        if (q != end) cout << "(kernel stopped early) ";
+      }
+      unsigned long long cycles = Cycles() - start;
+
+      cout << fixed << setprecision(3) << setw(10)
+           << (cycles > 0 ? (double)size*reps/cycles : 0);
+    }
+    cout << endl;
+  }
+
+  CScanKernels::SetISA(saved);
+}
+
+/// @brief generate a synthetic module of (at least) @a size bytes
+string Synthesize(size_t size)
+{
+  ostringstream o;
+  int n = 0;
+
+  o << "// synthetic module" << endl
+    << "module synthetic;" << endl
+    << "var counter, total: integer;" << endl
+    << "    matrix: integer[16][16];" << endl;
+
+  while ((size_t)o.tellp() < size) {
+    o << endl
+      << "//--------------------------------------------------------------" << endl
+      << "// procedure " << n << endl
+      << "//" << endl
+      << "function compute_value_" << n << "(alpha: integer; beta: integer): integer;" << endl
+      << "var index, result: integer;" << endl
+      << "    buffer: integer[32];" << endl
+      << "begin" << endl
+      << "  index := 0; result := alpha * " << n << " + beta;" << endl
+      << "  while (index < 32) do" << endl
+      << "    buffer[index] := (result + index) * (index - 3) / 7;" << endl
+      << "    if ((result > 1000) && (matrix[index / 2][" << n % 16 << "] # 0)) then" << endl
+      << "      result := result - buffer[index]" << endl
+      << "    else" << endl
+      << "      WriteStr(\"iteration\\t\"); WriteChar('\\n')" << endl
+      << "    end;" << endl
+      << "    index := index + 1" << endl
+      << "  end;" << endl
+      << "  return result" << endl
+      << "end compute_value_" << n << ";" << endl;
+    n++;
+  }
+
+  o << endl
+    << "begin" << endl
+    << "  total := compute_value_0(counter, 1)" << endl
+    << "end synthetic." << endl;
+
+  return o.str();
+}
+
+/// @brief check the token types produced for a set of reference inputs
+///        covering all keywords, operators and lexical errors
+/// @retval number of failed inputs
+int CheckLexemes(void)
+{
+  const struct {
+    const char *source;
+    vector<EToken> tokens;
+  } cases[] = {
+    { "module begin end true false char boolean integer if then else",
+      { tModule, tBegin, tEnd, tBoolean, tBoolean, tBaseType, tBaseType,
+        tBaseType, tIf, tThen, tElse } },
+    { "while do return var procedure function break",
+      { tWhile, tDo, tReturn, tVar, tProcedure, tFunction, tBreak } },
+    { "modules Module modul _if if0 doo ends var_ x Break integers",
+      { tId, tId, tId, tId, tId, tId, tId, tId, tId, tId, tId } },
+    { "+ - || * / && | & |& &|",
+      { tTermOp, tTermOp, tTermOp, tFactOp, tFactOp, tFactOp, tUndefined,
+        tUndefined, tUndefined, tUndefined, tUndefined, tUndefined } },
+    { "< <= > >= = # := : ; . , ( ) [ ] ! =<",
+      { tRelOp, tRelOp, tRelOp, tRelOp, tRelOp, tRelOp, tAssign, tColon,
+        tSemicolon, tDot, tComma, tLBrak, tRBrak, tLSBrak, tRSBrak, tCompl,
+        tRelOp, tRelOp } },
+    { "12ab a12 0 007",
+      { tNumber, tId, tId, tNumber, tNumber } },
+    { "a//comment ; x\nb/c//\n/",
+      { tId, tId, tFactOp, tId, tFactOp } },
+    { "'a' '\\n' '\\0' 'ab' '\\q' '' \"s\\t\" \"\" \"x",
+      { tChar, tChar, tChar, tUndefined, tUndefined, tUndefined, tString,
+        tString, tUndefined } },
+    { "$ % ^ ~ ? @ ` \\ { } \r",
+      { tUndefined, tUndefined, tUndefined, tUndefined, tUndefined,
+        tUndefined, tUndefined, tUndefined, tUndefined, tUndefined,
+        tUndefined } },
+  };
+  int ncases = sizeof(cases) / sizeof(cases[0]);
+  int failed = 0;
+
+  for (int c=0; c<ncases; c++) {
+    CScanner s(cases[c].source);
+    vector<EToken> expected = cases[c].tokens;
+    expected.push_back(tEOF);
+
+    bool ok = true;
+    for (size_t t=0; t<expected.size(); t++) {
+      CToken token = s.Get();
+      if (token.GetType() != expected[t]) {
+        cout << "  case " << c << ", token " << t << ": expected "
+             << CToken::Name(expected[t]) << ", got " << token << endl;
+        ok = false;
+        break;
+      }
+    }
+    if (!ok) failed++;
+  }
+
+  cout << "  " << ncases << " reference inputs, " << failed << " failed."
+       << endl;
+
+  return failed;
+}
+
+/// @brief compare two token buffers
+/// @retval index of the first differing token or -1 if they are identical
+long long CompareTokens(const CTokenBuffer &a, const CTokenBuffer &b)
+{
+  size_t n = min(a.GetSize(), b.GetSize());
+
+  for (size_t i=0; i<n; i++) {
+    if ((a.GetType(i) != b.GetType(i)) || (a.GetValue(i) != b.GetValue(i)) ||
+        (a.GetPosition(i) != b.GetPosition(i))) return i;
+  }
+
+  return a.GetSize() == b.GetSize() ? -1 : n;
+}
+
+/// @brief check that the istream, the buffer and the parallel scanner
+///        produce identical token streams for a file
+/// @retval true if all token streams are identical
+bool CheckFile(const char *fn)
+{
+  CTokenBuffer ref;
+  ifstream in(fn);
+  CScanner(&in).Tokenize(&ref);
+
+  CSourceBuffer buf(fn);
+  bool ok = true;
+
+  for (int n=1; n<=4; n++) {
+    CTokenBuffer tokens;
+    if (n == 1) CScanner(&buf).Tokenize(&tokens);
+    else CScanner::Tokenize(&buf, &tokens, n);
+
+    long long diff = CompareTokens(ref, tokens);
+    if (diff >= 0) {
+      cout << "  " << (n == 1 ? "buffer" : "parallel") << " scanner ("
+           << n << " thread(s)) differs at token " << diff << ": "
+           << ref.GetToken(diff) << " vs. " << tokens.GetToken(diff) << endl;
+      ok = false;
+    }
+  }
+
+  // binary dump round trip
+  CLineTable *lines = CLineTable::Get();
+  vector<unsigned int> start, loaded;
+  lines->GetLineStarts(&start);
+
+  stringstream dump;
+  CTokenBuffer tokens;
+  ref.Save(dump, lines);
+  if (!tokens.Load(dump, lines) || (CompareTokens(ref, tokens) >= 0)) {
+    cout << "  binary token dump does not round-trip." << endl;
+    ok = false;
+  }
+  lines->GetLineStarts(&loaded);
+  if (loaded != start) {
+    cout << "  line table does not round-trip." << endl;
+    ok = false;
+  }
+
+  // CTokenPrinter prints the same text as CToken::print
+  ostringstream text, fast;
+  {
+    CTokenPrinter printer(&fast);
+    for (size_t t=0; t<ref.GetSize(); t++) {
+      text << ref.GetToken(t) << endl;
+      printer.Print(ref, t);
+      printer.Print("\n");
+    }
+  }
+  if (text.str() != fast.str()) {
+    cout << "  token printer output differs from CToken::print." << endl;
+    ok = false;
+  }
+
+  cout << "  " << ref.GetSize() << " tokens, "
+       << (ok ? "identical." : "MISMATCH.") << endl;
+
+  return ok;
+}
+
 int main(int argc, char *argv[])
 {
   int i = 1;
+  int maxthreads = thread::hardware_concurrency();
+  if (maxthreads < 1) maxthreads = 1;
 
   while (i < argc) {
-    CScanner *s = new CScanner(new ifstream(argv[i]));
+    if (strcmp(argv[i], "--mmap") == 0) { use_mmap = true; i++; continue; }
+    if (strcmp(argv[i], "--bench") == 0) { benchmark = true; i++; continue; }
+    if (strcmp(argv[i], "--tokens=bin") == 0) { dump_bin = true; i++; continue; }
+    if (strcmp(argv[i], "--tokens=text") == 0) { dump_bin = false; i++; continue; }
+    if ((strcmp(argv[i], "--isa") == 0) && (i+1 < argc)) {
+      int isa = isaScalar;
+      while ((isa <= isaAVX2) &&
+             (strcmp(argv[i+1], CScanKernels::GetISAName((EScanISA)isa)) != 0)) {
+        isa++;
+      }
+      if ((isa > isaAVX2) || !CScanKernels::SetISA((EScanISA)isa)) {
+        cout << "instruction set '" << argv[i+1] << "' not supported." << endl;
+      }
+      i += 2;
+      continue;
+    }
+    if (strcmp(argv[i], "--bench-kernels") == 0) {
+      BenchmarkKernels();
+      cout << endl;
+      i++;
+      continue;
+    }
+    if (strcmp(argv[i], "--check") == 0) {
+      cout << "checking scanner..." << endl;
+      nfailed += CheckLexemes();
+      cout << endl;
+      check = true;
+      i++;
+      continue;
+    }
+    if (strcmp(argv[i], "--bench-parallel") == 0) {
+      bench_parallel = true; i++; continue;
+    }
+    if ((strcmp(argv[i], "--threads") == 0) && (i+1 < argc)) {
+      nthreads = maxthreads = atoi(argv[i+1]);
+      i += 2;
+      continue;
+    }
+    if ((strcmp(argv[i], "--synthetic") == 0) && (i+1 < argc)) {
+      string src = Synthesize(atol(argv[i+1]) * 1024 * 1024);
+      CSourceBuffer buf(src.data(), src.size());
+      cout << "benchmarking synthetic module (" << src.size() << " bytes)..."
+           << endl;
+      BenchmarkParallel(&buf, maxthreads);
+      cout << endl;
+      i += 2;
+      continue;
+    }
+
+    if (benchmark) {
+      Benchmark(argv[i]);
+      cout << endl;
+      i++;
+      continue;
+    }
+
+    if (check) {
+      cout << "checking '" << argv[i] << "'..." << endl;
+      if (!CheckFile(argv[i])) nfailed++;
+      cout << endl;
+      i++;
+      continue;
+    }
+
+    if (bench_parallel) {
+      CSourceBuffer buf(argv[i]);
+      cout << "benchmarking '" << argv[i] << "'..." << endl;
+      if (buf.Good()) BenchmarkParallel(&buf, maxthreads);
+      else cout << "  cannot open input file." << endl;
+      cout << endl;
+      i++;
+      continue;
+    }
 
-    cout << "scanning '" << argv[i] << "'..." << endl;
+    string fn(argv[i]);
+
+    if (dump_bin) {
+      // scan into a token buffer and write it in binary form
+      CSourceBuffer buf(fn);
+      CTokenBuffer tokens;
+      CScanner(&buf).Tokenize(&tokens);
+
+      ofstream out(fn + ".tok", ios::binary);
+      cout << "dumping '" << fn << "'..." << endl;
+      if (buf.Good() && tokens.Save(out, CLineTable::Get())) {
+        cout << "  " << tokens.GetSize() << " tokens written to '" << fn
+             << ".tok'." << endl;
+      } else {
+        cout << "  cannot dump tokens." << endl;
+      }
+
+      cout << endl << endl;
+      i++;
+      continue;
+    }
+
+    cout << "scanning '" << fn << "'..." << endl;
+
+    if ((fn.size() > 4) && (fn.compare(fn.size() - 4, 4, ".tok") == 0)) {
+      // print a binary token dump
+      ifstream in(fn, ios::binary);
+      CTokenBuffer tokens;
+      if (!tokens.Load(in, CLineTable::Get())) {
+        cout << "  invalid token dump." << endl;
+      } else {
+        CTokenPrinter printer(&cout);
+        for (size_t t=0; t<tokens.GetSize(); t++) {
+          printer.Print("  ");
+          printer.Print(tokens, t);
+          printer.Print("\n");
+        }
+      }
+
+      cout << endl << endl;
+      i++;
+      continue;
+    }
+
+    if (nthreads > 0) {
+      // scan in parallel into a token buffer, then print the buffer
+      CSourceBuffer buf(argv[i]);
+      CTokenBuffer tokens;
+      CScanner::Tokenize(&buf, &tokens, nthreads);
+
+      if (tokens.GetType(0) == tIOError) {
+        cout << "  cannot open input stream: " << tokens.GetToken(0) << endl;
+      } else {
+        CTokenPrinter printer(&cout);
+        for (size_t t=0; t<tokens.GetSize(); t++) {
+          printer.Print("  ");
+          printer.Print(tokens, t);
+          printer.Print("\n");
+        }
+      }
+
+      cout << endl << endl;
+      i++;
+      continue;
+    }
+
+    CSourceBuffer *buf = NULL;
+    CScanner *s;
+    if (use_mmap) {
+      buf = new CSourceBuffer(argv[i]);
+      s = new CScanner(buf);
+    } else {
+      s = new CScanner(new ifstream(argv[i]));
+    }
 
     if (!s->Good()) cout << "  cannot open input stream: " << s->Peek() << endl;
 
-    while (s->Good()) {
-      CToken t = s->Get();
-      cout << "  " << t << endl;
-      if (t.GetType() == tEOF) break;
+    {
+      CTokenPrinter printer(&cout);
+      while (s->Good()) {
+        CToken t = s->Get();
+        printer.Print("  ");
+        printer.Print(t);
+        printer.Print("\n");
+        if (t.GetType() == tEOF) break;
+      }
     }
 
     cout << endl << endl;
 
+    delete s;
+    delete buf;
+
     i++;
   }
 
   cout << "Done." << endl;
 
-  return EXIT_SUCCESS;
+  return nfailed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -31,16 +31,42 @@
 /// DAMAGE.
 //------------------------------------------------------------------------------
 
+#include <algorithm>
 #include <cassert>
 
 #include "type.h"
+#include "compilation.h"
 using namespace std;
 
 
+/// @brief kinds of types (seeds of the structural hashes)
+enum EHashKind { hkNull=1, hkInt, hkChar, hkBool, hkPointer, hkArray };
+
+/// @brief combine a hash value with another value
+static inline size_t HashCombine(size_t h, size_t v)
+{
+  return h ^ (v + (size_t)0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2));
+}
+
+/// @brief structural hash of a pointer type
+static inline size_t PointerHash(const CType *basetype)
+{
+  return HashCombine(hkPointer, basetype != NULL ? basetype->GetHash() : 0);
+}
+
+/// @brief structural hash of an array type
+static inline size_t ArrayHash(int nelem, const CType *innertype)
+{
+  return HashCombine(HashCombine(hkArray, (size_t)nelem),
+                     innertype->GetHash());
+}
+
+
 //------------------------------------------------------------------------------
 // CType
 //
 CType::CType(void)
+  : _hash(0)
 {
 }
 
@@ -86,6 +112,7 @@ bool CScalarType::Match(const CType *t) const
 CNullType::CNullType(void)
   : CScalarType()
 {
+  _hash = hkNull;
 }
 
 ostream& CNullType::print(ostream &out, int indent) const
@@ -102,6 +129,7 @@ ostream& CNullType::print(ostream &out, int indent) const
 CIntType::CIntType(void)
   : CScalarType()
 {
+  _hash = hkInt;
 }
 
 ostream& CIntType::print(ostream &out, int indent) const
@@ -121,6 +149,7 @@ ostream& CIntType::print(ostream &out, int indent) const
 CCharType::CCharType(void)
   : CScalarType()
 {
+  _hash = hkChar;
 }
 
 ostream& CCharType::print(ostream &out, int indent) const
@@ -140,6 +169,7 @@ ostream& CCharType::print(ostream &out, int indent) const
 CBoolType::CBoolType(void)
   : CScalarType()
 {
+  _hash = hkBool;
 }
 
 ostream& CBoolType::print(ostream &out, int indent) const
@@ -159,10 +189,13 @@ ostream& CBoolType::print(ostream &out, int indent) const
 CPointerType::CPointerType(const CType *basetype)
   : CScalarType(), _basetype(basetype)
 {
+  _hash = PointerHash(basetype);
 }
 
 bool CPointerType::Match(const CType *t) const
 {
+  // types are interned, i.e., identical types are the same object
+  if (t == this) return true;
   if ((t == NULL) || !t->IsPointer()) return false;
 
   const CPointerType *pt = dynamic_cast<const CPointerType*>(t);
@@ -177,6 +210,9 @@ bool CPointerType::Match(const CType *t) const
 
 bool CPointerType::Compare(const CType *t) const
 {
+  // types are interned, i.e., identical types are the same object
+  if (t == this) return true;
+
   // check whether t is a pointer
   if ((t == NULL) || !t->IsPointer()) return false;
 
@@ -209,6 +245,14 @@ CArrayType::CArrayType(int nelem, const CType *innertype)
 {
   assert((_nelem > 0) || (_nelem == OPEN));
   assert(_innertype != NULL);
+
+  _hash = ArrayHash(nelem, innertype);
+
+  // open dimensions and void pointers match types other than themselves
+  if (_nelem == OPEN) _exact = false;
+  else if (innertype->IsArray()) {
+    _exact = dynamic_cast<const CArrayType*>(innertype)->_exact;
+  } else _exact = !innertype->IsPointer();
 }
 
 CArrayType::~CArrayType(void)
@@ -253,6 +297,11 @@ int CArrayType::GetNDim(void) const
 
 bool CArrayType::Match(const CType *t) const
 {
+  // types are interned, i.e., without open dimensions only identical types
+  // (the same object) match
+  if (t == this) return true;
+  if (_exact) return false;
+
   if (t->IsArray()) {
     const CArrayType *at = dynamic_cast<const CArrayType*>(t);
     assert(at != NULL);
@@ -270,18 +319,8 @@ bool CArrayType::Match(const CType *t) const
 
 bool CArrayType::Compare(const CType *t) const
 {
-  if (t->IsArray()) {
-    const CArrayType *at = dynamic_cast<const CArrayType*>(t);
-    assert(at != NULL);
-
-    // comparison: match if
-    // - the number of elements match and
-    // - the inner types are compatible with respect to Compare()
-    return ((GetNElem() == at->GetNElem()) &&
-            GetInnerType()->Compare(at->GetInnerType()));
-  } else {
-    return false;
-  }
+  // types are interned, i.e., identical array types are the same object
+  return t == this;
 }
 
 ostream& CArrayType::print(ostream &out, int indent) const
@@ -301,34 +340,50 @@ ostream& CArrayType::print(ostream &out, int indent) const
 //------------------------------------------------------------------------------
 // CTypeManager
 //
-CTypeManager* CTypeManager::_global_tm = NULL;
+/// @brief order key of the next type request of this thread
+static thread_local unsigned long long _order =
+  (unsigned long long)CTypeManager::NOORDER << 32;
+
+/// @brief return the order key of a type request
+static inline unsigned long long NextOrder(void)
+{
+  unsigned long long key = _order;
+  if ((key >> 32) != CTypeManager::NOORDER) _order++;
+  return key;
+}
 
 CTypeManager::CTypeManager(void)
 {
-  _null = new CNullType();
-  _integer = new CIntType();
-  _char = new CCharType();
-  _boolean = new CBoolType();
-  _voidptr = new CPointerType(_null);
+  // the base types are immutable and shared by all type managers
+  static CNullType null;
+  static CIntType integer;
+  static CCharType chr;
+  static CBoolType boolean;
+  static CPointerType voidptr(&null);
+
+  _null = &null;
+  _integer = &integer;
+  _char = &chr;
+  _boolean = &boolean;
+  _voidptr = &voidptr;
+  _ptr_index.insert(make_pair(_voidptr->GetHash(), _ptr.size()));
   _ptr.push_back(_voidptr);
+  _ptr_order.push_back(NextOrder());
+  _ptr_mark = _array_mark = 0;
 }
 
 CTypeManager::~CTypeManager(void)
 {
-  delete _null;
-  delete _integer;
-  delete _char;
-  delete _boolean;
-  // _voidptr is a member of _pointer and will get deleted just below
-  for (size_t i=0; i<_ptr.size(); i++) delete _ptr[i];
+  // _voidptr is a member of _ptr but shared
+  for (size_t i=0; i<_ptr.size(); i++) {
+    if (_ptr[i] != _voidptr) delete _ptr[i];
+  }
   for (size_t i=0; i<_array.size(); i++) delete _array[i];
 }
 
 CTypeManager* CTypeManager::Get(void)
 {
-  if (_global_tm == NULL) _global_tm = new CTypeManager();
-
-  return _global_tm;
+  return CCompilation::GetCurrent()->GetTypeManager();
 }
 
 const CNullType* CTypeManager::GetNull(void) const
@@ -358,33 +413,115 @@ const CPointerType* CTypeManager::GetVoidPtr(void) const
 
 const CPointerType* CTypeManager::GetPointer(const CType *basetype)
 {
-  for (size_t i=0; i<_ptr.size(); i++) {
-    if ((_ptr[i]->GetBaseType()->Compare(basetype))) {
+  unsigned long long key = NextOrder();
+  size_t hash = PointerHash(basetype);
+  lock_guard<mutex> guard(_lock);
+
+  // the inner types are interned as well, i.e., identical composite types
+  // have the same base type object
+  auto range = _ptr_index.equal_range(hash);
+  for (auto it=range.first; it!=range.second; it++) {
+    size_t i = it->second;
+    if (_ptr[i]->GetBaseType() == basetype) {
+      _ptr_order[i] = min(_ptr_order[i], key);
       return _ptr[i];
     }
   }
 
   CPointerType *p = new CPointerType(basetype);
+  _ptr_index.insert(make_pair(hash, _ptr.size()));
   _ptr.push_back(p);
+  _ptr_order.push_back(key);
 
   return p;
 }
 
 const CArrayType* CTypeManager::GetArray(int nelem, const CType *innertype)
 {
-  for (size_t i=0; i<_array.size(); i++) {
+  unsigned long long key = NextOrder();
+  size_t hash = ArrayHash(nelem, innertype);
+  lock_guard<mutex> guard(_lock);
+
+  auto range = _array_index.equal_range(hash);
+  for (auto it=range.first; it!=range.second; it++) {
+    size_t i = it->second;
     if ((_array[i]->GetNElem() == nelem) &&
-        (_array[i]->GetInnerType()->Compare(innertype))) {
+        (_array[i]->GetInnerType() == innertype)) {
+      _array_order[i] = min(_array_order[i], key);
       return _array[i];
     }
   }
 
   CArrayType *a = new CArrayType(nelem, innertype);
+  _array_index.insert(make_pair(hash, _array.size()));
   _array.push_back(a);
+  _array_order.push_back(key);
 
   return a;
 }
 
+void CTypeManager::GetTypes(vector<const CType*> *types) const
+{
+  types->clear();
+  types->insert(types->end(), _array.begin(), _array.end());
+  types->insert(types->end(), _ptr.begin(), _ptr.end());
+}
+
+void CTypeManager::SetOrder(unsigned int key)
+{
+  _order = (unsigned long long)key << 32;
+}
+
+void CTypeManager::BeginOrder(void)
+{
+  _ptr_mark = _ptr.size();
+  _array_mark = _array.size();
+}
+
+void CTypeManager::EndOrder(unsigned int cutoff)
+{
+  SortOrder(_ptr, _ptr_order, _ptr_index, _ptr_mark, cutoff);
+  SortOrder(_array, _array_order, _array_index, _array_mark, cutoff);
+}
+
+template<class T>
+void CTypeManager::SortOrder(vector<T*> &types,
+                             vector<unsigned long long> &order,
+                             unordered_multimap<size_t, size_t> &index,
+                             size_t mark, unsigned int cutoff)
+{
+  vector<pair<unsigned long long, T*> > sorted;
+  for (size_t i=mark; i<types.size(); i++) {
+    sorted.push_back(make_pair(order[i], types[i]));
+  }
+
+  // untagged types have equal keys and keep their relative order
+  stable_sort(sorted.begin(), sorted.end(),
+              [](const pair<unsigned long long, T*> &a,
+                 const pair<unsigned long long, T*> &b)
+              { return a.first < b.first; });
+
+  // a type is created after the types it is composed of and has a larger
+  // key, i.e., discarded types are not referenced by the remaining ones
+  types.resize(mark);
+  order.resize(mark);
+  for (size_t i=0; i<sorted.size(); i++) {
+    unsigned int key = (unsigned int)(sorted[i].first >> 32);
+    if ((key != NOORDER) && (key >= cutoff)) {
+      delete sorted[i].second;
+    } else {
+      types.push_back(sorted[i].second);
+      order.push_back(sorted[i].first);
+    }
+  }
+
+  // the positions of the sorted types have changed
+  index.clear();
+  for (size_t i=0; i<types.size(); i++) {
+    index.insert(make_pair(types[i]->GetHash(), i));
+  }
+}
+
 ostream& CTypeManager::print(ostream &out, int indent) const
 {
   string ind(indent, ' ');
@@ -35,6 +35,8 @@
 #define __SnuPL_TYPE_H__
 
 #include <iostream>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 using namespace std;
 
@@ -121,6 +123,15 @@ class CType {
     /// @retval false if the types are not identical
     virtual bool Compare(const CType *t) const;
 
+    /// @brief return the structural hash of this type
+    ///
+    /// the hash is computed from the kind of the type and, for composite
+    /// types, from the element count and the hash of the inner type when
+    /// the type is created. It is used by the type manager to intern types.
+    ///
+    /// @retval size_t structural hash
+    size_t GetHash(void) const { return _hash; };
+
     /// @}
 
     /// @brief print the type to an output stream
@@ -128,6 +139,9 @@ class CType {
     /// @param out output stream
     /// @param indent indentation
     virtual ostream&  print(ostream &out, int indent=0) const = 0;
+
+  protected:
+    size_t        _hash;          ///< structural hash
 };
 
 /// @name CType output operators
@@ -489,17 +503,29 @@ class CArrayType : public CType {
   private:
     int            _nelem;        ///< element count
     const CType   *_innertype;    ///< inner type
+    bool           _exact;        ///< Match() is identical to Compare(), i.e.,
+                                  ///< no dimension is open
 };
 
 
 //------------------------------------------------------------------------------
 /// @brief type manager
 ///
-/// manages all types in a module
+/// manages all types in a module. Each compilation has its own type manager
+/// (see CCompilation); the base types are shared by all type managers.
+///
+/// composite types are hash-consed: GetPointer() and GetArray() look up the
+/// structural hash of the requested type in a hash table and create a new
+/// type only if no identical type exists. Two types are thus identical
+/// (Compare()) exactly if their pointers are equal.
 ///
 class CTypeManager {
+  friend class CCompilation;
+
   public:
-    /// @brief return the global type manager
+    /// @brief return the type manager of the current compilation
+    ///
+    /// see CCompilation
     static CTypeManager* Get(void);
 
     /// @name base types
@@ -527,6 +553,49 @@ class CTypeManager {
     /// @param innertype type of array elements
     const CArrayType* GetArray(int nelem, const CType* innertype);
 
+    /// @brief return all composite types
+    ///
+    /// array types are listed before pointer types, each in the order of
+    /// the type manager. A type is listed after the types it is composed of.
+    ///
+    /// @param types (out) composite types
+    void GetTypes(vector<const CType*> *types) const;
+
+    /// @}
+
+    /// @name type order
+    ///
+    /// composite types are listed in the order in which they were first
+    /// requested. Types may be requested by several threads concurrently
+    /// (see CParser::Parse()); to keep the order independent of the thread
+    /// schedule, each thread tags its requests with an order key. EndOrder()
+    /// sorts the types created since BeginOrder() by the smallest key they
+    /// were requested with.
+    /// @{
+
+    /// @brief set the order key of the requests of the calling thread
+    ///
+    /// the requests are numbered consecutively within a key, i.e., keys
+    /// denote the parts of the input in the order a single thread would
+    /// process them.
+    ///
+    /// @param key order key (NOORDER: untagged)
+    static void SetOrder(unsigned int key);
+
+    /// @brief start tagging the types created from now on
+    void BeginOrder(void);
+
+    /// @brief sort the types created since BeginOrder() by their order key
+    ///
+    /// untagged types are sorted last. Types that have only been requested
+    /// with a key >= @a cutoff are deleted (used to discard the types
+    /// requested by parts of the input that follow an error).
+    ///
+    /// @param cutoff first key whose types are discarded
+    void EndOrder(unsigned int cutoff=NOORDER);
+
+    static const unsigned int NOORDER = ~0u; ///< no order key
+
     /// @}
 
     /// @brief print all types to an output stream
@@ -544,16 +613,30 @@ class CTypeManager {
 
     /// @}
 
-    CNullType     *_null;         ///< null base type
-    CIntType      *_integer;      ///< integer base type
-    CCharType     *_char;         ///< char base type
-    CBoolType     *_boolean;      ///< boolean base type
-    CPointerType  *_voidptr;      ///< void pointer type
+    /// @brief sort the types created since BeginOrder() by their order key
+    template<class T>
+    void SortOrder(vector<T*> &types, vector<unsigned long long> &order,
+                   unordered_multimap<size_t, size_t> &index,
+                   size_t mark, unsigned int cutoff);
+
+    CNullType     *_null;         ///< null base type (shared)
+    CIntType      *_integer;      ///< integer base type (shared)
+    CCharType     *_char;         ///< char base type (shared)
+    CBoolType     *_boolean;      ///< boolean base type (shared)
+    CPointerType  *_voidptr;      ///< void pointer type (shared)
 
     vector<CPointerType*> _ptr;   ///< pointer types
     vector<CArrayType*> _array;   ///< array types
+    vector<unsigned long long> _ptr_order;   ///< order keys of _ptr
+    vector<unsigned long long> _array_order; ///< order keys of _array
+    unordered_multimap<size_t, size_t> _ptr_index;
+                                  ///< positions in _ptr by structural hash
+    unordered_multimap<size_t, size_t> _array_index;
+                                  ///< positions in _array by structural hash
+    size_t        _ptr_mark;      ///< pointer types before BeginOrder()
+    size_t        _array_mark;    ///< array types before BeginOrder()
+    mutex         _lock;          ///< protects the composite types
 
-    static CTypeManager *_global_tm; ///< global type manager instance
 };
 
 